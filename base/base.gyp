@@ -468,6 +468,7 @@
         'debug/crash_logging_unittest.cc',
         'debug/leak_tracker_unittest.cc',
         'debug/proc_maps_linux_unittest.cc',
+        'debug/sampling_heap_profiler_unittest.cc',
         'debug/stack_trace_unittest.cc',
         'debug/trace_event_memory_unittest.cc',
         'debug/trace_event_unittest.cc',
@@ -514,6 +515,7 @@
         'md5_unittest.cc',
         'memory/aligned_memory_unittest.cc',
         'memory/discardable_memory_unittest.cc',
+        'memory/discardable_memory_provider_linux_unittest.cc',
         'memory/linked_ptr_unittest.cc',
         'memory/ref_counted_memory_unittest.cc',
         'memory/ref_counted_unittest.cc',
@@ -0,0 +1,438 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/sampling_heap_profiler.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/atomicops.h"
+#include "base/debug/leak_annotations.h"
+#include "base/debug/stack_trace.h"
+#include "base/debug/trace_event.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include "base/debug/proc_maps_linux.h"
+#endif
+
+namespace base {
+namespace debug {
+
+namespace {
+
+// Deepest call stack recorded per sample.
+const size_t kMaxStackDepth = 32;
+
+// Frames for StackTrace's constructor and RecordAlloc() itself.
+const size_t kSkipFrames = 2;
+
+// Table sizes, all powers of two.
+const size_t kBucketTableSize = 4096;
+const size_t kLiveTableSize = 1 << 16;
+const size_t kLiveFilterSize = 8192;
+
+// Longest probe sequence before a table is considered full.
+const size_t kMaxProbes = 32;
+
+// Sampled allocations that share a call stack.
+struct Bucket {
+  // Hash of |frames|. Zero while the bucket is unclaimed.
+  subtle::AtomicWord hash;
+  // Set once |depth| and |frames| have been written.
+  subtle::Atomic32 ready;
+  size_t depth;
+  const void* frames[kMaxStackDepth];
+  subtle::AtomicWord alloc_count;
+  subtle::AtomicWord alloc_bytes;
+  subtle::AtomicWord free_count;
+  subtle::AtomicWord free_bytes;
+};
+
+// A sampled allocation that has not been freed yet.
+struct LiveSample {
+  // Zero for a slot never used, kFreedAddress for a slot that can be reused.
+  subtle::AtomicWord address;
+  Bucket* bucket;
+  size_t size;
+};
+
+const subtle::AtomicWord kFreedAddress = 1;
+
+// The tables are allocated by the first Start() and never freed, as hooks
+// running on other threads may still use them after Stop().
+Bucket* g_buckets = NULL;
+LiveSample* g_live_samples = NULL;
+// Number of live samples per address hash. Lets RecordFree() rule out most
+// addresses by looking at a table small enough to stay in cache.
+subtle::Atomic32* g_live_filter = NULL;
+
+subtle::Atomic32 g_running = 0;
+subtle::AtomicWord g_sampling_interval = 0;
+// Bytes left to allocate before the next sample is taken.
+subtle::AtomicWord g_bytes_until_sample = 0;
+// xorshift state for drawing sampling intervals. Never zero.
+subtle::Atomic32 g_random_state = 1;
+subtle::Atomic32 g_dropped_samples = 0;
+
+size_t HashStack(const void* const* frames, size_t depth) {
+  uintptr_t hash = 0;
+  for (size_t i = 0; i < depth; ++i) {
+    hash += reinterpret_cast<uintptr_t>(frames[i]);
+    hash += hash << 10;
+    hash ^= hash >> 6;
+  }
+  hash += hash << 3;
+  hash ^= hash >> 11;
+  return hash;
+}
+
+size_t HashAddress(const void* address) {
+  // Allocations are at least 8-byte aligned, so the low bits carry nothing.
+  uintptr_t key = reinterpret_cast<uintptr_t>(address) >> 3;
+  key ^= key >> 16;
+  key *= 0x45d9f3b;
+  key ^= key >> 16;
+  return key;
+}
+
+// Draws the number of bytes until the next sample from an exponential
+// distribution, which makes the samples a Poisson process over bytes.
+subtle::AtomicWord NextSampleInterval() {
+  subtle::Atomic32 state;
+  uint32 next;
+  do {
+    state = subtle::NoBarrier_Load(&g_random_state);
+    next = static_cast<uint32>(state);
+    next ^= next << 13;
+    next ^= next >> 17;
+    next ^= next << 5;
+  } while (subtle::NoBarrier_CompareAndSwap(
+               &g_random_state, state,
+               static_cast<subtle::Atomic32>(next)) != state);
+  // |next| is never zero, so |uniform| is in (0, 1).
+  double uniform = next / 4294967296.0;
+  double interval = -log(uniform) *
+      subtle::NoBarrier_Load(&g_sampling_interval);
+  return static_cast<subtle::AtomicWord>(interval) + 1;
+}
+
+Bucket* FindOrCreateBucket(const void* const* frames, size_t depth) {
+  const subtle::AtomicWord hash = HashStack(frames, depth) | 1;
+  for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+    Bucket* bucket =
+        &g_buckets[((hash >> 1) + probe) & (kBucketTableSize - 1)];
+    subtle::AtomicWord bucket_hash = subtle::Acquire_Load(&bucket->hash);
+    if (bucket_hash == 0) {
+      bucket_hash = subtle::NoBarrier_CompareAndSwap(&bucket->hash, 0, hash);
+      if (bucket_hash == 0) {
+        bucket->depth = depth;
+        memcpy(bucket->frames, frames, depth * sizeof(frames[0]));
+        subtle::Release_Store(&bucket->ready, 1);
+        return bucket;
+      }
+    }
+    // A bucket still being filled in is skipped; at worst the stack gets a
+    // second bucket, which the readers add up like any other.
+    if (bucket_hash == hash && subtle::Acquire_Load(&bucket->ready) &&
+        bucket->depth == depth &&
+        memcmp(bucket->frames, frames, depth * sizeof(frames[0])) == 0) {
+      return bucket;
+    }
+  }
+  return NULL;
+}
+
+bool InsertLiveSample(const void* address, Bucket* bucket, size_t size) {
+  const size_t hash = HashAddress(address);
+  const subtle::AtomicWord key = reinterpret_cast<subtle::AtomicWord>(address);
+  for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+    LiveSample* sample = &g_live_samples[(hash + probe) & (kLiveTableSize - 1)];
+    subtle::AtomicWord current = subtle::NoBarrier_Load(&sample->address);
+    if ((current == 0 || current == kFreedAddress) &&
+        subtle::NoBarrier_CompareAndSwap(&sample->address, current, key) ==
+            current) {
+      // |address| can't be freed before the allocator returns it, so nobody
+      // reads these before this thread is done.
+      sample->bucket = bucket;
+      sample->size = size;
+      subtle::NoBarrier_AtomicIncrement(
+          &g_live_filter[hash & (kLiveFilterSize - 1)], 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Estimated totals from the sampled counts of one bucket.
+struct Estimate {
+  int64 live_count;
+  int64 live_bytes;
+};
+
+Estimate EstimateLive(const Bucket& bucket, double interval) {
+  Estimate estimate = { 0, 0 };
+  int64 count = subtle::NoBarrier_Load(&bucket.alloc_count) -
+                subtle::NoBarrier_Load(&bucket.free_count);
+  int64 bytes = subtle::NoBarrier_Load(&bucket.alloc_bytes) -
+                subtle::NoBarrier_Load(&bucket.free_bytes);
+  if (count <= 0 || bytes <= 0)
+    return estimate;
+  // An allocation of |size| bytes is sampled with probability
+  // 1 - exp(-size / interval); dividing by it undoes the sampling.
+  double mean_size = static_cast<double>(bytes) / count;
+  double scale = 1.0 / (1.0 - exp(-mean_size / interval));
+  estimate.live_count = static_cast<int64>(count * scale + 0.5);
+  estimate.live_bytes = static_cast<int64>(bytes * scale + 0.5);
+  return estimate;
+}
+
+void AppendFrames(const Bucket& bucket, std::string* output) {
+  for (size_t i = 0; i < bucket.depth; ++i) {
+    base::StringAppendF(output, " 0x%" PRIx64,
+                        static_cast<uint64>(
+                            reinterpret_cast<uintptr_t>(bucket.frames[i])));
+  }
+}
+
+// Holds a snapshot of the sampled heap until the tracing system serializes it.
+class SampledHeapHolder : public ConvertableToTraceFormat {
+ public:
+  explicit SampledHeapHolder(const std::string& json) : json_(json) {}
+  virtual ~SampledHeapHolder() {}
+
+  // base::debug::ConvertableToTraceFormat overrides:
+  virtual void AppendAsTraceFormat(std::string* out) const OVERRIDE {
+    out->append(json_);
+  }
+
+ private:
+  std::string json_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampledHeapHolder);
+};
+
+}  // namespace
+
+// static
+void SamplingHeapProfiler::Start(size_t sampling_interval) {
+  DCHECK(!IsRunning());
+  DCHECK_GT(sampling_interval, 0u);
+  if (!g_buckets) {
+    g_buckets = new Bucket[kBucketTableSize];
+    g_live_samples = new LiveSample[kLiveTableSize];
+    g_live_filter = new subtle::Atomic32[kLiveFilterSize];
+    ANNOTATE_LEAKING_OBJECT_PTR(g_buckets);
+    ANNOTATE_LEAKING_OBJECT_PTR(g_live_samples);
+    ANNOTATE_LEAKING_OBJECT_PTR(g_live_filter);
+  }
+  memset(g_buckets, 0, kBucketTableSize * sizeof(g_buckets[0]));
+  memset(g_live_samples, 0, kLiveTableSize * sizeof(g_live_samples[0]));
+  memset(g_live_filter, 0, kLiveFilterSize * sizeof(g_live_filter[0]));
+
+  // The first stack capture can allocate, which must not happen for the
+  // first time inside an allocator hook.
+  StackTrace warm_up;
+
+  subtle::NoBarrier_Store(&g_sampling_interval,
+                          static_cast<subtle::AtomicWord>(sampling_interval));
+  subtle::NoBarrier_Store(
+      &g_random_state,
+      static_cast<subtle::Atomic32>(TimeTicks::Now().ToInternalValue()) | 1);
+  subtle::NoBarrier_Store(&g_bytes_until_sample, NextSampleInterval());
+  subtle::NoBarrier_Store(&g_dropped_samples, 0);
+  subtle::Release_Store(&g_running, 1);
+}
+
+// static
+void SamplingHeapProfiler::Stop() {
+  subtle::Release_Store(&g_running, 0);
+}
+
+// static
+bool SamplingHeapProfiler::IsRunning() {
+  return subtle::Acquire_Load(&g_running) != 0;
+}
+
+// static
+void SamplingHeapProfiler::RecordAlloc(const void* address, size_t size) {
+  if (!subtle::NoBarrier_Load(&g_running) || !address)
+    return;
+
+  const subtle::AtomicWord bytes = static_cast<subtle::AtomicWord>(size);
+  const subtle::AtomicWord left =
+      subtle::NoBarrier_AtomicIncrement(&g_bytes_until_sample, -bytes);
+  // Only the allocation that uses up the interval takes the sample.
+  if (left > 0 || left + bytes <= 0)
+    return;
+
+  // Restart the countdown before doing anything slow, keeping the bytes other
+  // threads allocated meanwhile but not the remainder of this allocation.
+  subtle::NoBarrier_AtomicIncrement(&g_bytes_until_sample,
+                                    NextSampleInterval() - left);
+
+  StackTrace trace;
+  size_t depth = 0;
+  const void* const* frames = trace.Addresses(&depth);
+  if (depth > kSkipFrames) {
+    frames += kSkipFrames;
+    depth -= kSkipFrames;
+  }
+  depth = std::min(depth, kMaxStackDepth);
+
+  Bucket* bucket = FindOrCreateBucket(frames, depth);
+  if (!bucket) {
+    subtle::NoBarrier_AtomicIncrement(&g_dropped_samples, 1);
+    return;
+  }
+  subtle::NoBarrier_AtomicIncrement(&bucket->alloc_count, 1);
+  subtle::NoBarrier_AtomicIncrement(&bucket->alloc_bytes, bytes);
+  if (!InsertLiveSample(address, bucket, size)) {
+    // The free could not be matched later; treat the sample as freed now so
+    // it doesn't look like a leak.
+    subtle::NoBarrier_AtomicIncrement(&bucket->free_count, 1);
+    subtle::NoBarrier_AtomicIncrement(&bucket->free_bytes, bytes);
+    subtle::NoBarrier_AtomicIncrement(&g_dropped_samples, 1);
+  }
+}
+
+// static
+void SamplingHeapProfiler::RecordFree(const void* address) {
+  if (!subtle::NoBarrier_Load(&g_running) || !address)
+    return;
+
+  const size_t hash = HashAddress(address);
+  subtle::Atomic32* filter = &g_live_filter[hash & (kLiveFilterSize - 1)];
+  if (!subtle::NoBarrier_Load(filter))
+    return;
+
+  const subtle::AtomicWord key = reinterpret_cast<subtle::AtomicWord>(address);
+  for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+    LiveSample* sample = &g_live_samples[(hash + probe) & (kLiveTableSize - 1)];
+    subtle::AtomicWord current = subtle::NoBarrier_Load(&sample->address);
+    if (current == 0)
+      return;
+    if (current != key)
+      continue;
+    // Read the sample before releasing the slot to other allocations.
+    Bucket* bucket = sample->bucket;
+    subtle::AtomicWord bytes = static_cast<subtle::AtomicWord>(sample->size);
+    if (subtle::NoBarrier_CompareAndSwap(&sample->address, key,
+                                         kFreedAddress) != key) {
+      return;
+    }
+    subtle::NoBarrier_AtomicIncrement(filter, -1);
+    subtle::NoBarrier_AtomicIncrement(&bucket->free_count, 1);
+    subtle::NoBarrier_AtomicIncrement(&bucket->free_bytes, bytes);
+    return;
+  }
+}
+
+// static
+std::string SamplingHeapProfiler::GetProfile() {
+  int64 live_count = 0;
+  int64 live_bytes = 0;
+  int64 alloc_count = 0;
+  int64 alloc_bytes = 0;
+  std::string stacks;
+  for (size_t i = 0; g_buckets && i < kBucketTableSize; ++i) {
+    const Bucket& bucket = g_buckets[i];
+    if (!subtle::Acquire_Load(&bucket.ready))
+      continue;
+    int64 allocs = subtle::NoBarrier_Load(&bucket.alloc_count);
+    int64 bytes = subtle::NoBarrier_Load(&bucket.alloc_bytes);
+    int64 frees = subtle::NoBarrier_Load(&bucket.free_count);
+    int64 freed_bytes = subtle::NoBarrier_Load(&bucket.free_bytes);
+    base::StringAppendF(&stacks,
+                        "%" PRId64 ": %" PRId64 " [%" PRId64 ": %" PRId64
+                        "] @",
+                        allocs - frees, bytes - freed_bytes, allocs, bytes);
+    AppendFrames(bucket, &stacks);
+    stacks.append("\n");
+    live_count += allocs - frees;
+    live_bytes += bytes - freed_bytes;
+    alloc_count += allocs;
+    alloc_bytes += bytes;
+  }
+
+  std::string profile = base::StringPrintf(
+      "heap profile: %" PRId64 ": %" PRId64 " [%" PRId64 ": %" PRId64
+      "] @ heap_v2/%" PRId64 "\n",
+      live_count, live_bytes, alloc_count, alloc_bytes,
+      static_cast<int64>(subtle::NoBarrier_Load(&g_sampling_interval)));
+  profile.append(stacks);
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // pprof needs the mappings to symbolize the program counters.
+  std::string proc_maps;
+  if (ReadProcMaps(&proc_maps)) {
+    profile.append("\nMAPPED_LIBRARIES:\n");
+    profile.append(proc_maps);
+  }
+#endif
+  return profile;
+}
+
+// static
+void SamplingHeapProfiler::AppendProfileAsTraceFormat(std::string* output) {
+  const double interval = subtle::NoBarrier_Load(&g_sampling_interval);
+  int64 total_count = 0;
+  int64 total_bytes = 0;
+  std::string stacks;
+  for (size_t i = 0; g_buckets && i < kBucketTableSize; ++i) {
+    const Bucket& bucket = g_buckets[i];
+    if (!subtle::Acquire_Load(&bucket.ready))
+      continue;
+    Estimate estimate = EstimateLive(bucket, interval);
+    if (estimate.live_count == 0)
+      continue;
+    base::StringAppendF(&stacks,
+                        ",\n{\"current_allocs\": %" PRId64
+                        ", \"current_bytes\": %" PRId64 ", \"trace\": \"",
+                        estimate.live_count, estimate.live_bytes);
+    // Trace viewer expects a trailing space after each frame.
+    for (size_t f = 0; f < bucket.depth; ++f) {
+      base::StringAppendF(&stacks, "0x%" PRIx64 " ",
+                          static_cast<uint64>(
+                              reinterpret_cast<uintptr_t>(bucket.frames[f])));
+    }
+    stacks.append("\"}");
+    total_count += estimate.live_count;
+    total_bytes += estimate.live_bytes;
+  }
+
+  base::StringAppendF(output,
+                      "[{\"current_allocs\": %" PRId64
+                      ", \"current_bytes\": %" PRId64 ", \"trace\": \"\"}",
+                      total_count, total_bytes);
+  output->append(stacks);
+  output->append("]\n");
+}
+
+// static
+void SamplingHeapProfiler::TraceSnapshot() {
+  std::string json;
+  AppendProfileAsTraceFormat(&json);
+  scoped_ptr<ConvertableToTraceFormat> holder(new SampledHeapHolder(json));
+  const int kSnapshotId = 1;
+  TRACE_EVENT_OBJECT_SNAPSHOT_WITH_ID(
+      TRACE_DISABLED_BY_DEFAULT("memory"),
+      "memory::SampledHeap",
+      kSnapshotId,
+      holder.Pass());
+}
+
+// static
+int SamplingHeapProfiler::GetDroppedSampleCount() {
+  return subtle::NoBarrier_Load(&g_dropped_samples);
+}
+
+}  // namespace debug
+}  // namespace base
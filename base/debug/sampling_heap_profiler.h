@@ -0,0 +1,76 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_DEBUG_SAMPLING_HEAP_PROFILER_H_
+#define BASE_DEBUG_SAMPLING_HEAP_PROFILER_H_
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+
+namespace base {
+namespace debug {
+
+// A heap profiler cheap enough to leave running in production. Unlike
+// tcmalloc's heap profiler, which records every allocation, it samples
+// allocations as a Poisson process over allocated bytes: on average one
+// sample is taken per |sampling_interval| bytes, so an allocation's chance of
+// being sampled grows with its size. Each sample records the call stack of
+// the allocation. Samples are aggregated by stack in fixed-size tables that
+// the allocator hooks update without taking locks.
+//
+// The profiler does not intercept allocations itself, as base cannot depend
+// on the allocator. The embedder routes allocations to RecordAlloc() and
+// RecordFree(), for example from tcmalloc's malloc hooks:
+//
+//   MallocHook_AddNewHook(&SamplingHeapProfiler::RecordAlloc);
+//   MallocHook_AddDeleteHook(&SamplingHeapProfiler::RecordFree);
+//   SamplingHeapProfiler::Start(SamplingHeapProfiler::kDefaultInterval);
+//
+// All methods are static and thread-safe.
+class BASE_EXPORT SamplingHeapProfiler {
+ public:
+  // Mean number of bytes allocated between two samples.
+  static const size_t kDefaultInterval = 128 * 1024;
+
+  // Starts sampling, discarding samples from earlier runs. Must not be
+  // called while the profiler is running.
+  static void Start(size_t sampling_interval);
+
+  // Stops sampling. Samples already taken stay available to the Get*()
+  // functions below until the next Start().
+  static void Stop();
+
+  static bool IsRunning();
+
+  // Allocator hooks. Must be cheap and must not allocate unless they take a
+  // sample.
+  static void RecordAlloc(const void* address, size_t size);
+  static void RecordFree(const void* address);
+
+  // Returns the sampled heap in pprof's "heap_v2" text format, which pprof
+  // scales back to estimated totals by itself.
+  static std::string GetProfile();
+
+  // Appends the estimated live heap as trace event compatible JSON, in the
+  // same shape as AppendHeapProfileAsTraceFormat() in trace_event_memory.h.
+  // Stack frames are written as hex program counters.
+  static void AppendProfileAsTraceFormat(std::string* output);
+
+  // Records the estimated live heap as a "memory::SampledHeap" object
+  // snapshot in the disabled-by-default "memory" trace category.
+  static void TraceSnapshot();
+
+  // Number of samples that could not be recorded because a table was full.
+  static int GetDroppedSampleCount();
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SamplingHeapProfiler);
+};
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_SAMPLING_HEAP_PROFILER_H_
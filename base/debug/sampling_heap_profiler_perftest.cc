@@ -0,0 +1,69 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+
+#include "base/debug/sampling_heap_profiler.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const int kIterations = 10 * 1000 * 1000;
+
+// Allocation sizes cycled through by the benchmark, typical of small
+// browser allocations.
+const size_t kSizes[] = { 16, 32, 48, 64, 128, 256, 24, 512 };
+
+// Allocates and frees |kIterations| blocks, calling the profiler hooks when
+// |hooked|, as an allocator shim would. Returns the time taken.
+base::TimeDelta RunAllocations(bool hooked) {
+  void* live[64] = { NULL };
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    void*& slot = live[i % arraysize(live)];
+    if (hooked)
+      SamplingHeapProfiler::RecordFree(slot);
+    free(slot);
+    size_t size = kSizes[i % arraysize(kSizes)];
+    slot = malloc(size);
+    if (hooked)
+      SamplingHeapProfiler::RecordAlloc(slot, size);
+  }
+  base::TimeDelta elapsed = timer.Elapsed();
+  for (size_t i = 0; i < arraysize(live); ++i) {
+    if (hooked)
+      SamplingHeapProfiler::RecordFree(live[i]);
+    free(live[i]);
+  }
+  return elapsed;
+}
+
+}  // namespace
+
+TEST(SamplingHeapProfilerPerfTest, AllocationOverhead) {
+  base::TimeDelta baseline = RunAllocations(false);
+
+  SamplingHeapProfiler::Start(SamplingHeapProfiler::kDefaultInterval);
+  base::TimeDelta sampled = RunAllocations(true);
+  SamplingHeapProfiler::Stop();
+
+  LogPerfResult("SamplingHeapProfiler_baseline",
+                baseline.InMillisecondsF(), "ms");
+  LogPerfResult("SamplingHeapProfiler_sampled",
+                sampled.InMillisecondsF(), "ms");
+  LogPerfResult("SamplingHeapProfiler_overhead",
+                100.0 * (sampled - baseline).InMillisecondsF() /
+                    baseline.InMillisecondsF(),
+                "%");
+  LogPerfResult("SamplingHeapProfiler_profile_size",
+                SamplingHeapProfiler::GetProfile().size(), "bytes");
+}
+
+}  // namespace debug
+}  // namespace base
@@ -0,0 +1,98 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/sampling_heap_profiler.h"
+
+#include <string>
+
+#include "base/strings/string_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+// Stand-ins for heap blocks; only their addresses are used.
+int64 g_blocks[10];
+
+// Allocations this much larger than the sampling interval are sampled with
+// probability 1 - e^-1024, so the tests below are deterministic in practice.
+const size_t kInterval = 1024;
+const size_t kLargeSize = 1024 * kInterval;
+
+void AllocateBlocks() {
+  for (size_t i = 0; i < arraysize(g_blocks); ++i)
+    SamplingHeapProfiler::RecordAlloc(&g_blocks[i], kLargeSize);
+}
+
+}  // namespace
+
+TEST(SamplingHeapProfilerTest, NotRunning) {
+  EXPECT_FALSE(SamplingHeapProfiler::IsRunning());
+  // The hooks must be safe to call before the profiler ever started.
+  SamplingHeapProfiler::RecordAlloc(&g_blocks[0], kLargeSize);
+  SamplingHeapProfiler::RecordFree(&g_blocks[0]);
+}
+
+TEST(SamplingHeapProfilerTest, Profile) {
+  SamplingHeapProfiler::Start(kInterval);
+  EXPECT_TRUE(SamplingHeapProfiler::IsRunning());
+  AllocateBlocks();
+  // Unsampled addresses are ignored.
+  SamplingHeapProfiler::RecordFree(&kInterval);
+  EXPECT_TRUE(StartsWithASCII(
+      SamplingHeapProfiler::GetProfile(),
+      "heap profile: 10: 10485760 [10: 10485760] @ heap_v2/1024\n", true));
+
+  for (size_t i = 0; i < arraysize(g_blocks) / 2; ++i)
+    SamplingHeapProfiler::RecordFree(&g_blocks[i]);
+  // A second free of the same block is not counted.
+  SamplingHeapProfiler::RecordFree(&g_blocks[0]);
+  std::string profile = SamplingHeapProfiler::GetProfile();
+  EXPECT_TRUE(StartsWithASCII(
+      profile, "heap profile: 5: 5242880 [10: 10485760] @ heap_v2/1024\n",
+      true)) << profile;
+  // All blocks come from the same stack.
+  EXPECT_NE(std::string::npos,
+            profile.find("\n5: 5242880 [10: 10485760] @ 0x"));
+
+  SamplingHeapProfiler::Stop();
+  EXPECT_FALSE(SamplingHeapProfiler::IsRunning());
+  // Samples survive Stop().
+  EXPECT_EQ(profile, SamplingHeapProfiler::GetProfile());
+  EXPECT_EQ(0, SamplingHeapProfiler::GetDroppedSampleCount());
+}
+
+TEST(SamplingHeapProfilerTest, TraceFormat) {
+  SamplingHeapProfiler::Start(kInterval);
+  AllocateBlocks();
+  SamplingHeapProfiler::RecordFree(&g_blocks[0]);
+  SamplingHeapProfiler::Stop();
+
+  std::string json;
+  SamplingHeapProfiler::AppendProfileAsTraceFormat(&json);
+  EXPECT_TRUE(StartsWithASCII(
+      json,
+      "[{\"current_allocs\": 9, \"current_bytes\": 9437184, \"trace\": \"\"},\n"
+      "{\"current_allocs\": 9, \"current_bytes\": 9437184, \"trace\": \"0x",
+      true)) << json;
+  EXPECT_TRUE(EndsWith(json, " \"}]\n", true)) << json;
+}
+
+TEST(SamplingHeapProfilerTest, RestartDiscardsSamples) {
+  SamplingHeapProfiler::Start(kInterval);
+  AllocateBlocks();
+  SamplingHeapProfiler::Stop();
+
+  SamplingHeapProfiler::Start(kInterval);
+  SamplingHeapProfiler::RecordAlloc(&g_blocks[0], kLargeSize);
+  EXPECT_TRUE(StartsWithASCII(
+      SamplingHeapProfiler::GetProfile(),
+      "heap profile: 1: 1048576 [1: 1048576] @ heap_v2/1024\n", true));
+  SamplingHeapProfiler::Stop();
+}
+
+}  // namespace debug
+}  // namespace base
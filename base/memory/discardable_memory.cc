@@ -24,9 +24,21 @@ void* DiscardableMemory::Memory() const {
   return memory_;
 }
 
+#if !defined(OS_LINUX)
+
+// static
+void DiscardableMemory::RegisterMemoryPressureListeners() {
+}
+
+// static
+void DiscardableMemory::UnregisterMemoryPressureListeners() {
+}
+
+#endif  // !OS_LINUX
+
 // Stub implementations for platforms that don't support discardable memory.
 
-#if !defined(OS_ANDROID) && !defined(OS_MACOSX)
+#if !defined(OS_ANDROID) && !defined(OS_MACOSX) && !defined(OS_LINUX)
 
 DiscardableMemory::~DiscardableMemory() {
   NOTIMPLEMENTED();
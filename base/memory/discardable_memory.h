@@ -37,6 +37,10 @@ enum LockDiscardableMemoryStatus {
 //   - Because of memory alignment, the amount of memory allocated can be
 //     larger than the requested memory size. It is not very efficient for
 //     small allocations.
+//   - On Linux desktop, discardable memory is emulated in userspace: the
+//     process keeps its unlocked discardable memory under a process-wide
+//     limit, purging the least recently used first (see
+//     discardable_memory_provider_linux.h).
 //
 // References:
 //   - Linux: http://lwn.net/Articles/452035/
@@ -76,6 +80,13 @@ class BASE_EXPORT DiscardableMemory {
   // before calling this. Otherwise, this will cause a DCHECK error.
   void* Memory() const;
 
+  // Makes discardable memory purged in response to MemoryPressureListener
+  // signals, on platforms where the process rather than the kernel decides
+  // what to purge. Must be called on a thread with a MessageLoop, which then
+  // handles the signals. A no-op on other platforms.
+  static void RegisterMemoryPressureListeners();
+  static void UnregisterMemoryPressureListeners();
+
   // Testing utility calls.
 
   // Check whether a purge of all discardable memory in the system is supported.
@@ -0,0 +1,81 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/discardable_memory.h"
+
+#include <sys/mman.h>
+
+#include "base/logging.h"
+#include "base/memory/discardable_memory_provider_linux.h"
+
+namespace base {
+
+using internal::DiscardableMemoryProvider;
+
+// static
+bool DiscardableMemory::Supported() {
+  return true;
+}
+
+DiscardableMemory::~DiscardableMemory() {
+  if (!memory_)
+    return;
+  DiscardableMemoryProvider::GetInstance()->Unregister(this);
+  if (munmap(memory_, size_) == -1)
+    DPLOG(ERROR) << "Failed to unmap memory.";
+}
+
+bool DiscardableMemory::InitializeAndLock(size_t size) {
+  DCHECK(!memory_);
+  void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    DPLOG(ERROR) << "Failed to map memory.";
+    return false;
+  }
+
+  memory_ = memory;
+  size_ = size;
+  is_locked_ = true;
+  DiscardableMemoryProvider::GetInstance()->Register(this, memory_, size_);
+  return true;
+}
+
+LockDiscardableMemoryStatus DiscardableMemory::Lock() {
+  DCHECK(memory_);
+  DCHECK(!is_locked_);
+
+  bool intact = DiscardableMemoryProvider::GetInstance()->Lock(this);
+  is_locked_ = true;
+  return intact ? DISCARDABLE_MEMORY_SUCCESS : DISCARDABLE_MEMORY_PURGED;
+}
+
+void DiscardableMemory::Unlock() {
+  DCHECK(is_locked_);
+
+  DiscardableMemoryProvider::GetInstance()->Unlock(this);
+  is_locked_ = false;
+}
+
+// static
+void DiscardableMemory::RegisterMemoryPressureListeners() {
+  DiscardableMemoryProvider::GetInstance()->RegisterMemoryPressureListener();
+}
+
+// static
+void DiscardableMemory::UnregisterMemoryPressureListeners() {
+  DiscardableMemoryProvider::GetInstance()->UnregisterMemoryPressureListener();
+}
+
+// static
+bool DiscardableMemory::PurgeForTestingSupported() {
+  return true;
+}
+
+// static
+void DiscardableMemory::PurgeForTesting() {
+  DiscardableMemoryProvider::GetInstance()->PurgeAll();
+}
+
+}  // namespace base
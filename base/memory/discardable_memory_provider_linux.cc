@@ -0,0 +1,193 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/discardable_memory_provider_linux.h"
+
+#include <sys/mman.h>
+
+#include "base/bind.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// Resident discardable memory is kept under this limit by default.
+const size_t kDefaultDiscardableMemoryLimit = 512 * 1024 * 1024;
+
+// Resident discardable memory is reduced to this size on moderate pressure.
+const size_t kDefaultBytesToKeepUnderModeratePressure = 128 * 1024 * 1024;
+
+base::LazyInstance<DiscardableMemoryProvider>::Leaky g_provider =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Provider set by SetInstanceForTest(), if any.
+DiscardableMemoryProvider* g_provider_for_test = NULL;
+
+}  // namespace
+
+DiscardableMemoryProvider::Statistics::Statistics()
+    : bytes_allocated(0),
+      bytes_resident(0),
+      bytes_locked(0),
+      purge_count(0),
+      bytes_purged(0) {
+}
+
+DiscardableMemoryProvider::DiscardableMemoryProvider()
+    : allocations_(AllocationMap::NO_AUTO_EVICT),
+      discardable_memory_limit_(kDefaultDiscardableMemoryLimit),
+      bytes_to_keep_under_moderate_pressure_(
+          kDefaultBytesToKeepUnderModeratePressure) {
+}
+
+DiscardableMemoryProvider::~DiscardableMemoryProvider() {
+  DCHECK(allocations_.empty());
+}
+
+// static
+DiscardableMemoryProvider* DiscardableMemoryProvider::GetInstance() {
+  if (g_provider_for_test)
+    return g_provider_for_test;
+  return g_provider.Pointer();
+}
+
+// static
+void DiscardableMemoryProvider::SetInstanceForTest(
+    DiscardableMemoryProvider* provider) {
+  g_provider_for_test = provider;
+}
+
+void DiscardableMemoryProvider::RegisterMemoryPressureListener() {
+  DCHECK(!memory_pressure_listener_);
+  memory_pressure_listener_.reset(new MemoryPressureListener(
+      base::Bind(&DiscardableMemoryProvider::OnMemoryPressure,
+                 base::Unretained(this))));
+}
+
+void DiscardableMemoryProvider::UnregisterMemoryPressureListener() {
+  DCHECK(memory_pressure_listener_);
+  memory_pressure_listener_.reset();
+}
+
+void DiscardableMemoryProvider::SetDiscardableMemoryLimit(size_t bytes) {
+  AutoLock lock(lock_);
+  discardable_memory_limit_ = bytes;
+  PurgeLRUUntilUsageIsWithin(discardable_memory_limit_);
+}
+
+void DiscardableMemoryProvider::SetBytesToKeepUnderModeratePressure(
+    size_t bytes) {
+  AutoLock lock(lock_);
+  bytes_to_keep_under_moderate_pressure_ = bytes;
+}
+
+void DiscardableMemoryProvider::Register(const DiscardableMemory* discardable,
+                                         void* memory,
+                                         size_t size) {
+  AutoLock lock(lock_);
+  DCHECK(allocations_.Peek(discardable) == allocations_.end());
+  allocations_.Put(discardable, Allocation(memory, size));
+  statistics_.bytes_allocated += size;
+  statistics_.bytes_resident += size;
+  statistics_.bytes_locked += size;
+  PurgeLRUUntilUsageIsWithin(discardable_memory_limit_);
+}
+
+void DiscardableMemoryProvider::Unregister(
+    const DiscardableMemory* discardable) {
+  AutoLock lock(lock_);
+  AllocationMap::iterator it = allocations_.Peek(discardable);
+  DCHECK(it != allocations_.end());
+  const Allocation& allocation = it->second;
+  statistics_.bytes_allocated -= allocation.size;
+  if (!allocation.purged)
+    statistics_.bytes_resident -= allocation.size;
+  if (allocation.locked)
+    statistics_.bytes_locked -= allocation.size;
+  allocations_.Erase(it);
+}
+
+bool DiscardableMemoryProvider::Lock(const DiscardableMemory* discardable) {
+  AutoLock lock(lock_);
+  AllocationMap::iterator it = allocations_.Get(discardable);
+  DCHECK(it != allocations_.end());
+  Allocation* allocation = &it->second;
+  DCHECK(!allocation->locked);
+  allocation->locked = true;
+  statistics_.bytes_locked += allocation->size;
+  if (!allocation->purged)
+    return true;
+
+  // The purged pages read back as zeros and are faulted in again on use.
+  allocation->purged = false;
+  statistics_.bytes_resident += allocation->size;
+  PurgeLRUUntilUsageIsWithin(discardable_memory_limit_);
+  return false;
+}
+
+void DiscardableMemoryProvider::Unlock(const DiscardableMemory* discardable) {
+  AutoLock lock(lock_);
+  AllocationMap::iterator it = allocations_.Peek(discardable);
+  DCHECK(it != allocations_.end());
+  Allocation* allocation = &it->second;
+  DCHECK(allocation->locked);
+  allocation->locked = false;
+  statistics_.bytes_locked -= allocation->size;
+}
+
+void DiscardableMemoryProvider::PurgeAll() {
+  AutoLock lock(lock_);
+  PurgeLRUUntilUsageIsWithin(0);
+}
+
+DiscardableMemoryProvider::Statistics
+DiscardableMemoryProvider::GetStatistics() const {
+  AutoLock lock(lock_);
+  return statistics_;
+}
+
+void DiscardableMemoryProvider::OnMemoryPressure(
+    MemoryPressureListener::MemoryPressureLevel pressure_level) {
+  AutoLock lock(lock_);
+  switch (pressure_level) {
+    case MemoryPressureListener::MEMORY_PRESSURE_MODERATE:
+      PurgeLRUUntilUsageIsWithin(bytes_to_keep_under_moderate_pressure_);
+      return;
+    case MemoryPressureListener::MEMORY_PRESSURE_CRITICAL:
+      PurgeLRUUntilUsageIsWithin(0);
+      return;
+  }
+  NOTREACHED();
+}
+
+void DiscardableMemoryProvider::PurgeLRUUntilUsageIsWithin(size_t limit) {
+  lock_.AssertAcquired();
+  for (AllocationMap::reverse_iterator it = allocations_.rbegin();
+       it != allocations_.rend() && statistics_.bytes_resident > limit;
+       ++it) {
+    Allocation* allocation = &it->second;
+    if (allocation->locked || allocation->purged)
+      continue;
+    Purge(allocation);
+  }
+}
+
+void DiscardableMemoryProvider::Purge(Allocation* allocation) {
+  // For private anonymous mappings, MADV_DONTNEED frees the pages at once and
+  // the mapping reads back as zeros, so the memory stays valid.
+  if (madvise(allocation->memory, allocation->size, MADV_DONTNEED) == -1) {
+    DPLOG(ERROR) << "madvise() failed";
+    return;
+  }
+  allocation->purged = true;
+  statistics_.bytes_resident -= allocation->size;
+  ++statistics_.purge_count;
+  statistics_.bytes_purged += allocation->size;
+}
+
+}  // namespace internal
+}  // namespace base
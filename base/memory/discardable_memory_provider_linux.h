@@ -0,0 +1,126 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MEMORY_DISCARDABLE_MEMORY_PROVIDER_LINUX_H_
+#define BASE_MEMORY_DISCARDABLE_MEMORY_PROVIDER_LINUX_H_
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/containers/mru_cache.h"
+#include "base/memory/memory_pressure_listener.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+
+namespace base {
+class DiscardableMemory;
+
+namespace internal {
+
+// Linux has no kernel support for discardable memory comparable to ashmem or
+// purgeable VM objects, so it is emulated in userspace. The provider keeps
+// every DiscardableMemory of the process in one LRU list and holds the pages
+// of all of them under a process-wide limit. When the limit is exceeded, the
+// least recently used unlocked allocations are purged with
+// madvise(MADV_DONTNEED), which returns their pages to the kernel right away.
+// Locked allocations are never purged. Memory pressure signals purge further.
+//
+// All methods are thread-safe.
+class BASE_EXPORT_PRIVATE DiscardableMemoryProvider {
+ public:
+  struct Statistics {
+    Statistics();
+
+    // Sizes of all, of the resident (not purged), and of the locked
+    // allocations.
+    size_t bytes_allocated;
+    size_t bytes_resident;
+    size_t bytes_locked;
+
+    // Number of purges since the provider was created, and their total size.
+    size_t purge_count;
+    uint64 bytes_purged;
+  };
+
+  DiscardableMemoryProvider();
+  ~DiscardableMemoryProvider();
+
+  // Returns the provider used by DiscardableMemory.
+  static DiscardableMemoryProvider* GetInstance();
+
+  // Makes GetInstance() return |provider|, or the default instance again if
+  // |provider| is NULL.
+  static void SetInstanceForTest(DiscardableMemoryProvider* provider);
+
+  // Starts and stops purging on memory pressure signals. Signals are received
+  // on the calling thread, which must have a MessageLoop.
+  void RegisterMemoryPressureListener();
+  void UnregisterMemoryPressureListener();
+
+  // The most memory the resident allocations may use before unlocked ones
+  // are purged. Locked allocations can take usage above it.
+  void SetDiscardableMemoryLimit(size_t bytes);
+
+  // The most memory the resident allocations may use after a moderate memory
+  // pressure signal. A critical signal purges all unlocked allocations.
+  void SetBytesToKeepUnderModeratePressure(size_t bytes);
+
+  // Adds the |size| bytes at |memory| to the provider, locked.
+  void Register(const DiscardableMemory* discardable, void* memory,
+                size_t size);
+
+  // Removes an allocation. It need not be unlocked.
+  void Unregister(const DiscardableMemory* discardable);
+
+  // Locks an allocation, marking it as most recently used. Returns false if
+  // its contents were purged while it was unlocked; the memory is usable
+  // either way.
+  bool Lock(const DiscardableMemory* discardable);
+
+  // Unlocks an allocation so that it can be purged.
+  void Unlock(const DiscardableMemory* discardable);
+
+  // Purges all unlocked allocations.
+  void PurgeAll();
+
+  Statistics GetStatistics() const;
+
+ private:
+  struct Allocation {
+    Allocation(void* memory, size_t size)
+        : memory(memory),
+          size(size),
+          locked(true),
+          purged(false) {}
+
+    void* memory;
+    size_t size;
+    bool locked;
+    bool purged;
+  };
+  typedef MRUCache<const DiscardableMemory*, Allocation> AllocationMap;
+
+  void OnMemoryPressure(
+      MemoryPressureListener::MemoryPressureLevel pressure_level);
+
+  // Purges unlocked allocations, least recently used first, until resident
+  // allocations use at most |limit| bytes. Requires |lock_|.
+  void PurgeLRUUntilUsageIsWithin(size_t limit);
+
+  void Purge(Allocation* allocation);
+
+  mutable base::Lock lock_;
+  AllocationMap allocations_;
+  Statistics statistics_;
+  size_t discardable_memory_limit_;
+  size_t bytes_to_keep_under_moderate_pressure_;
+
+  scoped_ptr<MemoryPressureListener> memory_pressure_listener_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiscardableMemoryProvider);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_MEMORY_DISCARDABLE_MEMORY_PROVIDER_LINUX_H_
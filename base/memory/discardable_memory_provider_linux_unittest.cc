@@ -0,0 +1,155 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/discardable_memory_provider_linux.h"
+
+#include <string.h>
+
+#include "base/memory/discardable_memory.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+const size_t kPageSize = 4096;
+
+}  // namespace
+
+class DiscardableMemoryProviderTest : public testing::Test {
+ protected:
+  DiscardableMemoryProviderTest() {
+    DiscardableMemoryProvider::SetInstanceForTest(&provider_);
+  }
+
+  virtual ~DiscardableMemoryProviderTest() {
+    DiscardableMemoryProvider::SetInstanceForTest(NULL);
+  }
+
+  // Returns a new locked discardable memory of |size| bytes, filled with
+  // |value|.
+  scoped_ptr<DiscardableMemory> CreateLockedMemory(size_t size, char value) {
+    scoped_ptr<DiscardableMemory> memory(new DiscardableMemory);
+    EXPECT_TRUE(memory->InitializeAndLock(size));
+    memset(memory->Memory(), value, size);
+    return memory.Pass();
+  }
+
+  // Returns true if the first byte of the locked |memory| is |value|.
+  bool HasContents(const DiscardableMemory& memory, char value) {
+    return *static_cast<const char*>(memory.Memory()) == value;
+  }
+
+  DiscardableMemoryProvider provider_;
+};
+
+TEST_F(DiscardableMemoryProviderTest, Statistics) {
+  scoped_ptr<DiscardableMemory> memory(CreateLockedMemory(kPageSize, 'a'));
+  DiscardableMemoryProvider::Statistics statistics = provider_.GetStatistics();
+  EXPECT_EQ(kPageSize, statistics.bytes_allocated);
+  EXPECT_EQ(kPageSize, statistics.bytes_resident);
+  EXPECT_EQ(kPageSize, statistics.bytes_locked);
+
+  memory->Unlock();
+  statistics = provider_.GetStatistics();
+  EXPECT_EQ(kPageSize, statistics.bytes_resident);
+  EXPECT_EQ(0u, statistics.bytes_locked);
+
+  memory.reset();
+  statistics = provider_.GetStatistics();
+  EXPECT_EQ(0u, statistics.bytes_allocated);
+  EXPECT_EQ(0u, statistics.bytes_resident);
+  EXPECT_EQ(0u, statistics.purge_count);
+}
+
+TEST_F(DiscardableMemoryProviderTest, LockedMemoryIsNotPurged) {
+  provider_.SetDiscardableMemoryLimit(kPageSize);
+  scoped_ptr<DiscardableMemory> first(CreateLockedMemory(kPageSize, 'a'));
+  scoped_ptr<DiscardableMemory> second(CreateLockedMemory(kPageSize, 'b'));
+
+  // Both are locked, so the limit can't be honored.
+  EXPECT_EQ(2 * kPageSize, provider_.GetStatistics().bytes_resident);
+  EXPECT_TRUE(HasContents(*first, 'a'));
+  EXPECT_TRUE(HasContents(*second, 'b'));
+
+  provider_.PurgeAll();
+  EXPECT_EQ(0u, provider_.GetStatistics().purge_count);
+  EXPECT_TRUE(HasContents(*first, 'a'));
+}
+
+TEST_F(DiscardableMemoryProviderTest, LimitPurgesLeastRecentlyUsed) {
+  provider_.SetDiscardableMemoryLimit(2 * kPageSize);
+  scoped_ptr<DiscardableMemory> first(CreateLockedMemory(kPageSize, 'a'));
+  scoped_ptr<DiscardableMemory> second(CreateLockedMemory(kPageSize, 'b'));
+  first->Unlock();
+  second->Unlock();
+
+  // Make |first| the most recently used.
+  EXPECT_EQ(DISCARDABLE_MEMORY_SUCCESS, first->Lock());
+  first->Unlock();
+
+  // Going over the limit purges |second|.
+  scoped_ptr<DiscardableMemory> third(CreateLockedMemory(kPageSize, 'c'));
+  DiscardableMemoryProvider::Statistics statistics = provider_.GetStatistics();
+  EXPECT_EQ(2 * kPageSize, statistics.bytes_resident);
+  EXPECT_EQ(1u, statistics.purge_count);
+  EXPECT_EQ(kPageSize, statistics.bytes_purged);
+
+  EXPECT_EQ(DISCARDABLE_MEMORY_SUCCESS, first->Lock());
+  EXPECT_TRUE(HasContents(*first, 'a'));
+  first->Unlock();
+
+  // Relocking |second| purges |first|, the least recently used unlocked
+  // memory, to make room.
+  EXPECT_EQ(DISCARDABLE_MEMORY_PURGED, second->Lock());
+  EXPECT_TRUE(HasContents(*second, 0));
+  EXPECT_EQ(2u, provider_.GetStatistics().purge_count);
+  EXPECT_EQ(DISCARDABLE_MEMORY_PURGED, first->Lock());
+}
+
+TEST_F(DiscardableMemoryProviderTest, LoweringLimitPurges) {
+  scoped_ptr<DiscardableMemory> memory(CreateLockedMemory(kPageSize, 'a'));
+  memory->Unlock();
+  provider_.SetDiscardableMemoryLimit(0);
+  EXPECT_EQ(0u, provider_.GetStatistics().bytes_resident);
+  EXPECT_EQ(DISCARDABLE_MEMORY_PURGED, memory->Lock());
+}
+
+TEST_F(DiscardableMemoryProviderTest, MemoryPressure) {
+  MessageLoop message_loop;
+  provider_.RegisterMemoryPressureListener();
+  provider_.SetBytesToKeepUnderModeratePressure(kPageSize);
+
+  scoped_ptr<DiscardableMemory> first(CreateLockedMemory(kPageSize, 'a'));
+  scoped_ptr<DiscardableMemory> second(CreateLockedMemory(kPageSize, 'b'));
+  scoped_ptr<DiscardableMemory> third(CreateLockedMemory(kPageSize, 'c'));
+  first->Unlock();
+  second->Unlock();
+
+  // Moderate pressure purges down to one page, the least recently used first.
+  MemoryPressureListener::NotifyMemoryPressure(
+      MemoryPressureListener::MEMORY_PRESSURE_MODERATE);
+  message_loop.RunUntilIdle();
+  EXPECT_EQ(kPageSize, provider_.GetStatistics().bytes_resident);
+  EXPECT_EQ(2u, provider_.GetStatistics().purge_count);
+
+  EXPECT_EQ(DISCARDABLE_MEMORY_PURGED, first->Lock());
+  first->Unlock();
+  third->Unlock();
+
+  // Critical pressure purges everything that is unlocked.
+  MemoryPressureListener::NotifyMemoryPressure(
+      MemoryPressureListener::MEMORY_PRESSURE_CRITICAL);
+  message_loop.RunUntilIdle();
+  EXPECT_EQ(0u, provider_.GetStatistics().bytes_resident);
+  EXPECT_EQ(DISCARDABLE_MEMORY_PURGED, third->Lock());
+
+  provider_.UnregisterMemoryPressureListener();
+}
+
+}  // namespace internal
+}  // namespace base
@@ -6,10 +6,13 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "base/compiler_specific.h"
 #include "base/debug/leak_annotations.h"
+#include "base/debug/trace_event.h"
 #include "base/format_macros.h"
+#include "base/json/string_escape.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/port.h"
 #include "base/process/process_handle.h"
@@ -49,6 +52,42 @@ const ThreadData::Status kInitialStartupState =
 // problem with its presence).
 static const bool kAllowAlternateTimeSourceHandling = true;
 
+// Holds a JSON snapshot of the profiler until the tracing system serializes it.
+class ProcessDataHolder : public base::debug::ConvertableToTraceFormat {
+ public:
+  explicit ProcessDataHolder(const std::string& json) : json_(json) {}
+  virtual ~ProcessDataHolder() {}
+
+  // base::debug::ConvertableToTraceFormat overrides:
+  virtual void AppendAsTraceFormat(std::string* out) const OVERRIDE {
+    out->append(json_);
+  }
+
+ private:
+  std::string json_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessDataHolder);
+};
+
+// Hashes for the direct-mapped lookup caches in ThreadData.  Locations are
+// hashed on their (static) file name and line, and Births on their address.
+size_t HashLocation(const Location& location) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(location.file_name()) +
+                  location.line_number() * 31;
+  return key ^ (key >> 6);
+}
+
+size_t HashBirths(const Births* birth) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(birth);
+  return key ^ (key >> 6);
+}
+
+bool SameLocation(const Location& a, const Location& b) {
+  return a.line_number() == b.line_number() &&
+         a.file_name() == b.file_name() &&
+         a.function_name() == b.function_name();
+}
+
 }  // namespace
 
 //------------------------------------------------------------------------------
@@ -76,11 +115,19 @@ DeathData::DeathData(int count) {
 void DeathData::RecordDeath(const int32 queue_duration,
                             const int32 run_duration,
                             int32 random_number) {
+  RecordSampledDeath(queue_duration, run_duration, random_number, 1);
+}
+
+void DeathData::RecordSampledDeath(const int32 queue_duration,
+                                   const int32 run_duration,
+                                   int32 random_number,
+                                   int weight) {
   // We'll just clamp at INT_MAX, but we should note this in the UI as such.
   if (count_ < INT_MAX)
     ++count_;
-  queue_duration_sum_ += queue_duration;
-  run_duration_sum_ += run_duration;
+  queue_duration_sum_ += queue_duration * weight;
+  run_duration_sum_ += run_duration * weight;
+  queue_duration_histogram_[QueueDurationBucket(queue_duration)] += weight;
 
   if (queue_duration_max_ < queue_duration)
     queue_duration_max_ = queue_duration;
@@ -92,14 +139,23 @@ void DeathData::RecordDeath(const int32 queue_duration,
   // results in a completely uniform selection of the sample (at least when we
   // don't clamp count_... but that should be inconsequentially likely).
   // We ignore the fact that we correlated our selection of a sample to the run
-  // and queue times (i.e., we used them to generate random_number).
+  // and queue times (i.e., we used them to generate random_number).  When only
+  // one in |weight| runs is timed, a timed run replaces the sample with
+  // probability |weight| / count_, which keeps the sample uniform over the
+  // timed runs.
   CHECK_GT(count_, 0);
-  if (0 == (random_number % count_)) {
+  if ((static_cast<uint32>(random_number) % static_cast<uint32>(count_)) <
+      static_cast<uint32>(weight)) {
     queue_duration_sample_ = queue_duration;
     run_duration_sample_ = run_duration;
   }
 }
 
+void DeathData::RecordUntimedDeath() {
+  if (count_ < INT_MAX)
+    ++count_;
+}
+
 int DeathData::count() const { return count_; }
 
 int32 DeathData::run_duration_sum() const { return run_duration_sum_; }
@@ -122,6 +178,22 @@ int32 DeathData::queue_duration_sample() const {
   return queue_duration_sample_;
 }
 
+int32 DeathData::queue_duration_histogram(int bucket) const {
+  DCHECK_GE(bucket, 0);
+  DCHECK_LT(bucket, kQueueDurationBuckets);
+  return queue_duration_histogram_[bucket];
+}
+
+// static
+int DeathData::QueueDurationBucket(int32 queue_duration) {
+  int bucket = 0;
+  while (queue_duration > 0 && bucket < kQueueDurationBuckets - 1) {
+    queue_duration >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
 void DeathData::ResetMax() {
   run_duration_max_ = 0;
   queue_duration_max_ = 0;
@@ -135,6 +207,8 @@ void DeathData::Clear() {
   queue_duration_sum_ = 0;
   queue_duration_max_ = 0;
   queue_duration_sample_ = 0;
+  for (int i = 0; i < kQueueDurationBuckets; ++i)
+    queue_duration_histogram_[i] = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -157,6 +231,9 @@ DeathDataSnapshot::DeathDataSnapshot(
       queue_duration_sum(death_data.queue_duration_sum()),
       queue_duration_max(death_data.queue_duration_max()),
       queue_duration_sample(death_data.queue_duration_sample()) {
+  queue_duration_histogram.reserve(DeathData::kQueueDurationBuckets);
+  for (int i = 0; i < DeathData::kQueueDurationBuckets; ++i)
+    queue_duration_histogram.push_back(death_data.queue_duration_histogram(i));
 }
 
 DeathDataSnapshot::~DeathDataSnapshot() {
@@ -234,12 +311,19 @@ base::LazyInstance<base::Lock>::Leaky
 // static
 ThreadData::Status ThreadData::status_ = ThreadData::UNINITIALIZED;
 
+// static
+int ThreadData::timing_sample_rate_ = 1;
+
 ThreadData::ThreadData(const std::string& suggested_name)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(0),
+      timed_runs_(0),
+      sampled_run_depth_(0),
+      runs_until_timed_(0),
       incarnation_count_for_pool_(-1) {
   DCHECK_GE(suggested_name.size(), 0u);
+  ClearLookupCaches();
   thread_name_ = suggested_name;
   PushToHeadOfList();  // Which sets real incarnation_count_for_pool_.
 }
@@ -248,14 +332,24 @@ ThreadData::ThreadData(int thread_number)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(thread_number),
+      timed_runs_(0),
+      sampled_run_depth_(0),
+      runs_until_timed_(0),
       incarnation_count_for_pool_(-1)  {
   CHECK_GT(thread_number, 0);
+  ClearLookupCaches();
   base::StringAppendF(&thread_name_, "WorkerThread-%d", thread_number);
   PushToHeadOfList();  // Which sets real incarnation_count_for_pool_.
 }
 
 ThreadData::~ThreadData() {}
 
+void ThreadData::ClearLookupCaches() {
+  memset(birth_cache_, 0, sizeof(birth_cache_));
+  memset(death_cache_keys_, 0, sizeof(death_cache_keys_));
+  memset(death_cache_values_, 0, sizeof(death_cache_values_));
+}
+
 void ThreadData::PushToHeadOfList() {
   // Toss in a hint of randomness (atop the uniniitalized value).
   (void)VALGRIND_MAKE_MEM_DEFINED_IF_ADDRESSABLE(&random_number_,
@@ -373,17 +467,23 @@ void ThreadData::Snapshot(bool reset_max, ProcessDataSnapshot* process_data) {
 }
 
 Births* ThreadData::TallyABirth(const Location& location) {
-  BirthMap::iterator it = birth_map_.find(location);
-  Births* child;
-  if (it != birth_map_.end()) {
-    child =  it->second;
+  size_t cache_index = HashLocation(location) & (kLookupCacheSize - 1);
+  Births* child = birth_cache_[cache_index];
+  if (child && SameLocation(child->location(), location)) {
     child->RecordBirth();
   } else {
-    child = new Births(location, *this);  // Leak this.
-    // Lock since the map may get relocated now, and other threads sometimes
-    // snapshot it (but they lock before copying it).
-    base::AutoLock lock(map_lock_);
-    birth_map_[location] = child;
+    BirthMap::iterator it = birth_map_.find(location);
+    if (it != birth_map_.end()) {
+      child =  it->second;
+      child->RecordBirth();
+    } else {
+      child = new Births(location, *this);  // Leak this.
+      // Lock since the map may get relocated now, and other threads sometimes
+      // snapshot it (but they lock before copying it).
+      base::AutoLock lock(map_lock_);
+      birth_map_[location] = child;
+    }
+    birth_cache_[cache_index] = child;
   }
 
   if (kTrackParentChildLinks && status_ > PROFILING_ACTIVE &&
@@ -402,6 +502,7 @@ Births* ThreadData::TallyABirth(const Location& location) {
 }
 
 void ThreadData::TallyADeath(const Births& birth,
+                             bool timed,
                              int32 queue_duration,
                              int32 run_duration) {
   // Stir in some randomness, plus add constant in case durations are zero.
@@ -416,15 +517,27 @@ void ThreadData::TallyADeath(const Births& birth,
   if (kAllowAlternateTimeSourceHandling && now_function_)
     queue_duration = 0;
 
-  DeathMap::iterator it = death_map_.find(&birth);
+  size_t cache_index = HashBirths(&birth) & (kLookupCacheSize - 1);
   DeathData* death_data;
-  if (it != death_map_.end()) {
-    death_data = &it->second;
+  if (death_cache_keys_[cache_index] == &birth) {
+    death_data = death_cache_values_[cache_index];
+  } else {
+    DeathMap::iterator it = death_map_.find(&birth);
+    if (it != death_map_.end()) {
+      death_data = &it->second;
+    } else {
+      base::AutoLock lock(map_lock_);  // Lock as the map may get relocated now.
+      death_data = &death_map_[&birth];
+    }  // Release lock ASAP.
+    death_cache_keys_[cache_index] = &birth;
+    death_cache_values_[cache_index] = death_data;
+  }
+  if (timed) {
+    death_data->RecordSampledDeath(queue_duration, run_duration,
+                                   random_number_, timing_sample_rate_);
   } else {
-    base::AutoLock lock(map_lock_);  // Lock as the map may get relocated now.
-    death_data = &death_map_[&birth];
-  }  // Release lock ASAP.
-  death_data->RecordDeath(queue_duration, run_duration, random_number_);
+    death_data->RecordUntimedDeath();
+  }
 
   if (!kTrackParentChildLinks)
     return;
@@ -469,7 +582,8 @@ void ThreadData::TallyRunOnNamedThreadIfTracking(
   // of start_of_run or end_of_run is zero.  In that case, we didn't bother to
   // get a time value since we "weren't tracking" and we were trying to be
   // efficient by not calling for a genuine time value. For simplicity, we'll
-  // use a default zero duration when we can't calculate a true value.
+  // use a default zero duration when we can't calculate a true value.  A null
+  // start_of_run also marks a run that was not sampled for timing.
   int32 queue_duration = 0;
   int32 run_duration = 0;
   if (!start_of_run.is_null()) {
@@ -478,7 +592,8 @@ void ThreadData::TallyRunOnNamedThreadIfTracking(
     if (!end_of_run.is_null())
       run_duration = (end_of_run - start_of_run).InMilliseconds();
   }
-  current_thread_data->TallyADeath(*birth, queue_duration, run_duration);
+  current_thread_data->TallyADeath(*birth, !start_of_run.is_null(),
+                                   queue_duration, run_duration);
 }
 
 // static
@@ -516,7 +631,8 @@ void ThreadData::TallyRunOnWorkerThreadIfTracking(
     if (!end_of_run.is_null())
       run_duration = (end_of_run - start_of_run).InMilliseconds();
   }
-  current_thread_data->TallyADeath(*birth, queue_duration, run_duration);
+  current_thread_data->TallyADeath(*birth, !start_of_run.is_null(),
+                                   queue_duration, run_duration);
 }
 
 // static
@@ -541,7 +657,8 @@ void ThreadData::TallyRunInAScopedRegionIfTracking(
   int32 run_duration = 0;
   if (!start_of_run.is_null() && !end_of_run.is_null())
     run_duration = (end_of_run - start_of_run).InMilliseconds();
-  current_thread_data->TallyADeath(*birth, queue_duration, run_duration);
+  current_thread_data->TallyADeath(*birth, !start_of_run.is_null(),
+                                   queue_duration, run_duration);
 }
 
 // static
@@ -733,14 +850,120 @@ TrackedTime ThreadData::NowForStartOfRun(const Births* parent) {
     if (current_thread_data)
       current_thread_data->parent_stack_.push(parent);
   }
+  if (timing_sample_rate_ > 1 && TrackingStatus()) {
+    ThreadData* current_thread_data = Get();
+    if (current_thread_data && !current_thread_data->StartSampledRun())
+      return TrackedTime();
+  }
   return Now();
 }
 
 // static
 TrackedTime ThreadData::NowForEndOfRun() {
+  if (timing_sample_rate_ > 1 && TrackingStatus()) {
+    ThreadData* current_thread_data = Get();
+    if (current_thread_data && !current_thread_data->EndSampledRun())
+      return TrackedTime();
+  }
   return Now();
 }
 
+bool ThreadData::StartSampledRun() {
+  bool timed = --runs_until_timed_ <= 0;
+  if (timed) {
+    // Spread timed runs uniformly around the mean spacing, so that they don't
+    // keep landing on the same task of a periodic sequence of tasks.
+    random_number_ = static_cast<int32>(
+        static_cast<uint32>(random_number_) * 1103515245u + 12345u);
+    runs_until_timed_ = 1 + static_cast<uint32>(random_number_) %
+        (2 * timing_sample_rate_ - 1);
+  }
+  timed_runs_ = (timed_runs_ << 1) | (timed ? 1 : 0);
+  ++sampled_run_depth_;
+  return timed;
+}
+
+bool ThreadData::EndSampledRun() {
+  // Runs that started before sampling was turned on were timed.  Runs nested
+  // deeper than timed_runs_ has bits for lose their end time, which only
+  // zeroes their run duration.
+  if (sampled_run_depth_ == 0)
+    return true;
+  --sampled_run_depth_;
+  bool timed = (timed_runs_ & 1) != 0;
+  timed_runs_ >>= 1;
+  return timed;
+}
+
+// static
+void ThreadData::SetTimingSampleRate(int rate) {
+  DCHECK_GE(rate, 1);
+  timing_sample_rate_ = rate;
+}
+
+// static
+int ThreadData::timing_sample_rate() {
+  return timing_sample_rate_;
+}
+
+// static
+void ThreadData::TraceSnapshot() {
+  bool enabled;
+  TRACE_EVENT_CATEGORY_GROUP_ENABLED(
+      TRACE_DISABLED_BY_DEFAULT("tracked_objects"), &enabled);
+  if (!enabled)
+    return;
+
+  ProcessDataSnapshot process_data;
+  Snapshot(false, &process_data);
+  std::string json;
+  AppendSnapshotAsTraceFormat(process_data, &json);
+  scoped_ptr<base::debug::ConvertableToTraceFormat> holder(
+      new ProcessDataHolder(json));
+  const int kSnapshotId = 1;
+  TRACE_EVENT_OBJECT_SNAPSHOT_WITH_ID(
+      TRACE_DISABLED_BY_DEFAULT("tracked_objects"),
+      "tracked_objects::ProcessData",
+      kSnapshotId,
+      holder.Pass());
+}
+
+// static
+void ThreadData::AppendSnapshotAsTraceFormat(
+    const ProcessDataSnapshot& process_data,
+    std::string* output) {
+  base::StringAppendF(output, "{\"process_id\": %d, \"tasks\": [",
+                      process_data.process_id);
+  for (size_t i = 0; i < process_data.tasks.size(); ++i) {
+    const TaskSnapshot& task = process_data.tasks[i];
+    const DeathDataSnapshot& death = task.death_data;
+    if (i)
+      output->append(", ");
+    output->append("{\"birth_thread\": ");
+    base::JsonDoubleQuote(task.birth.thread_name, true, output);
+    output->append(", \"death_thread\": ");
+    base::JsonDoubleQuote(task.death_thread_name, true, output);
+    output->append(", \"file\": ");
+    base::JsonDoubleQuote(task.birth.location.file_name, true, output);
+    output->append(", \"function\": ");
+    base::JsonDoubleQuote(task.birth.location.function_name, true, output);
+    base::StringAppendF(
+        output,
+        ", \"line\": %d, \"count\": %d, \"run_ms\": %d, "
+        "\"run_ms_max\": %d, \"queue_ms\": %d, \"queue_ms_max\": %d, "
+        "\"queue_ms_histogram\": [",
+        task.birth.location.line_number, death.count, death.run_duration_sum,
+        death.run_duration_max, death.queue_duration_sum,
+        death.queue_duration_max);
+    for (size_t j = 0; j < death.queue_duration_histogram.size(); ++j) {
+      base::StringAppendF(output, j ? ", %d" : "%d",
+                          death.queue_duration_histogram[j]);
+    }
+    output->append("]}");
+  }
+  output->append("]}");
+}
+
 // static
 void ThreadData::SetAlternateTimeSource(NowFunction* now_function) {
   DCHECK(now_function);
@@ -794,6 +1017,7 @@ void ThreadData::ShutdownSingleThreadedCleanup(bool leak) {
   // Put most global static back in pristine shape.
   worker_thread_data_creation_count_ = 0;
   cleanup_count_ = 0;
+  timing_sample_rate_ = 1;
   tls_index_.Set(NULL);
   status_ = DORMANT_DURING_TESTS;  // Almost UNINITIALIZED.
 
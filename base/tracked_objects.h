@@ -265,12 +265,29 @@ class BASE_EXPORT DeathData {
   // a corresponding death.
   explicit DeathData(int count);
 
+  // Number of buckets in the histogram of queueing delays.  Bucket 0 counts
+  // delays under 1ms, bucket i counts delays in [2^(i-1), 2^i) ms, and the
+  // last bucket also counts all longer delays.
+  enum { kQueueDurationBuckets = 12 };
+
   // Update stats for a task destruction (death) that had a Run() time of
   // |duration|, and has had a queueing delay of |queue_duration|.
   void RecordDeath(const int32 queue_duration,
                    const int32 run_duration,
                    int random_number);
 
+  // Same as RecordDeath(), for a timed run that stands in for |weight| runs
+  // when only one in |weight| runs is timed (see
+  // ThreadData::SetTimingSampleRate()).  Sums and histogram buckets are scaled
+  // by |weight|, so that averages stay unbiased.
+  void RecordSampledDeath(const int32 queue_duration,
+                          const int32 run_duration,
+                          int random_number,
+                          int weight);
+
+  // Update stats for a death whose run was not timed.  Only the count changes.
+  void RecordUntimedDeath();
+
   // Metrics accessors, used only for serialization and in tests.
   int count() const;
   int32 run_duration_sum() const;
@@ -279,6 +296,11 @@ class BASE_EXPORT DeathData {
   int32 queue_duration_sum() const;
   int32 queue_duration_max() const;
   int32 queue_duration_sample() const;
+  int32 queue_duration_histogram(int bucket) const;
+
+  // Returns the histogram bucket that counts a queueing delay of
+  // |queue_duration| milliseconds.
+  static int QueueDurationBucket(int32 queue_duration);
 
   // Reset the max values to zero.
   void ResetMax();
@@ -302,6 +324,9 @@ class BASE_EXPORT DeathData {
   // and rarely updated.
   int32 run_duration_sample_;
   int32 queue_duration_sample_;
+  // Distribution of queueing delays, used to tell a few very late runs from
+  // many slightly late ones, which the sum and max can't.
+  int32 queue_duration_histogram_[kQueueDurationBuckets];
 };
 
 //------------------------------------------------------------------------------
@@ -319,6 +344,7 @@ struct BASE_EXPORT DeathDataSnapshot {
   int32 queue_duration_sum;
   int32 queue_duration_max;
   int32 queue_duration_sample;
+  std::vector<int32> queue_duration_histogram;
 };
 
 //------------------------------------------------------------------------------
@@ -464,6 +490,26 @@ class BASE_EXPORT ThreadData {
   static TrackedTime NowForStartOfRun(const Births* parent);
   static TrackedTime NowForEndOfRun();
 
+  // Times only one in about |rate| runs on each thread, to make profiling
+  // cheap enough to leave on.  NowForStartOfRun() and NowForEndOfRun() return
+  // a null time for untimed runs, without reading the clock, and such runs are
+  // counted but add nothing to the sums.  Timed runs are weighted by |rate| so
+  // that sum / count remains an unbiased average.  The default rate of 1 times
+  // every run.
+  static void SetTimingSampleRate(int rate);
+  static int timing_sample_rate();
+
+  // Records the current snapshot as a "tracked_objects::ProcessData" object
+  // snapshot in the disabled-by-default "tracked_objects" trace category.  This
+  // is cheap enough to call from a timer to follow the profile over time.
+  static void TraceSnapshot();
+
+  // Appends |process_data| to |output| as JSON, in the format used by
+  // TraceSnapshot().
+  static void AppendSnapshotAsTraceFormat(
+      const ProcessDataSnapshot& process_data,
+      std::string* output);
+
   // Provide a time function that does nothing (runs fast) when we don't have
   // the profiler enabled.  It will generally be optimized away when it is
   // ifdef'ed to be small enough (allowing the profiler to be "compiled out" of
@@ -488,12 +534,17 @@ class BASE_EXPORT ThreadData {
   // better change of optimizing (inlining? etc.) private methods (knowing that
   // there will be no need for an external entry point).
   friend class TrackedObjectsTest;
+  friend class TrackedObjectsPerfTest;
   FRIEND_TEST_ALL_PREFIXES(TrackedObjectsTest, MinimalStartupShutdown);
   FRIEND_TEST_ALL_PREFIXES(TrackedObjectsTest, TinyStartupShutdown);
   FRIEND_TEST_ALL_PREFIXES(TrackedObjectsTest, ParentChildTest);
 
   typedef std::map<const BirthOnThread*, int> BirthCountMap;
 
+  // Size of the direct-mapped caches in front of birth_map_ and death_map_.
+  // Must be a power of two.
+  enum { kLookupCacheSize = 64 };
+
   // Worker thread construction creates a name since there is none.
   explicit ThreadData(int thread_number);
 
@@ -502,6 +553,9 @@ class BASE_EXPORT ThreadData {
 
   ~ThreadData();
 
+  // Empties the birth and death lookup caches.
+  void ClearLookupCaches();
+
   // Push this instance to the head of all_thread_data_list_head_, linking it to
   // the previous head.  This is performed after each construction, and leaves
   // the instance permanently on that list.
@@ -517,8 +571,18 @@ class BASE_EXPORT ThreadData {
   // In this thread's data, record a new birth.
   Births* TallyABirth(const Location& location);
 
-  // Find a place to record a death on this thread.
-  void TallyADeath(const Births& birth, int32 queue_duration, int32 duration);
+  // Find a place to record a death on this thread.  |timed| is false if the
+  // run was not timed (see SetTimingSampleRate()), in which case the
+  // durations are ignored.
+  void TallyADeath(const Births& birth,
+                   bool timed,
+                   int32 queue_duration,
+                   int32 duration);
+
+  // Called on this thread at the start and end of each run while timing is
+  // sampled, to decide (and later recall) whether the run is timed.
+  bool StartSampledRun();
+  bool EndSampledRun();
 
   // Snapshot (under a lock) the profiled data for the tasks in each ThreadData
   // instance.  Also updates the |birth_counts| tally for each task to keep
@@ -614,6 +678,9 @@ class BASE_EXPORT ThreadData {
   // We set status_ to SHUTDOWN when we shut down the tracking service.
   static Status status_;
 
+  // One in about this many runs is timed.  See SetTimingSampleRate().
+  static int timing_sample_rate_;
+
   // Link to next instance (null terminated list). Used to globally track all
   // registered instances (corresponds to all registered threads where we keep
   // data).
@@ -651,6 +718,14 @@ class BASE_EXPORT ThreadData {
   // local Births (that took place on this thread).
   ParentChildSet parent_child_set_;
 
+  // Direct-mapped caches of the most recently used entries of birth_map_ and
+  // death_map_, which spare most births and deaths the map lookup.  Map
+  // entries are never erased, so cached pointers stay valid.  Only accessed
+  // on this thread.
+  Births* birth_cache_[kLookupCacheSize];
+  const Births* death_cache_keys_[kLookupCacheSize];
+  DeathData* death_cache_values_[kLookupCacheSize];
+
   // Lock to protect *some* access to BirthMap and DeathMap.  The maps are
   // regularly read and written on this thread, but may only be read from other
   // threads.  To support this, we acquire this lock if we are writing from this
@@ -675,6 +750,15 @@ class BASE_EXPORT ThreadData {
   // we stir in more and more as we go.
   int32 random_number_;
 
+  // One bit per run in progress on this thread, with the innermost run in the
+  // low bit, set if that run is timed.  Only maintained while timing is
+  // sampled; |sampled_run_depth_| counts the runs that have a bit.
+  uint32 timed_runs_;
+  int sampled_run_depth_;
+
+  // Number of runs left until the next timed run.
+  int runs_until_timed_;
+
   // Record of what the incarnation_counter_ was when this instance was created.
   // If the incarnation_counter_ has changed, then we avoid pushing into the
   // pool (this is only critical in tests which go through multiple
@@ -0,0 +1,82 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "base/tracked_objects.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace tracked_objects {
+
+namespace {
+
+const int kTasks = 1000 * 1000;
+
+void DoNothing(int* counter) {
+  ++*counter;
+}
+
+// Posts from several locations, as a real message loop sees tasks from many.
+void PostTasks(base::MessageLoop* loop, int* counter, int count) {
+  for (int i = 0; i < count; i += 4) {
+    loop->PostTask(FROM_HERE, base::Bind(&DoNothing, counter));
+    loop->PostTask(FROM_HERE, base::Bind(&DoNothing, counter));
+    loop->PostTask(FROM_HERE, base::Bind(&DoNothing, counter));
+    loop->PostTask(FROM_HERE, base::Bind(&DoNothing, counter));
+  }
+}
+
+}  // namespace
+
+class TrackedObjectsPerfTest : public testing::Test {
+ protected:
+  TrackedObjectsPerfTest() {
+    ThreadData::ShutdownSingleThreadedCleanup(true);
+  }
+
+  virtual ~TrackedObjectsPerfTest() {
+    ThreadData::ShutdownSingleThreadedCleanup(true);
+  }
+
+  // Posts and runs |kTasks| empty tasks with the profiler in |status|, timing
+  // one in |sample_rate| runs, and logs the time taken per task as |name|.
+  void RunTasks(const char* name, ThreadData::Status status, int sample_rate) {
+    ThreadData::InitializeAndSetTrackingStatus(status);
+    ThreadData::SetTimingSampleRate(sample_rate);
+    base::MessageLoop loop;
+    int counter = 0;
+    PerfTimer timer;
+    PostTasks(&loop, &counter, kTasks);
+    loop.RunUntilIdle();
+    base::TimeDelta elapsed = timer.Elapsed();
+    EXPECT_EQ(kTasks, counter);
+    ThreadData::SetTimingSampleRate(1);
+
+    LogPerfResult(base::StringPrintf("TrackedObjects_%s", name).c_str(),
+                  elapsed.InMillisecondsF() * 1000.0 * 1000.0 / kTasks,
+                  "ns/task");
+  }
+};
+
+TEST_F(TrackedObjectsPerfTest, PostTaskOverhead) {
+  RunTasks("deactivated", ThreadData::DEACTIVATED, 1);
+  RunTasks("all_timed", ThreadData::PROFILING_ACTIVE, 1);
+  RunTasks("sampled_1_in_16", ThreadData::PROFILING_ACTIVE, 16);
+
+  // Snapshotting should stay cheap enough to do periodically.
+  ThreadData::InitializeAndSetTrackingStatus(ThreadData::PROFILING_ACTIVE);
+  PerfTimer timer;
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  std::string json;
+  ThreadData::AppendSnapshotAsTraceFormat(process_data, &json);
+  LogPerfResult("TrackedObjects_snapshot", timer.Elapsed().InMillisecondsF(),
+                "ms");
+}
+
+}  // namespace tracked_objects
@@ -6,9 +6,11 @@
 
 #include "base/tracked_objects.h"
 
+#include "base/json/json_reader.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/process/process_handle.h"
 #include "base/time/time.h"
+#include "base/values.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 const int kLineNumber = 1776;
@@ -578,4 +580,131 @@ TEST_F(TrackedObjectsTest, DifferentLives) {
   EXPECT_EQ(base::GetCurrentProcId(), process_data.process_id);
 }
 
+TEST_F(TrackedObjectsTest, QueueDurationHistogram) {
+  EXPECT_EQ(0, DeathData::QueueDurationBucket(0));
+  EXPECT_EQ(1, DeathData::QueueDurationBucket(1));
+  EXPECT_EQ(2, DeathData::QueueDurationBucket(2));
+  EXPECT_EQ(2, DeathData::QueueDurationBucket(3));
+  EXPECT_EQ(3, DeathData::QueueDurationBucket(4));
+  EXPECT_EQ(DeathData::kQueueDurationBuckets - 1,
+            DeathData::QueueDurationBucket(1 << 20));
+
+  DeathData data;
+  const int kUnrandomInt = 0;
+  data.RecordDeath(0, 1, kUnrandomInt);
+  data.RecordDeath(3, 1, kUnrandomInt);
+  data.RecordDeath(3, 1, kUnrandomInt);
+  data.RecordDeath(100000, 1, kUnrandomInt);
+
+  DeathDataSnapshot snapshot(data);
+  ASSERT_EQ(static_cast<size_t>(DeathData::kQueueDurationBuckets),
+            snapshot.queue_duration_histogram.size());
+  EXPECT_EQ(1, snapshot.queue_duration_histogram[0]);
+  EXPECT_EQ(2, snapshot.queue_duration_histogram[2]);
+  EXPECT_EQ(1, snapshot.queue_duration_histogram[
+      DeathData::kQueueDurationBuckets - 1]);
+
+  data.Clear();
+  for (int i = 0; i < DeathData::kQueueDurationBuckets; ++i)
+    EXPECT_EQ(0, data.queue_duration_histogram(i));
+}
+
+TEST_F(TrackedObjectsTest, SampledDeathsAreWeighted) {
+  DeathData data;
+  const int kUnrandomInt = 0;
+  const int kWeight = 8;
+  data.RecordSampledDeath(4, 2, kUnrandomInt, kWeight);
+  for (int i = 0; i < kWeight - 1; ++i)
+    data.RecordUntimedDeath();
+
+  EXPECT_EQ(kWeight, data.count());
+  EXPECT_EQ(kWeight * 2, data.run_duration_sum());
+  EXPECT_EQ(2, data.run_duration_max());
+  EXPECT_EQ(2, data.run_duration_sample());
+  EXPECT_EQ(kWeight * 4, data.queue_duration_sum());
+  EXPECT_EQ(4, data.queue_duration_max());
+  EXPECT_EQ(kWeight, data.queue_duration_histogram(
+      DeathData::QueueDurationBucket(4)));
+}
+
+TEST_F(TrackedObjectsTest, TimingSampleRate) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+          ThreadData::PROFILING_ACTIVE))
+    return;
+
+  const int kRate = 10;
+  const int kRuns = 1000;
+  ThreadData::SetTimingSampleRate(kRate);
+  EXPECT_EQ(kRate, ThreadData::timing_sample_rate());
+
+  const char kFunction[] = "TimingSampleRate";
+  Location location(kFunction, kFile, kLineNumber, NULL);
+  int timed_runs = 0;
+  for (int i = 0; i < kRuns; ++i) {
+    Births* birth = ThreadData::TallyABirthIfActive(location);
+    TrackedTime start_of_run = ThreadData::NowForStartOfRun(birth);
+    // A nested run must not disturb the decision for the outer run.
+    TrackedTime nested_start = ThreadData::NowForStartOfRun(NULL);
+    TrackedTime nested_end = ThreadData::NowForEndOfRun();
+    EXPECT_EQ(nested_start.is_null(), nested_end.is_null());
+    TrackedTime end_of_run = ThreadData::NowForEndOfRun();
+    EXPECT_EQ(start_of_run.is_null(), end_of_run.is_null());
+    if (!start_of_run.is_null())
+      ++timed_runs;
+    ThreadData::TallyRunOnWorkerThreadIfTracking(birth, start_of_run,
+                                                 start_of_run, end_of_run);
+  }
+  EXPECT_GT(timed_runs, kRuns / kRate / 2);
+  EXPECT_LT(timed_runs, kRuns / kRate * 2);
+
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  ASSERT_EQ(1u, process_data.tasks.size());
+  EXPECT_EQ(kRuns, process_data.tasks[0].death_data.count);
+}
+
+TEST_F(TrackedObjectsTest, SnapshotAsTraceFormat) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+          ThreadData::PROFILING_ACTIVE))
+    return;
+
+  const char kFunction[] = "SnapshotAsTraceFormat";
+  Location location(kFunction, kFile, kLineNumber, NULL);
+  Births* birth = ThreadData::TallyABirthIfActive(location);
+  const TrackedTime kTimePosted = TrackedTime() + Duration::FromMilliseconds(1);
+  const TrackedTime kStartOfRun = TrackedTime() +
+      Duration::FromMilliseconds(5);
+  const TrackedTime kEndOfRun = TrackedTime() + Duration::FromMilliseconds(7);
+  ThreadData::TallyRunOnWorkerThreadIfTracking(birth, kTimePosted,
+                                               kStartOfRun, kEndOfRun);
+
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  std::string json;
+  ThreadData::AppendSnapshotAsTraceFormat(process_data, &json);
+
+  scoped_ptr<base::Value> root(base::JSONReader::Read(json));
+  base::DictionaryValue* root_dict = NULL;
+  ASSERT_TRUE(root && root->GetAsDictionary(&root_dict));
+  base::ListValue* tasks = NULL;
+  ASSERT_TRUE(root_dict->GetList("tasks", &tasks));
+  ASSERT_EQ(1u, tasks->GetSize());
+  base::DictionaryValue* task = NULL;
+  ASSERT_TRUE(tasks->GetDictionary(0, &task));
+  std::string function;
+  EXPECT_TRUE(task->GetString("function", &function));
+  EXPECT_EQ(kFunction, function);
+  int value = 0;
+  EXPECT_TRUE(task->GetInteger("count", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(task->GetInteger("run_ms", &value));
+  EXPECT_EQ(2, value);
+  EXPECT_TRUE(task->GetInteger("queue_ms", &value));
+  EXPECT_EQ(4, value);
+  base::ListValue* histogram = NULL;
+  ASSERT_TRUE(task->GetList("queue_ms_histogram", &histogram));
+  EXPECT_EQ(static_cast<size_t>(DeathData::kQueueDurationBuckets),
+            histogram->GetSize());
+}
+
 }  // namespace tracked_objects
@@ -807,6 +807,38 @@ TEST_F(InMemoryURLIndexTest, TypedCharacterCaching) {
   CheckTerm(cache, ASCIIToUTF16("rec"));
 }
 
+TEST_F(InMemoryURLIndexTest, IncrementalRefinement) {
+  // Simulate typing "mortgage" one character at a time. The items rejected
+  // for the shorter search strings are remembered, and not scored again.
+  URLIndexPrivateData& private_data(*GetPrivateData());
+  const string16 search_string(ASCIIToUTF16("mortgage"));
+  ScoredHistoryMatches matches;
+  for (size_t i = 1; i <= search_string.length(); ++i) {
+    matches = url_index_->HistoryItemsForTerms(search_string.substr(0, i),
+                                               string16::npos);
+  }
+  EXPECT_FALSE(private_data.rejected_history_ids_.empty());
+
+  // A search string which does not extend the previous one is scored from
+  // scratch, and finds the same matches.
+  url_index_->HistoryItemsForTerms(ASCIIToUTF16("zzz"), string16::npos);
+  EXPECT_TRUE(private_data.rejected_history_ids_.empty());
+  ScoredHistoryMatches fresh_matches =
+      url_index_->HistoryItemsForTerms(search_string, string16::npos);
+  ASSERT_FALSE(matches.empty());
+  ASSERT_EQ(fresh_matches.size(), matches.size());
+  for (size_t i = 0; i < matches.size(); ++i) {
+    EXPECT_EQ(fresh_matches[i].url_info.id(), matches[i].url_info.id());
+    EXPECT_EQ(fresh_matches[i].raw_score, matches[i].raw_score);
+  }
+
+  // Updating the index forgets the rejected items, as they may match now.
+  URLRow new_row(GURL("http://www.mortgagerates.com/"), 87654321);
+  new_row.set_last_visit(base::Time::Now());
+  EXPECT_TRUE(UpdateURL(new_row));
+  EXPECT_TRUE(private_data.rejected_history_ids_.empty());
+}
+
 TEST_F(InMemoryURLIndexTest, AddNewRows) {
   // Verify that the row we're going to add does not already exist.
   URLID new_row_id = 87654321;
@@ -185,6 +185,7 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   // initialized yet) or the search string has no words.
   if (word_list_.empty() || lower_words.empty()) {
     search_term_cache_.clear();  // Invalidate the term cache.
+    ResetRejectedHistoryIDs();
     return scored_items;
   }
 
@@ -194,6 +195,20 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
 
   HistoryIDSet history_id_set = HistoryIDSetFromWords(lower_words);
 
+  // When the user extends the previous search string, skip the candidates
+  // it rejected before they take up any of the scoring budget below. Every
+  // term of the previous search string is contained in a term of the new one.
+  if (!last_search_string_.empty() &&
+      StartsWith(lower_raw_string, last_search_string_, true)) {
+    for (HistoryIDSet::const_iterator it = rejected_history_ids_.begin();
+         it != rejected_history_ids_.end(); ++it) {
+      history_id_set.erase(*it);
+    }
+  } else {
+    rejected_history_ids_.clear();
+  }
+  last_search_string_ = lower_raw_string;
+
   // Trim the candidate pool if it is large. Note that we do not filter out
   // items that do not contain the search terms as proper substrings -- doing
   // so is the performance-costly operation we are trying to avoid in order
@@ -244,9 +259,13 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
     // but this is such a rare edge case that it's not worth the time.
     return scored_items;
   }
-  scored_items = std::for_each(history_id_set.begin(), history_id_set.end(),
+  AddHistoryMatch add_history_match = std::for_each(
+      history_id_set.begin(), history_id_set.end(),
       AddHistoryMatch(*this, languages, bookmark_service, lower_raw_string,
-                      lower_raw_terms, base::Time::Now())).ScoredMatches();
+                      lower_raw_terms, base::Time::Now()));
+  scored_items = add_history_match.ScoredMatches();
+  rejected_history_ids_.insert(add_history_match.RejectedIDs().begin(),
+                               add_history_match.RejectedIDs().end());
 
   // Select and sort only the top kMaxMatches results.
   if (scored_items.size() > AutocompleteProvider::kMaxMatches) {
@@ -330,8 +349,10 @@ bool URLIndexPrivateData::UpdateURL(
     RemoveRowFromIndex(row);
     row_was_updated = true;
   }
-  if (row_was_updated)
+  if (row_was_updated) {
     search_term_cache_.clear();  // This invalidates the cache.
+    ResetRejectedHistoryIDs();
+  }
   return row_was_updated;
 }
 
@@ -388,6 +409,7 @@ bool URLIndexPrivateData::DeleteURL(const GURL& url) {
     return false;
   RemoveRowFromIndex(pos->second.url_row);
   search_term_cache_.clear();  // This invalidates the cache.
+  ResetRejectedHistoryIDs();
   return true;
 }
 
@@ -888,6 +910,11 @@ void URLIndexPrivateData::ResetSearchTermCache() {
     iter->second.used_ = false;
 }
 
+void URLIndexPrivateData::ResetRejectedHistoryIDs() {
+  last_search_string_.clear();
+  rejected_history_ids_.clear();
+}
+
 bool URLIndexPrivateData::SaveToFile(const base::FilePath& file_path) {
   base::TimeTicks beginning_time = base::TimeTicks::Now();
   InMemoryURLIndexCacheItem index_cache;
@@ -1303,6 +1330,8 @@ void URLIndexPrivateData::AddHistoryMatch::operator()(
                              bookmark_service_);
     if (match.raw_score > 0)
       scored_matches_.push_back(match);
+    else
+      rejected_ids_.insert(history_id);
   }
 }
 
@@ -64,9 +64,12 @@ class URLIndexPrivateData
   // will be found in nearly all history candidates. Results are sorted by
   // descending score. The full results set (i.e. beyond the
   // |kItemsToScoreLimit| limit) will be retained and used for subsequent calls
-  // to this function. |bookmark_service| is used to boost a result's score if
-  // its URL is referenced by one or more of the user's bookmarks.  |languages|
-  // is used to help parse/format the URLs in the history index.
+  // to this function. When |term_string| extends the previous search string,
+  // as it does while the user types, the candidates that the previous search
+  // rejected are not scored again. |bookmark_service| is used to boost a
+  // result's score if its URL is referenced by one or more of the user's
+  // bookmarks.  |languages| is used to help parse/format the URLs in the
+  // history index.
   ScoredHistoryMatches HistoryItemsForTerms(string16 term_string,
                                             size_t cursor_position,
                                             const std::string& languages,
@@ -152,6 +155,7 @@ class URLIndexPrivateData
   friend class InMemoryURLIndexTest;
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheSaveRestore);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, HugeResultSet);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, IncrementalRefinement);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, ReadVisitsFromHistory);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, RebuildFromHistoryIfCacheOld);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Scoring);
@@ -207,11 +211,15 @@ class URLIndexPrivateData
 
     ScoredHistoryMatches ScoredMatches() const { return scored_matches_; }
 
+    // The candidates which were scored and did not match.
+    const HistoryIDSet& RejectedIDs() const { return rejected_ids_; }
+
    private:
     const URLIndexPrivateData& private_data_;
     const std::string& languages_;
     BookmarkService* bookmark_service_;
     ScoredHistoryMatches scored_matches_;
+    HistoryIDSet rejected_ids_;
     const string16& lower_string_;
     const String16Vector& lower_terms_;
     const base::Time now_;
@@ -293,6 +301,10 @@ class URLIndexPrivateData
   // Clears |used_| for each item in the search term cache.
   void ResetSearchTermCache();
 
+  // Forgets the history items rejected by the recent searches, as the index
+  // changed since.
+  void ResetRejectedHistoryIDs();
+
   // Caches the index private data and writes the cache file to the profile
   // directory.  Called by WritePrivateDataToCacheFileTask.
   bool SaveToFile(const base::FilePath& file_path);
@@ -326,6 +338,13 @@ class URLIndexPrivateData
   // Cache of search terms.
   SearchTermCacheMap search_term_cache_;
 
+  // The lower-cased search string of the most recent search, and the history
+  // items that it, or the searches it extended, scored and rejected. An item
+  // which does not match some terms cannot match terms which extend them, so
+  // these are skipped while the search string keeps being extended.
+  string16 last_search_string_;
+  HistoryIDSet rejected_history_ids_;
+
   // Allows canceling pending requests to update recent visits information.
   CancelableRequestConsumer recent_visits_consumer_;
 
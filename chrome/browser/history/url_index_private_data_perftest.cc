@@ -0,0 +1,122 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/url_index_private_data.h"
+
+#include <set>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/strings/string16.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/time/time.h"
+#include "chrome/browser/history/history_database.h"
+#include "chrome/browser/history/history_types.h"
+#include "sql/init_status.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "url/gurl.h"
+
+namespace history {
+
+namespace {
+
+// The number of history items in the synthetic history.
+const int kHistoryItems = 20000;
+
+// The words which make up the synthetic page titles and paths.
+const char* const kWords[] = {
+  "news", "mortgage", "rates", "weather", "sports", "recipes", "travel",
+  "music", "movies", "review", "forum", "search", "report", "market",
+  "finance", "health", "garden", "science", "history", "software",
+};
+
+const char kLanguages[] = "en";
+
+class URLIndexPrivateDataPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    history_db_.reset(new HistoryDatabase);
+    ASSERT_EQ(sql::INIT_OK, history_db_->Init(
+        temp_dir_.path().Append(FILE_PATH_LITERAL("History"))));
+
+    const int kNumWords = static_cast<int>(arraysize(kWords));
+    history_db_->BeginTransaction();
+    for (int i = 0; i < kHistoryItems; ++i) {
+      const char* first_word = kWords[i % kNumWords];
+      const char* second_word = kWords[(i / kNumWords) % kNumWords];
+      URLRow row(GURL(base::StringPrintf(
+          "http://www.site%d.example.com/%s/%s-%d.html",
+          i % 1000, first_word, second_word, i)));
+      row.set_title(UTF8ToUTF16(base::StringPrintf(
+          "%s and %s page %d", first_word, second_word, i)));
+      row.set_visit_count(1 + i % 7);
+      row.set_typed_count(i % 3);
+      row.set_last_visit(base::Time::Now() - base::TimeDelta::FromHours(i));
+      ASSERT_NE(0, history_db_->AddURL(row));
+    }
+    history_db_->CommitTransaction();
+
+    std::set<std::string> scheme_whitelist;
+    scheme_whitelist.insert("http");
+    scheme_whitelist.insert("https");
+    private_data_ = URLIndexPrivateData::RebuildFromHistory(
+        history_db_.get(), kLanguages, scheme_whitelist);
+    ASSERT_TRUE(private_data_.get());
+  }
+
+  // Types |search_string| one character at a time, and logs the mean and the
+  // slowest time per keystroke as |test_name|. When |from_scratch| is set,
+  // an unrelated search runs between keystrokes, so that no keystroke can
+  // reuse the work of the previous one.
+  void TypeSearchString(const std::string& search_string,
+                        bool from_scratch,
+                        const std::string& test_name) {
+    const string16 search_string16(UTF8ToUTF16(search_string));
+    base::TimeDelta total;
+    base::TimeDelta slowest;
+    for (size_t i = 1; i <= search_string16.length(); ++i) {
+      if (from_scratch) {
+        private_data_->HistoryItemsForTerms(ASCIIToUTF16("zzz"),
+                                            string16::npos, kLanguages, NULL);
+      }
+      PerfTimer timer;
+      private_data_->HistoryItemsForTerms(search_string16.substr(0, i),
+                                          string16::npos, kLanguages, NULL);
+      base::TimeDelta elapsed = timer.Elapsed();
+      total += elapsed;
+      if (elapsed > slowest)
+        slowest = elapsed;
+    }
+    LogPerfResult((test_name + "_mean").c_str(),
+                  total.InMillisecondsF() / search_string16.length(), "ms");
+    LogPerfResult((test_name + "_max").c_str(),
+                  slowest.InMillisecondsF(), "ms");
+  }
+
+  base::ScopedTempDir temp_dir_;
+  scoped_ptr<HistoryDatabase> history_db_;
+  scoped_refptr<URLIndexPrivateData> private_data_;
+};
+
+TEST_F(URLIndexPrivateDataPerfTest, TypeFromScratch) {
+  TypeSearchString("mortgage rates", true,
+                   "URLIndexPrivateData_TypeFromScratch");
+}
+
+TEST_F(URLIndexPrivateDataPerfTest, TypeIncrementally) {
+  TypeSearchString("mortgage rates", false,
+                   "URLIndexPrivateData_TypeIncrementally");
+}
+
+}  // namespace
+
+}  // namespace history
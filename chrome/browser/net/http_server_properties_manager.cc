@@ -4,6 +4,10 @@
 
 #include "chrome/browser/net/http_server_properties_manager.h"
 
+#include <algorithm>
+#include <set>
+#include <utility>
+
 #include "base/bind.h"
 #include "base/metrics/histogram.h"
 #include "base/prefs/pref_service.h"
@@ -12,6 +16,7 @@
 #include "base/strings/stringprintf.h"
 #include "base/values.h"
 #include "chrome/browser/chrome_notification_types.h"
+#include "chrome/browser/prefs/scoped_user_pref_update.h"
 #include "chrome/common/pref_names.h"
 #include "components/user_prefs/pref_registry_syncable.h"
 #include "content/public/browser/browser_thread.h"
@@ -39,12 +44,15 @@ const int64 kUpdatePrefsDelayMs = 5000;
 const int kMissingVersion = 0;
 
 // The version number of persisted http_server_properties.
-const int kVersionNumber = 2;
+const int kVersionNumber = 3;
 
 typedef std::vector<std::string> StringVector;
 
 }  // namespace
 
+// static
+const size_t HttpServerPropertiesManager::kMaxServersToPersist = 300;
+
 ////////////////////////////////////////////////////////////////////////////////
 //  HttpServerPropertiesManager
 
@@ -76,6 +84,7 @@ void HttpServerPropertiesManager::InitializeOnIOThread() {
   io_weak_ptr_factory_.reset(
       new base::WeakPtrFactory<HttpServerPropertiesManager>(this));
   http_server_properties_impl_.reset(new net::HttpServerPropertiesImpl());
+  server_prefs_.reset(new ServerPrefCache(kMaxServersToPersist));
 
   io_prefs_update_timer_.reset(
       new base::OneShotTimer<HttpServerPropertiesManager>);
@@ -129,6 +138,7 @@ void HttpServerPropertiesManager::Clear(const base::Closure& completion) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
   http_server_properties_impl_->Clear();
+  server_prefs_->Clear();
   UpdatePrefsFromCacheOnIO(completion);
 }
 
@@ -144,6 +154,7 @@ void HttpServerPropertiesManager::SetSupportsSpdy(
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
   http_server_properties_impl_->SetSupportsSpdy(server, support_spdy);
+  TouchServer(server);
   ScheduleUpdatePrefsOnIO();
 }
 
@@ -167,6 +178,7 @@ void HttpServerPropertiesManager::SetAlternateProtocol(
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   http_server_properties_impl_->SetAlternateProtocol(
       server, alternate_port, alternate_protocol);
+  TouchServer(server);
   ScheduleUpdatePrefsOnIO();
 }
 
@@ -174,6 +186,7 @@ void HttpServerPropertiesManager::SetBrokenAlternateProtocol(
     const net::HostPortPair& server) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   http_server_properties_impl_->SetBrokenAlternateProtocol(server);
+  TouchServer(server);
   ScheduleUpdatePrefsOnIO();
 }
 
@@ -198,8 +211,10 @@ bool HttpServerPropertiesManager::SetSpdySetting(
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   bool persist = http_server_properties_impl_->SetSpdySetting(
       host_port_pair, id, flags, value);
-  if (persist)
+  if (persist) {
+    TouchServer(host_port_pair);
     ScheduleUpdatePrefsOnIO();
+  }
   return persist;
 }
 
@@ -207,12 +222,14 @@ void HttpServerPropertiesManager::ClearSpdySettings(
     const net::HostPortPair& host_port_pair) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   http_server_properties_impl_->ClearSpdySettings(host_port_pair);
+  TouchServer(host_port_pair);
   ScheduleUpdatePrefsOnIO();
 }
 
 void HttpServerPropertiesManager::ClearAllSpdySettings() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   http_server_properties_impl_->ClearAllSpdySettings();
+  InvalidateServerPrefs();
   ScheduleUpdatePrefsOnIO();
 }
 
@@ -234,12 +251,14 @@ void HttpServerPropertiesManager::SetPipelineCapability(
     net::HttpPipelinedHostCapability capability) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   http_server_properties_impl_->SetPipelineCapability(origin, capability);
+  TouchServer(origin);
   ScheduleUpdatePrefsOnIO();
 }
 
 void HttpServerPropertiesManager::ClearPipelineCapabilities() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   http_server_properties_impl_->ClearPipelineCapabilities();
+  InvalidateServerPrefs();
   ScheduleUpdatePrefsOnIO();
 }
 
@@ -275,188 +294,149 @@ void HttpServerPropertiesManager::UpdateCacheFromPrefsOnUI() {
   if (!pref_service_->HasPrefPath(prefs::kHttpServerProperties))
     return;
 
-  bool detected_corrupted_prefs = false;
-  const base::DictionaryValue& http_server_properties_dict =
-      *pref_service_->GetDictionary(prefs::kHttpServerProperties);
+  // The properties are parsed on the IO thread, so that the UI thread only
+  // copies the preference.
+  base::DictionaryValue* http_server_properties_dict =
+      pref_service_->GetDictionary(prefs::kHttpServerProperties)->DeepCopy();
+
+  BrowserThread::PostTask(
+      BrowserThread::IO,
+      FROM_HERE,
+      base::Bind(&HttpServerPropertiesManager::
+                 UpdateCacheFromPrefsOnIO,
+                 base::Unretained(this),
+                 base::Owned(http_server_properties_dict)));
+}
+
+void HttpServerPropertiesManager::UpdateCacheFromPrefsOnIO(
+    base::DictionaryValue* http_server_properties_dict) {
+  // Preferences have the master data because admins might have pushed new
+  // preferences. Update the cached data with new data from preferences.
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
   int version = kMissingVersion;
-  if (!http_server_properties_dict.GetIntegerWithoutPathExpansion(
+  if (!http_server_properties_dict->GetIntegerWithoutPathExpansion(
       "version", &version)) {
     DVLOG(1) << "Missing version. Clearing all properties.";
     return;
   }
 
-  // The properties for a given server is in
-  // http_server_properties_dict["servers"][server].
+  // The properties for a given server are in a list of single entry
+  // dictionaries, http_server_properties_dict["servers"][i][server], from the
+  // most recently used server to the least. Before version 3, they were in a
+  // dictionary, http_server_properties_dict["servers"][server].
+  const base::ListValue* servers_list = NULL;
   const base::DictionaryValue* servers_dict = NULL;
-  if (!http_server_properties_dict.GetDictionaryWithoutPathExpansion(
+  size_t num_servers = 0;
+  if (http_server_properties_dict->GetListWithoutPathExpansion(
+      "servers", &servers_list)) {
+    num_servers = servers_list->GetSize();
+  } else if (http_server_properties_dict->GetDictionaryWithoutPathExpansion(
       "servers", &servers_dict)) {
+    num_servers = servers_dict->size();
+  } else {
     DVLOG(1) << "Malformed http_server_properties for servers.";
     return;
   }
 
-  // TODO(rtenneti): Mark entries with an LRU sequence number (date of access?),
-  // and then truncate down deleting old stuff.
-  if (version != kVersionNumber && servers_dict->size() > 300) {
+  // Version 1 wrote every server it knew of, so an oversized dictionary from
+  // it is dropped rather than trimmed.
+  if (version < 2 && num_servers > kMaxServersToPersist) {
     DVLOG(1) << "Size is too large. Clearing all properties.";
     return;
   }
 
+  // Only kMaxServersToPersist servers are read: the most recently used ones
+  // from a list, and the first ones from a dictionary, which has no order of
+  // use. The preferences are then rewritten without the others.
+  const size_t num_servers_to_read = std::min(num_servers,
+                                              kMaxServersToPersist);
+
+  // The servers and their properties, from the least recently used server to
+  // the most.
+  typedef std::vector<std::pair<std::string, const base::Value*> >
+      ServerPrefVector;
+  ServerPrefVector server_prefs;
+  if (servers_list) {
+    for (size_t i = num_servers_to_read; i > 0; --i) {
+      const base::DictionaryValue* entry_dict = NULL;
+      if (!servers_list->GetDictionary(i - 1, &entry_dict) ||
+          entry_dict->size() != 1) {
+        DVLOG(1) << "Malformed http_server_properties server list entry.";
+        continue;
+      }
+      base::DictionaryValue::Iterator it(*entry_dict);
+      server_prefs.push_back(std::make_pair(it.key(), &it.value()));
+    }
+  } else {
+    for (base::DictionaryValue::Iterator it(*servers_dict);
+         !it.IsAtEnd() && server_prefs.size() < num_servers_to_read;
+         it.Advance()) {
+      server_prefs.push_back(std::make_pair(it.key(), &it.value()));
+    }
+  }
+  bool detected_corrupted_prefs = server_prefs.size() != num_servers_to_read;
+
   // String is host/port pair of spdy server.
-  scoped_ptr<StringVector> spdy_servers(new StringVector);
-  scoped_ptr<net::SpdySettingsMap> spdy_settings_map(new net::SpdySettingsMap);
-  scoped_ptr<net::PipelineCapabilityMap> pipeline_capability_map(
-      new net::PipelineCapabilityMap);
-  scoped_ptr<net::AlternateProtocolMap> alternate_protocol_map(
-      new net::AlternateProtocolMap);
-
-  for (base::DictionaryValue::Iterator it(*servers_dict); !it.IsAtEnd();
-       it.Advance()) {
+  StringVector spdy_servers;
+  net::SpdySettingsMap spdy_settings_map;
+  net::PipelineCapabilityMap pipeline_capability_map;
+  net::AlternateProtocolMap alternate_protocol_map;
+
+  // The properties of every server are rebuilt on the next update, as the
+  // cache is about to be replaced. The servers read from the preferences keep
+  // their order, and are more recent than those only known to the cache.
+  InvalidateServerPrefs();
+  std::set<net::HostPortPair> servers_read;
+  for (ServerPrefVector::const_iterator it = server_prefs.begin();
+       it != server_prefs.end(); ++it) {
     // Get server's host/pair.
-    const std::string& server_str = it.key();
+    const std::string& server_str = it->first;
     net::HostPortPair server = net::HostPortPair::FromString(server_str);
-    if (server.host().empty()) {
+    if (server.host().empty() || !servers_read.insert(server).second) {
       DVLOG(1) << "Malformed http_server_properties for server: " << server_str;
       detected_corrupted_prefs = true;
       continue;
     }
 
     const base::DictionaryValue* server_pref_dict = NULL;
-    if (!it.value().GetAsDictionary(&server_pref_dict)) {
+    if (!it->second->GetAsDictionary(&server_pref_dict)) {
       DVLOG(1) << "Malformed http_server_properties server: " << server_str;
       detected_corrupted_prefs = true;
       continue;
     }
 
-    // Get if server supports Spdy.
-    bool supports_spdy = false;
-    if ((server_pref_dict->GetBoolean(
-         "supports_spdy", &supports_spdy)) && supports_spdy) {
-      spdy_servers->push_back(server_str);
-    }
-
-    // Get SpdySettings.
-    DCHECK(!ContainsKey(*spdy_settings_map, server));
-    const base::DictionaryValue* spdy_settings_dict = NULL;
-    if (server_pref_dict->GetDictionaryWithoutPathExpansion(
-        "settings", &spdy_settings_dict)) {
-      net::SettingsMap settings_map;
-      for (base::DictionaryValue::Iterator dict_it(*spdy_settings_dict);
-           !dict_it.IsAtEnd(); dict_it.Advance()) {
-        const std::string& id_str = dict_it.key();
-        int id = 0;
-        if (!base::StringToInt(id_str, &id)) {
-          DVLOG(1) << "Malformed id in SpdySettings for server: " <<
-              server_str;
-          NOTREACHED();
-          continue;
-        }
-        int value = 0;
-        if (!dict_it.value().GetAsInteger(&value)) {
-          DVLOG(1) << "Malformed value in SpdySettings for server: " <<
-              server_str;
-          NOTREACHED();
-          continue;
-        }
-        net::SettingsFlagsAndValue flags_and_value(
-            net::SETTINGS_FLAG_PERSISTED, value);
-        settings_map[static_cast<net::SpdySettingsIds>(id)] = flags_and_value;
-      }
-      (*spdy_settings_map)[server] = settings_map;
-    }
-
-    int pipeline_capability = net::PIPELINE_UNKNOWN;
-    if ((server_pref_dict->GetInteger(
-         "pipeline_capability", &pipeline_capability)) &&
-        pipeline_capability != net::PIPELINE_UNKNOWN) {
-      (*pipeline_capability_map)[server] =
-          static_cast<net::HttpPipelinedHostCapability>(pipeline_capability);
-    }
-
-    // Get alternate_protocol server.
-    DCHECK(!ContainsKey(*alternate_protocol_map, server));
-    const base::DictionaryValue* port_alternate_protocol_dict = NULL;
-    if (!server_pref_dict->GetDictionaryWithoutPathExpansion(
-        "alternate_protocol", &port_alternate_protocol_dict)) {
-      continue;
+    TouchServer(server);
+    if (!AddServerPref(server_str, server, *server_pref_dict, &spdy_servers,
+                       &spdy_settings_map, &alternate_protocol_map,
+                       &pipeline_capability_map)) {
+      detected_corrupted_prefs = true;
     }
-
-    do {
-      int port = 0;
-      if (!port_alternate_protocol_dict->GetIntegerWithoutPathExpansion(
-          "port", &port) || (port > (1 << 16))) {
-        DVLOG(1) << "Malformed Alternate-Protocol server: " << server_str;
-        detected_corrupted_prefs = true;
-        continue;
-      }
-      std::string protocol_str;
-      if (!port_alternate_protocol_dict->GetStringWithoutPathExpansion(
-              "protocol_str", &protocol_str)) {
-        DVLOG(1) << "Malformed Alternate-Protocol server: " << server_str;
-        detected_corrupted_prefs = true;
-        continue;
-      }
-      net::AlternateProtocol protocol =
-          net::AlternateProtocolFromString(protocol_str);
-      if (protocol > net::NUM_ALTERNATE_PROTOCOLS) {
-        DVLOG(1) << "Malformed Alternate-Protocol server: " << server_str;
-        detected_corrupted_prefs = true;
-        continue;
-      }
-
-      net::PortAlternateProtocolPair port_alternate_protocol;
-      port_alternate_protocol.port = port;
-      port_alternate_protocol.protocol = protocol;
-
-      (*alternate_protocol_map)[server] = port_alternate_protocol;
-    } while (false);
   }
 
-  BrowserThread::PostTask(
-      BrowserThread::IO,
-      FROM_HERE,
-      base::Bind(&HttpServerPropertiesManager::
-                 UpdateCacheFromPrefsOnIO,
-                 base::Unretained(this),
-                 base::Owned(spdy_servers.release()),
-                 base::Owned(spdy_settings_map.release()),
-                 base::Owned(alternate_protocol_map.release()),
-                 base::Owned(pipeline_capability_map.release()),
-                 detected_corrupted_prefs));
-}
-
-void HttpServerPropertiesManager::UpdateCacheFromPrefsOnIO(
-    StringVector* spdy_servers,
-    net::SpdySettingsMap* spdy_settings_map,
-    net::AlternateProtocolMap* alternate_protocol_map,
-    net::PipelineCapabilityMap* pipeline_capability_map,
-    bool detected_corrupted_prefs) {
-  // Preferences have the master data because admins might have pushed new
-  // preferences. Update the cached data with new data from preferences.
-  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
-
-  UMA_HISTOGRAM_COUNTS("Net.CountOfSpdyServers", spdy_servers->size());
-  http_server_properties_impl_->InitializeSpdyServers(spdy_servers, true);
+  UMA_HISTOGRAM_COUNTS("Net.CountOfSpdyServers", spdy_servers.size());
+  http_server_properties_impl_->InitializeSpdyServers(&spdy_servers, true);
 
   // Clear the cached data and use the new spdy_settings from preferences.
-  UMA_HISTOGRAM_COUNTS("Net.CountOfSpdySettings", spdy_settings_map->size());
+  UMA_HISTOGRAM_COUNTS("Net.CountOfSpdySettings", spdy_settings_map.size());
   http_server_properties_impl_->InitializeSpdySettingsServers(
-      spdy_settings_map);
+      &spdy_settings_map);
 
   // Clear the cached data and use the new Alternate-Protocol server list from
   // preferences.
   UMA_HISTOGRAM_COUNTS("Net.CountOfAlternateProtocolServers",
-                       alternate_protocol_map->size());
+                       alternate_protocol_map.size());
   http_server_properties_impl_->InitializeAlternateProtocolServers(
-      alternate_protocol_map);
+      &alternate_protocol_map);
 
   UMA_HISTOGRAM_COUNTS("Net.CountOfPipelineCapableServers",
-                       pipeline_capability_map->size());
+                       pipeline_capability_map.size());
   http_server_properties_impl_->InitializePipelineCapabilities(
-      pipeline_capability_map);
+      &pipeline_capability_map);
 
-  // Update the prefs with what we have read (delete all corrupted prefs).
-  if (detected_corrupted_prefs)
+  // Update the prefs with what we have read (delete all corrupted prefs and
+  // the servers which were not read).
+  if (detected_corrupted_prefs || num_servers_to_read < num_servers)
     ScheduleUpdatePrefsOnIO();
 }
 
@@ -490,21 +470,32 @@ void HttpServerPropertiesManager::UpdatePrefsFromCacheOnIO(
     const base::Closure& completion) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
-  base::ListValue* spdy_server_list = new base::ListValue;
-  http_server_properties_impl_->GetSpdyServerList(spdy_server_list);
-
-  net::SpdySettingsMap* spdy_settings_map = new net::SpdySettingsMap;
-  *spdy_settings_map = http_server_properties_impl_->spdy_settings_map();
+  net::PipelineCapabilityMap pipeline_capability_map =
+      http_server_properties_impl_->GetPipelineCapabilityMap();
 
-  net::AlternateProtocolMap* alternate_protocol_map =
-      new net::AlternateProtocolMap;
-  *alternate_protocol_map =
-      http_server_properties_impl_->alternate_protocol_map();
+  // Only the properties of servers that changed since the last update are
+  // rebuilt. Servers without properties are dropped.
+  base::ListValue* servers_list = new base::ListValue;
+  ServerPrefCache::iterator it = server_prefs_->begin();
+  while (it != server_prefs_->end()) {
+    if (!it->second)
+      it->second = CreateServerPref(it->first, pipeline_capability_map);
+    if (!it->second) {
+      it = server_prefs_->Erase(it);
+      continue;
+    }
+    base::DictionaryValue* entry_dict = new base::DictionaryValue;
+    entry_dict->SetWithoutPathExpansion(it->first.ToString(),
+                                        it->second->DeepCopy());
+    servers_list->Append(entry_dict);
+    ++it;
+  }
 
-  net::PipelineCapabilityMap* pipeline_capability_map =
-      new net::PipelineCapabilityMap;
-  *pipeline_capability_map =
-      http_server_properties_impl_->GetPipelineCapabilityMap();
+  base::DictionaryValue* http_server_properties_dict =
+      new base::DictionaryValue;
+  http_server_properties_dict->SetWithoutPathExpansion("servers",
+                                                       servers_list);
+  SetVersion(http_server_properties_dict, kVersionNumber);
 
   // Update the preferences on the UI thread.
   BrowserThread::PostTask(
@@ -512,183 +503,208 @@ void HttpServerPropertiesManager::UpdatePrefsFromCacheOnIO(
       FROM_HERE,
       base::Bind(&HttpServerPropertiesManager::UpdatePrefsOnUI,
                  ui_weak_ptr_,
-                 base::Owned(spdy_server_list),
-                 base::Owned(spdy_settings_map),
-                 base::Owned(alternate_protocol_map),
-                 base::Owned(pipeline_capability_map),
+                 base::Owned(http_server_properties_dict),
                  completion));
 }
 
-// A local or temporary data structure to hold |supports_spdy|, SpdySettings,
-// PortAlternateProtocolPair, and |pipeline_capability| preferences for a
-// server. This is used only in UpdatePrefsOnUI.
-struct ServerPref {
-  ServerPref()
-      : supports_spdy(false),
-        settings_map(NULL),
-        alternate_protocol(NULL),
-        pipeline_capability(net::PIPELINE_UNKNOWN) {
+void HttpServerPropertiesManager::UpdatePrefsOnUI(
+    base::DictionaryValue* http_server_properties_dict,
+    const base::Closure& completion) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+
+  // Persist the prefs::kHttpServerProperties. The dictionary was built on the
+  // IO thread, so it is swapped in rather than copied.
+  setting_prefs_ = true;
+  {
+    DictionaryPrefUpdate update(pref_service_, prefs::kHttpServerProperties);
+    update->Swap(http_server_properties_dict);
   }
-  ServerPref(bool supports_spdy,
-             const net::SettingsMap* settings_map,
-             const net::PortAlternateProtocolPair* alternate_protocol)
-      : supports_spdy(supports_spdy),
-        settings_map(settings_map),
-        alternate_protocol(alternate_protocol),
-        pipeline_capability(net::PIPELINE_UNKNOWN) {
+  setting_prefs_ = false;
+
+  // Note that |completion| will be fired after we have written everything to
+  // the Preferences, but likely before these changes are serialized to disk.
+  // This is not a problem though, as JSONPrefStore guarantees that this will
+  // happen, pretty soon, and even in the case we shut down immediately.
+  if (!completion.is_null())
+    completion.Run();
+}
+
+void HttpServerPropertiesManager::TouchServer(
+    const net::HostPortPair& server) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  // Moves |server| to the front, and drops its persisted properties.
+  server_prefs_->Put(server, NULL);
+}
+
+void HttpServerPropertiesManager::InvalidateServerPrefs() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  for (ServerPrefCache::iterator it = server_prefs_->begin();
+       it != server_prefs_->end(); ++it) {
+    delete it->second;
+    it->second = NULL;
   }
-  bool supports_spdy;
-  const net::SettingsMap* settings_map;
-  const net::PortAlternateProtocolPair* alternate_protocol;
-  net::HttpPipelinedHostCapability pipeline_capability;
-};
+}
 
-void HttpServerPropertiesManager::UpdatePrefsOnUI(
-    base::ListValue* spdy_server_list,
+// static
+bool HttpServerPropertiesManager::AddServerPref(
+    const std::string& server_str,
+    const net::HostPortPair& server,
+    const base::DictionaryValue& server_pref_dict,
+    StringVector* spdy_servers,
     net::SpdySettingsMap* spdy_settings_map,
     net::AlternateProtocolMap* alternate_protocol_map,
-    net::PipelineCapabilityMap* pipeline_capability_map,
-    const base::Closure& completion) {
-
-  typedef std::map<net::HostPortPair, ServerPref> ServerPrefMap;
-  ServerPrefMap server_pref_map;
-
-  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+    net::PipelineCapabilityMap* pipeline_capability_map) {
+  // Get if server supports Spdy.
+  bool supports_spdy = false;
+  if ((server_pref_dict.GetBoolean(
+       "supports_spdy", &supports_spdy)) && supports_spdy) {
+    spdy_servers->push_back(server_str);
+  }
 
-  // Add servers that support spdy to server_pref_map.
-  std::string s;
-  for (base::ListValue::const_iterator list_it = spdy_server_list->begin();
-       list_it != spdy_server_list->end(); ++list_it) {
-    if ((*list_it)->GetAsString(&s)) {
-      net::HostPortPair server = net::HostPortPair::FromString(s);
-
-      ServerPrefMap::iterator it = server_pref_map.find(server);
-      if (it == server_pref_map.end()) {
-        ServerPref server_pref(true, NULL, NULL);
-        server_pref_map[server] = server_pref;
-      } else {
-        it->second.supports_spdy = true;
+  // Get SpdySettings.
+  DCHECK(!ContainsKey(*spdy_settings_map, server));
+  const base::DictionaryValue* spdy_settings_dict = NULL;
+  if (server_pref_dict.GetDictionaryWithoutPathExpansion(
+      "settings", &spdy_settings_dict)) {
+    net::SettingsMap settings_map;
+    for (base::DictionaryValue::Iterator dict_it(*spdy_settings_dict);
+         !dict_it.IsAtEnd(); dict_it.Advance()) {
+      const std::string& id_str = dict_it.key();
+      int id = 0;
+      if (!base::StringToInt(id_str, &id)) {
+        DVLOG(1) << "Malformed id in SpdySettings for server: " <<
+            server_str;
+        NOTREACHED();
+        continue;
+      }
+      int value = 0;
+      if (!dict_it.value().GetAsInteger(&value)) {
+        DVLOG(1) << "Malformed value in SpdySettings for server: " <<
+            server_str;
+        NOTREACHED();
+        continue;
       }
+      net::SettingsFlagsAndValue flags_and_value(
+          net::SETTINGS_FLAG_PERSISTED, value);
+      settings_map[static_cast<net::SpdySettingsIds>(id)] = flags_and_value;
     }
+    (*spdy_settings_map)[server] = settings_map;
   }
 
-  // Add servers that have SpdySettings to server_pref_map.
-  for (net::SpdySettingsMap::iterator map_it =
-       spdy_settings_map->begin();
-       map_it != spdy_settings_map->end(); ++map_it) {
-    const net::HostPortPair& server = map_it->first;
-
-    ServerPrefMap::iterator it = server_pref_map.find(server);
-    if (it == server_pref_map.end()) {
-      ServerPref server_pref(false, &map_it->second, NULL);
-      server_pref_map[server] = server_pref;
-    } else {
-      it->second.settings_map = &map_it->second;
-    }
+  int pipeline_capability = net::PIPELINE_UNKNOWN;
+  if ((server_pref_dict.GetInteger(
+       "pipeline_capability", &pipeline_capability)) &&
+      pipeline_capability != net::PIPELINE_UNKNOWN) {
+    (*pipeline_capability_map)[server] =
+        static_cast<net::HttpPipelinedHostCapability>(pipeline_capability);
   }
 
-  // Add AlternateProtocol servers to server_pref_map.
-  for (net::AlternateProtocolMap::const_iterator map_it =
-       alternate_protocol_map->begin();
-       map_it != alternate_protocol_map->end(); ++map_it) {
-    const net::HostPortPair& server = map_it->first;
-    const net::PortAlternateProtocolPair& port_alternate_protocol =
-        map_it->second;
-    if (port_alternate_protocol.protocol < 0 ||
-        port_alternate_protocol.protocol >= net::NUM_ALTERNATE_PROTOCOLS) {
-      continue;
-    }
+  // Get alternate_protocol server.
+  DCHECK(!ContainsKey(*alternate_protocol_map, server));
+  const base::DictionaryValue* port_alternate_protocol_dict = NULL;
+  if (!server_pref_dict.GetDictionaryWithoutPathExpansion(
+      "alternate_protocol", &port_alternate_protocol_dict)) {
+    return true;
+  }
 
-    ServerPrefMap::iterator it = server_pref_map.find(server);
-    if (it == server_pref_map.end()) {
-      ServerPref server_pref(false, NULL, &map_it->second);
-      server_pref_map[server] = server_pref;
-    } else {
-      it->second.alternate_protocol = &map_it->second;
-    }
+  int port = 0;
+  if (!port_alternate_protocol_dict->GetIntegerWithoutPathExpansion(
+      "port", &port) || (port > (1 << 16))) {
+    DVLOG(1) << "Malformed Alternate-Protocol server: " << server_str;
+    return false;
+  }
+  std::string protocol_str;
+  if (!port_alternate_protocol_dict->GetStringWithoutPathExpansion(
+          "protocol_str", &protocol_str)) {
+    DVLOG(1) << "Malformed Alternate-Protocol server: " << server_str;
+    return false;
+  }
+  net::AlternateProtocol protocol =
+      net::AlternateProtocolFromString(protocol_str);
+  if (protocol > net::NUM_ALTERNATE_PROTOCOLS) {
+    DVLOG(1) << "Malformed Alternate-Protocol server: " << server_str;
+    return false;
   }
 
-  for (net::PipelineCapabilityMap::const_iterator map_it =
-           pipeline_capability_map->begin();
-       map_it != pipeline_capability_map->end(); ++map_it) {
-    const net::HostPortPair& server = map_it->first;
-    const net::HttpPipelinedHostCapability& pipeline_capability =
-        map_it->second;
-
-    ServerPrefMap::iterator it = server_pref_map.find(server);
-    if (it == server_pref_map.end()) {
-      ServerPref server_pref;
-      server_pref.pipeline_capability = pipeline_capability;
-      server_pref_map[server] = server_pref;
-    } else {
-      it->second.pipeline_capability = pipeline_capability;
-    }
+  net::PortAlternateProtocolPair port_alternate_protocol;
+  port_alternate_protocol.port = port;
+  port_alternate_protocol.protocol = protocol;
+
+  (*alternate_protocol_map)[server] = port_alternate_protocol;
+  return true;
+}
+
+base::DictionaryValue* HttpServerPropertiesManager::CreateServerPref(
+    const net::HostPortPair& server,
+    const net::PipelineCapabilityMap& pipeline_capability_map) const {
+  bool supports_spdy = http_server_properties_impl_->SupportsSpdy(server);
+
+  const net::SpdySettingsMap& spdy_settings_map =
+      http_server_properties_impl_->spdy_settings_map();
+  net::SpdySettingsMap::const_iterator settings_it =
+      spdy_settings_map.find(server);
+  const net::SettingsMap* settings_map =
+      settings_it != spdy_settings_map.end() ? &settings_it->second : NULL;
+
+  const net::AlternateProtocolMap& alternate_protocol_map =
+      http_server_properties_impl_->alternate_protocol_map();
+  net::AlternateProtocolMap::const_iterator alternate_it =
+      alternate_protocol_map.find(server);
+  const net::PortAlternateProtocolPair* port_alternate_protocol = NULL;
+  if (alternate_it != alternate_protocol_map.end() &&
+      alternate_it->second.protocol >= 0 &&
+      alternate_it->second.protocol < net::NUM_ALTERNATE_PROTOCOLS) {
+    port_alternate_protocol = &alternate_it->second;
   }
 
-  // Persist the prefs::kHttpServerProperties.
-  base::DictionaryValue http_server_properties_dict;
-  base::DictionaryValue* servers_dict = new base::DictionaryValue;
-  for (ServerPrefMap::const_iterator map_it =
-       server_pref_map.begin();
-       map_it != server_pref_map.end(); ++map_it) {
-    const net::HostPortPair& server = map_it->first;
-    const ServerPref& server_pref = map_it->second;
-
-    base::DictionaryValue* server_pref_dict = new base::DictionaryValue;
-
-    // Save supports_spdy.
-    server_pref_dict->SetBoolean("supports_spdy", server_pref.supports_spdy);
-
-    // Save SPDY settings.
-    if (server_pref.settings_map) {
-      base::DictionaryValue* spdy_settings_dict = new base::DictionaryValue;
-      for (net::SettingsMap::const_iterator it =
-           server_pref.settings_map->begin();
-           it != server_pref.settings_map->end(); ++it) {
-        net::SpdySettingsIds id = it->first;
-        uint32 value = it->second.second;
-        std::string key = base::StringPrintf("%u", id);
-        spdy_settings_dict->SetInteger(key, value);
-      }
-      server_pref_dict->SetWithoutPathExpansion("settings", spdy_settings_dict);
-    }
+  net::HttpPipelinedHostCapability pipeline_capability =
+      net::PIPELINE_UNKNOWN;
+  net::PipelineCapabilityMap::const_iterator pipeline_it =
+      pipeline_capability_map.find(server);
+  if (pipeline_it != pipeline_capability_map.end())
+    pipeline_capability = pipeline_it->second;
 
-    // Save alternate_protocol.
-    if (server_pref.alternate_protocol) {
-      base::DictionaryValue* port_alternate_protocol_dict =
-          new base::DictionaryValue;
-      const net::PortAlternateProtocolPair* port_alternate_protocol =
-          server_pref.alternate_protocol;
-      port_alternate_protocol_dict->SetInteger(
-          "port", port_alternate_protocol->port);
-      const char* protocol_str =
-          net::AlternateProtocolToString(port_alternate_protocol->protocol);
-      port_alternate_protocol_dict->SetString("protocol_str", protocol_str);
-      server_pref_dict->SetWithoutPathExpansion(
-          "alternate_protocol", port_alternate_protocol_dict);
-    }
+  if (!supports_spdy && !settings_map && !port_alternate_protocol &&
+      pipeline_capability == net::PIPELINE_UNKNOWN) {
+    return NULL;
+  }
 
-    if (server_pref.pipeline_capability != net::PIPELINE_UNKNOWN) {
-      server_pref_dict->SetInteger("pipeline_capability",
-                                   server_pref.pipeline_capability);
+  base::DictionaryValue* server_pref_dict = new base::DictionaryValue;
+
+  // Save supports_spdy.
+  server_pref_dict->SetBoolean("supports_spdy", supports_spdy);
+
+  // Save SPDY settings.
+  if (settings_map) {
+    base::DictionaryValue* spdy_settings_dict = new base::DictionaryValue;
+    for (net::SettingsMap::const_iterator it = settings_map->begin();
+         it != settings_map->end(); ++it) {
+      net::SpdySettingsIds id = it->first;
+      uint32 value = it->second.second;
+      std::string key = base::StringPrintf("%u", id);
+      spdy_settings_dict->SetInteger(key, value);
     }
+    server_pref_dict->SetWithoutPathExpansion("settings", spdy_settings_dict);
+  }
 
-    servers_dict->SetWithoutPathExpansion(server.ToString(), server_pref_dict);
+  // Save alternate_protocol.
+  if (port_alternate_protocol) {
+    base::DictionaryValue* port_alternate_protocol_dict =
+        new base::DictionaryValue;
+    port_alternate_protocol_dict->SetInteger(
+        "port", port_alternate_protocol->port);
+    const char* protocol_str =
+        net::AlternateProtocolToString(port_alternate_protocol->protocol);
+    port_alternate_protocol_dict->SetString("protocol_str", protocol_str);
+    server_pref_dict->SetWithoutPathExpansion(
+        "alternate_protocol", port_alternate_protocol_dict);
   }
 
-  http_server_properties_dict.SetWithoutPathExpansion("servers", servers_dict);
-  SetVersion(&http_server_properties_dict, kVersionNumber);
-  setting_prefs_ = true;
-  pref_service_->Set(prefs::kHttpServerProperties,
-                     http_server_properties_dict);
-  setting_prefs_ = false;
+  if (pipeline_capability != net::PIPELINE_UNKNOWN) {
+    server_pref_dict->SetInteger("pipeline_capability", pipeline_capability);
+  }
 
-  // Note that |completion| will be fired after we have written everything to
-  // the Preferences, but likely before these changes are serialized to disk.
-  // This is not a problem though, as JSONPrefStore guarantees that this will
-  // happen, pretty soon, and even in the case we shut down immediately.
-  if (!completion.is_null())
-    completion.Run();
+  return server_pref_dict;
 }
 
 void HttpServerPropertiesManager::OnHttpServerPropertiesChanged() {
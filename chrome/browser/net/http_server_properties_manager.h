@@ -9,6 +9,7 @@
 #include <vector>
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/containers/mru_cache.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
 #include "base/prefs/pref_change_registrar.h"
@@ -58,6 +59,10 @@ class HttpServerPropertiesManager
   explicit HttpServerPropertiesManager(PrefService* pref_service);
   virtual ~HttpServerPropertiesManager();
 
+  // The maximum number of servers whose properties are persisted. The most
+  // recently used servers are kept.
+  static const size_t kMaxServersToPersist;
+
   // Initialize |http_server_properties_impl_| and |io_method_factory_| on IO
   // thread. It also posts a task to UI thread to get SPDY Server preferences
   // from |pref_service_|.
@@ -166,18 +171,14 @@ class HttpServerPropertiesManager
   virtual void StartCacheUpdateTimerOnUI(base::TimeDelta delay);
 
   // Update cached prefs in |http_server_properties_impl_| with data from
-  // preferences. It gets the data on UI thread and calls
-  // UpdateSpdyServersFromPrefsOnIO() to perform the update on IO thread.
+  // preferences. It copies the data on UI thread and calls
+  // UpdateCacheFromPrefsOnIO() to parse it and perform the update on IO thread.
   virtual void UpdateCacheFromPrefsOnUI();
 
-  // Starts the update of cached prefs in |http_server_properties_impl_| on the
-  // IO thread. Protected for testing.
+  // Parses |http_server_properties_dict| and updates the cached prefs in
+  // |http_server_properties_impl_| on the IO thread. Protected for testing.
   void UpdateCacheFromPrefsOnIO(
-      std::vector<std::string>* spdy_servers,
-      net::SpdySettingsMap* spdy_settings_map,
-      net::AlternateProtocolMap* alternate_protocol_map,
-      net::PipelineCapabilityMap* pipeline_capability_map,
-      bool detected_corrupted_prefs);
+      base::DictionaryValue* http_server_properties_dict);
 
   // These are used to delay updating the preferences when cached data in
   // |http_server_properties_impl_| is changing, and execute only one update per
@@ -189,8 +190,9 @@ class HttpServerPropertiesManager
   virtual void StartPrefsUpdateTimerOnIO(base::TimeDelta delay);
 
   // Update prefs::kHttpServerProperties in preferences with the cached data
-  // from |http_server_properties_impl_|. This gets the data on IO thread and
-  // posts a task (UpdatePrefsOnUI) to update the preferences UI thread.
+  // from |http_server_properties_impl_|. This builds the preferences on IO
+  // thread, rebuilding only the servers that changed since the last update,
+  // and posts a task (UpdatePrefsOnUI) to update the preferences UI thread.
   void UpdatePrefsFromCacheOnIO();
 
   // Same as above, but fires an optional |completion| callback on the UI thread
@@ -200,15 +202,41 @@ class HttpServerPropertiesManager
   // Update prefs::kHttpServerProperties preferences on UI thread. Executes an
   // optional |completion| callback when finished. Protected for testing.
   void UpdatePrefsOnUI(
-      base::ListValue* spdy_server_list,
-      net::SpdySettingsMap* spdy_settings_map,
-      net::AlternateProtocolMap* alternate_protocol_map,
-      net::PipelineCapabilityMap* pipeline_capability_map,
+      base::DictionaryValue* http_server_properties_dict,
       const base::Closure& completion);
 
  private:
+  // The persisted properties of each server, from the most recently used
+  // server to the least. A NULL value means the properties of the server
+  // changed, and are rebuilt on the next update of the preferences.
+  typedef base::OwningMRUCache<net::HostPortPair, base::DictionaryValue*>
+      ServerPrefCache;
+
   void OnHttpServerPropertiesChanged();
 
+  // Marks |server| as the most recently used server, and its properties as
+  // changed.
+  void TouchServer(const net::HostPortPair& server);
+
+  // Marks the properties of all the servers as changed.
+  void InvalidateServerPrefs();
+
+  // Adds the properties of |server| in |server_pref_dict| to the maps. Returns
+  // false if they are malformed.
+  static bool AddServerPref(
+      const std::string& server_str,
+      const net::HostPortPair& server,
+      const base::DictionaryValue& server_pref_dict,
+      std::vector<std::string>* spdy_servers,
+      net::SpdySettingsMap* spdy_settings_map,
+      net::AlternateProtocolMap* alternate_protocol_map,
+      net::PipelineCapabilityMap* pipeline_capability_map);
+
+  // Returns the persisted properties of |server|, or NULL if it has none.
+  base::DictionaryValue* CreateServerPref(
+      const net::HostPortPair& server,
+      const net::PipelineCapabilityMap& pipeline_capability_map) const;
+
   // ---------
   // UI thread
   // ---------
@@ -242,6 +270,8 @@ class HttpServerPropertiesManager
 
   scoped_ptr<net::HttpServerPropertiesImpl> http_server_properties_impl_;
 
+  scoped_ptr<ServerPrefCache> server_prefs_;
+
   DISALLOW_COPY_AND_ASSIGN(HttpServerPropertiesManager);
 };
 
@@ -8,6 +8,7 @@
 #include "base/message_loop/message_loop.h"
 #include "base/prefs/pref_registry_simple.h"
 #include "base/prefs/testing_pref_service.h"
+#include "base/strings/stringprintf.h"
 #include "base/values.h"
 #include "chrome/common/pref_names.h"
 #include "content/public/test/test_browser_thread.h"
@@ -61,17 +62,10 @@ class TestingHttpServerPropertiesManager : public HttpServerPropertiesManager {
 
   MOCK_METHOD0(UpdateCacheFromPrefsOnUI, void());
   MOCK_METHOD1(UpdatePrefsFromCacheOnIO, void(const base::Closure&));
-  MOCK_METHOD5(UpdateCacheFromPrefsOnIO,
-               void(std::vector<std::string>* spdy_servers,
-                    net::SpdySettingsMap* spdy_settings_map,
-                    net::AlternateProtocolMap* alternate_protocol_map,
-                    net::PipelineCapabilityMap* pipeline_capability_map,
-                    bool detected_corrupted_prefs));
-  MOCK_METHOD4(UpdatePrefsOnUI,
-               void(base::ListValue* spdy_server_list,
-                    net::SpdySettingsMap* spdy_settings_map,
-                    net::AlternateProtocolMap* alternate_protocol_map,
-                    net::PipelineCapabilityMap* pipeline_capability_map));
+  MOCK_METHOD1(UpdateCacheFromPrefsOnIO,
+               void(base::DictionaryValue* http_server_properties_dict));
+  MOCK_METHOD1(UpdatePrefsOnUI,
+               void(base::DictionaryValue* http_server_properties_dict));
 
  private:
   DISALLOW_COPY_AND_ASSIGN(TestingHttpServerPropertiesManager);
@@ -461,6 +455,148 @@ TEST_F(HttpServerPropertiesManagerTest, Clear) {
   Mock::VerifyAndClearExpectations(http_server_props_manager_.get());
 }
 
+TEST_F(HttpServerPropertiesManagerTest, PersistMostRecentServers) {
+  ExpectPrefsUpdate();
+
+  // Add one more server than are persisted. The first one is the least
+  // recently used.
+  const size_t kNumServers =
+      HttpServerPropertiesManager::kMaxServersToPersist + 1;
+  for (size_t i = 0; i < kNumServers; ++i) {
+    http_server_props_manager_->SetSupportsSpdy(
+        net::HostPortPair(base::StringPrintf("www%d.example.com",
+                                             static_cast<int>(i)), 443),
+        true);
+  }
+
+  // Run the task.
+  loop_.RunUntilIdle();
+  Mock::VerifyAndClearExpectations(http_server_props_manager_.get());
+
+  const base::DictionaryValue* http_server_properties_dict =
+      pref_service_.GetDictionary(prefs::kHttpServerProperties);
+  const base::ListValue* servers_list = NULL;
+  ASSERT_TRUE(http_server_properties_dict->GetListWithoutPathExpansion(
+      "servers", &servers_list));
+  ASSERT_EQ(HttpServerPropertiesManager::kMaxServersToPersist,
+            servers_list->GetSize());
+
+  // The most recently used server comes first.
+  const base::DictionaryValue* server_dict = NULL;
+  ASSERT_TRUE(servers_list->GetDictionary(0, &server_dict));
+  EXPECT_TRUE(server_dict->HasKey(base::StringPrintf(
+      "www%d.example.com:443", static_cast<int>(kNumServers - 1))));
+  ASSERT_TRUE(servers_list->GetDictionary(servers_list->GetSize() - 1,
+                                          &server_dict));
+  EXPECT_TRUE(server_dict->HasKey("www1.example.com:443"));
+}
+
+TEST_F(HttpServerPropertiesManagerTest, ReadServersList) {
+  ExpectCacheUpdate();
+
+  // Version 3 keeps the servers in a list, the most recently used first.
+  base::ListValue* servers_list = new base::ListValue;
+  const char* const kServers[] = {
+    "www.google.com:80", "mail.google.com:80", "docs.google.com:443",
+  };
+  for (size_t i = 0; i < arraysize(kServers); ++i) {
+    base::DictionaryValue* server_pref_dict = new base::DictionaryValue;
+    server_pref_dict->SetBoolean("supports_spdy", true);
+    base::DictionaryValue* entry_dict = new base::DictionaryValue;
+    entry_dict->SetWithoutPathExpansion(kServers[i], server_pref_dict);
+    servers_list->Append(entry_dict);
+  }
+
+  base::DictionaryValue* http_server_properties_dict =
+      new base::DictionaryValue;
+  HttpServerPropertiesManager::SetVersion(http_server_properties_dict, 3);
+  http_server_properties_dict->SetWithoutPathExpansion("servers",
+                                                       servers_list);
+  pref_service_.SetUserPref(prefs::kHttpServerProperties,
+                            http_server_properties_dict);
+
+  loop_.RunUntilIdle();
+  Mock::VerifyAndClearExpectations(http_server_props_manager_.get());
+
+  for (size_t i = 0; i < arraysize(kServers); ++i) {
+    EXPECT_TRUE(http_server_props_manager_->SupportsSpdy(
+        net::HostPortPair::FromString(kServers[i])));
+  }
+
+  // Using a new server puts it in front of the ones read, which keep their
+  // order.
+  ExpectPrefsUpdate();
+  http_server_props_manager_->SetSupportsSpdy(
+      net::HostPortPair::FromString("maps.google.com:443"), true);
+  loop_.RunUntilIdle();
+  Mock::VerifyAndClearExpectations(http_server_props_manager_.get());
+
+  const base::ListValue* written_list = NULL;
+  ASSERT_TRUE(pref_service_.GetDictionary(prefs::kHttpServerProperties)->
+      GetListWithoutPathExpansion("servers", &written_list));
+  ASSERT_EQ(arraysize(kServers) + 1, written_list->GetSize());
+  const base::DictionaryValue* entry_dict = NULL;
+  ASSERT_TRUE(written_list->GetDictionary(0, &entry_dict));
+  EXPECT_TRUE(entry_dict->HasKey("maps.google.com:443"));
+  for (size_t i = 0; i < arraysize(kServers); ++i) {
+    ASSERT_TRUE(written_list->GetDictionary(i + 1, &entry_dict));
+    EXPECT_TRUE(entry_dict->HasKey(kServers[i]));
+  }
+}
+
+TEST_F(HttpServerPropertiesManagerTest, UpgradeFromVersion2) {
+  ExpectCacheUpdate();
+  // Only kMaxServersToPersist servers are read, so the preferences are
+  // rewritten.
+  ExpectPrefsUpdate();
+
+  // Version 2 kept the servers in a dictionary of any size.
+  const size_t kNumServers =
+      HttpServerPropertiesManager::kMaxServersToPersist + 1;
+  base::DictionaryValue* servers_dict = new base::DictionaryValue;
+  for (size_t i = 0; i < kNumServers; ++i) {
+    base::DictionaryValue* server_pref_dict = new base::DictionaryValue;
+    server_pref_dict->SetBoolean("supports_spdy", true);
+    servers_dict->SetWithoutPathExpansion(
+        base::StringPrintf("www%03d.example.com:443", static_cast<int>(i)),
+        server_pref_dict);
+  }
+
+  base::DictionaryValue* http_server_properties_dict =
+      new base::DictionaryValue;
+  HttpServerPropertiesManager::SetVersion(http_server_properties_dict, 2);
+  http_server_properties_dict->SetWithoutPathExpansion("servers",
+                                                       servers_dict);
+  pref_service_.SetUserPref(prefs::kHttpServerProperties,
+                            http_server_properties_dict);
+
+  loop_.RunUntilIdle();
+  Mock::VerifyAndClearExpectations(http_server_props_manager_.get());
+
+  // The first servers of the dictionary are kept, and the last one dropped.
+  EXPECT_TRUE(http_server_props_manager_->SupportsSpdy(
+      net::HostPortPair("www000.example.com", 443)));
+  EXPECT_TRUE(http_server_props_manager_->SupportsSpdy(
+      net::HostPortPair(base::StringPrintf(
+          "www%03d.example.com", static_cast<int>(kNumServers - 2)), 443)));
+  EXPECT_FALSE(http_server_props_manager_->SupportsSpdy(
+      net::HostPortPair(base::StringPrintf(
+          "www%03d.example.com", static_cast<int>(kNumServers - 1)), 443)));
+
+  // The rewritten preferences are in the version 3 format.
+  const base::DictionaryValue* written_dict =
+      pref_service_.GetDictionary(prefs::kHttpServerProperties);
+  int version = 0;
+  ASSERT_TRUE(written_dict->GetIntegerWithoutPathExpansion("version",
+                                                           &version));
+  EXPECT_EQ(3, version);
+  const base::ListValue* written_list = NULL;
+  ASSERT_TRUE(written_dict->GetListWithoutPathExpansion("servers",
+                                                        &written_list));
+  EXPECT_EQ(HttpServerPropertiesManager::kMaxServersToPersist,
+            written_list->GetSize());
+}
+
 TEST_F(HttpServerPropertiesManagerTest, ShutdownWithPendingUpdateCache0) {
   // Post an update task to the UI thread.
   http_server_props_manager_->ScheduleUpdateCacheOnUI();
@@ -24,10 +24,13 @@
 #include "base/threading/thread_restrictions.h"
 #include "base/time/time.h"
 #include "base/values.h"
+#include "chrome/browser/browser_process.h"
 #include "chrome/browser/io_thread.h"
 #include "chrome/browser/net/preconnect.h"
 #include "chrome/browser/prefs/scoped_user_pref_update.h"
 #include "chrome/browser/prefs/session_startup_pref.h"
+#include "chrome/browser/profiles/profile.h"
+#include "chrome/browser/profiles/profile_manager.h"
 #include "chrome/common/chrome_switches.h"
 #include "chrome/common/pref_names.h"
 #include "components/user_prefs/pref_registry_syncable.h"
@@ -37,6 +40,7 @@
 #include "net/base/host_port_pair.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_log.h"
+#include "net/dns/host_cache.h"
 #include "net/dns/host_resolver.h"
 #include "net/dns/single_request_host_resolver.h"
 #include "net/url_request/url_request_context_getter.h"
@@ -46,10 +50,28 @@ using content::BrowserThread;
 
 namespace chrome_browser_net {
 
+namespace {
+
+// Returns true if any profile has an off-the-record profile open.
+bool OffTheRecordProfileExists() {
+  ProfileManager* profile_manager = g_browser_process->profile_manager();
+  if (!profile_manager)
+    return false;
+  std::vector<Profile*> profiles = profile_manager->GetLoadedProfiles();
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    if (profiles[i]->HasOffTheRecordProfile())
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
 // static
 const int Predictor::kPredictorReferrerVersion = 2;
 const double Predictor::kPreconnectWorthyExpectedValue = 0.8;
 const double Predictor::kDNSPreresolutionWorthyExpectedValue = 0.1;
+const int Predictor::kMaxPreconnectSocketsPerNavigation = 8;
 const double Predictor::kDiscardableExpectedValue = 0.05;
 // The goal is of trimming is to to reduce the importance (number of expected
 // subresources needed) by a factor of 2 after about 24 hours of uptime. We will
@@ -85,6 +107,9 @@ static size_t g_max_parallel_resolves =
 // we change the format so that we discard old data.
 static const int kPredictorStartupFormatVersion = 1;
 
+// The most navigations whose predictions are remembered until they are scored.
+static const size_t kMaxUnscoredNavigations = 50;
+
 class Predictor::LookupRequest {
  public:
   LookupRequest(Predictor* predictor,
@@ -257,6 +282,91 @@ void Predictor::PreconnectUsage::ObserveLinkNavigation(const GURL& url) {
   UMA_HISTOGRAM_BOOLEAN("Net.PreconnectedLinkNavigations", did_use_preconnect);
 }
 
+Predictor::PredictionAccuracy::PredictionAccuracy()
+    : navigations_(Navigations::NO_AUTO_EVICT),
+      max_duration_(base::TimeDelta::FromSeconds(
+          Predictor::kMaxUnusedSocketLifetimeSecondsWithoutAGet)),
+      predicted_count_(0),
+      needed_count_(0),
+      used_count_(0) {
+}
+
+Predictor::PredictionAccuracy::~PredictionAccuracy() {}
+
+void Predictor::PredictionAccuracy::ObservePrediction(
+    const GURL& referrer,
+    const std::set<GURL>& predicted) {
+  base::TimeTicks now = base::TimeTicks::Now();
+  ScoreExpired(now);
+
+  // The previous navigation to |referrer| is over.
+  Navigations::iterator it = navigations_.Peek(referrer);
+  if (it != navigations_.end()) {
+    Score(it->second);
+    navigations_.Erase(it);
+  }
+
+  Navigation navigation;
+  navigation.time = now;
+  navigation.predicted = predicted;
+  navigations_.Put(referrer, navigation);
+}
+
+void Predictor::PredictionAccuracy::ObserveSubresource(
+    const GURL& referrer,
+    const GURL& subresource) {
+  Navigations::iterator it = navigations_.Peek(referrer);
+  if (it == navigations_.end())
+    return;
+  // Too late for any preconnection to have helped.
+  if (base::TimeTicks::Now() - it->second.time >= max_duration_)
+    return;
+  it->second.needed.insert(subresource);
+}
+
+void Predictor::PredictionAccuracy::ScoreAll() {
+  for (Navigations::iterator it = navigations_.begin();
+       it != navigations_.end(); ++it) {
+    Score(it->second);
+  }
+  navigations_.Clear();
+}
+
+void Predictor::PredictionAccuracy::ScoreExpired(base::TimeTicks now) {
+  // Navigations are put in the order they happen, so the eldest is last.
+  Navigations::reverse_iterator eldest = navigations_.rbegin();
+  while (eldest != navigations_.rend()) {
+    if (navigations_.size() < kMaxUnscoredNavigations &&
+        now - eldest->second.time < max_duration_) {
+      break;
+    }
+    Score(eldest->second);
+    eldest = navigations_.Erase(eldest);
+  }
+}
+
+void Predictor::PredictionAccuracy::Score(const Navigation& navigation) {
+  int used = 0;
+  for (std::set<GURL>::const_iterator it = navigation.predicted.begin();
+       it != navigation.predicted.end(); ++it) {
+    if (navigation.needed.count(*it))
+      ++used;
+  }
+  int predicted = static_cast<int>(navigation.predicted.size());
+  int needed = static_cast<int>(navigation.needed.size());
+  if (predicted > 0) {
+    UMA_HISTOGRAM_PERCENTAGE("Net.PredictedSubresourcePrecision",
+                             used * 100 / predicted);
+  }
+  if (needed > 0) {
+    UMA_HISTOGRAM_PERCENTAGE("Net.PredictedSubresourceRecall",
+                             used * 100 / needed);
+  }
+  predicted_count_ += predicted;
+  needed_count_ += needed;
+  used_count_ += used;
+}
+
 Predictor::Predictor(bool preconnect_enabled)
     : url_request_context_getter_(NULL),
       predictor_enabled_(true),
@@ -293,6 +403,8 @@ void Predictor::RegisterProfilePrefs(
                              user_prefs::PrefRegistrySyncable::UNSYNCABLE_PREF);
   registry->RegisterListPref(prefs::kDnsPrefetchingHostReferralList,
                              user_prefs::PrefRegistrySyncable::UNSYNCABLE_PREF);
+  registry->RegisterListPref(prefs::kDnsPrefetchingHostCache,
+                             user_prefs::PrefRegistrySyncable::UNSYNCABLE_PREF);
 }
 
 // --------------------- Start UI methods. ------------------------------------
@@ -315,12 +427,17 @@ void Predictor::InitNetworkPredictor(PrefService* user_prefs,
       static_cast<base::ListValue*>(user_prefs->GetList(
           prefs::kDnsPrefetchingHostReferralList)->DeepCopy());
 
+  base::ListValue* host_cache_list =
+      static_cast<base::ListValue*>(user_prefs->GetList(
+          prefs::kDnsPrefetchingHostCache)->DeepCopy());
+
   // Now that we have the statistics in memory, wipe them from the Preferences
   // file. They will be serialized back on a clean shutdown. This way we only
   // have to worry about clearing our in-memory state when Clearing Browsing
   // Data.
   user_prefs->ClearPref(prefs::kDnsPrefetchingStartupList);
   user_prefs->ClearPref(prefs::kDnsPrefetchingHostReferralList);
+  user_prefs->ClearPref(prefs::kDnsPrefetchingHostCache);
 
   BrowserThread::PostTask(
       BrowserThread::IO,
@@ -328,7 +445,7 @@ void Predictor::InitNetworkPredictor(PrefService* user_prefs,
       base::Bind(
           &Predictor::FinalizeInitializationOnIOThread,
           base::Unretained(this),
-          urls, referral_list,
+          urls, referral_list, host_cache_list,
           io_thread, predictor_enabled));
 }
 
@@ -489,7 +606,9 @@ void Predictor::set_max_parallel_resolves(size_t max_parallel_resolves) {
 void Predictor::ShutdownOnUIThread(PrefService* user_prefs) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
 
-  SaveStateForNextStartupAndTrim(user_prefs);
+  // The host cache is shared with off-the-record profiles, so it is not saved
+  // while one is open.
+  SaveStateForNextStartupAndTrim(user_prefs, !OffTheRecordProfileExists());
 
   BrowserThread::PostTask(
       BrowserThread::IO,
@@ -513,7 +632,7 @@ void Predictor::DiscardAllResults() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   // Delete anything listed so far in this session that shows in about:dns.
   referrers_.clear();
-
+  prediction_accuracy_.Clear();
 
   // Try to delete anything in our work queue.
   while (!work_queue_.IsEmpty()) {
@@ -579,6 +698,7 @@ void Predictor::LearnFromNavigation(const GURL& referring_url,
   DCHECK_NE(target_url, GURL::EmptyGURL());
 
   referrers_[referring_url].SuggestHost(target_url);
+  prediction_accuracy_.ObserveSubresource(referring_url, target_url);
   // Possibly do some referrer trimming.
   TrimReferrers();
 }
@@ -790,6 +910,7 @@ void Predictor::DiscardInitialNavigationHistory() {
 void Predictor::FinalizeInitializationOnIOThread(
     const UrlList& startup_urls,
     base::ListValue* referral_list,
+    base::ListValue* host_cache_list,
     IOThread* io_thread,
     bool predictor_enabled) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
@@ -799,6 +920,16 @@ void Predictor::FinalizeInitializationOnIOThread(
   host_resolver_ = io_thread->globals()->host_resolver.get();
   preconnect_usage_.reset(new PreconnectUsage());
 
+  // Restore the host cache of the previous session, so that the first
+  // requests do not have to wait for the resolver. A malformed list only
+  // loses the entries after the error.
+  net::HostCache* host_cache = host_resolver_->GetHostCache();
+  if (host_cache) {
+    host_cache->RestoreFromListValue(*host_cache_list, base::TimeTicks::Now(),
+                                     base::Time::Now());
+  }
+  delete host_cache_list;
+
   // base::WeakPtrFactory instances need to be created and destroyed
   // on the same thread. The predictor lives on the IO thread and will die
   // from there so now that we're on the IO thread we need to properly
@@ -869,6 +1000,8 @@ void Predictor::DnsPrefetchMotivatedList(
 static void SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
     base::ListValue* startup_list,
     base::ListValue* referral_list,
+    base::ListValue* host_cache_list,
+    bool save_host_cache,
     base::WaitableEvent* completion,
     Predictor* predictor) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
@@ -878,10 +1011,12 @@ static void SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
     return;
   }
   predictor->SaveDnsPrefetchStateForNextStartupAndTrim(
-      startup_list, referral_list, completion);
+      startup_list, referral_list, host_cache_list, save_host_cache,
+      completion);
 }
 
-void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
+void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs,
+                                               bool save_host_cache) {
   if (!predictor_enabled_)
     return;
 
@@ -890,10 +1025,14 @@ void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
   ListPrefUpdate update_startup_list(prefs, prefs::kDnsPrefetchingStartupList);
   ListPrefUpdate update_referral_list(prefs,
                                       prefs::kDnsPrefetchingHostReferralList);
+  ListPrefUpdate update_host_cache_list(prefs,
+                                        prefs::kDnsPrefetchingHostCache);
   if (BrowserThread::CurrentlyOn(BrowserThread::IO)) {
     SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
         update_startup_list.Get(),
         update_referral_list.Get(),
+        update_host_cache_list.Get(),
+        save_host_cache,
         &completion,
         this);
   } else {
@@ -904,6 +1043,8 @@ void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
             &SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread,
             update_startup_list.Get(),
             update_referral_list.Get(),
+            update_host_cache_list.Get(),
+            save_host_cache,
             &completion,
             this));
 
@@ -921,6 +1062,8 @@ void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
 void Predictor::SaveDnsPrefetchStateForNextStartupAndTrim(
     base::ListValue* startup_list,
     base::ListValue* referral_list,
+    base::ListValue* host_cache_list,
+    bool save_host_cache,
     base::WaitableEvent* completion) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   if (initial_observer_.get())
@@ -931,9 +1074,45 @@ void Predictor::SaveDnsPrefetchStateForNextStartupAndTrim(
   TrimReferrersNow();
   SerializeReferrers(referral_list);
 
+  host_cache_list->Clear();
+  net::HostCache* host_cache =
+      host_resolver_ ? host_resolver_->GetHostCache() : NULL;
+  if (host_cache && save_host_cache) {
+    std::set<std::string> hostnames;
+    GetSeenHostnames(&hostnames);
+    host_cache->GetAsListValueForHostnames(hostnames, host_cache_list,
+                                           base::TimeTicks::Now(),
+                                           base::Time::Now());
+  }
+
   completion->Signal();
 }
 
+void Predictor::GetSeenHostnames(std::set<std::string>* hostnames) const {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  if (initial_observer_.get()) {
+    const InitialObserver::FirstNavigations& first_navigations =
+        initial_observer_->first_navigations();
+    for (InitialObserver::FirstNavigations::const_iterator it =
+             first_navigations.begin();
+         it != first_navigations.end(); ++it) {
+      hostnames->insert(it->first.host());
+    }
+  }
+  for (Referrers::const_iterator it = referrers_.begin();
+       it != referrers_.end(); ++it) {
+    hostnames->insert(it->first.host());
+    for (Referrer::const_iterator sub = it->second.begin();
+         sub != it->second.end(); ++sub) {
+      hostnames->insert(sub->first.host());
+    }
+  }
+  for (Results::const_iterator it = results_.begin(); it != results_.end();
+       ++it) {
+    hostnames->insert(it->first.host());
+  }
+}
+
 void Predictor::EnablePredictor(bool enable) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI) ||
          BrowserThread::CurrentlyOn(BrowserThread::IO));
@@ -1036,6 +1215,13 @@ enum SubresourceValue {
   SUBRESOURCE_VALUE_MAX
 };
 
+// Orders subresources from the most expected to be used to the least.
+static bool IsMoreExpectedSubresource(Referrer::iterator left,
+                                      Referrer::iterator right) {
+  return left->second.subresource_use_rate() >
+      right->second.subresource_use_rate();
+}
+
 void Predictor::PrepareFrameSubresources(const GURL& url,
                                          const GURL& first_party_for_cookies) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
@@ -1059,23 +1245,39 @@ void Predictor::PrepareFrameSubresources(const GURL& url,
   referrer->IncrementUseCount();
   const UrlInfo::ResolutionMotivation motivation =
       UrlInfo::LEARNED_REFERAL_MOTIVATED;
+
+  // Consider the most likely subresources first, so that they get the
+  // preconnections when there are more candidates than the budget allows.
+  std::vector<Referrer::iterator> future_urls;
   for (Referrer::iterator future_url = referrer->begin();
        future_url != referrer->end(); ++future_url) {
+    future_urls.push_back(future_url);
+  }
+  std::stable_sort(future_urls.begin(), future_urls.end(),
+                   IsMoreExpectedSubresource);
+
+  int sockets_left = kMaxPreconnectSocketsPerNavigation;
+  std::set<GURL> predicted_urls;
+  for (size_t i = 0; i < future_urls.size(); ++i) {
+    Referrer::iterator future_url = future_urls[i];
     SubresourceValue evalution(TOO_NEW);
     double connection_expectation = future_url->second.subresource_use_rate();
     UMA_HISTOGRAM_CUSTOM_COUNTS("Net.PreconnectSubresourceExpectation",
                                 static_cast<int>(connection_expectation * 100),
                                 10, 5000, 50);
     future_url->second.ReferrerWasObserved();
-    if (preconnect_enabled_ &&
+    if (preconnect_enabled_ && sockets_left > 0 &&
         connection_expectation > kPreconnectWorthyExpectedValue) {
       evalution = PRECONNECTION;
       future_url->second.IncrementPreconnectionCount();
       int count = static_cast<int>(std::ceil(connection_expectation));
       if (url.host() == future_url->first.host())
         ++count;
+      count = std::min(count, sockets_left);
+      sockets_left -= count;
       PreconnectUrlOnIOThread(future_url->first, first_party_for_cookies,
                               motivation, count);
+      predicted_urls.insert(future_url->first);
     } else if (connection_expectation > kDNSPreresolutionWorthyExpectedValue) {
       evalution = PRERESOLUTION;
       future_url->second.preresolution_increment();
@@ -1083,10 +1285,12 @@ void Predictor::PrepareFrameSubresources(const GURL& url,
                                                      motivation);
       if (queued_info)
         queued_info->SetReferringHostname(url);
+      predicted_urls.insert(future_url->first);
     }
     UMA_HISTOGRAM_ENUMERATION("Net.PreconnectSubresourceEval", evalution,
                               SUBRESOURCE_VALUE_MAX);
   }
+  prediction_accuracy_.ObservePrediction(url, predicted_urls);
 }
 
 void Predictor::OnLookupFinished(LookupRequest* request, const GURL& url,
@@ -25,9 +25,11 @@
 #include <string>
 #include <vector>
 
+#include "base/containers/mru_cache.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
 #include "chrome/browser/net/referrer.h"
 #include "chrome/browser/net/timed_cache.h"
 #include "chrome/browser/net/url_info.h"
@@ -197,6 +199,7 @@ class Predictor {
   void FinalizeInitializationOnIOThread(
       const std::vector<GURL>& urls_to_prefetch,
       base::ListValue* referral_list,
+      base::ListValue* host_cache_list,
       IOThread* io_thread,
       bool predictor_enabled);
 
@@ -214,12 +217,19 @@ class Predictor {
                                 UrlInfo::ResolutionMotivation motivation);
 
   // May be called from either the IO or UI thread and will PostTask
-  // to the IO thread if necessary.
-  void SaveStateForNextStartupAndTrim(PrefService* prefs);
-
+  // to the IO thread if necessary. The host cache is only saved if
+  // |save_host_cache| is true.
+  void SaveStateForNextStartupAndTrim(PrefService* prefs,
+                                      bool save_host_cache);
+
+  // The host cache is shared by all profiles, so only the entries for hosts
+  // this predictor has seen are saved, and none if |save_host_cache| is
+  // false.
   void SaveDnsPrefetchStateForNextStartupAndTrim(
       base::ListValue* startup_list,
       base::ListValue* referral_list,
+      base::ListValue* host_cache_list,
+      bool save_host_cache,
       base::WaitableEvent* completion);
 
   // May be called from either the IO or UI thread and will PostTask
@@ -295,6 +305,10 @@ class Predictor {
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueuePushPopTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueueReorderTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, ReferrerSerializationTrimTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, PreconnectBudgetTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, ReplayNavigationLogTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, SaveHostCacheOnlyForSeenHosts);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, SaveNoHostCacheWhenNotAllowed);
   friend class WaitForResolutionHelper;  // For testing.
 
   class LookupRequest;
@@ -350,6 +364,10 @@ class Predictor {
     // Discards all initial loading history.
     void DiscardInitialNavigationHistory() { first_navigations_.clear(); }
 
+    const FirstNavigations& first_navigations() const {
+      return first_navigations_;
+    }
+
    private:
     // List of the first N URL resolutions observed in this run.
     FirstNavigations first_navigations_;
@@ -358,6 +376,63 @@ class Predictor {
     static const size_t kStartupResolutionCount = 10;
   };
 
+  // The PredictionAccuracy scores the subresources predicted when a referrer
+  // is navigated to against the subresources that the navigation then needed.
+  // A navigation is scored when its referrer is navigated to again, or once
+  // the preconnections made for it would have been dropped anyway. The
+  // precision and recall of each navigation are recorded in UMA, and their
+  // totals are kept for tests and replays of navigation logs.
+  class PredictionAccuracy {
+   public:
+    PredictionAccuracy();
+    ~PredictionAccuracy();
+
+    // Records a navigation to |referrer|, for which the subresources in
+    // |predicted| were preconnected or pre-resolved.
+    void ObservePrediction(const GURL& referrer,
+                           const std::set<GURL>& predicted);
+
+    // Records that the last navigation to |referrer| needed |subresource|.
+    void ObserveSubresource(const GURL& referrer, const GURL& subresource);
+
+    // Scores all the navigations that were not scored yet.
+    void ScoreAll();
+
+    // Discards all the navigations that were not scored yet.
+    void Clear() { navigations_.Clear(); }
+
+    int64 predicted_count() const { return predicted_count_; }
+    int64 needed_count() const { return needed_count_; }
+    int64 used_count() const { return used_count_; }
+
+   private:
+    struct Navigation {
+      base::TimeTicks time;
+      std::set<GURL> predicted;
+      std::set<GURL> needed;
+    };
+    typedef base::MRUCache<GURL, Navigation> Navigations;
+
+    // Scores the navigations older than |max_duration_|, and the least recent
+    // ones beyond the most that are remembered.
+    void ScoreExpired(base::TimeTicks now);
+
+    void Score(const Navigation& navigation);
+
+    // The navigations not scored yet, keyed by referrer.
+    Navigations navigations_;
+
+    const base::TimeDelta max_duration_;
+
+    // The number of predicted subresources, of needed ones, and of predicted
+    // ones that were needed, over all the scored navigations.
+    int64 predicted_count_;
+    int64 needed_count_;
+    int64 used_count_;
+
+    DISALLOW_COPY_AND_ASSIGN(PredictionAccuracy);
+  };
+
   // A map that is keyed with the host/port that we've learned were the cause
   // of loading additional URLs.  The list of additional targets is held
   // in a Referrer instance, which is a value in this map.
@@ -368,6 +443,10 @@ class Predictor {
   // nothing).  The following are the threasholds for taking those actions.
   static const double kPreconnectWorthyExpectedValue;
   static const double kDNSPreresolutionWorthyExpectedValue;
+  // The most sockets that are preconnected for the subresources of a single
+  // navigation. The most likely subresources are preconnected first, and
+  // those left once the budget is spent are only pre-resolved.
+  static const int kMaxPreconnectSocketsPerNavigation;
   // Referred hosts with a subresource_use_rate_ that are less than the
   // following threshold will be discarded when we Trim() the list.
   static const double kDiscardableExpectedValue;
@@ -386,6 +465,10 @@ class Predictor {
   // Number of referring URLs processed in an incremental trimming.
   static const size_t kUrlsTrimmedPerIncrement;
 
+  // Adds the hosts that were navigated to, referred to or resolved by this
+  // predictor to |hostnames|.
+  void GetSeenHostnames(std::set<std::string>* hostnames) const;
+
   // Only for testing. Returns true if hostname has been successfully resolved
   // (name found).
   bool WasFound(const GURL& url) const {
@@ -517,6 +600,8 @@ class Predictor {
   class PreconnectUsage;
   scoped_ptr<PreconnectUsage> preconnect_usage_;
 
+  PredictionAccuracy prediction_accuracy_;
+
   // For each URL that we might navigate to (that we've "learned about")
   // we have a Referrer list. Each Referrer list has all hostnames we might
   // need to pre-resolve or pre-connect to when there is a navigation to the
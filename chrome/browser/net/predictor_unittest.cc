@@ -11,6 +11,9 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/timer/timer.h"
 #include "base/values.h"
 #include "chrome/browser/net/predictor.h"
@@ -18,7 +21,10 @@
 #include "chrome/common/net/predictor_common.h"
 #include "content/public/test/test_browser_thread.h"
 #include "net/base/address_list.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
 #include "net/base/winsock_init.h"
+#include "net/dns/host_cache.h"
 #include "net/dns/mock_host_resolver.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -553,6 +559,175 @@ TEST_F(PredictorTest, ReferrerSerializationTrimTest) {
 }
 
 
+TEST_F(PredictorTest, PreconnectBudgetTest) {
+  host_resolver_->rules()->AddRule("*.example.com", "127.0.0.1");
+  Predictor predictor(true);
+  predictor.SetHostResolver(host_resolver_.get());
+  GURL referring_url("http://www.example.com/");
+
+  // Each subresource is expected to need 3 connections, so the budget only
+  // covers the first few.
+  const size_t kSubresources = 10;
+  for (size_t i = 0; i < kSubresources; ++i) {
+    GURL subresource_url(base::StringPrintf(
+        "http://img%d.example.com/", static_cast<int>(i)));
+    predictor.LearnFromNavigation(referring_url, subresource_url);
+  }
+  predictor.PredictFrameSubresources(referring_url, GURL());
+
+  const Referrer& referrer = predictor.referrers_[referring_url];
+  ASSERT_EQ(kSubresources, referrer.size());
+  int preconnected = 0;
+  int preresolved = 0;
+  for (Referrer::const_iterator it = referrer.begin(); it != referrer.end();
+       ++it) {
+    preconnected += it->second.preconnection_count();
+    preresolved += it->second.preresolution_count();
+  }
+  EXPECT_EQ(3, preconnected);
+  EXPECT_EQ(7, preresolved);
+
+  predictor.Shutdown();
+}
+
+// Replays |log| through |predictor| the way ConnectInterceptor reports
+// navigations. Each line of |log| is a page that was navigated to, followed by
+// the subresource hosts that it needed, separated by spaces.
+static void ReplayNavigationLog(Predictor* predictor, const std::string& log) {
+  std::vector<std::string> lines;
+  base::SplitString(log, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    std::vector<std::string> urls;
+    base::SplitStringAlongWhitespace(lines[i], &urls);
+    if (urls.empty())
+      continue;
+    GURL page_url(Predictor::CanonicalizeUrl(GURL(urls[0])));
+    predictor->PredictFrameSubresources(page_url, GURL());
+    for (size_t j = 1; j < urls.size(); ++j) {
+      predictor->LearnFromNavigation(
+          page_url, Predictor::CanonicalizeUrl(GURL(urls[j])));
+    }
+  }
+}
+
+TEST_F(PredictorTest, ReplayNavigationLogTest) {
+  host_resolver_->rules()->AddRule("*.example.com", "127.0.0.1");
+  Predictor predictor(true);
+  predictor.SetHostResolver(host_resolver_.get());
+
+  // The page needs a and b for five visits, and then a and c.
+  std::string log;
+  for (int i = 0; i < 5; ++i)
+    log += "http://www.example.com/ http://a.example.com/ "
+           "http://b.example.com/\n";
+  for (int i = 0; i < 5; ++i)
+    log += "http://www.example.com/ http://a.example.com/ "
+           "http://c.example.com/\n";
+  ReplayNavigationLog(&predictor, log);
+  predictor.prediction_accuracy_.ScoreAll();
+
+  // Nothing is known about the first visit. The next four get a and b right.
+  // The sixth needs c before it was learned, and the last four still predict
+  // b, whose expected use decays over the visits that don't need it.
+  const Predictor::PredictionAccuracy& accuracy =
+      predictor.prediction_accuracy_;
+  EXPECT_EQ(22, accuracy.predicted_count());
+  EXPECT_EQ(18, accuracy.needed_count());
+  EXPECT_EQ(17, accuracy.used_count());
+
+  predictor.Shutdown();
+}
+
+// Adds a successful entry for |hostname| to |host_cache|.
+static void AddHostCacheEntry(const std::string& hostname,
+                              net::HostCache* host_cache) {
+  net::IPAddressNumber address;
+  EXPECT_TRUE(net::ParseIPLiteralToNumber("127.0.0.1", &address));
+  host_cache->Set(
+      net::HostCache::Key(hostname, net::ADDRESS_FAMILY_UNSPECIFIED, 0),
+      net::HostCache::Entry(net::OK,
+                            net::AddressList::CreateFromIPAddress(address, 0)),
+      base::TimeTicks::Now(), TimeDelta::FromMinutes(10));
+}
+
+// The host cache is shared by all profiles, so a predictor must only save the
+// entries for hosts its own profile has seen.
+TEST_F(PredictorTest, SaveHostCacheOnlyForSeenHosts) {
+  Predictor predictor(true);
+  predictor.SetHostResolver(host_resolver_.get());
+  scoped_ptr<ListValue> referral_list(NewEmptySerializationList());
+  AddToSerializedList(GURL("http://www.google.com:80"),
+                      GURL("http://icons.google.com:80"), 10.0,
+                      referral_list.get());
+  predictor.DeserializeReferrers(*referral_list.get());
+
+  net::HostCache* host_cache = host_resolver_->GetHostCache();
+  ASSERT_TRUE(host_cache);
+  AddHostCacheEntry("www.google.com", host_cache);
+  AddHostCacheEntry("icons.google.com", host_cache);
+  AddHostCacheEntry("other-profile.com", host_cache);
+
+  ListValue startup_list;
+  ListValue recovered_referral_list;
+  ListValue host_cache_list;
+  base::WaitableEvent completion(true, false);
+  predictor.SaveDnsPrefetchStateForNextStartupAndTrim(
+      &startup_list, &recovered_referral_list, &host_cache_list, true,
+      &completion);
+  EXPECT_TRUE(completion.IsSignaled());
+
+  net::HostCache restored(10);
+  ASSERT_TRUE(restored.RestoreFromListValue(
+      host_cache_list, base::TimeTicks::Now(), base::Time::Now()));
+  EXPECT_EQ(2u, restored.stale_size());
+  EXPECT_TRUE(restored.LookupStale(
+      net::HostCache::Key("www.google.com", net::ADDRESS_FAMILY_UNSPECIFIED,
+                          0),
+      base::TimeTicks::Now()));
+  EXPECT_TRUE(restored.LookupStale(
+      net::HostCache::Key("icons.google.com", net::ADDRESS_FAMILY_UNSPECIFIED,
+                          0),
+      base::TimeTicks::Now()));
+  EXPECT_FALSE(restored.LookupStale(
+      net::HostCache::Key("other-profile.com",
+                          net::ADDRESS_FAMILY_UNSPECIFIED, 0),
+      base::TimeTicks::Now()));
+
+  predictor.Shutdown();
+}
+
+// Nothing is saved from the host cache while an off-the-record profile may
+// have added entries to it.
+TEST_F(PredictorTest, SaveNoHostCacheWhenNotAllowed) {
+  Predictor predictor(true);
+  predictor.SetHostResolver(host_resolver_.get());
+  scoped_ptr<ListValue> referral_list(NewEmptySerializationList());
+  AddToSerializedList(GURL("http://www.google.com:80"),
+                      GURL("http://icons.google.com:80"), 10.0,
+                      referral_list.get());
+  predictor.DeserializeReferrers(*referral_list.get());
+
+  net::HostCache* host_cache = host_resolver_->GetHostCache();
+  ASSERT_TRUE(host_cache);
+  AddHostCacheEntry("www.google.com", host_cache);
+
+  ListValue startup_list;
+  ListValue recovered_referral_list;
+  ListValue host_cache_list;
+  base::WaitableEvent completion(true, false);
+  predictor.SaveDnsPrefetchStateForNextStartupAndTrim(
+      &startup_list, &recovered_referral_list, &host_cache_list, false,
+      &completion);
+  EXPECT_TRUE(completion.IsSignaled());
+  EXPECT_EQ(0u, host_cache_list.GetSize());
+  // The referrers are still saved.
+  EXPECT_TRUE(GetDataFromSerialization(
+      GURL("http://www.google.com:80"), GURL("http://icons.google.com:80"),
+      recovered_referral_list, NULL));
+
+  predictor.Shutdown();
+}
+
 TEST_F(PredictorTest, PriorityQueuePushPopTest) {
   Predictor::HostNameQueue queue;
 
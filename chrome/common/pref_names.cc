@@ -496,6 +496,11 @@ const char kDnsHostReferralList[] = "HostReferralList";
 const char kDnsPrefetchingHostReferralList[] =
     "dns_prefetching.host_referral_list";
 
+// The successfully resolved host names and their addresses, with the time at
+// which they expire. Used to answer requests during the next startup while the
+// names are resolved again.
+const char kDnsPrefetchingHostCache[] = "dns_prefetching.host_cache";
+
 // Disables the SPDY protocol.
 const char kDisableSpdy[] = "spdy.disabled";
 
@@ -8,6 +8,7 @@
 #include <set>
 #include <utility>
 
+#include "base/atomicops.h"
 #include "base/bind.h"
 #include "base/location.h"
 #include "base/memory/ref_counted.h"
@@ -40,6 +41,150 @@ struct LifetimeFlag : public base::RefCountedThreadSafe<LifetimeFlag> {
   DISALLOW_COPY_AND_ASSIGN(LifetimeFlag);
 };
 
+// The state shared between a writer and its reader.  Data moves from the
+// writer to the reader through a single-producer/single-consumer lock-free
+// queue of batches, so publishing data never requires a task post by itself.
+// Tasks are only posted to wake a side that has declared itself idle: the
+// reader when it has drained the queue (empty -> non-empty transition) and
+// the writer when it has been told the stream is full and the reader has
+// since consumed a window's worth of data (watermark crossing).
+//
+// Both idle declarations follow the same protocol: the idle side sets its
+// flag, issues a full barrier and re-examines the shared state; the other
+// side updates the shared state, issues a full barrier and then claims the
+// flag with a compare-and-swap.  At least one of the two is guaranteed to
+// notice the other, and only the side that successfully claims the flag
+// posts a wake-up.
+//
+// The queue is unbounded rather than a fixed ring because
+// ByteStreamWriter::Write() always accepts data; the buffer size only
+// determines when the writer is told to stop.
+class ByteStreamSharedState
+    : public base::RefCountedThreadSafe<ByteStreamSharedState> {
+ public:
+  struct Batch {
+    Batch() : bytes(0), complete(false), status(0), next(0) { }
+
+    ContentVector contents;
+    size_t bytes;
+    bool complete;
+    int status;
+    base::subtle::AtomicWord next;  // Batch*
+  };
+
+  ByteStreamSharedState()
+      : head_(new Batch),
+        tail_(head_),
+        reader_waiting_(1),
+        writer_waiting_(0),
+        consumed_bytes_(0) { }
+
+  // Writer side.  Appends |batch| to the queue, taking ownership, and
+  // returns true if the reader was idle and must be woken by the caller.
+  bool Push(Batch* batch) {
+    DCHECK(!batch->next);
+    base::subtle::Release_Store(&tail_->next,
+                                reinterpret_cast<base::subtle::AtomicWord>(
+                                    batch));
+    tail_ = batch;
+    base::subtle::MemoryBarrier();
+    return ClaimFlag(&reader_waiting_);
+  }
+
+  // Reader side.  Moves the oldest batch into |*batch| and returns true, or
+  // returns false if the queue is empty.
+  bool Pop(Batch* batch) {
+    Batch* next = reinterpret_cast<Batch*>(
+        base::subtle::Acquire_Load(&head_->next));
+    if (!next)
+      return false;
+    // |next| becomes the new sentinel once its payload has been taken.
+    batch->contents.swap(next->contents);
+    batch->bytes = next->bytes;
+    batch->complete = next->complete;
+    batch->status = next->status;
+    delete head_;
+    head_ = next;
+    return true;
+  }
+
+  // Reader side.  Declares that the reader has drained the queue.  Returns
+  // false if data arrived concurrently, in which case the reader should
+  // keep reading instead of waiting for a notification.
+  bool MarkReaderWaiting() {
+    base::subtle::NoBarrier_Store(&reader_waiting_, 1);
+    base::subtle::MemoryBarrier();
+    if (!base::subtle::Acquire_Load(&head_->next))
+      return true;
+    // Data raced in.  If the writer has already claimed the flag a
+    // notification is on its way and will find nothing to do; either way
+    // it's safe to read now.
+    ClaimFlag(&reader_waiting_);
+    return false;
+  }
+
+  // Reader side.  Credits |bytes| back to the writer.  Returns true if the
+  // writer was blocked and must be woken by the caller.
+  bool Consume(size_t bytes) {
+    base::subtle::Barrier_AtomicIncrement(
+        &consumed_bytes_, static_cast<base::subtle::Atomic32>(bytes));
+    return ClaimFlag(&writer_waiting_);
+  }
+
+  // Writer side.  Returns the number of bytes consumed by the reader since
+  // the last call.
+  size_t TakeConsumedBytes() {
+    return static_cast<size_t>(
+        base::subtle::NoBarrier_AtomicExchange(&consumed_bytes_, 0));
+  }
+
+  // Writer side.  Declares that the writer is blocked on the reader.
+  void MarkWriterWaiting() {
+    base::subtle::NoBarrier_Store(&writer_waiting_, 1);
+    base::subtle::MemoryBarrier();
+  }
+
+  // Writer side.  Withdraws a MarkWriterWaiting() after the writer found
+  // space on its own.  Returns false if the reader has already claimed the
+  // flag, i.e. a wake-up is on its way.
+  bool CancelWriterWaiting() {
+    return ClaimFlag(&writer_waiting_);
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<ByteStreamSharedState>;
+
+  ~ByteStreamSharedState() {
+    while (head_) {
+      Batch* next = reinterpret_cast<Batch*>(
+          base::subtle::NoBarrier_Load(&head_->next));
+      delete head_;
+      head_ = next;
+    }
+  }
+
+  static bool ClaimFlag(volatile base::subtle::Atomic32* flag) {
+    return base::subtle::NoBarrier_Load(flag) &&
+        base::subtle::NoBarrier_CompareAndSwap(flag, 1, 0) == 1;
+  }
+
+  // Only accessed by the reader.  Always points at a sentinel batch whose
+  // payload has already been consumed.
+  Batch* head_;
+
+  // Only accessed by the writer.
+  Batch* tail_;
+
+  volatile base::subtle::Atomic32 reader_waiting_;
+  volatile base::subtle::Atomic32 writer_waiting_;
+
+  // Bytes read by the reader but not yet credited to the writer.  Bounded
+  // by the bytes in flight, so 32 bits are plenty.
+  volatile base::subtle::Atomic32 consumed_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ByteStreamSharedState);
+};
+
 // For both ByteStreamWriterImpl and ByteStreamReaderImpl, Construction and
 // SetPeer may happen anywhere; all other operations on each class must
 // happen in the context of their SequencedTaskRunner.
@@ -47,6 +192,7 @@ class ByteStreamWriterImpl : public ByteStreamWriter {
  public:
   ByteStreamWriterImpl(scoped_refptr<base::SequencedTaskRunner> task_runner,
                        scoped_refptr<LifetimeFlag> lifetime_flag,
+                       scoped_refptr<ByteStreamSharedState> shared_state,
                        size_t buffer_size);
   virtual ~ByteStreamWriterImpl();
 
@@ -64,12 +210,19 @@ class ByteStreamWriterImpl : public ByteStreamWriter {
 
   // PostTask target from |ByteStreamReaderImpl::MaybeUpdateInput|.
   static void UpdateWindow(scoped_refptr<LifetimeFlag> lifetime_flag,
-                           ByteStreamWriterImpl* target,
-                           size_t bytes_consumed);
+                           ByteStreamWriterImpl* target);
 
  private:
   // Called from UpdateWindow when object existence has been validated.
-  void UpdateWindowInternal(size_t bytes_consumed);
+  void UpdateWindowInternal();
+
+  // Collects the bytes the reader has consumed and returns true if
+  // there's room for more data.
+  bool HasSpace();
+
+  // Declares the writer blocked unless space turned up in the meantime.
+  // Returns true if the writer is now waiting for UpdateWindow.
+  bool WaitForSpace();
 
   void PostToPeer(bool complete, int status);
 
@@ -82,10 +235,16 @@ class ByteStreamWriterImpl : public ByteStreamWriter {
   // True while this object is alive.
   scoped_refptr<LifetimeFlag> my_lifetime_flag_;
 
+  scoped_refptr<ByteStreamSharedState> shared_state_;
+
   base::Closure space_available_callback_;
   ContentVector input_contents_;
   size_t input_contents_size_;
 
+  // True from the time Write() returns false until UpdateWindow finds
+  // space again.
+  bool waiting_for_space_;
+
   // ** Peer information.
 
   scoped_refptr<base::SequencedTaskRunner> peer_task_runner_;
@@ -106,6 +265,7 @@ class ByteStreamReaderImpl : public ByteStreamReader {
  public:
   ByteStreamReaderImpl(scoped_refptr<base::SequencedTaskRunner> task_runner,
                        scoped_refptr<LifetimeFlag> lifetime_flag,
+                       scoped_refptr<ByteStreamSharedState> shared_state,
                        size_t buffer_size);
   virtual ~ByteStreamReaderImpl();
 
@@ -120,27 +280,21 @@ class ByteStreamReaderImpl : public ByteStreamReader {
   virtual int GetStatus() const OVERRIDE;
   virtual void RegisterCallback(const base::Closure& sink_callback) OVERRIDE;
 
-  // PostTask target from |ByteStreamWriterImpl::Write| and
-  // |ByteStreamWriterImpl::Close|.
-  // Receive data from our peer.
+  // PostTask target from |ByteStreamWriterImpl::PostToPeer| when data
+  // or completion arrives while the reader is idle.
   // static because it may be called after the object it is targeting
   // has been destroyed.  It may not access |*target|
   // if |*object_lifetime_flag| is false.
-  static void TransferData(
+  static void DataAvailable(
       scoped_refptr<LifetimeFlag> object_lifetime_flag,
-      ByteStreamReaderImpl* target,
-      scoped_ptr<ContentVector> transfer_buffer,
-      size_t transfer_buffer_bytes,
-      bool source_complete,
-      int status);
+      ByteStreamReaderImpl* target);
 
  private:
-  // Called from TransferData once object existence has been validated.
-  void TransferDataInternal(
-      scoped_ptr<ContentVector> transfer_buffer,
-      size_t transfer_buffer_bytes,
-      bool source_complete,
-      int status);
+  // Called from DataAvailable once object existence has been validated.
+  void DataAvailableInternal();
+
+  // Moves everything the writer has published into |available_contents_|.
+  void PullFromWriter();
 
   void MaybeUpdateInput();
 
@@ -151,6 +305,8 @@ class ByteStreamReaderImpl : public ByteStreamReader {
   // True while this object is alive.
   scoped_refptr<LifetimeFlag> my_lifetime_flag_;
 
+  scoped_refptr<ByteStreamSharedState> shared_state_;
+
   ContentVector available_contents_;
 
   bool received_status_;
@@ -158,10 +314,6 @@ class ByteStreamReaderImpl : public ByteStreamReader {
 
   base::Closure data_available_callback_;
 
-  // Time of last point at which data in stream transitioned from full
-  // to non-full.  Nulled when a callback is sent.
-  base::Time last_non_full_time_;
-
   // ** Peer information
 
   scoped_refptr<base::SequencedTaskRunner> peer_task_runner_;
@@ -181,11 +333,14 @@ class ByteStreamReaderImpl : public ByteStreamReader {
 ByteStreamWriterImpl::ByteStreamWriterImpl(
     scoped_refptr<base::SequencedTaskRunner> task_runner,
     scoped_refptr<LifetimeFlag> lifetime_flag,
+    scoped_refptr<ByteStreamSharedState> shared_state,
     size_t buffer_size)
     : total_buffer_size_(buffer_size),
       my_task_runner_(task_runner),
       my_lifetime_flag_(lifetime_flag),
+      shared_state_(shared_state),
       input_contents_size_(0),
+      waiting_for_space_(false),
       output_size_used_(0),
       peer_(NULL) {
   DCHECK(my_lifetime_flag_.get());
@@ -216,7 +371,12 @@ bool ByteStreamWriterImpl::Write(
   if (input_contents_size_ > total_buffer_size_ / kFractionBufferBeforeSending)
     PostToPeer(false, 0);
 
-  return (input_contents_size_ + output_size_used_ <= total_buffer_size_);
+  // Once the reader owes us a wake-up, further writes just add to the
+  // backlog.
+  if (waiting_for_space_)
+    return false;
+
+  return !WaitForSpace();
 }
 
 void ByteStreamWriterImpl::Flush() {
@@ -238,27 +398,47 @@ void ByteStreamWriterImpl::RegisterCallback(
 
 // static
 void ByteStreamWriterImpl::UpdateWindow(
-    scoped_refptr<LifetimeFlag> lifetime_flag, ByteStreamWriterImpl* target,
-    size_t bytes_consumed) {
+    scoped_refptr<LifetimeFlag> lifetime_flag, ByteStreamWriterImpl* target) {
   // If the target object isn't alive anymore, we do nothing.
   if (!lifetime_flag->is_alive) return;
 
-  target->UpdateWindowInternal(bytes_consumed);
+  target->UpdateWindowInternal();
 }
 
-void ByteStreamWriterImpl::UpdateWindowInternal(size_t bytes_consumed) {
+void ByteStreamWriterImpl::UpdateWindowInternal() {
   DCHECK(my_task_runner_->RunsTasksOnCurrentThread());
+  DCHECK(waiting_for_space_);
+  waiting_for_space_ = false;
+
+  // The reader only wakes us after consuming a window's worth of data, but
+  // that isn't necessarily enough; if it isn't, go back to waiting.
+  if (WaitForSpace())
+    return;
+
+  if (!space_available_callback_.is_null())
+    space_available_callback_.Run();
+}
+
+bool ByteStreamWriterImpl::HasSpace() {
+  size_t bytes_consumed = shared_state_->TakeConsumedBytes();
   DCHECK_GE(output_size_used_, bytes_consumed);
   output_size_used_ -= bytes_consumed;
+  return input_contents_size_ + output_size_used_ <= total_buffer_size_;
+}
 
-  // Callback if we were above the limit and we're now <= to it.
-  size_t total_known_size_used =
-      input_contents_size_ + output_size_used_;
+bool ByteStreamWriterImpl::WaitForSpace() {
+  DCHECK(!waiting_for_space_);
+  if (HasSpace())
+    return false;
 
-  if (total_known_size_used <= total_buffer_size_ &&
-      (total_known_size_used + bytes_consumed > total_buffer_size_) &&
-      !space_available_callback_.is_null())
-    space_available_callback_.Run();
+  // Re-check after publishing the flag so that a reader that consumed data
+  // concurrently either sees the flag or has its consumption counted here.
+  shared_state_->MarkWriterWaiting();
+  if (HasSpace() && shared_state_->CancelWriterWaiting())
+    return false;
+
+  waiting_for_space_ = true;
+  return true;
 }
 
 void ByteStreamWriterImpl::PostToPeer(bool complete, int status) {
@@ -266,33 +446,34 @@ void ByteStreamWriterImpl::PostToPeer(bool complete, int status) {
   // Valid contexts in which to call.
   DCHECK(complete || 0 != input_contents_size_);
 
-  scoped_ptr<ContentVector> transfer_buffer;
-  size_t buffer_size = 0;
-  if (0 != input_contents_size_) {
-    transfer_buffer.reset(new ContentVector);
-    transfer_buffer->swap(input_contents_);
-    buffer_size = input_contents_size_;
-    output_size_used_ += input_contents_size_;
-    input_contents_size_ = 0;
-  }
+  ByteStreamSharedState::Batch* batch = new ByteStreamSharedState::Batch;
+  batch->contents.swap(input_contents_);
+  batch->bytes = input_contents_size_;
+  batch->complete = complete;
+  batch->status = status;
+  output_size_used_ += input_contents_size_;
+  input_contents_size_ = 0;
+
+  // The reader is only notified if it has run dry; otherwise it will pick
+  // the batch up on its next Read().
+  if (!shared_state_->Push(batch))
+    return;
   peer_task_runner_->PostTask(
       FROM_HERE, base::Bind(
-          &ByteStreamReaderImpl::TransferData,
+          &ByteStreamReaderImpl::DataAvailable,
           peer_lifetime_flag_,
-          peer_,
-          base::Passed(&transfer_buffer),
-          buffer_size,
-          complete,
-          status));
+          peer_));
 }
 
 ByteStreamReaderImpl::ByteStreamReaderImpl(
     scoped_refptr<base::SequencedTaskRunner> task_runner,
     scoped_refptr<LifetimeFlag> lifetime_flag,
+    scoped_refptr<ByteStreamSharedState> shared_state,
     size_t buffer_size)
     : total_buffer_size_(buffer_size),
       my_task_runner_(task_runner),
       my_lifetime_flag_(lifetime_flag),
+      shared_state_(shared_state),
       received_status_(false),
       status_(0),
       unreported_consumed_bytes_(0),
@@ -319,6 +500,15 @@ ByteStreamReaderImpl::Read(scoped_refptr<net::IOBuffer>* data,
                            size_t* length) {
   DCHECK(my_task_runner_->RunsTasksOnCurrentThread());
 
+  if (available_contents_.empty() && !received_status_) {
+    PullFromWriter();
+    // Going idle; if data raced in while doing so, take it instead.
+    if (available_contents_.empty() && !received_status_ &&
+        !shared_state_->MarkReaderWaiting()) {
+      PullFromWriter();
+    }
+  }
+
   if (available_contents_.size()) {
     *data = available_contents_.front().first;
     *length = available_contents_.front().second;
@@ -348,51 +538,41 @@ void ByteStreamReaderImpl::RegisterCallback(
 }
 
 // static
-void ByteStreamReaderImpl::TransferData(
+void ByteStreamReaderImpl::DataAvailable(
     scoped_refptr<LifetimeFlag> object_lifetime_flag,
-    ByteStreamReaderImpl* target,
-    scoped_ptr<ContentVector> transfer_buffer,
-    size_t buffer_size,
-    bool source_complete,
-    int status) {
+    ByteStreamReaderImpl* target) {
   // If our target is no longer alive, do nothing.
   if (!object_lifetime_flag->is_alive) return;
 
-  target->TransferDataInternal(
-      transfer_buffer.Pass(), buffer_size, source_complete, status);
+  target->DataAvailableInternal();
 }
 
-void ByteStreamReaderImpl::TransferDataInternal(
-    scoped_ptr<ContentVector> transfer_buffer,
-    size_t buffer_size,
-    bool source_complete,
-    int status) {
+void ByteStreamReaderImpl::DataAvailableInternal() {
   DCHECK(my_task_runner_->RunsTasksOnCurrentThread());
 
-  bool was_empty = available_contents_.empty();
+  // Posted on transition from empty to non-empty, or source complete.
+  if (!data_available_callback_.is_null())
+    data_available_callback_.Run();
+}
 
-  if (transfer_buffer) {
+void ByteStreamReaderImpl::PullFromWriter() {
+  ByteStreamSharedState::Batch batch;
+  while (!received_status_ && shared_state_->Pop(&batch)) {
     available_contents_.insert(available_contents_.end(),
-                               transfer_buffer->begin(),
-                               transfer_buffer->end());
-  }
-
-  if (source_complete) {
-    received_status_ = true;
-    status_ = status;
+                               batch.contents.begin(),
+                               batch.contents.end());
+    batch.contents.clear();
+    if (batch.complete) {
+      received_status_ = true;
+      status_ = batch.status;
+    }
   }
-
-  // Callback on transition from empty to non-empty, or
-  // source complete.
-  if (((was_empty && !available_contents_.empty()) ||
-       source_complete) &&
-      !data_available_callback_.is_null())
-    data_available_callback_.Run();
 }
 
-// Decide whether or not to send the input a window update.
+// Decide whether or not to credit the input with consumed bytes.
 // Currently we do that whenever we've got unreported consumption
-// greater than 1/3 of total size.
+// greater than 1/3 of total size; the input is only sent a task if it
+// is blocked waiting for that credit.
 void ByteStreamReaderImpl::MaybeUpdateInput() {
   DCHECK(my_task_runner_->RunsTasksOnCurrentThread());
 
@@ -400,13 +580,16 @@ void ByteStreamReaderImpl::MaybeUpdateInput() {
       total_buffer_size_ / kFractionReadBeforeWindowUpdate)
     return;
 
+  bool writer_blocked = shared_state_->Consume(unreported_consumed_bytes_);
+  unreported_consumed_bytes_ = 0;
+  if (!writer_blocked)
+    return;
+
   peer_task_runner_->PostTask(
       FROM_HERE, base::Bind(
           &ByteStreamWriterImpl::UpdateWindow,
           peer_lifetime_flag_,
-          peer_,
-          unreported_consumed_bytes_));
-  unreported_consumed_bytes_ = 0;
+          peer_));
 }
 
 }  // namespace
@@ -426,11 +609,13 @@ void CreateByteStream(
     scoped_ptr<ByteStreamReader>* output) {
   scoped_refptr<LifetimeFlag> input_flag(new LifetimeFlag());
   scoped_refptr<LifetimeFlag> output_flag(new LifetimeFlag());
+  scoped_refptr<ByteStreamSharedState> shared_state(
+      new ByteStreamSharedState());
 
   ByteStreamWriterImpl* in = new ByteStreamWriterImpl(
-      input_task_runner, input_flag, buffer_size);
+      input_task_runner, input_flag, shared_state, buffer_size);
   ByteStreamReaderImpl* out = new ByteStreamReaderImpl(
-      output_task_runner, output_flag, buffer_size);
+      output_task_runner, output_flag, shared_state, buffer_size);
 
   in->SetPeer(out, output_task_runner, output_flag);
   out->SetPeer(in, input_task_runner, input_flag);
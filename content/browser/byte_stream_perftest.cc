@@ -0,0 +1,142 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "content/browser/byte_stream.h"
+
+#include "base/bind.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread.h"
+#include "net/base/io_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace content {
+
+namespace {
+
+// Matches the stream size used for downloads.
+const size_t kStreamSize = 100 * 1024;
+
+// Pushes |total_bytes| through the stream in |chunk_size| pieces from the
+// source thread, honoring flow control.
+class Source {
+ public:
+  Source(ByteStreamWriter* writer, size_t chunk_size, int64 total_bytes)
+      : writer_(writer),
+        chunk_size_(chunk_size),
+        bytes_left_(total_bytes) {
+    writer_->RegisterCallback(
+        base::Bind(&Source::WriteSome, base::Unretained(this)));
+  }
+
+  void WriteSome() {
+    while (bytes_left_ > 0) {
+      scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(chunk_size_));
+      bytes_left_ -= chunk_size_;
+      if (!writer_->Write(buffer, chunk_size_))
+        return;
+    }
+    writer_->Close(0);
+  }
+
+ private:
+  ByteStreamWriter* writer_;
+  const size_t chunk_size_;
+  int64 bytes_left_;
+
+  DISALLOW_COPY_AND_ASSIGN(Source);
+};
+
+// Drains the stream on the current thread and quits the message loop once
+// the source has closed it.
+class Sink {
+ public:
+  explicit Sink(ByteStreamReader* reader)
+      : reader_(reader),
+        bytes_read_(0),
+        callbacks_(0) {
+    reader_->RegisterCallback(
+        base::Bind(&Sink::ReadAll, base::Unretained(this)));
+  }
+
+  void ReadAll() {
+    ++callbacks_;
+    scoped_refptr<net::IOBuffer> data;
+    size_t length = 0;
+    ByteStreamReader::StreamState state;
+    while (ByteStreamReader::STREAM_HAS_DATA ==
+           (state = reader_->Read(&data, &length))) {
+      bytes_read_ += length;
+    }
+    if (state == ByteStreamReader::STREAM_COMPLETE)
+      base::MessageLoop::current()->Quit();
+  }
+
+  int64 bytes_read() const { return bytes_read_; }
+  int callbacks() const { return callbacks_; }
+
+ private:
+  ByteStreamReader* reader_;
+  int64 bytes_read_;
+  int callbacks_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sink);
+};
+
+}  // namespace
+
+class ByteStreamPerfTest : public testing::Test {
+ public:
+  ByteStreamPerfTest() : source_thread_("ByteStreamPerfTest source") {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(source_thread_.Start());
+  }
+
+  // Moves |total_bytes| from a source thread to this one in |chunk_size|
+  // pieces, as a download does between the IO and FILE threads.
+  void RunTransfer(const char* name, size_t chunk_size, int64 total_bytes) {
+    scoped_ptr<ByteStreamWriter> writer;
+    scoped_ptr<ByteStreamReader> reader;
+    CreateByteStream(source_thread_.message_loop_proxy(),
+                     message_loop_.message_loop_proxy(),
+                     kStreamSize, &writer, &reader);
+    Source source(writer.get(), chunk_size, total_bytes);
+    Sink sink(reader.get());
+
+    PerfTimer timer;
+    source_thread_.message_loop()->PostTask(
+        FROM_HERE, base::Bind(&Source::WriteSome, base::Unretained(&source)));
+    message_loop_.Run();
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    // The writer must be destroyed on its own thread before |source| goes
+    // away.
+    source_thread_.message_loop()->DeleteSoon(FROM_HERE, writer.release());
+    source_thread_.Stop();
+
+    EXPECT_EQ(total_bytes, sink.bytes_read());
+
+    double megabytes = static_cast<double>(total_bytes) / (1024 * 1024);
+    LogPerfResult(base::StringPrintf("%s_throughput", name).c_str(),
+                  megabytes / elapsed.InSecondsF(), "MB/s");
+    LogPerfResult(base::StringPrintf("%s_sink_callbacks", name).c_str(),
+                  sink.callbacks(), "callbacks");
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::Thread source_thread_;
+};
+
+TEST_F(ByteStreamPerfTest, SmallChunks) {
+  RunTransfer("ByteStream_4KB_chunks", 4 * 1024, 256 * 1024 * 1024);
+}
+
+TEST_F(ByteStreamPerfTest, LargeChunks) {
+  RunTransfer("ByteStream_32KB_chunks", 32 * 1024, 1024 * 1024 * 1024);
+}
+
+}  // namespace content
@@ -516,6 +516,110 @@ TEST_F(ByteStreamTest, ByteStream_SourceInterrupt) {
             byte_stream_output->Read(&output_io_buffer, &output_length));
 }
 
+// Confirm that the sink is only notified when it has run dry, not for every
+// batch of data the source sends.
+TEST_F(ByteStreamTest, ByteStream_SinkNotifiedOnlyWhenIdle) {
+  scoped_refptr<base::TestSimpleTaskRunner> task_runner(
+      new base::TestSimpleTaskRunner());
+
+  scoped_ptr<ByteStreamWriter> byte_stream_input;
+  scoped_ptr<ByteStreamReader> byte_stream_output;
+  CreateByteStream(
+      message_loop_.message_loop_proxy(), task_runner,
+      10000, &byte_stream_input, &byte_stream_output);
+
+  scoped_refptr<net::IOBuffer> output_io_buffer;
+  size_t output_length;
+
+  int num_callbacks = 0;
+  byte_stream_output->RegisterCallback(
+      base::Bind(CountCallbacks, &num_callbacks));
+
+  // Two batches sent before the sink gets to run result in one
+  // notification.
+  EXPECT_TRUE(Write(byte_stream_input.get(), 4000));
+  EXPECT_EQ(1u, task_runner->GetPendingTasks().size());
+  EXPECT_TRUE(Write(byte_stream_input.get(), 4000));
+  EXPECT_EQ(1u, task_runner->GetPendingTasks().size());
+  task_runner->RunUntilIdle();
+  EXPECT_EQ(1, num_callbacks);
+
+  EXPECT_EQ(ByteStreamReader::STREAM_HAS_DATA,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+  EXPECT_TRUE(ValidateIOBuffer(output_io_buffer, output_length));
+
+  // A batch that arrives while the sink is still reading doesn't need a
+  // notification either.
+  EXPECT_TRUE(Write(byte_stream_input.get(), 4000));
+  EXPECT_FALSE(task_runner->HasPendingTask());
+
+  EXPECT_EQ(ByteStreamReader::STREAM_HAS_DATA,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+  EXPECT_TRUE(ValidateIOBuffer(output_io_buffer, output_length));
+  EXPECT_EQ(ByteStreamReader::STREAM_HAS_DATA,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+  EXPECT_TRUE(ValidateIOBuffer(output_io_buffer, output_length));
+  EXPECT_EQ(ByteStreamReader::STREAM_EMPTY,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+
+  // Once it has run dry, the next batch wakes it up again.
+  EXPECT_TRUE(Write(byte_stream_input.get(), 4000));
+  EXPECT_EQ(1u, task_runner->GetPendingTasks().size());
+  task_runner->RunUntilIdle();
+  EXPECT_EQ(2, num_callbacks);
+  EXPECT_EQ(ByteStreamReader::STREAM_HAS_DATA,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+  EXPECT_TRUE(ValidateIOBuffer(output_io_buffer, output_length));
+}
+
+// Confirm that the source is not sent window updates while it isn't
+// blocked.
+TEST_F(ByteStreamTest, ByteStream_SourceNotifiedOnlyWhenBlocked) {
+  scoped_refptr<base::TestSimpleTaskRunner> task_runner(
+      new base::TestSimpleTaskRunner());
+
+  scoped_ptr<ByteStreamWriter> byte_stream_input;
+  scoped_ptr<ByteStreamReader> byte_stream_output;
+  CreateByteStream(
+      task_runner, message_loop_.message_loop_proxy(),
+      10000, &byte_stream_input, &byte_stream_output);
+
+  scoped_refptr<net::IOBuffer> output_io_buffer;
+  size_t output_length;
+
+  int num_callbacks = 0;
+  byte_stream_input->RegisterCallback(
+      base::Bind(CountCallbacks, &num_callbacks));
+
+  // Consuming more than a window's worth of data doesn't post anything to
+  // a source that still has room.
+  EXPECT_TRUE(Write(byte_stream_input.get(), 4000));
+  message_loop_.RunUntilIdle();
+  EXPECT_EQ(ByteStreamReader::STREAM_HAS_DATA,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+  EXPECT_TRUE(ValidateIOBuffer(output_io_buffer, output_length));
+  EXPECT_FALSE(task_runner->HasPendingTask());
+
+  // The consumed bytes are still credited, so the source has the whole
+  // buffer available again.
+  EXPECT_TRUE(Write(byte_stream_input.get(), 5000));
+  EXPECT_TRUE(Write(byte_stream_input.get(), 5000));
+  EXPECT_FALSE(Write(byte_stream_input.get(), 1));
+  EXPECT_FALSE(task_runner->HasPendingTask());
+
+  // Once it is blocked, draining the stream wakes it up exactly once.
+  message_loop_.RunUntilIdle();
+  EXPECT_EQ(ByteStreamReader::STREAM_HAS_DATA,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+  EXPECT_TRUE(ValidateIOBuffer(output_io_buffer, output_length));
+  EXPECT_EQ(ByteStreamReader::STREAM_HAS_DATA,
+            byte_stream_output->Read(&output_io_buffer, &output_length));
+  EXPECT_TRUE(ValidateIOBuffer(output_io_buffer, output_length));
+  EXPECT_EQ(1u, task_runner->GetPendingTasks().size());
+  task_runner->RunUntilIdle();
+  EXPECT_EQ(1, num_callbacks);
+}
+
 // Confirm that callback is called on zero data transfer but source
 // complete.
 TEST_F(ByteStreamTest, ByteStream_ZeroCallback) {
@@ -4,12 +4,17 @@
 
 #include "content/browser/download/base_file.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/file_util.h"
 #include "base/format_macros.h"
 #include "base/logging.h"
 #include "base/pickle.h"
 #include "base/strings/stringprintf.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/sequenced_worker_pool.h"
 #include "base/threading/thread_restrictions.h"
 #include "content/browser/download/download_interrupt_reasons_impl.h"
 #include "content/browser/download/download_net_log_parameters.h"
@@ -22,6 +27,85 @@
 
 namespace content {
 
+namespace {
+
+// Chunks smaller than this are hashed inline; handing them to the worker
+// would cost more than it saves.
+const size_t kMinBackgroundHashBytes = 16 * 1024;
+
+// Disk space is reserved once a download passes kMinPreallocationBytes, in
+// steps that grow with the file up to kMaxPreallocationStepBytes.
+const int64 kMinPreallocationBytes = 1024 * 1024;
+const int64 kMaxPreallocationStepBytes = 64 * 1024 * 1024;
+
+}  // namespace
+
+// Maintains the SHA-256 of the file on a worker sequence so that the FILE
+// thread doesn't wait on hashing while it writes.  The FILE thread only
+// touches the hash after waiting for the worker to catch up.
+class BaseFile::Hasher : public base::RefCountedThreadSafe<BaseFile::Hasher> {
+ public:
+  explicit Hasher(scoped_ptr<crypto::SecureHash> secure_hash)
+      : secure_hash_(secure_hash.Pass()),
+        pending_updates_(0),
+        updates_done_(&lock_) {
+    base::SequencedWorkerPool* pool = BrowserThread::GetBlockingPool();
+    task_runner_ = pool->GetSequencedTaskRunnerWithShutdownBehavior(
+        pool->GetSequenceToken(),
+        base::SequencedWorkerPool::BLOCK_SHUTDOWN);
+  }
+
+  // Adds |data| to the hash.
+  void Update(const char* data, size_t data_len) {
+    if (data_len >= kMinBackgroundHashBytes) {
+      scoped_ptr<std::string> copy(new std::string(data, data_len));
+      {
+        base::AutoLock auto_lock(lock_);
+        ++pending_updates_;
+      }
+      if (task_runner_->PostTask(
+              FROM_HERE, base::Bind(&Hasher::UpdateOnWorker, this,
+                                    base::Passed(&copy)))) {
+        return;
+      }
+      // The pool is shutting down; fall back to hashing here.
+      base::AutoLock auto_lock(lock_);
+      --pending_updates_;
+    }
+    Get()->Update(data, data_len);
+  }
+
+  // Waits for all queued updates and returns the hash.  The result may
+  // only be used until the next call to Update().
+  crypto::SecureHash* Get() {
+    base::AutoLock auto_lock(lock_);
+    while (pending_updates_ > 0)
+      updates_done_.Wait();
+    return secure_hash_.get();
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<Hasher>;
+
+  ~Hasher() {}
+
+  void UpdateOnWorker(scoped_ptr<std::string> data) {
+    secure_hash_->Update(data->data(), data->size());
+    base::AutoLock auto_lock(lock_);
+    if (--pending_updates_ == 0)
+      updates_done_.Signal();
+  }
+
+  scoped_ptr<crypto::SecureHash> secure_hash_;
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  base::Lock lock_;
+  int pending_updates_;  // Protected by |lock_|.
+  base::ConditionVariable updates_done_;
+
+  DISALLOW_COPY_AND_ASSIGN(Hasher);
+};
+
 // This will initialize the entire array to zero.
 const unsigned char BaseFile::kEmptySha256Hash[] = { 0 };
 
@@ -41,16 +125,20 @@ BaseFile::BaseFile(const base::FilePath& full_path,
       start_tick_(base::TimeTicks::Now()),
       calculate_hash_(calculate_hash),
       detached_(false),
+      preallocated_bytes_(0),
+      can_preallocate_(true),
       bound_net_log_(bound_net_log) {
   memcpy(sha256_hash_, kEmptySha256Hash, kSha256HashLen);
   if (calculate_hash_) {
-    secure_hash_.reset(crypto::SecureHash::Create(crypto::SecureHash::SHA256));
+    scoped_ptr<crypto::SecureHash> secure_hash(
+        crypto::SecureHash::Create(crypto::SecureHash::SHA256));
     if ((bytes_so_far_ > 0) &&  // Not starting at the beginning.
         (!IsEmptyHash(hash_state_bytes))) {
       Pickle hash_state(hash_state_bytes.c_str(), hash_state_bytes.size());
       PickleIterator data_iterator(hash_state);
-      secure_hash_->Deserialize(&data_iterator);
+      secure_hash->Deserialize(&data_iterator);
     }
+    hasher_ = new Hasher(secure_hash.Pass());
   }
 }
 
@@ -111,6 +199,8 @@ DownloadInterruptReason BaseFile::AppendDataToFile(const char* data,
   if (data_len == 0)
     return DOWNLOAD_INTERRUPT_REASON_NONE;
 
+  EnsurePreallocated(bytes_so_far_ + data_len);
+
   // The Write call below is not guaranteed to write all the data.
   size_t write_count = 0;
   size_t len = data_len;
@@ -143,7 +233,7 @@ DownloadInterruptReason BaseFile::AppendDataToFile(const char* data,
   RecordDownloadWriteLoopCount(write_count);
 
   if (calculate_hash_)
-    secure_hash_->Update(data, data_len);
+    hasher_->Update(data, data_len);
 
   return DOWNLOAD_INTERRUPT_REASON_NONE;
 }
@@ -206,7 +296,7 @@ void BaseFile::Finish() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
 
   if (calculate_hash_)
-    secure_hash_->Finish(sha256_hash_, kSha256HashLen);
+    hasher_->Get()->Finish(sha256_hash_, kSha256HashLen);
 
   Close();
 }
@@ -222,6 +312,13 @@ DownloadInterruptReason BaseFile::AnnotateWithSourceInformation() {
 }
 #endif
 
+// OS_LINUX has a specialized implementation.
+#if !defined(OS_LINUX)
+bool BaseFile::PreallocateSpace(int64 total_bytes) {
+  return false;
+}
+#endif
+
 bool BaseFile::GetHash(std::string* hash) {
   DCHECK(!detached_);
   hash->assign(reinterpret_cast<const char*>(sha256_hash_),
@@ -234,7 +331,7 @@ std::string BaseFile::GetHashState() {
     return std::string();
 
   Pickle hash_state;
-  if (!secure_hash_->Serialize(&hash_state))
+  if (!hasher_->Get()->Serialize(&hash_state))
     return std::string();
 
   return std::string(reinterpret_cast<const char*>(hash_state.data()),
@@ -258,6 +355,24 @@ std::string BaseFile::DebugString() const {
                             detached_ ? 'T' : 'F');
 }
 
+void BaseFile::EnsurePreallocated(int64 bytes_needed) {
+  if (!can_preallocate_ || bytes_needed <= preallocated_bytes_ ||
+      bytes_needed < kMinPreallocationBytes) {
+    return;
+  }
+
+  // Reserve as much again as has been written so far, so the number of
+  // reservations grows logarithmically with the size of the file.
+  int64 target = bytes_needed +
+      std::min(std::max(bytes_so_far_, kMinPreallocationBytes),
+               kMaxPreallocationStepBytes);
+  if (!PreallocateSpace(target)) {
+    can_preallocate_ = false;
+    return;
+  }
+  preallocated_bytes_ = target;
+}
+
 void BaseFile::CreateFileStream() {
   file_stream_.reset(new net::FileStream(bound_net_log_.net_log()));
   file_stream_->SetBoundNetLogSource(bound_net_log_);
@@ -322,6 +437,12 @@ void BaseFile::Close() {
   bound_net_log_.AddEvent(net::NetLog::TYPE_DOWNLOAD_FILE_CLOSED);
 
   if (file_stream_) {
+    // Give back whatever was reserved past the end of the data.  Truncating
+    // to the current size releases those blocks without touching the data.
+    if (preallocated_bytes_ > bytes_so_far_)
+      file_stream_->Truncate(bytes_so_far_);
+    preallocated_bytes_ = 0;
+
 #if defined(OS_CHROMEOS)
     // Currently we don't really care about the return value, since if it fails
     // theres not much we can do.  But we might in the future.
@@ -10,6 +10,7 @@
 #include "base/files/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/linked_ptr.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/time/time.h"
 #include "content/common/content_export.h"
@@ -53,7 +54,9 @@ class CONTENT_EXPORT BaseFile {
   DownloadInterruptReason Initialize(const base::FilePath& default_directory);
 
   // Write a new chunk of data to the file. Returns a DownloadInterruptReason
-  // indicating the result of the operation.
+  // indicating the result of the operation.  Large chunks are hashed on a
+  // worker thread while the next ones are written; the hash is brought up
+  // to date whenever it is read.
   DownloadInterruptReason AppendDataToFile(const char* data, size_t data_len);
 
   // Rename the download file. Returns a DownloadInterruptReason indicating the
@@ -102,6 +105,8 @@ class CONTENT_EXPORT BaseFile {
   friend class BaseFileTest;
   FRIEND_TEST_ALL_PREFIXES(BaseFileTest, IsEmptyHash);
 
+  class Hasher;
+
   // Re-initializes file_stream_ with a newly allocated net::FileStream().
   void CreateFileStream();
 
@@ -120,6 +125,16 @@ class CONTENT_EXPORT BaseFile {
   DownloadInterruptReason MoveFileAndAdjustPermissions(
       const base::FilePath& new_path);
 
+  // Makes sure that at least |bytes_needed| bytes are reserved on disk for
+  // the file, reserving ahead of the writes so that the file system can lay
+  // the file out contiguously.  Reservations are released by Close().
+  void EnsurePreallocated(int64 bytes_needed);
+
+  // Platform specific method that reserves |total_bytes| bytes of disk space
+  // for the file without changing its size.  Returns false if the platform or
+  // file system doesn't support it.
+  bool PreallocateSpace(int64 total_bytes);
+
   // Split out from CurrentSpeed to enable testing.
   int64 CurrentSpeedAtTime(base::TimeTicks current_time) const;
 
@@ -165,7 +180,7 @@ class CONTENT_EXPORT BaseFile {
 
   // Used to calculate hash for the file when calculate_hash_
   // is set.
-  scoped_ptr<crypto::SecureHash> secure_hash_;
+  scoped_refptr<Hasher> hasher_;
 
   unsigned char sha256_hash_[kSha256HashLen];
 
@@ -173,6 +188,11 @@ class CONTENT_EXPORT BaseFile {
   // won't delete it on destruction.
   bool detached_;
 
+  // Total disk space reserved for the file, and whether reserving more is
+  // worth trying.
+  int64 preallocated_bytes_;
+  bool can_preallocate_;
+
   net::BoundNetLog bound_net_log_;
 
   DISALLOW_COPY_AND_ASSIGN(BaseFile);
@@ -4,6 +4,11 @@
 
 #include "content/browser/download/base_file.h"
 
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <unistd.h>
+
+#include "base/posix/eintr_wrapper.h"
 #include "content/browser/download/file_metadata_linux.h"
 #include "content/public/browser/browser_thread.h"
 
@@ -17,4 +22,21 @@ DownloadInterruptReason BaseFile::AnnotateWithSourceInformation() {
   return DOWNLOAD_INTERRUPT_REASON_NONE;
 }
 
+bool BaseFile::PreallocateSpace(int64 total_bytes) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
+
+  // net::FileStream doesn't expose its descriptor, so reserve through a
+  // second one; the reservation belongs to the file, not the descriptor.
+  int fd = HANDLE_EINTR(open(full_path_.value().c_str(), O_WRONLY));
+  if (fd < 0)
+    return false;
+  // FALLOC_FL_KEEP_SIZE leaves the file size alone, so a reservation is
+  // invisible to readers and to the size checks in Open().
+  bool result =
+      HANDLE_EINTR(fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, total_bytes)) == 0;
+  if (HANDLE_EINTR(close(fd)) < 0)
+    result = false;
+  return result;
+}
+
 }  // namespace content
@@ -366,6 +366,36 @@ TEST_F(BaseFileTest, MultipleWritesWithHash) {
   EXPECT_EQ(expected_hash_hex, base::HexEncode(hash.data(), hash.size()));
 }
 
+// Write chunks large enough to be hashed off the FILE thread, mixed with
+// small ones that are hashed inline, and make sure the hash comes out in
+// order.  The total is large enough for disk space to be reserved ahead of
+// the writes; TearDown() checks that the reservation didn't change the
+// file's contents or size.
+TEST_F(BaseFileTest, LargeWritesWithHash) {
+  std::string large_data(256 * 1024, 'x');
+  for (size_t i = 0; i < large_data.size(); i += 1000)
+    large_data[i] = static_cast<char>('a' + (i / 1000) % 26);
+
+  ResetHash();
+  MakeFileWithHash();
+  ASSERT_TRUE(InitializeFile());
+  for (int i = 0; i < 8; ++i) {
+    UpdateHash(large_data.data(), large_data.size());
+    ASSERT_TRUE(AppendDataToFile(large_data));
+    UpdateHash(kTestData1, kTestDataLength1);
+    ASSERT_TRUE(AppendDataToFile(kTestData1));
+    // Intermediate states wait for the background hashing to catch up.
+    EXPECT_STRNE(std::string().c_str(), base_file_->GetHashState().c_str());
+  }
+  std::string expected_hash = GetFinalHash();
+  base_file_->Finish();
+
+  std::string hash;
+  EXPECT_TRUE(base_file_->GetHash(&hash));
+  EXPECT_EQ(base::HexEncode(expected_hash.data(), expected_hash.size()),
+            base::HexEncode(hash.data(), hash.size()));
+}
+
 // Write data to the file multiple times, interrupt it, and continue using
 // another file.  Calculate the resulting combined sha256 hash.
 TEST_F(BaseFileTest, MultipleWritesInterruptedWithHash) {
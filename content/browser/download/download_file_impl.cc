@@ -26,6 +26,9 @@ namespace content {
 const int kUpdatePeriodMs = 500;
 const int kMaxTimeBlockingFileThreadMs = 1000;
 
+// Size of the buffer used to coalesce incoming chunks into file writes.
+const size_t kWriteBufferSize = 512 * 1024;
+
 int DownloadFile::number_active_objects_ = 0;
 
 DownloadFileImpl::DownloadFileImpl(
@@ -48,6 +51,7 @@ DownloadFileImpl::DownloadFileImpl(
                 bound_net_log),
           default_download_directory_(default_download_directory),
           stream_reader_(stream.Pass()),
+          write_buffer_used_(0),
           bytes_seen_(0),
           bound_net_log_(bound_net_log),
           observer_(observer),
@@ -227,7 +231,7 @@ void DownloadFileImpl::StreamActive() {
         {
           ++num_buffers;
           base::TimeTicks write_start(base::TimeTicks::Now());
-          reason = AppendDataToFile(
+          reason = BufferDataForWrite(
               incoming_data.get()->data(), incoming_data_size);
           disk_writes_time_ += (base::TimeTicks::Now() - write_start);
           bytes_seen_ += incoming_data_size;
@@ -238,8 +242,11 @@ void DownloadFileImpl::StreamActive() {
         {
           reason = static_cast<DownloadInterruptReason>(
               stream_reader_->GetStatus());
-          SendUpdate();
           base::TimeTicks close_start(base::TimeTicks::Now());
+          DownloadInterruptReason flush_reason = FlushWriteBuffer();
+          if (reason == DOWNLOAD_INTERRUPT_REASON_NONE)
+            reason = flush_reason;
+          SendUpdate();
           file_.Finish();
           base::TimeTicks now(base::TimeTicks::Now());
           disk_writes_time_ += (now - close_start);
@@ -257,6 +264,17 @@ void DownloadFileImpl::StreamActive() {
            reason == DOWNLOAD_INTERRUPT_REASON_NONE &&
            now - start <= delta);
 
+  // Don't hold on to data between passes, so the file always reflects
+  // everything reported to the observer.
+  if (write_buffer_used_ > 0) {
+    base::TimeTicks write_start(base::TimeTicks::Now());
+    DownloadInterruptReason flush_reason = FlushWriteBuffer();
+    if (reason == DOWNLOAD_INTERRUPT_REASON_NONE)
+      reason = flush_reason;
+    now = base::TimeTicks::Now();
+    disk_writes_time_ += (now - write_start);
+  }
+
   // If we're stopping to yield the thread, post a task so we come back.
   if (state == ByteStreamReader::STREAM_HAS_DATA &&
       now - start > delta) {
@@ -305,6 +323,31 @@ void DownloadFileImpl::StreamActive() {
   }
 }
 
+DownloadInterruptReason DownloadFileImpl::BufferDataForWrite(
+    const char* data, size_t data_len) {
+  if (write_buffer_used_ + data_len > kWriteBufferSize) {
+    DownloadInterruptReason reason = FlushWriteBuffer();
+    if (reason != DOWNLOAD_INTERRUPT_REASON_NONE)
+      return reason;
+  }
+  if (data_len >= kWriteBufferSize)
+    return AppendDataToFile(data, data_len);
+
+  if (!write_buffer_)
+    write_buffer_.reset(new char[kWriteBufferSize]);
+  memcpy(write_buffer_.get() + write_buffer_used_, data, data_len);
+  write_buffer_used_ += data_len;
+  return DOWNLOAD_INTERRUPT_REASON_NONE;
+}
+
+DownloadInterruptReason DownloadFileImpl::FlushWriteBuffer() {
+  if (write_buffer_used_ == 0)
+    return DOWNLOAD_INTERRUPT_REASON_NONE;
+  size_t data_len = write_buffer_used_;
+  write_buffer_used_ = 0;
+  return AppendDataToFile(write_buffer_.get(), data_len);
+}
+
 void DownloadFileImpl::SendUpdate() {
   BrowserThread::PostTask(
       BrowserThread::UI, FROM_HERE,
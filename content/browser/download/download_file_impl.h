@@ -78,6 +78,14 @@ class CONTENT_EXPORT DownloadFileImpl : virtual public DownloadFile {
   // handled.
   void StreamActive();
 
+  // Appends |data| to |write_buffer_|, writing the buffer out first if
+  // |data| doesn't fit.  Chunks too big to buffer are written directly.
+  DownloadInterruptReason BufferDataForWrite(const char* data,
+                                             size_t data_len);
+
+  // Writes out whatever is in |write_buffer_|.
+  DownloadInterruptReason FlushWriteBuffer();
+
   // The base file instance.
   BaseFile file_;
 
@@ -93,6 +101,12 @@ class CONTENT_EXPORT DownloadFileImpl : virtual public DownloadFile {
   // Used to trigger progress updates.
   scoped_ptr<base::RepeatingTimer<DownloadFileImpl> > update_timer_;
 
+  // Chunks read from |stream_reader_| are coalesced here so that the file
+  // sees a few large writes instead of many small ones.  The buffer is
+  // always empty between calls to StreamActive().
+  scoped_ptr<char[]> write_buffer_;
+  size_t write_buffer_used_;
+
   // Statistics
   size_t bytes_seen_;
   base::TimeDelta disk_writes_time_;
@@ -0,0 +1,184 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/bind.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread.h"
+#include "content/browser/browser_thread_impl.h"
+#include "content/browser/byte_stream.h"
+#include "content/browser/download/download_file_impl.h"
+#include "content/browser/download/download_resource_handler.h"
+#include "content/public/browser/download_destination_observer.h"
+#include "content/public/browser/download_save_info.h"
+#include "content/public/browser/power_save_blocker.h"
+#include "net/base/io_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace content {
+
+namespace {
+
+// Stands in for the network: writes |total_bytes| into the stream from its
+// own thread in |chunk_size| pieces, as DownloadResourceHandler does from
+// the IO thread.
+class FakeByteSource {
+ public:
+  FakeByteSource(scoped_ptr<ByteStreamWriter> writer,
+                 size_t chunk_size,
+                 int64 total_bytes)
+      : writer_(writer.Pass()),
+        chunk_size_(chunk_size),
+        bytes_left_(total_bytes) {
+    writer_->RegisterCallback(
+        base::Bind(&FakeByteSource::WriteSome, base::Unretained(this)));
+  }
+
+  void WriteSome() {
+    while (bytes_left_ > 0) {
+      scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(chunk_size_));
+      memset(buffer->data(), static_cast<char>(bytes_left_), chunk_size_);
+      bytes_left_ -= chunk_size_;
+      if (!writer_->Write(buffer, chunk_size_))
+        return;
+    }
+    writer_->Close(DOWNLOAD_INTERRUPT_REASON_NONE);
+  }
+
+  void Destroy() {
+    writer_.reset();
+  }
+
+ private:
+  scoped_ptr<ByteStreamWriter> writer_;
+  const size_t chunk_size_;
+  int64 bytes_left_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeByteSource);
+};
+
+class CompletionObserver : public DownloadDestinationObserver {
+ public:
+  CompletionObserver() : completed_(false), weak_factory_(this) {}
+
+  virtual void DestinationUpdate(int64 bytes_so_far,
+                                 int64 bytes_per_sec,
+                                 const std::string& hash_state) OVERRIDE {}
+
+  virtual void DestinationError(DownloadInterruptReason reason) OVERRIDE {
+    ADD_FAILURE() << "Download interrupted: " << reason;
+    base::MessageLoop::current()->Quit();
+  }
+
+  virtual void DestinationCompleted(const std::string& final_hash) OVERRIDE {
+    completed_ = true;
+    base::MessageLoop::current()->Quit();
+  }
+
+  base::WeakPtr<DownloadDestinationObserver> AsWeakPtr() {
+    return weak_factory_.GetWeakPtr();
+  }
+
+  bool completed() const { return completed_; }
+
+ private:
+  bool completed_;
+  base::WeakPtrFactory<DownloadDestinationObserver> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompletionObserver);
+};
+
+void InitializeCallback(DownloadInterruptReason reason) {
+  EXPECT_EQ(DOWNLOAD_INTERRUPT_REASON_NONE, reason);
+}
+
+}  // namespace
+
+class DownloadFilePerfTest : public testing::Test {
+ public:
+  DownloadFilePerfTest()
+      : ui_thread_(BrowserThread::UI, &message_loop_),
+        file_thread_(BrowserThread::FILE, &message_loop_),
+        source_thread_("DownloadFilePerfTest source") {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    ASSERT_TRUE(source_thread_.Start());
+  }
+
+  // Downloads |total_bytes| from a stand-in source into a file in
+  // |temp_dir_| and logs the throughput.
+  void RunDownload(const char* name,
+                   size_t chunk_size,
+                   int64 total_bytes,
+                   bool calculate_hash) {
+    scoped_ptr<ByteStreamWriter> writer;
+    scoped_ptr<ByteStreamReader> reader;
+    CreateByteStream(source_thread_.message_loop_proxy(),
+                     message_loop_.message_loop_proxy(),
+                     DownloadResourceHandler::kDownloadByteStreamSize,
+                     &writer, &reader);
+    FakeByteSource source(writer.Pass(), chunk_size, total_bytes);
+
+    CompletionObserver observer;
+    scoped_ptr<DownloadSaveInfo> save_info(new DownloadSaveInfo());
+    scoped_ptr<DownloadFile> download_file(
+        new DownloadFileImpl(save_info.Pass(),
+                             temp_dir_.path(),
+                             GURL(),
+                             GURL(),
+                             calculate_hash,
+                             reader.Pass(),
+                             net::BoundNetLog(),
+                             scoped_ptr<PowerSaveBlocker>(),
+                             observer.AsWeakPtr()));
+
+    PerfTimer timer;
+    download_file->Initialize(base::Bind(&InitializeCallback));
+    source_thread_.message_loop()->PostTask(
+        FROM_HERE, base::Bind(&FakeByteSource::WriteSome,
+                              base::Unretained(&source)));
+    message_loop_.Run();
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    EXPECT_TRUE(observer.completed());
+    download_file.reset();
+    source_thread_.message_loop()->PostTask(
+        FROM_HERE, base::Bind(&FakeByteSource::Destroy,
+                              base::Unretained(&source)));
+    source_thread_.Stop();
+    message_loop_.RunUntilIdle();
+
+    double megabytes = static_cast<double>(total_bytes) / (1024 * 1024);
+    LogPerfResult(base::StringPrintf("%s_throughput", name).c_str(),
+                  megabytes / elapsed.InSecondsF(), "MB/s");
+  }
+
+ protected:
+  base::MessageLoopForIO message_loop_;
+  BrowserThreadImpl ui_thread_;
+  BrowserThreadImpl file_thread_;
+  base::Thread source_thread_;
+  base::ScopedTempDir temp_dir_;
+};
+
+TEST_F(DownloadFilePerfTest, SmallChunks) {
+  RunDownload("DownloadFile_4KB_chunks", 4 * 1024, 128 * 1024 * 1024, false);
+}
+
+TEST_F(DownloadFilePerfTest, SmallChunksWithHash) {
+  RunDownload("DownloadFile_4KB_chunks_hash", 4 * 1024, 128 * 1024 * 1024,
+              true);
+}
+
+TEST_F(DownloadFilePerfTest, LargeChunksWithHash) {
+  RunDownload("DownloadFile_32KB_chunks_hash", 32 * 1024, 512 * 1024 * 1024,
+              true);
+}
+
+}  // namespace content
@@ -580,6 +580,23 @@ TEST_F(DownloadFileTest, StreamNonEmptyError) {
   DestroyDownloadFile(0);
 }
 
+// Send a mix of chunks that are coalesced and chunks too large to buffer,
+// and make sure everything lands on disk in order by the end of the pass.
+TEST_F(DownloadFileTest, StreamCoalescesWrites) {
+  ASSERT_TRUE(CreateDownloadFile(0, true));
+
+  std::string medium_chunk(300 * 1024, 'm');
+  std::string large_chunk(600 * 1024, 'l');
+  const char* chunks1[] = {
+    kTestData1, medium_chunk.c_str(), kTestData2, medium_chunk.c_str(),
+    large_chunk.c_str(), kTestData3
+  };
+  AppendDataToFile(chunks1, arraysize(chunks1));
+
+  FinishStream(DOWNLOAD_INTERRUPT_REASON_NONE, true);
+  DestroyDownloadFile(0);
+}
+
 // Send some data, wait 3/4s of a second, run the message loop, and
 // confirm the values the observer received are correct.
 TEST_F(DownloadFileTest, ConfirmUpdate) {
@@ -39,6 +39,8 @@ namespace {
 static int kBufferSize = 1024 * 512;
 static int kMinAllocationSize = 1024 * 4;
 static int kMaxAllocationSize = 1024 * 32;
+// Upper bound for the allocation size when reads keep filling allocations.
+static int kMaxAdaptiveAllocationSize = 1024 * 128;
 
 void GetNumericArg(const std::string& name, int* result) {
   const std::string& value =
@@ -56,6 +58,16 @@ void InitializeResourceBufferConstants() {
   GetNumericArg("resource-buffer-size", &kBufferSize);
   GetNumericArg("resource-buffer-min-allocation-size", &kMinAllocationSize);
   GetNumericArg("resource-buffer-max-allocation-size", &kMaxAllocationSize);
+  GetNumericArg("resource-buffer-max-adaptive-allocation-size",
+                &kMaxAdaptiveAllocationSize);
+
+  // Keep the adaptive bound consistent with the other constants, which may
+  // have been overridden above.
+  kMaxAdaptiveAllocationSize = std::min(kMaxAdaptiveAllocationSize,
+                                        kBufferSize / 4);
+  kMaxAdaptiveAllocationSize = std::max(kMaxAdaptiveAllocationSize,
+                                        kMaxAllocationSize);
+  kMaxAdaptiveAllocationSize -= kMaxAdaptiveAllocationSize % kMinAllocationSize;
 }
 
 int CalcUsedPercentage(int bytes_read, int buffer_size) {
@@ -87,6 +99,7 @@ AsyncResourceHandler::AsyncResourceHandler(
       request_(request),
       rdh_(rdh),
       pending_data_count_(0),
+      pending_data_bytes_(0),
       allocation_size_(0),
       did_defer_(false),
       has_checked_for_sufficient_resources_(false),
@@ -129,9 +142,15 @@ void AsyncResourceHandler::OnFollowRedirect(
 void AsyncResourceHandler::OnDataReceivedACK(int request_id) {
   if (pending_data_count_) {
     --pending_data_count_;
+    pending_data_bytes_ -= pending_data_sizes_.front();
+    pending_data_sizes_.pop();
 
     buffer_->RecycleLeastRecentlyAllocated();
-    if (buffer_->CanAllocate())
+
+    // Wait until at least half of the buffer has been consumed before
+    // resuming, rather than resuming for every ACK with just enough room for
+    // a single small read.
+    if (buffer_->CanAllocate() && pending_data_bytes_ <= kBufferSize / 2)
       ResumeIfDeferred();
   }
 }
@@ -268,10 +287,14 @@ bool AsyncResourceHandler::OnReadCompleted(int request_id, int bytes_read,
       new ResourceMsg_DataReceived(routing_id_, request_id, data_offset,
                                    bytes_read, encoded_data_length));
   ++pending_data_count_;
+  pending_data_bytes_ += bytes_read;
+  pending_data_sizes_.push(bytes_read);
   UMA_HISTOGRAM_CUSTOM_COUNTS(
       "Net.AsyncResourceHandler_PendingDataCount",
       pending_data_count_, 0, 100, 100);
 
+  AdaptAllocationSize(bytes_read);
+
   if (!buffer_->CanAllocate()) {
     UMA_HISTOGRAM_CUSTOM_COUNTS(
         "Net.AsyncResourceHandler_PendingDataCount_WhenFull",
@@ -355,6 +378,22 @@ bool AsyncResourceHandler::EnsureResourceBufferIsInitialized() {
                              kMaxAllocationSize);
 }
 
+void AsyncResourceHandler::AdaptAllocationSize(int bytes_read) {
+  int max_allocation_size = buffer_->max_allocation_size();
+  if (bytes_read == max_allocation_size) {
+    // The network is producing data faster than we hand out space for it, so
+    // use larger allocations and thus fewer DataReceived messages.
+    max_allocation_size = std::min(max_allocation_size * 2,
+                                   kMaxAdaptiveAllocationSize);
+  } else if (bytes_read <= max_allocation_size / 4) {
+    max_allocation_size = std::max(max_allocation_size / 2,
+                                   kMaxAllocationSize);
+  }
+  max_allocation_size -= max_allocation_size % kMinAllocationSize;
+  if (max_allocation_size != buffer_->max_allocation_size())
+    buffer_->SetMaxAllocationSize(max_allocation_size);
+}
+
 void AsyncResourceHandler::ResumeIfDeferred() {
   if (did_defer_) {
     did_defer_ = false;
@@ -5,6 +5,7 @@
 #ifndef CONTENT_BROWSER_LOADER_ASYNC_RESOURCE_HANDLER_H_
 #define CONTENT_BROWSER_LOADER_ASYNC_RESOURCE_HANDLER_H_
 
+#include <queue>
 #include <string>
 
 #include "base/memory/ref_counted.h"
@@ -73,6 +74,10 @@ class AsyncResourceHandler : public ResourceHandler,
   bool EnsureResourceBufferIsInitialized();
   void ResumeIfDeferred();
 
+  // Grows the preferred allocation size while reads keep filling whole
+  // allocations, and shrinks it again once they stop doing so.
+  void AdaptAllocationSize(int bytes_read);
+
   scoped_refptr<ResourceBuffer> buffer_;
   scoped_refptr<ResourceMessageFilter> filter_;
   int routing_id_;
@@ -83,6 +88,13 @@ class AsyncResourceHandler : public ResourceHandler,
   // ACK for. This allows us to avoid having too many messages in flight.
   int pending_data_count_;
 
+  // Number of bytes referenced by those messages, and the size of each in the
+  // order they were sent.  Once the buffer fills up, reading is only resumed
+  // after enough of these bytes have been acknowledged, so that the renderer's
+  // ACKs are effectively coalesced into fewer, larger reads.
+  int pending_data_bytes_;
+  std::queue<int> pending_data_sizes_;
+
   int allocation_size_;
 
   bool did_defer_;
@@ -0,0 +1,224 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/pickle.h"
+#include "base/strings/stringprintf.h"
+#include "content/browser/browser_thread_impl.h"
+#include "content/browser/child_process_security_policy_impl.h"
+#include "content/browser/loader/resource_dispatcher_host_impl.h"
+#include "content/browser/loader/resource_message_filter.h"
+#include "content/common/child_process_host_impl.h"
+#include "content/common/resource_messages.h"
+#include "content/public/browser/resource_context.h"
+#include "content/public/common/process_type.h"
+#include "content/public/test/test_browser_context.h"
+#include "net/url_request/url_request.h"
+#include "net/url_request/url_request_context.h"
+#include "net/url_request/url_request_test_job.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/common/appcache/appcache_interfaces.h"
+
+namespace content {
+
+namespace {
+
+const char kScheme[] = "perf";
+const int kRequestId = 1;
+
+// The body served for every request; set up by the test before the request
+// is started.
+std::string* g_response_data = NULL;
+
+net::URLRequestJob* Factory(net::URLRequest* request,
+                            net::NetworkDelegate* network_delegate,
+                            const std::string& scheme) {
+  return new net::URLRequestTestJob(request,
+                                    network_delegate,
+                                    net::URLRequestTestJob::test_headers(),
+                                    *g_response_data,
+                                    true);
+}
+
+class ContextSelector
+    : public ResourceMessageFilter::URLRequestContextSelector {
+ public:
+  explicit ContextSelector(net::URLRequestContext* request_context)
+      : request_context_(request_context) {}
+
+  virtual net::URLRequestContext* GetRequestContext(
+      ResourceType::Type request_type) OVERRIDE {
+    return request_context_;
+  }
+
+ private:
+  net::URLRequestContext* const request_context_;
+};
+
+// Stands in for a renderer: counts the bytes announced by each DataReceived
+// message and immediately acknowledges it, as ResourceDispatcher does.
+class MockRendererFilter : public ResourceMessageFilter {
+ public:
+  MockRendererFilter(ResourceDispatcherHostImpl* host,
+                     ResourceContext* resource_context)
+      : ResourceMessageFilter(
+            ChildProcessHostImpl::GenerateChildProcessUniqueId(),
+            PROCESS_TYPE_RENDERER,
+            resource_context, NULL, NULL, NULL,
+            new ContextSelector(resource_context->GetRequestContext())),
+        host_(host),
+        bytes_received_(0),
+        data_messages_(0),
+        complete_(false) {
+    OnChannelConnected(base::GetCurrentProcId());
+  }
+
+  // ResourceMessageFilter override
+  virtual bool Send(IPC::Message* msg) OVERRIDE {
+    scoped_ptr<IPC::Message> message(msg);
+    if (msg->type() == ResourceMsg_DataReceived::ID) {
+      PickleIterator iter(*msg);
+      int request_id, data_offset, data_length;
+      EXPECT_TRUE(iter.ReadInt(&request_id));
+      EXPECT_TRUE(iter.ReadInt(&data_offset));
+      EXPECT_TRUE(iter.ReadInt(&data_length));
+      bytes_received_ += data_length;
+      ++data_messages_;
+      base::MessageLoop::current()->PostTask(
+          FROM_HERE,
+          base::Bind(&MockRendererFilter::SendACK, this, msg->routing_id(),
+                     request_id));
+    } else if (msg->type() == ResourceMsg_RequestComplete::ID) {
+      complete_ = true;
+      base::MessageLoop::current()->Quit();
+    }
+    return true;
+  }
+
+  int64 bytes_received() const { return bytes_received_; }
+  int data_messages() const { return data_messages_; }
+  bool complete() const { return complete_; }
+
+ private:
+  virtual ~MockRendererFilter() {}
+
+  void SendACK(int routing_id, int request_id) {
+    ResourceHostMsg_DataReceived_ACK ack(routing_id, request_id);
+    bool msg_was_ok;
+    host_->OnMessageReceived(ack, this, &msg_was_ok);
+  }
+
+  ResourceDispatcherHostImpl* host_;
+  int64 bytes_received_;
+  int data_messages_;
+  bool complete_;
+
+  DISALLOW_COPY_AND_ASSIGN(MockRendererFilter);
+};
+
+}  // namespace
+
+class AsyncResourceHandlerPerfTest : public testing::Test {
+ public:
+  AsyncResourceHandlerPerfTest()
+      : ui_thread_(BrowserThread::UI, &message_loop_),
+        file_thread_(BrowserThread::FILE_USER_BLOCKING, &message_loop_),
+        cache_thread_(BrowserThread::CACHE, &message_loop_),
+        io_thread_(BrowserThread::IO, &message_loop_) {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    browser_context_.reset(new TestBrowserContext());
+    BrowserContext::EnsureResourceContextInitialized(browser_context_.get());
+    message_loop_.RunUntilIdle();
+    filter_ = new MockRendererFilter(
+        &host_, browser_context_->GetResourceContext());
+    ChildProcessSecurityPolicyImpl* policy =
+        ChildProcessSecurityPolicyImpl::GetInstance();
+    policy->Add(filter_->child_id());
+    if (!policy->IsWebSafeScheme(kScheme))
+      policy->RegisterWebSafeScheme(kScheme);
+    old_factory_ = net::URLRequest::Deprecated::RegisterProtocolFactory(
+        kScheme, &Factory);
+  }
+
+  virtual void TearDown() OVERRIDE {
+    net::URLRequest::Deprecated::RegisterProtocolFactory(kScheme,
+                                                         old_factory_);
+    host_.CancelRequestsForProcess(filter_->child_id());
+    host_.Shutdown();
+    ChildProcessSecurityPolicyImpl::GetInstance()->Remove(filter_->child_id());
+    filter_ = NULL;
+    browser_context_.reset();
+    message_loop_.RunUntilIdle();
+    g_response_data = NULL;
+  }
+
+  // Streams a body of |body_size| bytes to the mock renderer and logs the
+  // achieved throughput.
+  void RunTransfer(const char* name, int body_size) {
+    std::string body(body_size, 'x');
+    g_response_data = &body;
+
+    ResourceHostMsg_Request request;
+    request.method = "GET";
+    request.url = GURL(base::StringPrintf("%s:body", kScheme));
+    request.first_party_for_cookies = request.url;
+    request.referrer_policy = WebKit::WebReferrerPolicyDefault;
+    request.load_flags = 0;
+    request.origin_pid = 0;
+    request.resource_type = ResourceType::SUB_RESOURCE;
+    request.request_context = 0;
+    request.appcache_host_id = appcache::kNoHostId;
+    request.download_to_file = false;
+    request.is_main_frame = true;
+    request.frame_id = 0;
+    request.parent_is_main_frame = false;
+    request.parent_frame_id = -1;
+    request.transition_type = PAGE_TRANSITION_LINK;
+    request.allow_download = true;
+
+    PerfTimer timer;
+    ResourceHostMsg_RequestResource msg(0, kRequestId, request);
+    bool msg_was_ok;
+    host_.OnMessageReceived(msg, filter_.get(), &msg_was_ok);
+    message_loop_.Run();
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    ASSERT_TRUE(filter_->complete());
+    EXPECT_EQ(body_size, filter_->bytes_received());
+
+    double megabytes = static_cast<double>(body_size) / (1024 * 1024);
+    LogPerfResult(base::StringPrintf("%s_throughput", name).c_str(),
+                  megabytes / elapsed.InSecondsF(), "MB/s");
+    LogPerfResult(base::StringPrintf("%s_data_messages", name).c_str(),
+                  filter_->data_messages(), "messages");
+  }
+
+ protected:
+  base::MessageLoopForIO message_loop_;
+  BrowserThreadImpl ui_thread_;
+  BrowserThreadImpl file_thread_;
+  BrowserThreadImpl cache_thread_;
+  BrowserThreadImpl io_thread_;
+  scoped_ptr<TestBrowserContext> browser_context_;
+  scoped_refptr<MockRendererFilter> filter_;
+  ResourceDispatcherHostImpl host_;
+  net::URLRequest::ProtocolFactory* old_factory_;
+};
+
+TEST_F(AsyncResourceHandlerPerfTest, SmallBody) {
+  RunTransfer("AsyncResourceHandler_64KB", 64 * 1024);
+}
+
+TEST_F(AsyncResourceHandlerPerfTest, LargeBody) {
+  RunTransfer("AsyncResourceHandler_64MB", 64 * 1024 * 1024);
+}
+
+}  // namespace content
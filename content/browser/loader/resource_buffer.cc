@@ -61,6 +61,14 @@ bool ResourceBuffer::IsInitialized() const {
   return shared_mem_.memory() != NULL;
 }
 
+void ResourceBuffer::SetMaxAllocationSize(int max_allocation_size) {
+  DCHECK(IsInitialized());
+  DCHECK_EQ(0, max_allocation_size % min_alloc_size_);
+  DCHECK_LE(max_allocation_size, buf_size_);
+
+  max_alloc_size_ = max_allocation_size;
+}
+
 bool ResourceBuffer::ShareToProcess(
     base::ProcessHandle process_handle,
     base::SharedMemoryHandle* shared_memory_handle,
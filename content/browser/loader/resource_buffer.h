@@ -71,6 +71,13 @@ class CONTENT_EXPORT ResourceBuffer
                   int max_allocation_size);
   bool IsInitialized() const;
 
+  // Changes the size of the segments preferred by Allocate.  This may be used
+  // to grow or shrink allocations as the rate of incoming data changes.  The
+  // new size must be a multiple of min_allocation_size and must not exceed
+  // the size of the buffer.
+  void SetMaxAllocationSize(int max_allocation_size);
+  int max_allocation_size() const { return max_alloc_size_; }
+
   // Returns a shared memory handle that can be passed to the given process.
   // The shared memory handle is only intended to be interpretted by code
   // running in the specified process.  NOTE: The caller should ensure that
@@ -44,6 +44,28 @@ TEST(ResourceBufferTest, BasicAllocations) {
   }
 }
 
+TEST(ResourceBufferTest, SetMaxAllocationSize) {
+  scoped_refptr<ResourceBuffer> buf = new ResourceBuffer();
+  EXPECT_TRUE(buf->Initialize(100, 5, 10));
+
+  int size;
+  buf->Allocate(&size);
+  EXPECT_EQ(10, size);
+
+  // Larger allocations are handed out once the maximum is raised.
+  buf->SetMaxAllocationSize(40);
+  EXPECT_EQ(40, buf->max_allocation_size());
+  buf->Allocate(&size);
+  EXPECT_EQ(40, size);
+  EXPECT_EQ(10, buf->GetLastAllocationOffset());
+
+  // And smaller ones once it is lowered again.
+  buf->SetMaxAllocationSize(5);
+  buf->Allocate(&size);
+  EXPECT_EQ(5, size);
+  EXPECT_EQ(50, buf->GetLastAllocationOffset());
+}
+
 TEST(ResourceBufferTest, AllocateAndRecycle) {
   scoped_refptr<ResourceBuffer> buf = new ResourceBuffer();
   EXPECT_TRUE(buf->Initialize(100, 5, 10));
@@ -4,6 +4,9 @@
 
 #include "content/browser/loader/resource_scheduler.h"
 
+#include <vector>
+
+#include "base/metrics/histogram.h"
 #include "base/stl_util.h"
 #include "content/common/resource_messages.h"
 #include "content/browser/loader/resource_message_delegate.h"
@@ -21,6 +24,51 @@
 namespace content {
 
 static const size_t kMaxNumDelayableRequestsPerClient = 10;
+static const size_t kMaxNumDelayableRequestsPerHost = 6;
+
+// Transfers smaller than this are dominated by latency rather than bandwidth,
+// so they aren't used to estimate the latter.
+static const int64 kMinBytesForBandwidthSample = 32 * 1024;
+
+// Weight, out of 8, that a new sample has in the bandwidth estimate.
+static const int64 kBandwidthSampleWeight = 2;
+
+// Above this estimate, low priority requests are not expected to slow down
+// critical ones, so they are not held back before the <body> is parsed.
+static const int64 kAmpleBandwidthBps = 20 * 1000 * 1000;
+
+namespace {
+
+void RecordQueueingTime(net::RequestPriority priority,
+                        base::TimeDelta queueing_time) {
+  switch (priority) {
+    case net::IDLE:
+      UMA_HISTOGRAM_TIMES("Net.ResourceScheduler.QueueingTime.Idle",
+                          queueing_time);
+      break;
+    case net::LOWEST:
+      UMA_HISTOGRAM_TIMES("Net.ResourceScheduler.QueueingTime.Lowest",
+                          queueing_time);
+      break;
+    case net::LOW:
+      UMA_HISTOGRAM_TIMES("Net.ResourceScheduler.QueueingTime.Low",
+                          queueing_time);
+      break;
+    case net::MEDIUM:
+      UMA_HISTOGRAM_TIMES("Net.ResourceScheduler.QueueingTime.Medium",
+                          queueing_time);
+      break;
+    case net::HIGHEST:
+      UMA_HISTOGRAM_TIMES("Net.ResourceScheduler.QueueingTime.Highest",
+                          queueing_time);
+      break;
+    default:
+      NOTREACHED();
+      break;
+  }
+}
+
+}  // namespace
 
 // A thin wrapper around net::PriorityQueue that deals with
 // ScheduledResourceRequests instead of PriorityQueue::Pointers.
@@ -58,6 +106,13 @@ class ResourceScheduler::RequestQueue {
   // Returns true if no requests are queued.
   bool IsEmpty() const { return queue_.size() == 0; }
 
+  // Removes and returns the highest priority request that's queued.
+  ScheduledResourceRequest* PopFirstMax() {
+    ScheduledResourceRequest* request = FirstMax();
+    Erase(request);
+    return request;
+  }
+
  private:
   typedef net::PriorityQueue<ScheduledResourceRequest*> NetQueue;
   typedef std::map<ScheduledResourceRequest*, NetQueue::Pointer> PointerMap;
@@ -80,7 +135,8 @@ class ResourceScheduler::ScheduledResourceRequest
         request_(request),
         ready_(false),
         deferred_(false),
-        scheduler_(scheduler) {
+        scheduler_(scheduler),
+        queued_time_(base::TimeTicks::Now()) {
   }
 
   virtual ~ScheduledResourceRequest() {
@@ -88,6 +144,7 @@ class ResourceScheduler::ScheduledResourceRequest
   }
 
   void Start() {
+    start_time_ = base::TimeTicks::Now();
     ready_ = true;
     if (deferred_ && request_->status().is_success()) {
       deferred_ = false;
@@ -98,6 +155,8 @@ class ResourceScheduler::ScheduledResourceRequest
   const ClientId& client_id() const { return client_id_; }
   net::URLRequest* url_request() { return request_; }
   const net::URLRequest* url_request() const { return request_; }
+  base::TimeTicks queued_time() const { return queued_time_; }
+  base::TimeTicks start_time() const { return start_time_; }
 
  private:
   // ResourceMessageDelegate interface:
@@ -125,6 +184,8 @@ class ResourceScheduler::ScheduledResourceRequest
   bool ready_;
   bool deferred_;
   ResourceScheduler* scheduler_;
+  base::TimeTicks queued_time_;
+  base::TimeTicks start_time_;
 
   DISALLOW_COPY_AND_ASSIGN(ScheduledResourceRequest);
 };
@@ -139,7 +200,7 @@ struct ResourceScheduler::Client {
   RequestSet in_flight_requests;
 };
 
-ResourceScheduler::ResourceScheduler() {
+ResourceScheduler::ResourceScheduler() : estimated_bandwidth_bps_(0) {
 }
 
 ResourceScheduler::~ResourceScheduler() {
@@ -168,7 +229,7 @@ scoped_ptr<ResourceThrottle> ResourceScheduler::ScheduleRequest(
   }
 
   Client* client = it->second;
-  if (ShouldStartRequest(request.get(), client)) {
+  if (ShouldStartRequest(request.get(), client) == START_REQUEST) {
     StartRequest(request.get(), client);
   } else {
     client->pending_requests.Insert(request.get(), url_request->priority());
@@ -197,6 +258,8 @@ void ResourceScheduler::RemoveRequest(ScheduledResourceRequest* request) {
     size_t erased = client->in_flight_requests.erase(request);
     DCHECK(erased);
 
+    AddBandwidthSample(request);
+
     // Removing this request may have freed up another to load.
     LoadAnyStartablePendingRequests(client);
   }
@@ -266,6 +329,8 @@ void ResourceScheduler::StartRequest(ScheduledResourceRequest* request,
                                      Client* client) {
   client->in_flight_requests.insert(request);
   request->Start();
+  RecordQueueingTime(request->url_request()->priority(),
+                     request->start_time() - request->queued_time());
 }
 
 void ResourceScheduler::ReprioritizeRequest(ScheduledResourceRequest* request,
@@ -296,34 +361,68 @@ void ResourceScheduler::ReprioritizeRequest(ScheduledResourceRequest* request,
 }
 
 void ResourceScheduler::LoadAnyStartablePendingRequests(Client* client) {
+  // Requests which are only held back by the per-host limit are set aside, so
+  // that requests to other hosts queued behind them still get a chance to
+  // start. Afterwards they are queued again, ahead of the requests which were
+  // behind them, so that the order within each priority is preserved.
+  std::vector<ScheduledResourceRequest*> skipped_requests;
   while (!client->pending_requests.IsEmpty()) {
     ScheduledResourceRequest* request = client->pending_requests.FirstMax();
-    if (ShouldStartRequest(request, client)) {
+    ShouldStartReqResult result = ShouldStartRequest(request, client);
+    if (result == START_REQUEST) {
       client->pending_requests.Erase(request);
       StartRequest(request, client);
+    } else if (result == DO_NOT_START_REQUEST_AND_KEEP_SEARCHING) {
+      skipped_requests.push_back(client->pending_requests.PopFirstMax());
     } else {
       break;
     }
   }
+
+  if (skipped_requests.empty())
+    return;
+
+  while (!client->pending_requests.IsEmpty())
+    skipped_requests.push_back(client->pending_requests.PopFirstMax());
+  for (size_t i = 0; i < skipped_requests.size(); ++i) {
+    client->pending_requests.Insert(
+        skipped_requests[i], skipped_requests[i]->url_request()->priority());
+  }
 }
 
 size_t ResourceScheduler::GetNumDelayableRequestsInFlight(
-    Client* client) const {
+    Client* client,
+    const net::HostPortPair& active_request_host,
+    size_t* total_delayable_count_for_host) const {
   size_t count = 0;
+  *total_delayable_count_for_host = 0;
   for (RequestSet::iterator it = client->in_flight_requests.begin();
        it != client->in_flight_requests.end(); ++it) {
-    if ((*it)->url_request()->priority() < net::LOW) {
-      const net::HttpServerProperties& http_server_properties =
-          *(*it)->url_request()->context()->http_server_properties();
-      if (!http_server_properties.SupportsSpdy(
-          net::HostPortPair::FromURL((*it)->url_request()->url()))) {
-        ++count;
+    const net::URLRequest& url_request = *(*it)->url_request();
+    if (url_request.priority() < net::LOW && !IsMultiplexed(url_request)) {
+      ++count;
+      if (net::HostPortPair::FromURL(url_request.url()).Equals(
+              active_request_host)) {
+        ++(*total_delayable_count_for_host);
       }
     }
   }
   return count;
 }
 
+bool ResourceScheduler::IsMultiplexed(
+    const net::URLRequest& url_request) const {
+  const net::HttpServerProperties& http_server_properties =
+      *url_request.context()->http_server_properties();
+  net::HostPortPair host_port_pair =
+      net::HostPortPair::FromURL(url_request.url());
+  if (http_server_properties.SupportsSpdy(host_port_pair))
+    return true;
+  return http_server_properties.HasAlternateProtocol(host_port_pair) &&
+      http_server_properties.GetAlternateProtocol(host_port_pair).protocol ==
+          net::QUIC;
+}
+
 // ShouldStartRequest is the main scheduling algorithm.
 //
 // Requests are categorized into two categories:
@@ -332,7 +431,8 @@ size_t ResourceScheduler::GetNumDelayableRequestsInFlight(
 //
 //   * Higher priority requests (>= net::LOW).
 //   * Synchronous requests.
-//   * Requests to SPDY-capable origin servers.
+//   * Requests to SPDY-capable or QUIC-capable origin servers, which share a
+//     single multiplexed connection.
 //
 // 2. The remainder are delayable requests, which follow these rules:
 //
@@ -340,39 +440,62 @@ size_t ResourceScheduler::GetNumDelayableRequestsInFlight(
 //     requests.
 //   * Once the renderer has a <body>, start loading delayable requests.
 //   * Never exceed 10 delayable requests in flight per client.
-//   * Prior to <body>, allow one delayable request to load at a time.
-bool ResourceScheduler::ShouldStartRequest(ScheduledResourceRequest* request,
-                                           Client* client) const {
+//   * Never exceed 6 delayable requests in flight per host, per client.
+//   * Prior to <body>, allow one delayable request to load at a time, unless
+//     the bandwidth estimate shows that delayable requests won't compete with
+//     the high priority ones.
+ResourceScheduler::ShouldStartReqResult ResourceScheduler::ShouldStartRequest(
+    ScheduledResourceRequest* request,
+    Client* client) const {
   const net::URLRequest& url_request = *request->url_request();
-  const net::HttpServerProperties& http_server_properties =
-      *url_request.context()->http_server_properties();
-
-  // TODO(willchan): We should really improve this algorithm as described in
-  // crbug.com/164101. Also, theoretically we should not count a SPDY request
-  // against the delayable requests limit.
-  bool origin_supports_spdy = http_server_properties.SupportsSpdy(
-      net::HostPortPair::FromURL(url_request.url()));
 
   if (url_request.priority() >= net::LOW ||
       !ResourceRequestInfo::ForRequest(&url_request)->IsAsync() ||
-      origin_supports_spdy) {
-    return true;
+      IsMultiplexed(url_request)) {
+    return START_REQUEST;
   }
 
-  size_t num_delayable_requests_in_flight =
-      GetNumDelayableRequestsInFlight(client);
+  size_t num_delayable_requests_in_flight_for_host = 0;
+  size_t num_delayable_requests_in_flight = GetNumDelayableRequestsInFlight(
+      client, net::HostPortPair::FromURL(url_request.url()),
+      &num_delayable_requests_in_flight_for_host);
   if (num_delayable_requests_in_flight >= kMaxNumDelayableRequestsPerClient) {
-    return false;
+    return DO_NOT_START_REQUEST_AND_STOP_SEARCHING;
   }
 
   bool have_immediate_requests_in_flight =
       client->in_flight_requests.size() > num_delayable_requests_in_flight;
   if (have_immediate_requests_in_flight && !client->has_body &&
-      num_delayable_requests_in_flight != 0) {
-    return false;
+      num_delayable_requests_in_flight != 0 &&
+      estimated_bandwidth_bps_ < kAmpleBandwidthBps) {
+    return DO_NOT_START_REQUEST_AND_STOP_SEARCHING;
   }
 
-  return true;
+  if (num_delayable_requests_in_flight_for_host >=
+      kMaxNumDelayableRequestsPerHost) {
+    return DO_NOT_START_REQUEST_AND_KEEP_SEARCHING;
+  }
+
+  return START_REQUEST;
+}
+
+void ResourceScheduler::AddBandwidthSample(ScheduledResourceRequest* request) {
+  int64 bytes = request->url_request()->received_response_content_length();
+  base::TimeDelta duration = base::TimeTicks::Now() - request->start_time();
+  if (bytes < kMinBytesForBandwidthSample || duration <= base::TimeDelta())
+    return;
+
+  int64 sample_bps = bytes * 8 * base::Time::kMicrosecondsPerSecond /
+      duration.InMicroseconds();
+  UMA_HISTOGRAM_COUNTS("Net.ResourceScheduler.TransferBandwidthKbps",
+                       sample_bps / 1000);
+  if (!estimated_bandwidth_bps_) {
+    estimated_bandwidth_bps_ = sample_bps;
+    return;
+  }
+  estimated_bandwidth_bps_ =
+      (estimated_bandwidth_bps_ * (8 - kBandwidthSampleWeight) +
+       sample_bps * kBandwidthSampleWeight) / 8;
 }
 
 ResourceScheduler::ClientId ResourceScheduler::MakeClientId(
@@ -12,11 +12,13 @@
 #include "base/compiler_specific.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/threading/non_thread_safe.h"
+#include "base/time/time.h"
 #include "content/common/content_export.h"
 #include "net/base/priority_queue.h"
 #include "net/base/request_priority.h"
 
 namespace net {
+class HostPortPair;
 class URLRequest;
 }
 
@@ -49,6 +51,11 @@ class ResourceThrottle;
 // The scheduler may defer issuing the request via the ResourceThrottle
 // interface or it may alter the request's priority by calling set_priority() on
 // the URLRequest.
+//
+// The scheduler also keeps a rough estimate of the available bandwidth, based
+// on the throughput of completed transfers. Low priority requests are only
+// held back for higher priority ones while that estimate suggests they would
+// actually compete for bandwidth.
 class CONTENT_EXPORT ResourceScheduler : public base::NonThreadSafe {
  public:
   ResourceScheduler();
@@ -77,6 +84,14 @@ class CONTENT_EXPORT ResourceScheduler : public base::NonThreadSafe {
   // resource loads won't interfere with first paint.
   void OnWillInsertBody(int child_id, int route_id);
 
+  // Returns the current bandwidth estimate in bits per second, or 0 if no
+  // transfer large enough to measure has completed yet.
+  int64 estimated_bandwidth_bps() const { return estimated_bandwidth_bps_; }
+
+  void SetEstimatedBandwidthForTesting(int64 bandwidth_bps) {
+    estimated_bandwidth_bps_ = bandwidth_bps;
+  }
+
  private:
   class RequestQueue;
   class ScheduledResourceRequest;
@@ -86,6 +101,16 @@ class CONTENT_EXPORT ResourceScheduler : public base::NonThreadSafe {
   typedef std::map<ClientId, Client*> ClientMap;
   typedef std::set<ScheduledResourceRequest*> RequestSet;
 
+  enum ShouldStartReqResult {
+    // The request may not start, and neither may any request queued behind
+    // it.
+    DO_NOT_START_REQUEST_AND_STOP_SEARCHING,
+    // The request may not start, but requests to other hosts queued behind it
+    // might.
+    DO_NOT_START_REQUEST_AND_KEEP_SEARCHING,
+    START_REQUEST,
+  };
+
   // Called when a ScheduledResourceRequest is destroyed.
   void RemoveRequest(ScheduledResourceRequest* request);
 
@@ -106,19 +131,36 @@ class CONTENT_EXPORT ResourceScheduler : public base::NonThreadSafe {
   void LoadAnyStartablePendingRequests(Client* client);
 
   // Returns the number of requests with priority < LOW that are currently in
-  // flight.
-  size_t GetNumDelayableRequestsInFlight(Client* client) const;
-
-  // Returns true if the request should start. This is the core scheduling
+  // flight to origins which don't multiplex requests over a single connection.
+  // Of those, the number to |active_request_host| is returned in
+  // |total_delayable_count_for_host|.
+  size_t GetNumDelayableRequestsInFlight(
+      Client* client,
+      const net::HostPortPair& active_request_host,
+      size_t* total_delayable_count_for_host) const;
+
+  // Returns true if requests to |url| are carried by a multiplexed session
+  // (SPDY or QUIC), so they don't count against the per-host limits.
+  bool IsMultiplexed(const net::URLRequest& url_request) const;
+
+  // Returns whether the request should start. This is the core scheduling
   // algorithm.
-  bool ShouldStartRequest(ScheduledResourceRequest* request,
-                          Client* client) const;
+  ShouldStartReqResult ShouldStartRequest(ScheduledResourceRequest* request,
+                                          Client* client) const;
+
+  // Updates the bandwidth estimate with the transfer made by |request|, which
+  // has just finished.
+  void AddBandwidthSample(ScheduledResourceRequest* request);
 
   // Returns the client ID for the given |child_id| and |route_id| combo.
   ClientId MakeClientId(int child_id, int route_id);
 
   ClientMap client_map_;
   RequestSet unowned_requests_;
+
+  // Exponentially weighted moving average of the throughput of completed
+  // transfers, in bits per second. 0 if unknown.
+  int64 estimated_bandwidth_bps_;
 };
 
 }  // namespace content
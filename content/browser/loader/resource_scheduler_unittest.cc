@@ -321,7 +321,7 @@ TEST_F(ResourceSchedulerTest, LimitedNumberOfDelayableRequestsInFlight) {
   const int kMaxNumDelayableRequestsPerClient = 10;  // Should match the .cc.
   ScopedVector<TestRequest> lows;
   for (int i = 0; i < kMaxNumDelayableRequestsPerClient; ++i) {
-    string url = "http://host/low" + base::IntToString(i);
+    string url = "http://host" + base::IntToString(i) + "/low";
     lows.push_back(NewRequest(url.c_str(), net::LOWEST));
     EXPECT_TRUE(lows[i]->started());
   }
@@ -363,7 +363,7 @@ TEST_F(ResourceSchedulerTest, RaisePriorityInQueue) {
   const int kMaxNumDelayableRequestsPerClient = 10;  // Should match the .cc.
   ScopedVector<TestRequest> lows;
   for (int i = 0; i < kMaxNumDelayableRequestsPerClient - 1; ++i) {
-    string url = "http://host/low" + base::IntToString(i);
+    string url = "http://host" + base::IntToString(i) + "/low";
     lows.push_back(NewRequest(url.c_str(), net::LOWEST));
   }
 
@@ -392,7 +392,7 @@ TEST_F(ResourceSchedulerTest, LowerPriority) {
   const int kNumFillerRequests = kMaxNumDelayableRequestsPerClient - 2;
   ScopedVector<TestRequest> lows;
   for (int i = 0; i < kNumFillerRequests; ++i) {
-    string url = "http://host/low" + base::IntToString(i);
+    string url = "http://host" + base::IntToString(i) + "/low";
     lows.push_back(NewRequest(url.c_str(), net::LOWEST));
   }
 
@@ -414,7 +414,7 @@ TEST_F(ResourceSchedulerTest, ReprioritizedRequestGoesToBackOfQueue) {
   const int kMaxNumDelayableRequestsPerClient = 10;  // Should match the .cc.
   ScopedVector<TestRequest> lows;
   for (int i = 0; i < kMaxNumDelayableRequestsPerClient; ++i) {
-    string url = "http://host/low" + base::IntToString(i);
+    string url = "http://host" + base::IntToString(i) + "/low";
     lows.push_back(NewRequest(url.c_str(), net::LOWEST));
   }
 
@@ -431,6 +431,141 @@ TEST_F(ResourceSchedulerTest, ReprioritizedRequestGoesToBackOfQueue) {
   EXPECT_FALSE(idle->started());
 }
 
+TEST_F(ResourceSchedulerTest, LimitedNumberOfDelayableRequestsPerHost) {
+  scheduler_.OnWillInsertBody(kChildId, kRouteId);
+
+  const int kMaxNumDelayableRequestsPerHost = 6;  // Should match the .cc.
+  ScopedVector<TestRequest> lows;
+  for (int i = 0; i < kMaxNumDelayableRequestsPerHost; ++i) {
+    string url = "http://host/low" + base::IntToString(i);
+    lows.push_back(NewRequest(url.c_str(), net::LOWEST));
+    EXPECT_TRUE(lows[i]->started());
+  }
+
+  // The host is saturated, but requests to other hosts queued behind the
+  // blocked one may still start.
+  scoped_ptr<TestRequest> blocked(NewRequest("http://host/last", net::LOWEST));
+  scoped_ptr<TestRequest> other(NewRequest("http://other/1", net::LOWEST));
+  EXPECT_FALSE(blocked->started());
+  EXPECT_TRUE(other->started());
+
+  lows.erase(lows.begin());
+  EXPECT_TRUE(blocked->started());
+}
+
+TEST_F(ResourceSchedulerTest, HostLimitedRequestsKeepTheirOrder) {
+  scheduler_.OnWillInsertBody(kChildId, kRouteId);
+
+  const int kMaxNumDelayableRequestsPerHost = 6;  // Should match the .cc.
+  ScopedVector<TestRequest> lows;
+  for (int i = 0; i < kMaxNumDelayableRequestsPerHost; ++i) {
+    string url = "http://host/low" + base::IntToString(i);
+    lows.push_back(NewRequest(url.c_str(), net::LOWEST));
+  }
+
+  scoped_ptr<TestRequest> first(NewRequest("http://host/first", net::LOWEST));
+  scoped_ptr<TestRequest> second(NewRequest("http://host/second",
+                                            net::LOWEST));
+  EXPECT_FALSE(first->started());
+  EXPECT_FALSE(second->started());
+
+  // Starting a request to another host shuffles the queue internally; the
+  // host-limited requests must still be served first-come, first-served.
+  scoped_ptr<TestRequest> other(NewRequest("http://other/1", net::LOWEST));
+  other.reset();
+
+  lows.erase(lows.begin());
+  EXPECT_TRUE(first->started());
+  EXPECT_FALSE(second->started());
+}
+
+TEST_F(ResourceSchedulerTest, QuicRequestsBypassHostLimit) {
+  http_server_properties_.SetAlternateProtocol(
+      net::HostPortPair("quichost", 80), 443, net::QUIC);
+
+  scoped_ptr<TestRequest> high(NewRequest("http://host/high", net::HIGHEST));
+  scoped_ptr<TestRequest> low(NewRequest("http://host/low", net::LOWEST));
+  scoped_ptr<TestRequest> low_quic(
+      NewRequest("http://quichost/low", net::LOWEST));
+  scoped_ptr<TestRequest> low2(NewRequest("http://host/low2", net::LOWEST));
+  EXPECT_TRUE(high->started());
+  EXPECT_TRUE(low->started());
+  EXPECT_TRUE(low_quic->started());
+  EXPECT_FALSE(low2->started());
+}
+
+TEST_F(ResourceSchedulerTest, AmpleBandwidthDoesNotDelayLowRequests) {
+  scheduler_.SetEstimatedBandwidthForTesting(100 * 1000 * 1000);
+
+  scoped_ptr<TestRequest> high(NewRequest("http://host/high", net::HIGHEST));
+  scoped_ptr<TestRequest> low(NewRequest("http://host/low", net::LOWEST));
+  scoped_ptr<TestRequest> low2(NewRequest("http://host/low2", net::LOWEST));
+  EXPECT_TRUE(high->started());
+  EXPECT_TRUE(low->started());
+  EXPECT_TRUE(low2->started());
+}
+
+// Simulates the load of a page with a few critical resources and many images
+// spread over several hosts, completing requests in the order they started,
+// and checks that the scheduler never exceeds its limits and eventually
+// starts everything.
+TEST_F(ResourceSchedulerTest, SimulatedPageLoad) {
+  const size_t kMaxNumDelayableRequestsPerClient = 10;  // Should match the .cc.
+  const size_t kMaxNumDelayableRequestsPerHost = 6;  // Should match the .cc.
+  const int kNumHosts = 3;
+  const int kNumImages = 60;
+
+  ScopedVector<TestRequest> requests;
+  requests.push_back(NewRequest("http://host0/doc.css", net::HIGHEST));
+  requests.push_back(NewRequest("http://host0/app.js", net::MEDIUM));
+  for (int i = 0; i < kNumImages; ++i) {
+    string url = "http://host" + base::IntToString(i % kNumHosts) + "/img" +
+        base::IntToString(i);
+    requests.push_back(NewRequest(url.c_str(), net::LOWEST));
+  }
+
+  // Until the body is inserted only one image may load next to the critical
+  // requests.
+  size_t num_started = 0;
+  for (size_t i = 0; i < requests.size(); ++i)
+    num_started += requests[i]->started() ? 1 : 0;
+  EXPECT_EQ(3u, num_started);
+
+  scheduler_.OnWillInsertBody(kChildId, kRouteId);
+
+  while (true) {
+    std::map<std::string, size_t> in_flight_per_host;
+    size_t delayable_in_flight = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+      if (!requests[i] || !requests[i]->started() ||
+          requests[i]->url_request()->priority() >= net::LOW) {
+        continue;
+      }
+      ++delayable_in_flight;
+      ++in_flight_per_host[requests[i]->url_request()->url().host()];
+    }
+    EXPECT_LE(delayable_in_flight, kMaxNumDelayableRequestsPerClient);
+    for (std::map<std::string, size_t>::const_iterator it =
+             in_flight_per_host.begin();
+         it != in_flight_per_host.end(); ++it) {
+      EXPECT_LE(it->second, kMaxNumDelayableRequestsPerHost) << it->first;
+    }
+
+    // Complete the oldest request which has started.
+    size_t i = 0;
+    while (i < requests.size() && (!requests[i] || !requests[i]->started()))
+      ++i;
+    if (i == requests.size())
+      break;
+    delete requests[i];
+    requests[i] = NULL;
+  }
+
+  // Every request must have been started, and thus completed.
+  for (size_t i = 0; i < requests.size(); ++i)
+    EXPECT_TRUE(requests[i] == NULL) << i;
+}
+
 }  // unnamed namespace
 
 }  // namespace content
@@ -35,6 +35,7 @@ IPC_STRUCT_TRAITS_BEGIN(tracked_objects::DeathDataSnapshot)
   IPC_STRUCT_TRAITS_MEMBER(queue_duration_sum)
   IPC_STRUCT_TRAITS_MEMBER(queue_duration_max)
   IPC_STRUCT_TRAITS_MEMBER(queue_duration_sample)
+  IPC_STRUCT_TRAITS_MEMBER(queue_duration_histogram)
 IPC_STRUCT_TRAITS_END()
 
 IPC_STRUCT_TRAITS_BEGIN(tracked_objects::TaskSnapshot)
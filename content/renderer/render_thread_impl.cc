@@ -413,6 +413,7 @@ void RenderThreadImpl::Init() {
 
   memory_pressure_listener_.reset(new base::MemoryPressureListener(
       base::Bind(&RenderThreadImpl::OnMemoryPressure, base::Unretained(this))));
+  base::DiscardableMemory::RegisterMemoryPressureListeners();
 
   TRACE_EVENT_END_ETW("RenderThreadImpl::Init", 0, "");
 }
@@ -466,6 +467,8 @@ void RenderThreadImpl::Shutdown() {
   if (webkit_platform_support_)
     WebKit::shutdown();
 
+  base::DiscardableMemory::UnregisterMemoryPressureListeners();
+
   lazy_tls.Pointer()->Set(NULL);
 
   // TODO(port)
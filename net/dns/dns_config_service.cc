@@ -20,6 +20,7 @@ DnsConfig::DnsConfig()
       timeout(base::TimeDelta::FromSeconds(kDnsTimeoutSeconds)),
       attempts(2),
       rotate(false),
+      parallel_attempts(1),
       edns0(false) {}
 
 DnsConfig::~DnsConfig() {}
@@ -36,6 +37,7 @@ bool DnsConfig::EqualsIgnoreHosts(const DnsConfig& d) const {
          (timeout == d.timeout) &&
          (attempts == d.attempts) &&
          (rotate == d.rotate) &&
+         (parallel_attempts == d.parallel_attempts) &&
          (edns0 == d.edns0);
 }
 
@@ -47,6 +49,7 @@ void DnsConfig::CopyIgnoreHosts(const DnsConfig& d) {
   timeout = d.timeout;
   attempts = d.attempts;
   rotate = d.rotate;
+  parallel_attempts = d.parallel_attempts;
   edns0 = d.edns0;
 }
 
@@ -68,6 +71,7 @@ base::Value* DnsConfig::ToValue() const {
   dict->SetDouble("timeout", timeout.InSecondsF());
   dict->SetInteger("attempts", attempts);
   dict->SetBoolean("rotate", rotate);
+  dict->SetInteger("parallel_attempts", parallel_attempts);
   dict->SetBoolean("edns0", edns0);
   dict->SetInteger("num_hosts", hosts.size());
 
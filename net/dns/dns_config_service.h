@@ -77,6 +77,9 @@ struct NET_EXPORT_PRIVATE DnsConfig {
   int attempts;
   // Round robin entries in |nameservers| for subsequent requests.
   bool rotate;
+  // Number of the healthiest |nameservers| queried at once on the first
+  // attempt for each name. The first response wins. Not part of resolv.conf.
+  int parallel_attempts;
   // Enable EDNS0 extensions.
   bool edns0;
 };
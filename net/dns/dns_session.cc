@@ -4,6 +4,9 @@
 
 #include "net/dns/dns_session.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/lazy_instance.h"
@@ -16,6 +19,7 @@
 #include "net/base/net_errors.h"
 #include "net/dns/dns_config_service.h"
 #include "net/dns/dns_socket_pool.h"
+#include "net/dns/dns_tcp_connection.h"
 #include "net/socket/stream_socket.h"
 #include "net/udp/datagram_client_socket.h"
 
@@ -121,7 +125,7 @@ unsigned DnsSession::NextGoodServerIndex(unsigned server_index) {
     base::Time cur_server_failure = server_stats_[index]->last_failure;
     // If number of failures on this server doesn't exceed number of allowed
     // attempts, return its index.
-    if (server_stats_[server_index]->last_failure_count < config_.attempts) {
+    if (server_stats_[index]->last_failure_count < config_.attempts) {
       return index;
     }
     // Track oldest failed server.
@@ -137,6 +141,27 @@ unsigned DnsSession::NextGoodServerIndex(unsigned server_index) {
   return oldest_server_failure_index;
 }
 
+void DnsSession::GetBestServerIndices(unsigned count,
+                                      std::vector<unsigned>* server_indices) {
+  // Failures beyond the allowed attempts all rank the same, so that a server
+  // that has been down for a while is not ranked below one that just went
+  // down. Ties keep the configured order.
+  typedef std::pair<std::pair<int, int64>, unsigned> RankedServer;
+  std::vector<RankedServer> ranked;
+  for (unsigned index = 0; index < server_stats_.size(); ++index) {
+    const ServerStats& stats = *server_stats_[index];
+    ranked.push_back(RankedServer(
+        std::make_pair(std::min(stats.last_failure_count, config_.attempts),
+                       stats.rtt_estimate.ToInternalValue()),
+        index));
+  }
+  std::sort(ranked.begin(), ranked.end());
+
+  server_indices->clear();
+  for (size_t i = 0; i < ranked.size() && i < count; ++i)
+    server_indices->push_back(ranked[i].second);
+}
+
 void DnsSession::RecordServerFailure(unsigned server_index) {
   UMA_HISTOGRAM_CUSTOM_COUNTS(
       "AsyncDNS.ServerFailureIndex", server_index, 0, 10, 10);
@@ -238,6 +263,33 @@ scoped_ptr<StreamSocket> DnsSession::CreateTCPSocket(
   return socket_pool_->CreateTCPSocket(server_index, source);
 }
 
+DnsTCPConnection* DnsSession::GetTCPConnection(unsigned server_index,
+                                               uint16 query_id,
+                                               const NetLog::Source& source) {
+  DnsTCPConnection* connection = NULL;
+  for (ScopedVector<DnsTCPConnection>::iterator it = tcp_connections_.begin();
+       it != tcp_connections_.end(); ) {
+    if ((*it)->IsDead()) {
+      // The server closed it, or it failed. Nobody else refers to it.
+      delete *it;
+      it = tcp_connections_.weak_erase(it);
+      continue;
+    }
+    if (!connection && (*it)->server_index() == server_index &&
+        (*it)->CanSendQuery(query_id)) {
+      connection = *it;
+    }
+    ++it;
+  }
+  if (connection)
+    return connection;
+
+  scoped_ptr<StreamSocket> socket(CreateTCPSocket(server_index, source));
+  connection = new DnsTCPConnection(server_index, socket.Pass());
+  tcp_connections_.push_back(connection);
+  return connection;
+}
+
 // Release a socket.
 void DnsSession::FreeSocket(unsigned server_index,
                             scoped_ptr<DatagramClientSocket> socket) {
@@ -27,6 +27,7 @@ namespace net {
 
 class ClientSocketFactory;
 class DatagramClientSocket;
+class DnsTCPConnection;
 class NetLog;
 class StreamSocket;
 
@@ -77,6 +78,12 @@ class NET_EXPORT_PRIVATE DnsSession
   // or have failed longer time ago.
   unsigned NextGoodServerIndex(unsigned server_index);
 
+  // Fills |server_indices| with the indices of at most |count| servers, best
+  // first. Servers that have failed fewer times in a row rank higher, and
+  // among those the ones with the lower RTT estimate.
+  void GetBestServerIndices(unsigned count,
+                            std::vector<unsigned>* server_indices);
+
   // Record that server failed to respond (due to SRV_FAIL or timeout).
   void RecordServerFailure(unsigned server_index);
 
@@ -106,6 +113,13 @@ class NET_EXPORT_PRIVATE DnsSession
   scoped_ptr<StreamSocket> CreateTCPSocket(unsigned server_index,
                                            const NetLog::Source& source);
 
+  // Returns a TCP connection to the server that can carry a query with
+  // |query_id|, reusing an open one when possible. The connection is owned by
+  // the session and lives as long as it.
+  DnsTCPConnection* GetTCPConnection(unsigned server_index,
+                                     uint16 query_id,
+                                     const NetLog::Source& source);
+
  private:
   friend class base::RefCounted<DnsSession>;
   ~DnsSession();
@@ -133,6 +147,9 @@ class NET_EXPORT_PRIVATE DnsSession
   // Track runtime statistics of each DNS server.
   ScopedVector<ServerStats> server_stats_;
 
+  // TCP connections to all servers, shared by transactions.
+  ScopedVector<DnsTCPConnection> tcp_connections_;
+
   // Buckets shared for all |ServerStats::rtt_histogram|.
   struct RttBuckets : public base::BucketRanges {
     RttBuckets();
@@ -5,6 +5,7 @@
 #include "net/dns/dns_session.h"
 
 #include <list>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/memory/scoped_ptr.h"
@@ -243,6 +244,37 @@ TEST_F(DnsSessionTest, HistogramTimeoutLong) {
   EXPECT_EQ(config_.timeout.InMilliseconds(), timeout.InMilliseconds());
 }
 
+TEST_F(DnsSessionTest, BestServerIndices) {
+  config_.attempts = 2;
+  Initialize(4);
+  std::vector<unsigned> indices;
+  session_->GetBestServerIndices(4, &indices);
+  unsigned kInitialOrder[] = { 0, 1, 2, 3 };
+  EXPECT_EQ(std::vector<unsigned>(kInitialOrder,
+                                  kInitialOrder + arraysize(kInitialOrder)),
+            indices);
+
+  // Failures rank first, then RTT estimates.
+  session_->RecordServerFailure(0);
+  session_->RecordRTT(3, base::TimeDelta::FromMilliseconds(1));
+  session_->GetBestServerIndices(3, &indices);
+  unsigned kRankedOrder[] = { 3, 1, 2 };
+  EXPECT_EQ(std::vector<unsigned>(kRankedOrder,
+                                  kRankedOrder + arraysize(kRankedOrder)),
+            indices);
+
+  // Past the allowed attempts, more failures do not lower the rank.
+  session_->RecordServerFailure(1);
+  session_->RecordServerFailure(1);
+  session_->RecordServerFailure(0);
+  session_->RecordServerFailure(0);
+  session_->GetBestServerIndices(4, &indices);
+  unsigned kFailedOrder[] = { 3, 2, 0, 1 };
+  EXPECT_EQ(std::vector<unsigned>(kFailedOrder,
+                                  kFailedOrder + arraysize(kFailedOrder)),
+            indices);
+}
+
 }  // namespace
 
 } // namespace net
@@ -0,0 +1,253 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/dns/dns_tcp_connection.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "net/base/big_endian.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/dns/dns_protocol.h"
+#include "net/dns/dns_query.h"
+#include "net/dns/dns_response.h"
+#include "net/socket/stream_socket.h"
+
+namespace net {
+
+DnsTCPConnection::DnsTCPConnection(unsigned server_index,
+                                   scoped_ptr<StreamSocket> socket)
+    : server_index_(server_index),
+      socket_(socket.Pass()),
+      state_(STATE_NOT_CONNECTED),
+      writing_(false),
+      length_buffer_(new IOBufferWithSize(sizeof(uint16))),
+      reading_(false),
+      reading_length_(true),
+      io_scheduled_(false),
+      weak_factory_(this) {
+  DCHECK(socket_.get());
+  read_buffer_ =
+      new DrainableIOBuffer(length_buffer_.get(), length_buffer_->size());
+}
+
+DnsTCPConnection::~DnsTCPConnection() {}
+
+bool DnsTCPConnection::CanSendQuery(uint16 id) const {
+  if (state_ == STATE_FAILED || pending_queries_.count(id))
+    return false;
+  // A connection the server closed while it was idle has to be detected
+  // before it is reused, since nothing is reading from it.
+  if (state_ == STATE_CONNECTED && pending_queries_.empty() &&
+      !socket_->IsConnectedAndIdle()) {
+    return false;
+  }
+  return true;
+}
+
+bool DnsTCPConnection::IsDead() const {
+  return pending_queries_.empty() && !CanSendQuery(0);
+}
+
+int DnsTCPConnection::SendQuery(const DnsQuery* query,
+                                scoped_ptr<DnsResponse>* response,
+                                const CompletionCallback& callback) {
+  DCHECK(CanSendQuery(query->id()));
+  DCHECK(!callback.is_null());
+
+  PendingQuery& pending = pending_queries_[query->id()];
+  pending.response = response;
+  pending.callback = callback;
+
+  scoped_refptr<IOBufferWithSize> length(
+      new IOBufferWithSize(sizeof(uint16)));
+  WriteBigEndian<uint16>(length->data(), query->io_buffer()->size());
+  write_queue_.push_back(length);
+  write_queue_.push_back(query->io_buffer());
+
+  // Completing asynchronously keeps the callbacks of other queries, which may
+  // be answered by the same IO, from running inside this call.
+  if (!io_scheduled_) {
+    io_scheduled_ = true;
+    base::MessageLoop::current()->PostTask(
+        FROM_HERE,
+        base::Bind(&DnsTCPConnection::DoIO, weak_factory_.GetWeakPtr()));
+  }
+  return ERR_IO_PENDING;
+}
+
+void DnsTCPConnection::CancelQuery(uint16 id) {
+  // The query may still be written, but its response will be dropped.
+  pending_queries_.erase(id);
+}
+
+const BoundNetLog& DnsTCPConnection::NetLog() const {
+  return socket_->NetLog();
+}
+
+void DnsTCPConnection::DoIO() {
+  io_scheduled_ = false;
+  switch (state_) {
+    case STATE_NOT_CONNECTED: {
+      state_ = STATE_CONNECTING;
+      // This use of base::Unretained is safe because we own the socket, and
+      // destroying it cancels its callbacks.
+      int rv = socket_->Connect(
+          base::Bind(&DnsTCPConnection::OnConnectComplete,
+                     base::Unretained(this)));
+      if (rv != ERR_IO_PENDING)
+        OnConnectComplete(rv);
+      break;
+    }
+    case STATE_CONNECTED:
+      DoWriteAndRead();
+      break;
+    case STATE_CONNECTING:
+    case STATE_FAILED:
+      break;
+  }
+}
+
+void DnsTCPConnection::OnConnectComplete(int rv) {
+  DCHECK_EQ(STATE_CONNECTING, state_);
+  if (rv < 0) {
+    Fail(rv);
+    return;
+  }
+  state_ = STATE_CONNECTED;
+  DoWriteAndRead();
+}
+
+void DnsTCPConnection::DoWriteAndRead() {
+  // A write which fails synchronously runs the callbacks of the pending
+  // queries, and they may delete |this|.
+  base::WeakPtr<DnsTCPConnection> self = weak_factory_.GetWeakPtr();
+  DoWrite();
+  if (self.get())
+    DoRead();
+}
+
+void DnsTCPConnection::DoWrite() {
+  while (state_ == STATE_CONNECTED && !writing_ && !write_queue_.empty()) {
+    if (!write_buffer_.get()) {
+      write_buffer_ = new DrainableIOBuffer(write_queue_.front().get(),
+                                            write_queue_.front()->size());
+    }
+    writing_ = true;
+    int rv = socket_->Write(
+        write_buffer_.get(),
+        write_buffer_->BytesRemaining(),
+        base::Bind(&DnsTCPConnection::OnWriteComplete,
+                   base::Unretained(this)));
+    if (rv == ERR_IO_PENDING || !HandleWriteResult(rv))
+      return;
+  }
+}
+
+void DnsTCPConnection::OnWriteComplete(int rv) {
+  if (HandleWriteResult(rv))
+    DoWrite();
+}
+
+bool DnsTCPConnection::HandleWriteResult(int rv) {
+  DCHECK_NE(ERR_IO_PENDING, rv);
+  writing_ = false;
+  if (rv < 0) {
+    Fail(rv);
+    return false;
+  }
+  write_buffer_->DidConsume(rv);
+  if (write_buffer_->BytesRemaining() == 0) {
+    write_buffer_ = NULL;
+    write_queue_.pop_front();
+  }
+  return true;
+}
+
+void DnsTCPConnection::DoRead() {
+  // Reading stops once every query has been answered. A response that
+  // arrives for a cancelled query is dropped when reading resumes.
+  while (state_ == STATE_CONNECTED && !reading_ && !pending_queries_.empty()) {
+    reading_ = true;
+    int rv = socket_->Read(
+        read_buffer_.get(),
+        read_buffer_->BytesRemaining(),
+        base::Bind(&DnsTCPConnection::OnReadComplete,
+                   base::Unretained(this)));
+    if (rv == ERR_IO_PENDING || !HandleReadResult(rv))
+      return;
+  }
+}
+
+void DnsTCPConnection::OnReadComplete(int rv) {
+  if (HandleReadResult(rv))
+    DoRead();
+}
+
+bool DnsTCPConnection::HandleReadResult(int rv) {
+  DCHECK_NE(ERR_IO_PENDING, rv);
+  reading_ = false;
+  if (rv == 0)
+    rv = ERR_CONNECTION_CLOSED;
+  if (rv < 0) {
+    Fail(rv);
+    return false;
+  }
+
+  read_buffer_->DidConsume(rv);
+  if (read_buffer_->BytesRemaining() > 0)
+    return true;
+
+  if (reading_length_) {
+    uint16 response_length = 0;
+    ReadBigEndian<uint16>(length_buffer_->data(), &response_length);
+    if (response_length < sizeof(dns_protocol::Header)) {
+      Fail(ERR_DNS_MALFORMED_RESPONSE);
+      return false;
+    }
+    // Allocate more space so that DnsResponse::InitParse sanity check passes.
+    response_.reset(new DnsResponse(response_length + 1));
+    read_buffer_ =
+        new DrainableIOBuffer(response_->io_buffer(), response_length);
+    reading_length_ = false;
+    return true;
+  }
+
+  int response_size = read_buffer_->BytesConsumed();
+  read_buffer_ =
+      new DrainableIOBuffer(length_buffer_.get(), length_buffer_->size());
+  reading_length_ = true;
+
+  uint16 id = 0;
+  ReadBigEndian<uint16>(response_->io_buffer()->data(), &id);
+  PendingQueryMap::iterator it = pending_queries_.find(id);
+  if (it == pending_queries_.end()) {
+    response_.reset();
+    return true;
+  }
+  *it->second.response = response_.Pass();
+  CompletionCallback callback = it->second.callback;
+  pending_queries_.erase(it);
+
+  base::WeakPtr<DnsTCPConnection> self = weak_factory_.GetWeakPtr();
+  callback.Run(response_size);
+  return self.get() != NULL;
+}
+
+void DnsTCPConnection::Fail(int rv) {
+  DCHECK_LT(rv, 0);
+  state_ = STATE_FAILED;
+  PendingQueryMap pending_queries;
+  pending_queries.swap(pending_queries_);
+  base::WeakPtr<DnsTCPConnection> self = weak_factory_.GetWeakPtr();
+  for (PendingQueryMap::iterator it = pending_queries.begin();
+       it != pending_queries.end(); ++it) {
+    it->second.callback.Run(rv);
+    if (!self.get())
+      return;
+  }
+}
+
+}  // namespace net
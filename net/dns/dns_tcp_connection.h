@@ -0,0 +1,127 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DNS_DNS_TCP_CONNECTION_H_
+#define NET_DNS_DNS_TCP_CONNECTION_H_
+
+#include <deque>
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_export.h"
+#include "net/base/net_log.h"
+
+namespace net {
+
+class DnsQuery;
+class DnsResponse;
+class DrainableIOBuffer;
+class IOBufferWithSize;
+class StreamSocket;
+
+// A TCP connection to a DNS server that carries any number of queries at
+// once. Queries are written in the order they are sent, and responses are
+// matched to them by ID in whatever order the server returns them, so one
+// connection can be reused and pipelined by many transactions.
+class NET_EXPORT_PRIVATE DnsTCPConnection {
+ public:
+  // |socket| must not be connected yet. The connection is made when the first
+  // query is sent.
+  DnsTCPConnection(unsigned server_index, scoped_ptr<StreamSocket> socket);
+  ~DnsTCPConnection();
+
+  // Returns true if a query with |id| can be sent on this connection, that is,
+  // the connection has not failed or been closed by the server, and no query
+  // with the same ID is outstanding on it.
+  bool CanSendQuery(uint16 id) const;
+
+  // Returns true if no queries are outstanding and the connection cannot take
+  // any more.
+  bool IsDead() const;
+
+  // Sends |query| and reads the response with the same ID into |*response|.
+  // Always returns ERR_IO_PENDING, and later runs |callback| with the size of
+  // the response, or a net error code. |query| and |response| must stay valid
+  // until then, or until CancelQuery() is called.
+  int SendQuery(const DnsQuery* query,
+                scoped_ptr<DnsResponse>* response,
+                const CompletionCallback& callback);
+
+  // Forgets the outstanding query with |id|. Its callback is not run.
+  void CancelQuery(uint16 id);
+
+  unsigned server_index() const { return server_index_; }
+
+  const BoundNetLog& NetLog() const;
+
+ private:
+  enum State {
+    STATE_NOT_CONNECTED,
+    STATE_CONNECTING,
+    STATE_CONNECTED,
+    STATE_FAILED,
+  };
+
+  struct PendingQuery {
+    scoped_ptr<DnsResponse>* response;
+    CompletionCallback callback;
+  };
+
+  typedef std::map<uint16, PendingQuery> PendingQueryMap;
+
+  // Starts connecting, writing or reading, as needed.
+  void DoIO();
+
+  void OnConnectComplete(int rv);
+
+  // Writes, and then reads unless |this| was deleted by a failed write.
+  void DoWriteAndRead();
+
+  void DoWrite();
+  void OnWriteComplete(int rv);
+  // Returns false if writing cannot continue.
+  bool HandleWriteResult(int rv);
+
+  void DoRead();
+  void OnReadComplete(int rv);
+  // Returns false if reading cannot continue.
+  bool HandleReadResult(int rv);
+
+  // Fails all outstanding queries with |rv|. |this| may be deleted on return.
+  void Fail(int rv);
+
+  const unsigned server_index_;
+  scoped_ptr<StreamSocket> socket_;
+  State state_;
+
+  PendingQueryMap pending_queries_;
+
+  // Length prefixes and queries still to be written, and the progress of the
+  // one at the front.
+  std::deque<scoped_refptr<IOBufferWithSize> > write_queue_;
+  scoped_refptr<DrainableIOBuffer> write_buffer_;
+  bool writing_;
+
+  // The response being read, after its length prefix.
+  scoped_refptr<IOBufferWithSize> length_buffer_;
+  scoped_ptr<DnsResponse> response_;
+  scoped_refptr<DrainableIOBuffer> read_buffer_;
+  bool reading_;
+  bool reading_length_;
+
+  // Set while a task to run DoIO() is posted.
+  bool io_scheduled_;
+
+  base::WeakPtrFactory<DnsTCPConnection> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsTCPConnection);
+};
+
+}  // namespace net
+
+#endif  // NET_DNS_DNS_TCP_CONNECTION_H_
@@ -0,0 +1,265 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/dns/dns_tcp_connection.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/address_list.h"
+#include "net/base/dns_util.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/dns/dns_protocol.h"
+#include "net/dns/dns_query.h"
+#include "net/dns/dns_response.h"
+#include "net/socket/socket_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// Builds a query with |id| and a matching response without answers.
+class QueryAndResponse {
+ public:
+  explicit QueryAndResponse(uint16 id) {
+    std::string qname;
+    EXPECT_TRUE(DNSDomainFromDot("www.example.com", &qname));
+    query_.reset(new DnsQuery(id, qname, dns_protocol::kTypeA));
+    query_data_.assign(query_->io_buffer()->data(),
+                       query_->io_buffer()->size());
+    query_length_ = LengthPrefix(query_data_.size());
+    response_data_ = query_data_;
+    response_data_[2] |= 0x80;  // QR bit.
+    framed_response_ = LengthPrefix(response_data_.size()) + response_data_;
+  }
+
+  const DnsQuery* query() const { return query_.get(); }
+  const std::string& response_data() const { return response_data_; }
+
+  MockWrite LengthWrite() const {
+    return MockWrite(SYNCHRONOUS, query_length_.data(), query_length_.size());
+  }
+  MockWrite QueryWrite() const {
+    return MockWrite(SYNCHRONOUS, query_data_.data(), query_data_.size());
+  }
+  MockRead ResponseRead() const {
+    return MockRead(ASYNC, framed_response_.data(), framed_response_.size());
+  }
+
+ private:
+  static std::string LengthPrefix(size_t length) {
+    std::string prefix(2, '\0');
+    prefix[0] = static_cast<char>(length >> 8);
+    prefix[1] = static_cast<char>(length & 0xff);
+    return prefix;
+  }
+
+  scoped_ptr<DnsQuery> query_;
+  std::string query_data_;
+  std::string query_length_;
+  std::string response_data_;
+  std::string framed_response_;
+};
+
+std::string ToString(DnsResponse* response, int size) {
+  return std::string(response->io_buffer()->data(), size);
+}
+
+// Deletes |*connection| and then passes |rv| on to |callback|, like a
+// transaction which drops its session once its query fails.
+void DeleteConnectionAndRun(scoped_ptr<DnsTCPConnection>* connection,
+                            const CompletionCallback& callback,
+                            int rv) {
+  connection->reset();
+  callback.Run(rv);
+}
+
+class DnsTCPConnectionTest : public testing::Test {
+ protected:
+  void CreateConnection(MockRead* reads, size_t reads_count,
+                        MockWrite* writes, size_t writes_count) {
+    data_.reset(new StaticSocketDataProvider(reads, reads_count,
+                                             writes, writes_count));
+    scoped_ptr<StreamSocket> socket(
+        new MockTCPClientSocket(AddressList(), NULL, data_.get()));
+    connection_.reset(new DnsTCPConnection(0, socket.Pass()));
+  }
+
+  scoped_ptr<StaticSocketDataProvider> data_;
+  scoped_ptr<DnsTCPConnection> connection_;
+};
+
+TEST_F(DnsTCPConnectionTest, PipelinedResponsesOutOfOrder) {
+  QueryAndResponse first(1);
+  QueryAndResponse second(2);
+  MockWrite writes[] = {
+    first.LengthWrite(), first.QueryWrite(),
+    second.LengthWrite(), second.QueryWrite(),
+  };
+  MockRead reads[] = { second.ResponseRead(), first.ResponseRead() };
+  CreateConnection(reads, arraysize(reads), writes, arraysize(writes));
+
+  scoped_ptr<DnsResponse> first_response;
+  scoped_ptr<DnsResponse> second_response;
+  TestCompletionCallback first_callback;
+  TestCompletionCallback second_callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(first.query(), &first_response,
+                                   first_callback.callback()));
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(second.query(), &second_response,
+                                   second_callback.callback()));
+
+  int rv = second_callback.WaitForResult();
+  ASSERT_EQ(static_cast<int>(second.response_data().size()), rv);
+  EXPECT_EQ(second.response_data(), ToString(second_response.get(), rv));
+  EXPECT_FALSE(first_callback.have_result());
+
+  rv = first_callback.WaitForResult();
+  ASSERT_EQ(static_cast<int>(first.response_data().size()), rv);
+  EXPECT_EQ(first.response_data(), ToString(first_response.get(), rv));
+
+  // The connection stays open for more queries.
+  EXPECT_TRUE(connection_->CanSendQuery(1));
+  EXPECT_FALSE(connection_->IsDead());
+}
+
+TEST_F(DnsTCPConnectionTest, DuplicateIdIsRejected) {
+  QueryAndResponse first(1);
+  MockWrite writes[] = { first.LengthWrite(), first.QueryWrite() };
+  MockRead reads[] = { MockRead(ASYNC, ERR_IO_PENDING) };
+  CreateConnection(reads, arraysize(reads), writes, arraysize(writes));
+
+  scoped_ptr<DnsResponse> response;
+  TestCompletionCallback callback;
+  EXPECT_TRUE(connection_->CanSendQuery(1));
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(first.query(), &response,
+                                   callback.callback()));
+  EXPECT_FALSE(connection_->CanSendQuery(1));
+  EXPECT_TRUE(connection_->CanSendQuery(2));
+}
+
+TEST_F(DnsTCPConnectionTest, CancelledQueryResponseIsDropped) {
+  QueryAndResponse first(1);
+  QueryAndResponse second(2);
+  MockWrite writes[] = {
+    first.LengthWrite(), first.QueryWrite(),
+    second.LengthWrite(), second.QueryWrite(),
+  };
+  MockRead reads[] = { first.ResponseRead(), second.ResponseRead() };
+  CreateConnection(reads, arraysize(reads), writes, arraysize(writes));
+
+  scoped_ptr<DnsResponse> first_response;
+  scoped_ptr<DnsResponse> second_response;
+  TestCompletionCallback first_callback;
+  TestCompletionCallback second_callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(first.query(), &first_response,
+                                   first_callback.callback()));
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(second.query(), &second_response,
+                                   second_callback.callback()));
+  connection_->CancelQuery(1);
+
+  int rv = second_callback.WaitForResult();
+  ASSERT_EQ(static_cast<int>(second.response_data().size()), rv);
+  EXPECT_EQ(second.response_data(), ToString(second_response.get(), rv));
+  EXPECT_FALSE(first_callback.have_result());
+  EXPECT_FALSE(first_response.get());
+}
+
+TEST_F(DnsTCPConnectionTest, ServerClosesConnection) {
+  QueryAndResponse first(1);
+  MockWrite writes[] = { first.LengthWrite(), first.QueryWrite() };
+  MockRead reads[] = { MockRead(ASYNC, OK) };
+  CreateConnection(reads, arraysize(reads), writes, arraysize(writes));
+
+  scoped_ptr<DnsResponse> response;
+  TestCompletionCallback callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(first.query(), &response,
+                                   callback.callback()));
+  EXPECT_EQ(ERR_CONNECTION_CLOSED, callback.WaitForResult());
+  EXPECT_FALSE(connection_->CanSendQuery(2));
+  EXPECT_TRUE(connection_->IsDead());
+}
+
+TEST_F(DnsTCPConnectionTest, ShortResponseLengthFails) {
+  QueryAndResponse first(1);
+  MockWrite writes[] = { first.LengthWrite(), first.QueryWrite() };
+  static const char kShortLength[] = { 0x00, 0x04 };
+  MockRead reads[] = {
+    MockRead(ASYNC, kShortLength, arraysize(kShortLength)),
+  };
+  CreateConnection(reads, arraysize(reads), writes, arraysize(writes));
+
+  scoped_ptr<DnsResponse> response;
+  TestCompletionCallback callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(first.query(), &response,
+                                   callback.callback()));
+  EXPECT_EQ(ERR_DNS_MALFORMED_RESPONSE, callback.WaitForResult());
+  EXPECT_TRUE(connection_->IsDead());
+}
+
+TEST_F(DnsTCPConnectionTest, WriteFailureOnConnectDeletesConnection) {
+  QueryAndResponse first(1);
+  MockWrite writes[] = { MockWrite(SYNCHRONOUS, ERR_CONNECTION_RESET) };
+  MockRead reads[] = { MockRead(ASYNC, ERR_IO_PENDING) };
+  CreateConnection(reads, arraysize(reads), writes, arraysize(writes));
+
+  // The write right after connecting fails, and the callback deletes the
+  // connection before it would start reading.
+  scoped_ptr<DnsResponse> response;
+  TestCompletionCallback callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(
+                first.query(), &response,
+                base::Bind(&DeleteConnectionAndRun, &connection_,
+                           callback.callback())));
+  EXPECT_EQ(ERR_CONNECTION_RESET, callback.WaitForResult());
+  EXPECT_FALSE(connection_.get());
+}
+
+TEST_F(DnsTCPConnectionTest, WriteFailureWhenConnectedDeletesConnection) {
+  QueryAndResponse first(1);
+  QueryAndResponse second(2);
+  MockWrite writes[] = {
+    first.LengthWrite(), first.QueryWrite(),
+    MockWrite(SYNCHRONOUS, ERR_CONNECTION_RESET),
+  };
+  MockRead reads[] = {
+    first.ResponseRead(),
+    MockRead(ASYNC, ERR_IO_PENDING),
+  };
+  CreateConnection(reads, arraysize(reads), writes, arraysize(writes));
+
+  scoped_ptr<DnsResponse> first_response;
+  TestCompletionCallback first_callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(first.query(), &first_response,
+                                   first_callback.callback()));
+  EXPECT_EQ(static_cast<int>(first.response_data().size()),
+            first_callback.WaitForResult());
+
+  // The next query is written on the open connection, and the write fails.
+  scoped_ptr<DnsResponse> second_response;
+  TestCompletionCallback second_callback;
+  EXPECT_EQ(ERR_IO_PENDING,
+            connection_->SendQuery(
+                second.query(), &second_response,
+                base::Bind(&DeleteConnectionAndRun, &connection_,
+                           second_callback.callback())));
+  EXPECT_EQ(ERR_CONNECTION_RESET, second_callback.WaitForResult());
+  EXPECT_FALSE(connection_.get());
+}
+
+}  // namespace
+
+}  // namespace net
@@ -32,7 +32,7 @@
 #include "net/dns/dns_query.h"
 #include "net/dns/dns_response.h"
 #include "net/dns/dns_session.h"
-#include "net/socket/stream_socket.h"
+#include "net/dns/dns_tcp_connection.h"
 #include "net/udp/datagram_client_socket.h"
 
 namespace net {
@@ -293,31 +293,32 @@ class DnsUDPAttempt : public DnsAttempt {
   DISALLOW_COPY_AND_ASSIGN(DnsUDPAttempt);
 };
 
+// Sends the query over a DnsTCPConnection shared with other transactions, which
+// matches the response to the query by ID.
 class DnsTCPAttempt : public DnsAttempt {
  public:
-  DnsTCPAttempt(unsigned server_index,
-                scoped_ptr<StreamSocket> socket,
-                scoped_ptr<DnsQuery> query)
-      : DnsAttempt(server_index),
-        next_state_(STATE_NONE),
-        socket_(socket.Pass()),
-        query_(query.Pass()),
-        length_buffer_(new IOBufferWithSize(sizeof(uint16))),
-        response_length_(0) {}
+  DnsTCPAttempt(DnsTCPConnection* connection, scoped_ptr<DnsQuery> query)
+      : DnsAttempt(connection->server_index()),
+        connection_(connection),
+        socket_net_log_(connection->NetLog()),
+        query_(query.Pass()) {}
+
+  virtual ~DnsTCPAttempt() {
+    if (is_pending())
+      connection_->CancelQuery(query_->id());
+  }
 
   // DnsAttempt:
   virtual int Start(const CompletionCallback& callback) OVERRIDE {
-    DCHECK_EQ(STATE_NONE, next_state_);
+    DCHECK(callback_.is_null());
     callback_ = callback;
     start_time_ = base::TimeTicks::Now();
-    next_state_ = STATE_CONNECT_COMPLETE;
-    int rv = socket_->Connect(base::Bind(&DnsTCPAttempt::OnIOComplete,
-                                         base::Unretained(this)));
-    if (rv == ERR_IO_PENDING) {
-      set_result(rv);
-      return rv;
-    }
-    return DoLoop(rv);
+    int rv = connection_->SendQuery(
+        query_.get(), &response_,
+        base::Bind(&DnsTCPAttempt::OnResponse, base::Unretained(this)));
+    DCHECK_EQ(ERR_IO_PENDING, rv);
+    set_result(rv);
+    return rv;
   }
 
   virtual const DnsQuery* GetQuery() const OVERRIDE {
@@ -330,147 +331,14 @@ class DnsTCPAttempt : public DnsAttempt {
   }
 
   virtual const BoundNetLog& GetSocketNetLog() const OVERRIDE {
-    return socket_->NetLog();
+    return socket_net_log_;
   }
 
  private:
-  enum State {
-    STATE_CONNECT_COMPLETE,
-    STATE_SEND_LENGTH,
-    STATE_SEND_QUERY,
-    STATE_READ_LENGTH,
-    STATE_READ_RESPONSE,
-    STATE_NONE,
-  };
-
-  int DoLoop(int result) {
-    CHECK_NE(STATE_NONE, next_state_);
-    int rv = result;
-    do {
-      State state = next_state_;
-      next_state_ = STATE_NONE;
-      switch (state) {
-        case STATE_CONNECT_COMPLETE:
-          rv = DoConnectComplete(rv);
-          break;
-        case STATE_SEND_LENGTH:
-          rv = DoSendLength(rv);
-          break;
-        case STATE_SEND_QUERY:
-          rv = DoSendQuery(rv);
-          break;
-        case STATE_READ_LENGTH:
-          rv = DoReadLength(rv);
-          break;
-        case STATE_READ_RESPONSE:
-          rv = DoReadResponse(rv);
-          break;
-        default:
-          NOTREACHED();
-          break;
-      }
-    } while (rv != ERR_IO_PENDING && next_state_ != STATE_NONE);
-
-    set_result(rv);
-    if (rv == OK) {
-      DCHECK_EQ(STATE_NONE, next_state_);
-      DNS_HISTOGRAM("AsyncDNS.TCPAttemptSuccess",
-                    base::TimeTicks::Now() - start_time_);
-    } else if (rv != ERR_IO_PENDING) {
-      DNS_HISTOGRAM("AsyncDNS.TCPAttemptFail",
-                    base::TimeTicks::Now() - start_time_);
-    }
-    return rv;
-  }
-
-  int DoConnectComplete(int rv) {
-    DCHECK_NE(ERR_IO_PENDING, rv);
-    if (rv < 0)
-      return rv;
-
-    WriteBigEndian<uint16>(length_buffer_->data(), query_->io_buffer()->size());
-    buffer_ =
-        new DrainableIOBuffer(length_buffer_.get(), length_buffer_->size());
-    next_state_ = STATE_SEND_LENGTH;
-    return OK;
-  }
-
-  int DoSendLength(int rv) {
-    DCHECK_NE(ERR_IO_PENDING, rv);
+  int ValidateResponse(int rv) {
     if (rv < 0)
       return rv;
-
-    buffer_->DidConsume(rv);
-    if (buffer_->BytesRemaining() > 0) {
-      next_state_ = STATE_SEND_LENGTH;
-      return socket_->Write(
-          buffer_.get(),
-          buffer_->BytesRemaining(),
-          base::Bind(&DnsTCPAttempt::OnIOComplete, base::Unretained(this)));
-    }
-    buffer_ = new DrainableIOBuffer(query_->io_buffer(),
-                                    query_->io_buffer()->size());
-    next_state_ = STATE_SEND_QUERY;
-    return OK;
-  }
-
-  int DoSendQuery(int rv) {
-    DCHECK_NE(ERR_IO_PENDING, rv);
-    if (rv < 0)
-      return rv;
-
-    buffer_->DidConsume(rv);
-    if (buffer_->BytesRemaining() > 0) {
-      next_state_ = STATE_SEND_QUERY;
-      return socket_->Write(
-          buffer_.get(),
-          buffer_->BytesRemaining(),
-          base::Bind(&DnsTCPAttempt::OnIOComplete, base::Unretained(this)));
-    }
-    buffer_ =
-        new DrainableIOBuffer(length_buffer_.get(), length_buffer_->size());
-    next_state_ = STATE_READ_LENGTH;
-    return OK;
-  }
-
-  int DoReadLength(int rv) {
-    DCHECK_NE(ERR_IO_PENDING, rv);
-    if (rv < 0)
-      return rv;
-
-    buffer_->DidConsume(rv);
-    if (buffer_->BytesRemaining() > 0) {
-      next_state_ = STATE_READ_LENGTH;
-      return socket_->Read(
-          buffer_.get(),
-          buffer_->BytesRemaining(),
-          base::Bind(&DnsTCPAttempt::OnIOComplete, base::Unretained(this)));
-    }
-    ReadBigEndian<uint16>(length_buffer_->data(), &response_length_);
-    // Check if advertised response is too short. (Optimization only.)
-    if (response_length_ < query_->io_buffer()->size())
-      return ERR_DNS_MALFORMED_RESPONSE;
-    // Allocate more space so that DnsResponse::InitParse sanity check passes.
-    response_.reset(new DnsResponse(response_length_ + 1));
-    buffer_ = new DrainableIOBuffer(response_->io_buffer(), response_length_);
-    next_state_ = STATE_READ_RESPONSE;
-    return OK;
-  }
-
-  int DoReadResponse(int rv) {
-    DCHECK_NE(ERR_IO_PENDING, rv);
-    if (rv < 0)
-      return rv;
-
-    buffer_->DidConsume(rv);
-    if (buffer_->BytesRemaining() > 0) {
-      next_state_ = STATE_READ_RESPONSE;
-      return socket_->Read(
-          buffer_.get(),
-          buffer_->BytesRemaining(),
-          base::Bind(&DnsTCPAttempt::OnIOComplete, base::Unretained(this)));
-    }
-    if (!response_->InitParse(buffer_->BytesConsumed(), *query_))
+    if (!response_->InitParse(rv, *query_))
       return ERR_DNS_MALFORMED_RESPONSE;
     if (response_->flags() & dns_protocol::kFlagTC)
       return ERR_UNEXPECTED;
@@ -483,21 +351,26 @@ class DnsTCPAttempt : public DnsAttempt {
     return OK;
   }
 
-  void OnIOComplete(int rv) {
-    rv = DoLoop(rv);
-    if (rv != ERR_IO_PENDING)
-      callback_.Run(rv);
+  void OnResponse(int rv) {
+    DCHECK_NE(ERR_IO_PENDING, rv);
+    rv = ValidateResponse(rv);
+    set_result(rv);
+    if (rv == OK) {
+      DNS_HISTOGRAM("AsyncDNS.TCPAttemptSuccess",
+                    base::TimeTicks::Now() - start_time_);
+    } else {
+      DNS_HISTOGRAM("AsyncDNS.TCPAttemptFail",
+                    base::TimeTicks::Now() - start_time_);
+    }
+    callback_.Run(rv);
   }
 
-  State next_state_;
+  // Owned by the DnsSession, which outlives the transaction.
+  DnsTCPConnection* connection_;
+  BoundNetLog socket_net_log_;
   base::TimeTicks start_time_;
 
-  scoped_ptr<StreamSocket> socket_;
   scoped_ptr<DnsQuery> query_;
-  scoped_refptr<IOBufferWithSize> length_buffer_;
-  scoped_refptr<DrainableIOBuffer> buffer_;
-
-  uint16 response_length_;
   scoped_ptr<DnsResponse> response_;
 
   CompletionCallback callback_;
@@ -512,7 +385,10 @@ class DnsTCPAttempt : public DnsAttempt {
 // The timeout for each DnsUDPAttempt is given by DnsSession::NextTimeout.
 // The first server to attempt on each query is given by
 // DnsSession::NextFirstServerIndex, and the order is round-robin afterwards.
-// Each server is attempted DnsConfig::attempts times.
+// Each server is attempted DnsConfig::attempts times. If
+// DnsConfig::parallel_attempts is above one, the first attempt for each name is
+// instead sent at once to the healthiest servers given by
+// DnsSession::GetBestServerIndices, and the first response wins.
 class DnsTransactionImpl : public DnsTransaction,
                            public base::NonThreadSafe,
                            public base::SupportsWeakPtr<DnsTransactionImpl> {
@@ -664,6 +540,38 @@ class DnsTransactionImpl : public DnsTransaction,
   // next nameserver.
   AttemptResult MakeAttempt() {
     unsigned attempt_number = attempts_.size();
+    const DnsConfig& config = session_->config();
+
+    unsigned server_index =
+        (first_server_index_ + attempt_number) % config.nameservers.size();
+    // Skip over known failed servers.
+    server_index = session_->NextGoodServerIndex(server_index);
+    return MakeAttemptOnServer(server_index);
+  }
+
+  // Makes the first attempts at the current name. Races them across the
+  // healthiest servers if so configured. Returns the result of the first
+  // attempt that completes synchronously, which leaves the rest unstarted.
+  AttemptResult MakeFirstAttempts() {
+    DCHECK(attempts_.empty());
+    const DnsConfig& config = session_->config();
+    if (config.parallel_attempts <= 1)
+      return MakeAttempt();
+
+    std::vector<unsigned> server_indices;
+    session_->GetBestServerIndices(config.parallel_attempts, &server_indices);
+    first_server_index_ = server_indices[0];
+    AttemptResult result(ERR_IO_PENDING, NULL);
+    for (size_t i = 0; i < server_indices.size(); ++i) {
+      result = MakeAttemptOnServer(server_indices[i]);
+      if (result.rv != ERR_IO_PENDING)
+        break;
+    }
+    return result;
+  }
+
+  AttemptResult MakeAttemptOnServer(unsigned server_index) {
+    unsigned attempt_number = attempts_.size();
 
     uint16 id = session_->NextQueryId();
     scoped_ptr<DnsQuery> query;
@@ -673,13 +581,6 @@ class DnsTransactionImpl : public DnsTransaction,
       query.reset(attempts_[0]->GetQuery()->CloneWithNewId(id));
     }
 
-    const DnsConfig& config = session_->config();
-
-    unsigned server_index =
-        (first_server_index_ + attempt_number) % config.nameservers.size();
-    // Skip over known failed servers.
-    server_index = session_->NextGoodServerIndex(server_index);
-
     scoped_ptr<DnsSession::SocketLease> lease =
         session_->AllocateSocket(server_index, net_log_.source());
 
@@ -716,13 +617,12 @@ class DnsTransactionImpl : public DnsTransaction,
 
     unsigned server_index = previous_attempt->server_index();
 
-    scoped_ptr<StreamSocket> socket(
-        session_->CreateTCPSocket(server_index, net_log_.source()));
-
     // TODO(szym): Reuse the same id to help the server?
     uint16 id = session_->NextQueryId();
     scoped_ptr<DnsQuery> query(
         previous_attempt->GetQuery()->CloneWithNewId(id));
+    DnsTCPConnection* connection =
+        session_->GetTCPConnection(server_index, id, net_log_.source());
 
     RecordLostPacketsIfAny();
     // Cancel all other attempts, no point waiting on them.
@@ -730,8 +630,7 @@ class DnsTransactionImpl : public DnsTransaction,
 
     unsigned attempt_number = attempts_.size();
 
-    DnsTCPAttempt* attempt = new DnsTCPAttempt(server_index, socket.Pass(),
-                                               query.Pass());
+    DnsTCPAttempt* attempt = new DnsTCPAttempt(connection, query.Pass());
 
     attempts_.push_back(attempt);
     ++attempts_count_;
@@ -762,7 +661,7 @@ class DnsTransactionImpl : public DnsTransaction,
     RecordLostPacketsIfAny();
     attempts_.clear();
     had_tcp_attempt_ = false;
-    return MakeAttempt();
+    return MakeFirstAttempts();
   }
 
   void OnUdpAttemptComplete(unsigned attempt_number,
@@ -0,0 +1,193 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/rand_util.h"
+#include "base/time/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/net_util.h"
+#include "net/dns/dns_protocol.h"
+#include "net/dns/dns_session.h"
+#include "net/dns/dns_socket_pool.h"
+#include "net/dns/dns_transaction.h"
+#include "net/socket/client_socket_factory.h"
+#include "net/udp/udp_server_socket.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kLookups = 500;
+
+// The primary server answers most queries quickly, but every tenth one is
+// queued behind other work. The secondary server is steady but slower.
+const int kPrimaryDelayMs = 2;
+const int kPrimarySlowDelayMs = 150;
+const int kPrimarySlowEvery = 10;
+const int kSecondaryDelayMs = 8;
+
+// A DNS server on loopback that answers every query with an empty NOERROR
+// response after a delay.
+class FakeDnsServer {
+ public:
+  FakeDnsServer(int delay_ms, int slow_delay_ms, int slow_every)
+      : socket_(NULL, NetLog::Source()),
+        read_buffer_(new IOBufferWithSize(dns_protocol::kMaxUDPSize)),
+        delay_ms_(delay_ms),
+        slow_delay_ms_(slow_delay_ms),
+        slow_every_(slow_every),
+        queries_(0) {
+  }
+
+  bool Start() {
+    IPAddressNumber localhost;
+    if (!ParseIPLiteralToNumber("127.0.0.1", &localhost))
+      return false;
+    if (socket_.Listen(IPEndPoint(localhost, 0)) != OK)
+      return false;
+    if (socket_.GetLocalAddress(&address_) != OK)
+      return false;
+    Read();
+    return true;
+  }
+
+  const IPEndPoint& address() const { return address_; }
+
+ private:
+  void Read() {
+    int rv = socket_.RecvFrom(
+        read_buffer_.get(), read_buffer_->size(), &peer_,
+        base::Bind(&FakeDnsServer::OnRead, base::Unretained(this)));
+    if (rv != ERR_IO_PENDING)
+      OnRead(rv);
+  }
+
+  void OnRead(int rv) {
+    if (rv >= static_cast<int>(sizeof(dns_protocol::Header))) {
+      scoped_refptr<IOBufferWithSize> response(new IOBufferWithSize(rv));
+      memcpy(response->data(), read_buffer_->data(), rv);
+      response->data()[2] |= 0x80;  // QR bit.
+      ++queries_;
+      int delay_ms = (slow_every_ && queries_ % slow_every_ == 0) ?
+          slow_delay_ms_ : delay_ms_;
+      base::MessageLoop::current()->PostDelayedTask(
+          FROM_HERE,
+          base::Bind(&FakeDnsServer::Respond, base::Unretained(this),
+                     response, peer_),
+          base::TimeDelta::FromMilliseconds(delay_ms));
+    }
+    Read();
+  }
+
+  void Respond(scoped_refptr<IOBufferWithSize> response,
+               const IPEndPoint& peer) {
+    // Loopback sends complete synchronously.
+    socket_.SendTo(response.get(), response->size(), peer,
+                   base::Bind(&FakeDnsServer::OnWrite));
+  }
+
+  static void OnWrite(int rv) {}
+
+  UDPServerSocket socket_;
+  IPEndPoint address_;
+  IPEndPoint peer_;
+  scoped_refptr<IOBufferWithSize> read_buffer_;
+  const int delay_ms_;
+  const int slow_delay_ms_;
+  const int slow_every_;
+  int queries_;
+};
+
+class DnsTransactionPerfTest : public testing::Test {
+ public:
+  DnsTransactionPerfTest()
+      : primary_(kPrimaryDelayMs, kPrimarySlowDelayMs, kPrimarySlowEvery),
+        secondary_(kSecondaryDelayMs, 0, 0),
+        result_(ERR_UNEXPECTED) {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(primary_.Start());
+    ASSERT_TRUE(secondary_.Start());
+  }
+
+  // Resolves |kLookups| names one after another, and logs the median and
+  // 99th percentile latency as |test_name|.
+  void Resolve(int parallel_attempts, const std::string& test_name) {
+    DnsConfig config;
+    config.nameservers.push_back(primary_.address());
+    config.nameservers.push_back(secondary_.address());
+    config.attempts = 1;
+    // Long enough that no lookup is retransmitted, which would hide the cost
+    // of waiting on the slow server.
+    config.timeout = base::TimeDelta::FromSeconds(1);
+    config.parallel_attempts = parallel_attempts;
+    scoped_refptr<DnsSession> session(new DnsSession(
+        config,
+        DnsSocketPool::CreateNull(ClientSocketFactory::GetDefaultFactory()),
+        base::Bind(&base::RandInt),
+        NULL));
+    scoped_ptr<DnsTransactionFactory> factory =
+        DnsTransactionFactory::CreateFactory(session.get());
+
+    std::vector<base::TimeDelta> latencies;
+    for (int i = 0; i < kLookups; ++i) {
+      scoped_ptr<DnsTransaction> transaction = factory->CreateTransaction(
+          "www.example.com.", dns_protocol::kTypeA,
+          base::Bind(&DnsTransactionPerfTest::OnTransactionComplete,
+                     base::Unretained(this)),
+          BoundNetLog());
+      PerfTimer timer;
+      transaction->Start();
+      base::MessageLoop::current()->Run();
+      latencies.push_back(timer.Elapsed());
+      ASSERT_EQ(OK, result_);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    LogPerfResult((test_name + "_p50").c_str(),
+                  latencies[latencies.size() / 2].InMillisecondsF(), "ms");
+    LogPerfResult((test_name + "_p99").c_str(),
+                  latencies[latencies.size() * 99 / 100].InMillisecondsF(),
+                  "ms");
+  }
+
+ private:
+  void OnTransactionComplete(DnsTransaction* transaction,
+                             int rv,
+                             const DnsResponse* response) {
+    result_ = rv;
+    base::MessageLoop::current()->Quit();
+  }
+
+  base::MessageLoopForIO message_loop_;
+  FakeDnsServer primary_;
+  FakeDnsServer secondary_;
+  int result_;
+};
+
+TEST_F(DnsTransactionPerfTest, SingleServer) {
+  Resolve(1, "DnsTransaction_SingleServer");
+}
+
+TEST_F(DnsTransactionPerfTest, RaceTwoServers) {
+  Resolve(2, "DnsTransaction_RaceTwoServers");
+}
+
+}  // namespace
+
+}  // namespace net
@@ -658,6 +658,43 @@ TEST_F(DnsTransactionTest, ServerFallbackAndRotate) {
   CheckServerOrder(kOrder, arraysize(kOrder));
 }
 
+TEST_F(DnsTransactionTest, RaceFirstAttempt) {
+  config_.parallel_attempts = 2;
+  ConfigureNumServers(2);
+  ConfigureFactory();
+
+  // The first server never responds, but the second one does.
+  AddQueryAndTimeout(kT0HostName, kT0Qtype);
+  AddAsyncQueryAndResponse(0 /* id */, kT0HostName, kT0Qtype,
+                           kT0ResponseDatagram, arraysize(kT0ResponseDatagram));
+
+  TransactionHelper helper0(kT0HostName, kT0Qtype, kT0RecordCount);
+  EXPECT_TRUE(helper0.Run(transaction_factory_.get()));
+
+  unsigned kOrder[] = { 0, 1 };
+  CheckServerOrder(kOrder, arraysize(kOrder));
+}
+
+TEST_F(DnsTransactionTest, RacePrefersHealthyServers) {
+  config_.parallel_attempts = 2;
+  ConfigureNumServers(3);
+  ConfigureFactory();
+
+  // Server 0 has failed, and server 2 is faster than server 1.
+  session_->RecordServerFailure(0);
+  session_->RecordRTT(2, base::TimeDelta::FromMilliseconds(1));
+
+  AddAsyncQueryAndResponse(0 /* id */, kT0HostName, kT0Qtype,
+                           kT0ResponseDatagram, arraysize(kT0ResponseDatagram));
+  AddQueryAndTimeout(kT0HostName, kT0Qtype);
+
+  TransactionHelper helper0(kT0HostName, kT0Qtype, kT0RecordCount);
+  EXPECT_TRUE(helper0.Run(transaction_factory_.get()));
+
+  unsigned kOrder[] = { 2, 1 };
+  CheckServerOrder(kOrder, arraysize(kOrder));
+}
+
 TEST_F(DnsTransactionTest, SuffixSearchAboveNdots) {
   config_.ndots = 2;
   config_.search.push_back("a");
@@ -8,10 +8,46 @@
 #include "base/metrics/field_trial.h"
 #include "base/metrics/histogram.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/values.h"
 #include "net/base/net_errors.h"
+#include "net/base/net_util.h"
 
 namespace net {
 
+namespace {
+
+// How long after its expiration a restored entry can still be used.
+const int kMaxStalenessHours = 24;
+
+// Keys of each entry in the list written by HostCache::GetAsListValue.
+const char kHostnameKey[] = "hostname";
+const char kAddressFamilyKey[] = "address_family";
+const char kFlagsKey[] = "flags";
+const char kExpirationKey[] = "expiration";
+const char kAddressesKey[] = "addresses";
+const char kCanonicalNameKey[] = "canonical_name";
+
+base::DictionaryValue* EntryToValue(const HostCache::Key& key,
+                                    const HostCache::Entry& entry,
+                                    base::Time expiration) {
+  base::DictionaryValue* value = new base::DictionaryValue();
+  value->SetString(kHostnameKey, key.hostname);
+  value->SetInteger(kAddressFamilyKey, key.address_family);
+  value->SetInteger(kFlagsKey, key.host_resolver_flags);
+  // base::Value has no 64-bit integers.
+  value->SetString(kExpirationKey,
+                   base::Int64ToString(expiration.ToInternalValue()));
+  base::ListValue* addresses = new base::ListValue();
+  for (size_t i = 0; i < entry.addrlist.size(); ++i)
+    addresses->AppendString(entry.addrlist[i].ToStringWithoutPort());
+  value->Set(kAddressesKey, addresses);
+  if (!entry.addrlist.canonical_name().empty())
+    value->SetString(kCanonicalNameKey, entry.addrlist.canonical_name());
+  return value;
+}
+
+}  // namespace
+
 //-----------------------------------------------------------------------------
 
 HostCache::Entry::Entry(int error, const AddressList& addrlist,
@@ -49,6 +85,20 @@ const HostCache::Entry* HostCache::Lookup(const Key& key,
   return entries_.Get(key, now);
 }
 
+const HostCache::Entry* HostCache::LookupStale(const Key& key,
+                                               base::TimeTicks now) {
+  DCHECK(CalledOnValidThread());
+  StaleEntryMap::iterator it = stale_entries_.find(key);
+  if (it == stale_entries_.end())
+    return NULL;
+  if (now - it->second.expiration >
+      base::TimeDelta::FromHours(kMaxStalenessHours)) {
+    stale_entries_.erase(it);
+    return NULL;
+  }
+  return &it->second.entry;
+}
+
 void HostCache::Set(const Key& key,
                     const Entry& entry,
                     base::TimeTicks now,
@@ -57,12 +107,109 @@ void HostCache::Set(const Key& key,
   if (caching_is_disabled())
     return;
 
+  // Keep serving a restored entry if the name could not be resolved again,
+  // e.g. because the network is down.
+  if (entry.error == OK)
+    stale_entries_.erase(key);
   entries_.Put(key, entry, now, now + ttl);
 }
 
 void HostCache::clear() {
   DCHECK(CalledOnValidThread());
   entries_.Clear();
+  stale_entries_.clear();
+}
+
+void HostCache::GetAsListValue(base::ListValue* entry_list,
+                               base::TimeTicks now,
+                               base::Time wall_now) const {
+  AppendEntriesToListValue(NULL, entry_list, now, wall_now);
+}
+
+void HostCache::GetAsListValueForHostnames(
+    const std::set<std::string>& hostnames,
+    base::ListValue* entry_list,
+    base::TimeTicks now,
+    base::Time wall_now) const {
+  AppendEntriesToListValue(&hostnames, entry_list, now, wall_now);
+}
+
+bool HostCache::RestoreFromListValue(const base::ListValue& entry_list,
+                                     base::TimeTicks now,
+                                     base::Time wall_now) {
+  DCHECK(CalledOnValidThread());
+  for (size_t i = 0; i < entry_list.GetSize(); ++i) {
+    if (stale_entries_.size() >= max_entries())
+      break;
+
+    const base::DictionaryValue* value;
+    std::string hostname;
+    int address_family;
+    int flags;
+    std::string expiration_string;
+    int64 expiration_value;
+    const base::ListValue* addresses;
+    if (!entry_list.GetDictionary(i, &value) ||
+        !value->GetString(kHostnameKey, &hostname) ||
+        !value->GetInteger(kAddressFamilyKey, &address_family) ||
+        !value->GetInteger(kFlagsKey, &flags) ||
+        !value->GetString(kExpirationKey, &expiration_string) ||
+        !base::StringToInt64(expiration_string, &expiration_value) ||
+        !value->GetList(kAddressesKey, &addresses)) {
+      return false;
+    }
+
+    base::TimeDelta time_to_expiration =
+        base::Time::FromInternalValue(expiration_value) - wall_now;
+    if (-time_to_expiration > base::TimeDelta::FromHours(kMaxStalenessHours))
+      continue;
+
+    AddressList addrlist;
+    for (size_t j = 0; j < addresses->GetSize(); ++j) {
+      std::string address_string;
+      IPAddressNumber address;
+      if (!addresses->GetString(j, &address_string) ||
+          !ParseIPLiteralToNumber(address_string, &address)) {
+        return false;
+      }
+      addrlist.push_back(IPEndPoint(address, 0));
+    }
+    if (addrlist.empty())
+      continue;
+    std::string canonical_name;
+    if (value->GetString(kCanonicalNameKey, &canonical_name))
+      addrlist.set_canonical_name(canonical_name);
+
+    Key key(hostname, static_cast<AddressFamily>(address_family), flags);
+    stale_entries_.insert(std::make_pair(
+        key, StaleEntry(Entry(OK, addrlist), now + time_to_expiration)));
+  }
+  return true;
+}
+
+void HostCache::AppendEntriesToListValue(
+    const std::set<std::string>* hostnames,
+    base::ListValue* entry_list,
+    base::TimeTicks now,
+    base::Time wall_now) const {
+  DCHECK(CalledOnValidThread());
+  for (EntryMap::Iterator it(entries_); it.HasNext(); it.Advance()) {
+    const Entry& entry = it.value();
+    if (entry.error != OK || entry.addrlist.empty())
+      continue;
+    if (hostnames && !hostnames->count(it.key().hostname))
+      continue;
+    entry_list->Append(
+        EntryToValue(it.key(), entry, wall_now + (it.expiration() - now)));
+  }
+  for (StaleEntryMap::const_iterator it = stale_entries_.begin();
+       it != stale_entries_.end(); ++it) {
+    if (hostnames && !hostnames->count(it->first.hostname))
+      continue;
+    entry_list->Append(EntryToValue(
+        it->first, it->second.entry,
+        wall_now + (it->second.expiration - now)));
+  }
 }
 
 size_t HostCache::size() const {
@@ -70,6 +217,11 @@ size_t HostCache::size() const {
   return entries_.size();
 }
 
+size_t HostCache::stale_size() const {
+  DCHECK(CalledOnValidThread());
+  return stale_entries_.size();
+}
+
 size_t HostCache::max_entries() const {
   DCHECK(CalledOnValidThread());
   return entries_.max_entries();
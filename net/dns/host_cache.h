@@ -6,6 +6,8 @@
 #define NET_DNS_HOST_CACHE_H_
 
 #include <functional>
+#include <map>
+#include <set>
 #include <string>
 
 #include "base/gtest_prod_util.h"
@@ -17,6 +19,10 @@
 #include "net/base/expiring_cache.h"
 #include "net/base/net_export.h"
 
+namespace base {
+class ListValue;
+}
+
 namespace net {
 
 // Cache used by HostResolver to map hostnames to their resolved result.
@@ -82,6 +88,12 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // |now|. If there is no such entry, returns NULL.
   const Entry* Lookup(const Key& key, base::TimeTicks now);
 
+  // Returns a pointer to the entry for |key| restored by
+  // RestoreFromListValue(), if it has not been replaced by a successful Set()
+  // and expired less than a day before |now|. Such an entry may be out of
+  // date, so it should only be used while the name is resolved again.
+  const Entry* LookupStale(const Key& key, base::TimeTicks now);
+
   // Overwrites or creates an entry for |key|.
   // |entry| is the value to set, |now| is the current time
   // |ttl| is the "time to live".
@@ -93,6 +105,28 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // Empties the cache
   void clear();
 
+  // Appends the successful entries, including restored ones, to |entry_list|
+  // with their expiration as of |wall_now|, so that the next process can
+  // restore them. |now| is the current time of the cache.
+  void GetAsListValue(base::ListValue* entry_list,
+                      base::TimeTicks now,
+                      base::Time wall_now) const;
+
+  // Like GetAsListValue(), but only appends the entries whose hostname is in
+  // |hostnames|.
+  void GetAsListValueForHostnames(const std::set<std::string>& hostnames,
+                                  base::ListValue* entry_list,
+                                  base::TimeTicks now,
+                                  base::Time wall_now) const;
+
+  // Adds the entries written by GetAsListValue() in an earlier process as
+  // stale entries. Drops those that expired more than a day before
+  // |wall_now|, and those that do not fit in the cache. Returns false if
+  // |entry_list| is malformed, in which case some entries may be restored.
+  bool RestoreFromListValue(const base::ListValue& entry_list,
+                            base::TimeTicks now,
+                            base::Time wall_now);
+
   // Returns the number of entries in the cache.
   size_t size() const;
 
@@ -101,12 +135,32 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
 
   const EntryMap& entries() const;
 
+  // Returns the number of restored entries that were not replaced yet.
+  size_t stale_size() const;
+
   // Creates a default cache.
   static scoped_ptr<HostCache> CreateDefaultCache();
 
  private:
   FRIEND_TEST_ALL_PREFIXES(HostCacheTest, NoCache);
 
+  struct StaleEntry {
+    StaleEntry(const Entry& entry, base::TimeTicks expiration)
+        : entry(entry), expiration(expiration) {}
+
+    Entry entry;
+    base::TimeTicks expiration;
+  };
+
+  typedef std::map<Key, StaleEntry> StaleEntryMap;
+
+  // Implements GetAsListValue() and GetAsListValueForHostnames(). Appends
+  // every entry if |hostnames| is NULL.
+  void AppendEntriesToListValue(const std::set<std::string>* hostnames,
+                                base::ListValue* entry_list,
+                                base::TimeTicks now,
+                                base::Time wall_now) const;
+
   // Returns true if this HostCache can contain no entries.
   bool caching_is_disabled() const {
     return entries_.max_entries() == 0;
@@ -116,6 +170,9 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // a resolved result entry.
   EntryMap entries_;
 
+  // Entries restored from a previous process.
+  StaleEntryMap stale_entries_;
+
   DISALLOW_COPY_AND_ASSIGN(HostCache);
 };
 
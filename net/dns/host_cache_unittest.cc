@@ -8,7 +8,9 @@
 #include "base/stl_util.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
+#include "base/values.h"
 #include "net/base/net_errors.h"
+#include "net/base/net_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace net {
@@ -22,6 +24,13 @@ HostCache::Key Key(const std::string& hostname) {
   return HostCache::Key(hostname, ADDRESS_FAMILY_UNSPECIFIED, 0);
 }
 
+// Builds an entry for a successful resolution to |ip_literal|.
+HostCache::Entry EntryForAddress(const std::string& ip_literal) {
+  IPAddressNumber address;
+  EXPECT_TRUE(ParseIPLiteralToNumber(ip_literal, &address));
+  return HostCache::Entry(OK, AddressList::CreateFromIPAddress(address, 0));
+}
+
 }  // namespace
 
 TEST(HostCacheTest, Basic) {
@@ -296,6 +305,160 @@ TEST(HostCacheTest, Clear) {
   EXPECT_EQ(0u, cache.size());
 }
 
+TEST(HostCacheTest, SnapshotRoundTrip) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(kMaxCacheEntries);
+  base::TimeTicks now;
+  base::Time wall_now = base::Time::Now();
+
+  cache.Set(Key("foobar.com"), EntryForAddress("1.2.3.4"), now, kTTL);
+  cache.Set(HostCache::Key("foobar.com", ADDRESS_FAMILY_IPV6, 0),
+            EntryForAddress("::1"), now, kTTL);
+  // Failures are not saved.
+  cache.Set(Key("failed.com"), HostCache::Entry(ERR_NAME_NOT_RESOLVED,
+                                                AddressList()), now, kTTL);
+
+  base::ListValue snapshot;
+  cache.GetAsListValue(&snapshot, now, wall_now);
+  EXPECT_EQ(2u, snapshot.GetSize());
+
+  // Restore in a process that starts a minute later.
+  HostCache restored(kMaxCacheEntries);
+  base::TimeTicks restored_now;
+  ASSERT_TRUE(restored.RestoreFromListValue(
+      snapshot, restored_now, wall_now + base::TimeDelta::FromMinutes(1)));
+  EXPECT_EQ(0u, restored.size());
+  EXPECT_EQ(2u, restored.stale_size());
+
+  // Restored entries are only returned as stale.
+  EXPECT_FALSE(restored.Lookup(Key("foobar.com"), restored_now));
+  const HostCache::Entry* entry =
+      restored.LookupStale(Key("foobar.com"), restored_now);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(OK, entry->error);
+  ASSERT_EQ(1u, entry->addrlist.size());
+  EXPECT_EQ("1.2.3.4", entry->addrlist[0].ToStringWithoutPort());
+  entry = restored.LookupStale(
+      HostCache::Key("foobar.com", ADDRESS_FAMILY_IPV6, 0), restored_now);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ("::1", entry->addrlist[0].ToStringWithoutPort());
+  EXPECT_FALSE(restored.LookupStale(Key("failed.com"), restored_now));
+}
+
+TEST(HostCacheTest, SnapshotForHostnames) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache previous(kMaxCacheEntries);
+  base::TimeTicks now;
+  base::Time wall_now = base::Time::Now();
+  previous.Set(Key("stale.com"), EntryForAddress("1.1.1.1"), now, kTTL);
+  previous.Set(Key("other-stale.com"), EntryForAddress("2.2.2.2"), now, kTTL);
+  base::ListValue previous_snapshot;
+  previous.GetAsListValue(&previous_snapshot, now, wall_now);
+
+  HostCache cache(kMaxCacheEntries);
+  ASSERT_TRUE(cache.RestoreFromListValue(previous_snapshot, now, wall_now));
+  cache.Set(Key("foobar.com"), EntryForAddress("1.2.3.4"), now, kTTL);
+  cache.Set(Key("other.com"), EntryForAddress("5.6.7.8"), now, kTTL);
+
+  std::set<std::string> hostnames;
+  hostnames.insert("foobar.com");
+  hostnames.insert("stale.com");
+  base::ListValue snapshot;
+  cache.GetAsListValueForHostnames(hostnames, &snapshot, now, wall_now);
+  EXPECT_EQ(2u, snapshot.GetSize());
+
+  HostCache restored(kMaxCacheEntries);
+  ASSERT_TRUE(restored.RestoreFromListValue(snapshot, now, wall_now));
+  EXPECT_EQ(2u, restored.stale_size());
+  EXPECT_TRUE(restored.LookupStale(Key("foobar.com"), now));
+  EXPECT_TRUE(restored.LookupStale(Key("stale.com"), now));
+  EXPECT_FALSE(restored.LookupStale(Key("other.com"), now));
+  EXPECT_FALSE(restored.LookupStale(Key("other-stale.com"), now));
+}
+
+TEST(HostCacheTest, SnapshotDropsVeryStaleEntries) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(kMaxCacheEntries);
+  base::TimeTicks now;
+  base::Time wall_now = base::Time::Now();
+  cache.Set(Key("foobar.com"), EntryForAddress("1.2.3.4"), now, kTTL);
+  base::ListValue snapshot;
+  cache.GetAsListValue(&snapshot, now, wall_now);
+
+  // Restored a few hours after expiration, the entry is still usable...
+  HostCache restored(kMaxCacheEntries);
+  base::TimeTicks restored_now;
+  ASSERT_TRUE(restored.RestoreFromListValue(
+      snapshot, restored_now, wall_now + base::TimeDelta::FromHours(3)));
+  EXPECT_TRUE(restored.LookupStale(Key("foobar.com"), restored_now));
+  // ...until a day after it expired.
+  EXPECT_FALSE(restored.LookupStale(
+      Key("foobar.com"), restored_now + base::TimeDelta::FromHours(22)));
+  EXPECT_EQ(0u, restored.stale_size());
+
+  // Restored two days later, it is dropped right away.
+  HostCache restored_later(kMaxCacheEntries);
+  ASSERT_TRUE(restored_later.RestoreFromListValue(
+      snapshot, restored_now, wall_now + base::TimeDelta::FromDays(2)));
+  EXPECT_EQ(0u, restored_later.stale_size());
+}
+
+TEST(HostCacheTest, StaleEntryReplacedOnSuccess) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(kMaxCacheEntries);
+  base::TimeTicks now;
+  base::Time wall_now = base::Time::Now();
+  cache.Set(Key("foobar.com"), EntryForAddress("1.2.3.4"), now, kTTL);
+  base::ListValue snapshot;
+  cache.GetAsListValue(&snapshot, now, wall_now);
+
+  HostCache restored(kMaxCacheEntries);
+  ASSERT_TRUE(restored.RestoreFromListValue(snapshot, now, wall_now));
+
+  // A failure to resolve again keeps the stale entry around.
+  restored.Set(Key("foobar.com"),
+               HostCache::Entry(ERR_NAME_NOT_RESOLVED, AddressList()),
+               now, base::TimeDelta());
+  EXPECT_TRUE(restored.LookupStale(Key("foobar.com"), now));
+
+  restored.Set(Key("foobar.com"), EntryForAddress("5.6.7.8"), now, kTTL);
+  EXPECT_FALSE(restored.LookupStale(Key("foobar.com"), now));
+  EXPECT_EQ("5.6.7.8",
+            restored.Lookup(Key("foobar.com"), now)->addrlist[0]
+                .ToStringWithoutPort());
+}
+
+TEST(HostCacheTest, RestoreMalformedSnapshot) {
+  HostCache cache(kMaxCacheEntries);
+  base::ListValue snapshot;
+  snapshot.AppendString("foobar.com");
+  EXPECT_FALSE(cache.RestoreFromListValue(snapshot, base::TimeTicks(),
+                                          base::Time::Now()));
+  EXPECT_EQ(0u, cache.stale_size());
+}
+
+TEST(HostCacheTest, RestoreRespectsMaxEntries) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(kMaxCacheEntries);
+  base::TimeTicks now;
+  base::Time wall_now = base::Time::Now();
+  for (int i = 0; i < kMaxCacheEntries; ++i) {
+    cache.Set(Key(base::StringPrintf("foobar%d.com", i)),
+              EntryForAddress("1.2.3.4"), now, kTTL);
+  }
+  base::ListValue snapshot;
+  cache.GetAsListValue(&snapshot, now, wall_now);
+
+  HostCache small_cache(2);
+  ASSERT_TRUE(small_cache.RestoreFromListValue(snapshot, now, wall_now));
+  EXPECT_EQ(2u, small_cache.stale_size());
+}
+
 // Tests the less than and equal operators for HostCache::Key work.
 TEST(HostCacheTest, KeyComparators) {
   struct {
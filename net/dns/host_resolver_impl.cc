@@ -408,6 +408,10 @@ void LogCancelRequest(const BoundNetLog& source_net_log,
   source_net_log.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL);
 }
 
+// Completion of a request that refreshes a stale cache entry. The result is
+// cached by the job, so there is nothing left to do.
+void OnStaleEntryRefreshed(AddressList* addresses, int rv) {}
+
 //-----------------------------------------------------------------------------
 
 // Keeps track of the highest priority.
@@ -1756,6 +1760,10 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
   Key key = GetEffectiveKeyForRequest(info, request_net_log);
 
   int rv = ResolveHelper(key, info, addresses, request_net_log);
+  if (rv == ERR_DNS_CACHE_MISS && ServeStaleFromCache(key, info, addresses)) {
+    request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CACHE_HIT);
+    rv = OK;
+  }
   if (rv != ERR_DNS_CACHE_MISS) {
     LogFinishRequest(source_net_log, request_net_log, info, rv);
     RecordTotalTime(HaveDnsConfig(), info.is_speculative(), base::TimeDelta());
@@ -1946,6 +1954,36 @@ bool HostResolverImpl::ServeFromCache(const Key& key,
   return true;
 }
 
+bool HostResolverImpl::ServeStaleFromCache(const Key& key,
+                                           const RequestInfo& info,
+                                           AddressList* addresses) {
+  DCHECK(addresses);
+  if (!info.allow_cached_response() || !cache_.get())
+    return false;
+
+  const HostCache::Entry* cache_entry = cache_->LookupStale(
+      key, base::TimeTicks::Now());
+  if (!cache_entry)
+    return false;
+  DCHECK_EQ(OK, cache_entry->error);
+  *addresses = EnsurePortOnAddressList(cache_entry->addrlist, info.port());
+
+  if (jobs_.find(key) == jobs_.end()) {
+    // The refresh does not serve from the cache, so it cannot get here again.
+    // Its result is stored in the cache by the job, which replaces the stale
+    // entry.
+    RequestInfo refresh_info(info);
+    refresh_info.set_allow_cached_response(false);
+    refresh_info.set_is_speculative(true);
+    refresh_info.set_priority(IDLE);
+    AddressList* refresh_addresses = new AddressList();
+    Resolve(refresh_info, refresh_addresses,
+            base::Bind(&OnStaleEntryRefreshed, base::Owned(refresh_addresses)),
+            NULL, BoundNetLog());
+  }
+  return true;
+}
+
 bool HostResolverImpl::ServeFromHosts(const Key& key,
                                       const RequestInfo& info,
                                       AddressList* addresses) {
@@ -180,6 +180,13 @@ class NET_EXPORT HostResolverImpl
                       int* net_error,
                       AddressList* addresses);
 
+  // If |key| has an entry restored into the cache from a previous session,
+  // fills |addresses| from it, starts resolving |key| again unless a job for it
+  // is already running, and returns true. Otherwise returns false.
+  bool ServeStaleFromCache(const Key& key,
+                           const RequestInfo& info,
+                           AddressList* addresses);
+
   // If we have a DnsClient with a valid DnsConfig, and |key| is found in the
   // HOSTS file, returns true and fills |addresses|. Otherwise returns false.
   bool ServeFromHosts(const Key& key,
@@ -0,0 +1,136 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/dns/host_resolver_impl.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "net/base/address_list.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/dns/host_cache.h"
+#include "net/dns/mock_host_resolver.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// The names a browser resolves while it starts up, e.g. those of the startup
+// pages and their subresources.
+const int kStartupNames = 20;
+
+// How long the system resolver takes for each name.
+const int kResolveLatencyMs = 50;
+
+std::string StartupName(int i) {
+  return base::StringPrintf("host%d.example", i);
+}
+
+class HostResolverImplPerfTest : public testing::Test {
+ public:
+  HostResolverImplPerfTest() : pending_(0) {}
+
+  virtual void SetUp() OVERRIDE {
+    proc_ = new RuleBasedHostResolverProc(NULL);
+    for (int i = 0; i < kStartupNames; ++i)
+      proc_->AddRuleWithLatency(StartupName(i), "127.0.0.1",
+                                kResolveLatencyMs);
+  }
+
+  // Creates a resolver with an empty cache, like the one of a new process.
+  scoped_ptr<HostResolverImpl> CreateResolver() {
+    return scoped_ptr<HostResolverImpl>(new HostResolverImpl(
+        HostCache::CreateDefaultCache(),
+        PrioritizedDispatcher::Limits(NUM_PRIORITIES, kStartupNames),
+        HostResolverImpl::ProcTaskParams(proc_.get(), 0),
+        NULL));
+  }
+
+  // Resolves all the startup names, and logs the time until the first and
+  // the last of them are available as |test_name|.
+  void ResolveStartupNames(HostResolverImpl* resolver,
+                           const std::string& test_name) {
+    AddressList addresses[kStartupNames];
+    base::TimeDelta first_resolution;
+    first_completion_ = base::TimeTicks();
+    base::TimeTicks start = base::TimeTicks::Now();
+    PerfTimer timer;
+    for (int i = 0; i < kStartupNames; ++i) {
+      HostResolver::RequestInfo info(HostPortPair(StartupName(i), 80));
+      int rv = resolver->Resolve(
+          info, &addresses[i],
+          base::Bind(&HostResolverImplPerfTest::OnResolveComplete,
+                     base::Unretained(this)),
+          NULL, BoundNetLog());
+      if (rv == ERR_IO_PENDING) {
+        ++pending_;
+        continue;
+      }
+      ASSERT_EQ(OK, rv);
+      if (first_resolution == base::TimeDelta())
+        first_resolution = timer.Elapsed();
+    }
+    if (pending_ > 0) {
+      base::MessageLoop::current()->Run();
+      if (first_resolution == base::TimeDelta())
+        first_resolution = first_completion_ - start;
+    }
+    base::TimeDelta last_resolution = timer.Elapsed();
+
+    LogPerfResult((test_name + "_first").c_str(),
+                  first_resolution.InMillisecondsF(), "ms");
+    LogPerfResult((test_name + "_all").c_str(),
+                  last_resolution.InMillisecondsF(), "ms");
+  }
+
+ protected:
+  scoped_refptr<RuleBasedHostResolverProc> proc_;
+
+ private:
+  void OnResolveComplete(int rv) {
+    EXPECT_EQ(OK, rv);
+    if (first_completion_.is_null())
+      first_completion_ = base::TimeTicks::Now();
+    if (--pending_ == 0)
+      base::MessageLoop::current()->Quit();
+  }
+
+  base::MessageLoopForIO message_loop_;
+  int pending_;
+  base::TimeTicks first_completion_;
+};
+
+TEST_F(HostResolverImplPerfTest, ColdStart) {
+  scoped_ptr<HostResolverImpl> resolver = CreateResolver();
+  ResolveStartupNames(resolver.get(), "HostResolverImpl_ColdStart");
+}
+
+TEST_F(HostResolverImplPerfTest, RestoredSnapshot) {
+  // Resolve the names in a previous session, and keep its cache.
+  base::ListValue snapshot;
+  {
+    scoped_ptr<HostResolverImpl> previous_resolver = CreateResolver();
+    ResolveStartupNames(previous_resolver.get(),
+                        "HostResolverImpl_PreviousSession");
+    previous_resolver->GetHostCache()->GetAsListValue(
+        &snapshot, base::TimeTicks::Now(), base::Time::Now());
+  }
+
+  scoped_ptr<HostResolverImpl> resolver = CreateResolver();
+  ASSERT_TRUE(resolver->GetHostCache()->RestoreFromListValue(
+      snapshot, base::TimeTicks::Now(), base::Time::Now()));
+  ResolveStartupNames(resolver.get(), "HostResolverImpl_RestoredSnapshot");
+}
+
+}  // namespace
+
+}  // namespace net
@@ -18,6 +18,7 @@
 #include "base/synchronization/lock.h"
 #include "base/test/test_timeouts.h"
 #include "base/time/time.h"
+#include "base/values.h"
 #include "net/base/address_list.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_util.h"
@@ -1200,6 +1201,46 @@ TEST_F(HostResolverImplTest, ResolveFromCache) {
   EXPECT_TRUE(requests_[2]->HasOneAddress("192.168.1.42", 80));
 }
 
+TEST_F(HostResolverImplTest, ServeRestoredEntryWhileRefreshing) {
+  proc_->AddRuleForAllFamilies("just.testing", "192.168.1.43");
+
+  // Restore the cache of a previous process.
+  HostCache::Key key("just.testing", ADDRESS_FAMILY_IPV4, 0);
+  IPAddressNumber address;
+  ASSERT_TRUE(ParseIPLiteralToNumber("192.168.1.42", &address));
+  HostCache previous_cache(10);
+  previous_cache.Set(
+      key, HostCache::Entry(OK, AddressList::CreateFromIPAddress(address, 0)),
+      base::TimeTicks::Now(), base::TimeDelta::FromMinutes(1));
+  base::ListValue snapshot;
+  previous_cache.GetAsListValue(&snapshot, base::TimeTicks::Now(),
+                                base::Time::Now());
+  ASSERT_TRUE(resolver_->GetHostCache()->RestoreFromListValue(
+      snapshot, base::TimeTicks::Now(), base::Time::Now()));
+
+  // The restored entry is served synchronously.
+  Request* req = CreateRequest("just.testing", 80, MEDIUM,
+                               ADDRESS_FAMILY_IPV4);
+  EXPECT_EQ(OK, req->Resolve());
+  EXPECT_TRUE(req->HasOneAddress("192.168.1.42", 80));
+
+  // This request joins the job started to refresh the entry.
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 80));
+  info.set_address_family(ADDRESS_FAMILY_IPV4);
+  info.set_allow_cached_response(false);
+  req = CreateRequest(info);
+  EXPECT_EQ(ERR_IO_PENDING, req->Resolve());
+  proc_->SignalMultiple(1u);
+  EXPECT_EQ(OK, req->WaitForResult());
+  EXPECT_EQ(1u, proc_->GetCaptureList().size());
+
+  // The refreshed entry replaced the restored one.
+  EXPECT_EQ(0u, resolver_->GetHostCache()->stale_size());
+  req = CreateRequest("just.testing", 80, MEDIUM, ADDRESS_FAMILY_IPV4);
+  EXPECT_EQ(OK, req->Resolve());
+  EXPECT_TRUE(req->HasOneAddress("192.168.1.43", 80));
+}
+
 // Test the retry attempts simulating host resolver proc that takes too long.
 TEST_F(HostResolverImplTest, MultipleAttempts) {
   // Total number of attempts would be 3 and we want the 3rd attempt to resolve
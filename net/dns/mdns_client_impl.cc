@@ -27,6 +27,9 @@ namespace {
 const char kMDnsMulticastGroupIPv4[] = "224.0.0.251";
 const char kMDnsMulticastGroupIPv6[] = "FF02::FB";
 const unsigned MDnsTransactionTimeoutSeconds = 3;
+// Room for a burst of responses from the devices on the link, which the
+// default socket buffer can drop.
+const int32 kMDnsReceiveBufferSize = 32 * dns_protocol::kMaxMulticastSize;
 }
 
 MDnsConnection::SocketHandler::SocketHandler(
@@ -97,6 +100,8 @@ int MDnsConnection::SocketHandler::BindSocket() {
 
   if (rv < OK) return rv;
 
+  // Failing to enlarge the buffer is not fatal.
+  socket_->SetReceiveBufferSize(kMDnsReceiveBufferSize);
   socket_->SetMulticastLoopbackMode(false);
 
   return socket_->JoinGroup(multicast_addr_.address());
@@ -1074,6 +1074,11 @@ class MDnsConnectionTest : public ::testing::Test {
     EXPECT_CALL(*socket_ipv4_, AllowAddressReuse());
     EXPECT_CALL(*socket_ipv6_, AllowAddressReuse());
 
+    EXPECT_CALL(*socket_ipv4_, SetReceiveBufferSize(_))
+        .WillOnce(Return(true));
+    EXPECT_CALL(*socket_ipv6_, SetReceiveBufferSize(_))
+        .WillOnce(Return(true));
+
     EXPECT_CALL(*socket_ipv4_, SetMulticastLoopbackMode(false));
     EXPECT_CALL(*socket_ipv6_, SetMulticastLoopbackMode(false));
 
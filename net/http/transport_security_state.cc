@@ -19,11 +19,13 @@
 
 #include "base/base64.h"
 #include "base/build_time.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
 #include "base/sha1.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
 #include "base/strings/utf_string_conversions.h"
 #include "base/time/time.h"
@@ -147,6 +149,14 @@ bool TransportSecurityState::GetDomainState(const std::string& host,
 
   bool has_preload = GetStaticDomainState(canonicalized_host, sni_enabled,
                                           &state);
+
+  // Without dynamic entries, the hashes of the domains are not needed.
+  if (enabled_hosts_.empty()) {
+    if (has_preload)
+      *result = state;
+    return has_preload;
+  }
+
   std::string canonicalized_preload = CanonicalizeHost(state.domain);
   GetDynamicDomainState(host, &state);
 
@@ -544,66 +554,186 @@ struct HSTSPreload {
   SecondLevelDomainName second_level_domain_name;
 };
 
-static bool HasPreload(const struct HSTSPreload* entries, size_t num_entries,
-                       const std::string& canonicalized_host, size_t i,
-                       TransportSecurityState::DomainState* out, bool* ret) {
-  for (size_t j = 0; j < num_entries; j++) {
-    if (entries[j].length == canonicalized_host.size() - i &&
-        memcmp(entries[j].dns_name, &canonicalized_host[i],
-               entries[j].length) == 0) {
-      if (!entries[j].include_subdomains && i != 0) {
-        *ret = false;
-      } else {
-        out->sts_include_subdomains = entries[j].include_subdomains;
-        out->pkp_include_subdomains = entries[j].include_subdomains;
-        *ret = true;
-        if (!entries[j].https_required)
-          out->upgrade_mode = TransportSecurityState::DomainState::MODE_DEFAULT;
-        if (entries[j].pins.required_hashes) {
-          const char* const* sha1_hash = entries[j].pins.required_hashes;
-          while (*sha1_hash) {
-            AddHash(*sha1_hash, &out->static_spki_hashes);
-            sha1_hash++;
-          }
-        }
-        if (entries[j].pins.excluded_hashes) {
-          const char* const* sha1_hash = entries[j].pins.excluded_hashes;
-          while (*sha1_hash) {
-            AddHash(*sha1_hash, &out->bad_static_spki_hashes);
-            sha1_hash++;
-          }
-        }
-      }
-      return true;
+// Applies the preloaded |entry|, which matched |canonicalized_host| from
+// offset |i|, to |out|. Returns false if |i| is not zero and the entry does
+// not include subdomains.
+static bool ApplyPreload(const struct HSTSPreload* entry, size_t i,
+                         TransportSecurityState::DomainState* out) {
+  if (!entry->include_subdomains && i != 0)
+    return false;
+
+  out->sts_include_subdomains = entry->include_subdomains;
+  out->pkp_include_subdomains = entry->include_subdomains;
+  if (!entry->https_required)
+    out->upgrade_mode = TransportSecurityState::DomainState::MODE_DEFAULT;
+  if (entry->pins.required_hashes) {
+    const char* const* sha1_hash = entry->pins.required_hashes;
+    while (*sha1_hash) {
+      AddHash(*sha1_hash, &out->static_spki_hashes);
+      sha1_hash++;
     }
   }
-  return false;
+  if (entry->pins.excluded_hashes) {
+    const char* const* sha1_hash = entry->pins.excluded_hashes;
+    while (*sha1_hash) {
+      AddHash(*sha1_hash, &out->bad_static_spki_hashes);
+      sha1_hash++;
+    }
+  }
+  return true;
 }
 
 #include "net/http/transport_security_state_static.h"
 
-// Returns the HSTSPreload entry for the |canonicalized_host| in |entries|,
-// or NULL if there is none. Prefers exact hostname matches to those that
-// match only because HSTSPreload.include_subdomains is true.
+namespace {
+
+// Appends the offsets of the labels of |name|, which is in DNS form, to
+// |offsets|.
+void GetLabelOffsets(const char* name, size_t length,
+                     std::vector<size_t>* offsets) {
+  for (size_t i = 0; i < length && name[i]; i += name[i] + 1)
+    offsets->push_back(i);
+}
+
+base::StringPiece LabelAt(const char* name, size_t offset) {
+  return base::StringPiece(name + offset + 1,
+                           static_cast<unsigned char>(name[offset]));
+}
+
+// The entries of |kPreloadedSTS| and |kPreloadedSNISTS|, indexed by the labels
+// of their names from the top-level domain down. The entries for a host and
+// all of its parent domains are found by walking the labels of the host once,
+// instead of comparing each parent domain with every entry.
+class PreloadTrie {
+ public:
+  // The entries for one of the domains found by FindMatches().
+  struct Match {
+    // Offset of the domain in the canonicalized host.
+    size_t offset;
+    const struct HSTSPreload* sts_entry;
+    const struct HSTSPreload* sni_entry;
+  };
+
+  PreloadTrie() : nodes_(1) {
+    for (size_t i = 0; i < kNumPreloadedSTS; ++i)
+      Insert(&kPreloadedSTS[i], false);
+    for (size_t i = 0; i < kNumPreloadedSNISTS; ++i)
+      Insert(&kPreloadedSNISTS[i], true);
+  }
+
+  // Fills |matches| with the entries for |canonicalized_host| and its parent
+  // domains, from the longest domain to the shortest.
+  void FindMatches(const std::string& canonicalized_host,
+                   std::vector<Match>* matches) const {
+    matches->clear();
+    std::vector<size_t> offsets;
+    GetLabelOffsets(canonicalized_host.data(), canonicalized_host.size(),
+                    &offsets);
+    size_t node = 0;
+    for (std::vector<size_t>::reverse_iterator it = offsets.rbegin();
+         it != offsets.rend(); ++it) {
+      if (!FindChild(node, LabelAt(canonicalized_host.data(), *it), &node))
+        break;
+      if (nodes_[node].sts_entry || nodes_[node].sni_entry) {
+        Match match = { *it, nodes_[node].sts_entry, nodes_[node].sni_entry };
+        matches->push_back(match);
+      }
+    }
+    std::reverse(matches->begin(), matches->end());
+  }
+
+ private:
+  struct Child {
+    std::string label;
+    size_t node;
+  };
+
+  struct Node {
+    Node() : sts_entry(NULL), sni_entry(NULL) {}
+
+    const struct HSTSPreload* sts_entry;
+    const struct HSTSPreload* sni_entry;
+    // Sorted by label.
+    std::vector<Child> children;
+  };
+
+  static bool ChildLabelLess(const Child& child,
+                             const base::StringPiece& label) {
+    return base::StringPiece(child.label) < label;
+  }
+
+  std::vector<Child>::const_iterator LowerBound(
+      size_t node, const base::StringPiece& label) const {
+    return std::lower_bound(nodes_[node].children.begin(),
+                            nodes_[node].children.end(),
+                            label, ChildLabelLess);
+  }
+
+  bool FindChild(size_t node, const base::StringPiece& label,
+                 size_t* child) const {
+    std::vector<Child>::const_iterator it = LowerBound(node, label);
+    if (it == nodes_[node].children.end() || it->label != label)
+      return false;
+    *child = it->node;
+    return true;
+  }
+
+  void Insert(const struct HSTSPreload* entry, bool is_sni) {
+    std::vector<size_t> offsets;
+    GetLabelOffsets(entry->dns_name, entry->length, &offsets);
+    size_t node = 0;
+    for (std::vector<size_t>::reverse_iterator it = offsets.rbegin();
+         it != offsets.rend(); ++it) {
+      base::StringPiece label = LabelAt(entry->dns_name, *it);
+      size_t child;
+      if (!FindChild(node, label, &child)) {
+        child = nodes_.size();
+        size_t index = LowerBound(node, label) - nodes_[node].children.begin();
+        Child new_child;
+        label.CopyToString(&new_child.label);
+        new_child.node = child;
+        nodes_[node].children.insert(
+            nodes_[node].children.begin() + index, new_child);
+        nodes_.push_back(Node());
+      }
+      node = child;
+    }
+    // As with a scan of the lists, the first entry for a name wins.
+    const struct HSTSPreload** slot =
+        is_sni ? &nodes_[node].sni_entry : &nodes_[node].sts_entry;
+    if (!*slot)
+      *slot = entry;
+  }
+
+  // The root is the first node.
+  std::vector<Node> nodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreloadTrie);
+};
+
+base::LazyInstance<PreloadTrie>::Leaky g_preload_trie =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+// Returns the HSTSPreload entry for the |canonicalized_host| in
+// |kPreloadedSNISTS| if |sni| is true, or in |kPreloadedSTS| otherwise, or
+// NULL if there is none. Prefers exact hostname matches to those that match
+// only because HSTSPreload.include_subdomains is true.
 //
 // |canonicalized_host| should be the hostname as canonicalized by
 // CanonicalizeHost.
 static const struct HSTSPreload* GetHSTSPreload(
     const std::string& canonicalized_host,
-    const struct HSTSPreload* entries,
-    size_t num_entries) {
-  for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
-    for (size_t j = 0; j < num_entries; j++) {
-      const struct HSTSPreload* entry = entries + j;
-
-      if (i != 0 && !entry->include_subdomains)
-        continue;
-
-      if (entry->length == canonicalized_host.size() - i &&
-          memcmp(entry->dns_name, &canonicalized_host[i], entry->length) == 0) {
-        return entry;
-      }
-    }
+    bool sni) {
+  std::vector<PreloadTrie::Match> matches;
+  g_preload_trie.Get().FindMatches(canonicalized_host, &matches);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    const struct HSTSPreload* entry =
+        sni ? matches[i].sni_entry : matches[i].sts_entry;
+    if (!entry || (matches[i].offset != 0 && !entry->include_subdomains))
+      continue;
+    return entry;
   }
 
   return NULL;
@@ -701,15 +831,13 @@ bool TransportSecurityState::AddHPKP(const std::string& host,
 bool TransportSecurityState::IsGooglePinnedProperty(const std::string& host,
                                                     bool sni_enabled) {
   std::string canonicalized_host = CanonicalizeHost(host);
-  const struct HSTSPreload* entry =
-      GetHSTSPreload(canonicalized_host, kPreloadedSTS, kNumPreloadedSTS);
+  const struct HSTSPreload* entry = GetHSTSPreload(canonicalized_host, false);
 
   if (entry && entry->pins.required_hashes == kGoogleAcceptableCerts)
     return true;
 
   if (sni_enabled) {
-    entry = GetHSTSPreload(canonicalized_host, kPreloadedSNISTS,
-                           kNumPreloadedSNISTS);
+    entry = GetHSTSPreload(canonicalized_host, true);
     if (entry && entry->pins.required_hashes == kGoogleAcceptableCerts)
       return true;
   }
@@ -721,13 +849,10 @@ bool TransportSecurityState::IsGooglePinnedProperty(const std::string& host,
 void TransportSecurityState::ReportUMAOnPinFailure(const std::string& host) {
   std::string canonicalized_host = CanonicalizeHost(host);
 
-  const struct HSTSPreload* entry =
-      GetHSTSPreload(canonicalized_host, kPreloadedSTS, kNumPreloadedSTS);
+  const struct HSTSPreload* entry = GetHSTSPreload(canonicalized_host, false);
 
-  if (!entry) {
-    entry = GetHSTSPreload(canonicalized_host, kPreloadedSNISTS,
-                           kNumPreloadedSNISTS);
-  }
+  if (!entry)
+    entry = GetHSTSPreload(canonicalized_host, true);
 
   if (!entry) {
     // We don't care to report pin failures for dynamic pins.
@@ -759,24 +884,22 @@ bool TransportSecurityState::GetStaticDomainState(
   out->sts_include_subdomains = false;
   out->pkp_include_subdomains = false;
 
-  const bool is_build_timely = IsBuildTimely();
+  if (!IsBuildTimely())
+    return false;
 
-  for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
-    std::string host_sub_chunk(&canonicalized_host[i],
-                               canonicalized_host.size() - i);
-    out->domain = DNSDomainToString(host_sub_chunk);
-    bool ret;
-    if (is_build_timely &&
-        HasPreload(kPreloadedSTS, kNumPreloadedSTS, canonicalized_host, i, out,
-                   &ret)) {
-      return ret;
-    }
-    if (sni_enabled &&
-        is_build_timely &&
-        HasPreload(kPreloadedSNISTS, kNumPreloadedSNISTS, canonicalized_host, i,
-                   out, &ret)) {
-      return ret;
-    }
+  // The longest matching domain decides, even if its entry does not include
+  // subdomains.
+  std::vector<PreloadTrie::Match> matches;
+  g_preload_trie.Get().FindMatches(canonicalized_host, &matches);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    const struct HSTSPreload* entry = matches[i].sts_entry;
+    if (!entry && sni_enabled)
+      entry = matches[i].sni_entry;
+    if (!entry)
+      continue;
+    out->domain =
+        DNSDomainToString(canonicalized_host.substr(matches[i].offset));
+    return ApplyPreload(entry, matches[i].offset, out);
   }
 
   return false;
@@ -786,6 +909,9 @@ bool TransportSecurityState::GetDynamicDomainState(const std::string& host,
                                                    DomainState* result) {
   DCHECK(CalledOnValidThread());
 
+  if (enabled_hosts_.empty())
+    return false;
+
   DomainState state;
   const std::string canonicalized_host = CanonicalizeHost(host);
   if (canonicalized_host.empty())
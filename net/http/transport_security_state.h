@@ -5,12 +5,12 @@
 #ifndef NET_HTTP_TRANSPORT_SECURITY_STATE_H_
 #define NET_HTTP_TRANSPORT_SECURITY_STATE_H_
 
-#include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
 #include "base/gtest_prod_util.h"
 #include "base/threading/non_thread_safe.h"
 #include "base/time/time.h"
@@ -141,6 +141,12 @@ class NET_EXPORT TransportSecurityState
     std::string domain;
   };
 
+ private:
+  // Dynamic DomainStates, keyed by HashHost(CanonicalizeHost(host)). The keys
+  // are SHA-256 digests, so they spread evenly over the buckets.
+  typedef base::hash_map<std::string, DomainState> DomainStateMap;
+
+ public:
   class NET_EXPORT Iterator {
    public:
     explicit Iterator(const TransportSecurityState& state);
@@ -152,8 +158,8 @@ class NET_EXPORT TransportSecurityState
     const DomainState& domain_state() const { return iterator_->second; }
 
    private:
-    std::map<std::string, DomainState>::const_iterator iterator_;
-    std::map<std::string, DomainState>::const_iterator end_;
+    DomainStateMap::const_iterator iterator_;
+    DomainStateMap::const_iterator end_;
   };
 
   // Assign a |Delegate| for persisting the transport security state. If
@@ -265,8 +271,6 @@ class NET_EXPORT TransportSecurityState
   FRIEND_TEST_ALL_PREFIXES(HttpSecurityHeadersTest,
                            UpdateDynamicPKPOnly);
 
-  typedef std::map<std::string, DomainState> DomainStateMap;
-
   // If a Delegate is present, notify it that the internal state has
   // changed.
   void DirtyNotify();
@@ -0,0 +1,86 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/transport_security_state.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if defined(USE_OPENSSL)
+#include "crypto/openssl_util.h"
+#else
+#include "crypto/nss_util.h"
+#endif
+
+namespace net {
+
+namespace {
+
+const int kIterations = 20000;
+
+// The hosts of a mix of URL requests: preloaded hosts, subdomains of
+// preloaded hosts, and hosts without any state.
+const char* const kHosts[] = {
+  "www.google.com",
+  "ssl.gstatic.com",
+  "a.b.c.googleusercontent.com",
+  "www.paypal.com",
+  "twitter.com",
+  "www.example.com",
+  "static.ak.fbcdn.net",
+  "en.wikipedia.org",
+  "images.example.co.uk",
+  "a.very.deep.subdomain.of.some.host.example.org",
+};
+
+// Looks up the hosts of |kIterations| requests, and logs the time per lookup
+// as |test_name|.
+void LookUpHosts(TransportSecurityState* state, const std::string& test_name) {
+  TransportSecurityState::DomainState domain_state;
+  int found = 0;
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    if (state->GetDomainState(kHosts[i % arraysize(kHosts)], true,
+                              &domain_state)) {
+      ++found;
+    }
+  }
+  base::TimeDelta elapsed = timer.Elapsed();
+  EXPECT_GT(found, 0);
+  LogPerfResult(test_name.c_str(),
+                elapsed.InMicroseconds() / static_cast<double>(kIterations),
+                "us");
+}
+
+class TransportSecurityStatePerfTest : public testing::Test {
+  virtual void SetUp() {
+#if defined(USE_OPENSSL)
+    crypto::EnsureOpenSSLInit();
+#else
+    crypto::EnsureNSSInit();
+#endif
+  }
+};
+
+TEST_F(TransportSecurityStatePerfTest, StaticOnly) {
+  TransportSecurityState state;
+  LookUpHosts(&state, "TransportSecurityState_StaticOnly");
+}
+
+TEST_F(TransportSecurityStatePerfTest, ThousandDynamicEntries) {
+  TransportSecurityState state;
+  const base::Time expiry = base::Time::Now() + base::TimeDelta::FromDays(1);
+  for (int i = 0; i < 1000; ++i)
+    state.AddHSTS(base::StringPrintf("host%d.example.net", i), expiry, true);
+  LookUpHosts(&state, "TransportSecurityState_ThousandDynamicEntries");
+}
+
+}  // namespace
+
+}  // namespace net
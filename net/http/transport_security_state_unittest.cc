@@ -12,6 +12,7 @@
 #include "base/files/file_path.h"
 #include "base/sha1.h"
 #include "base/strings/string_piece.h"
+#include "base/strings/stringprintf.h"
 #include "crypto/sha2.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_log.h"
@@ -183,6 +184,58 @@ TEST_F(TransportSecurityStateTest, PreloadedDomainSet) {
   EXPECT_EQ(domain_state.domain, "market.android.com");
 }
 
+TEST_F(TransportSecurityStateTest, PreloadsWithAndWithoutDynamicEntries) {
+  TransportSecurityState state;
+  TransportSecurityState::DomainState domain_state;
+  const base::Time expiry =
+      base::Time::Now() + base::TimeDelta::FromSeconds(1000);
+
+  // The second pass looks up the same hosts with a dynamic entry present.
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(state.GetDomainState("www.paypal.com", true, &domain_state));
+    EXPECT_EQ("www.paypal.com", domain_state.domain);
+    EXPECT_FALSE(state.GetDomainState("a.www.paypal.com", true,
+                                      &domain_state));
+
+    // ssl.google-analytics.com is in the STS list, and its parent domain is
+    // in the SNI list.
+    EXPECT_TRUE(state.GetDomainState("a.ssl.google-analytics.com", false,
+                                     &domain_state));
+    EXPECT_EQ("ssl.google-analytics.com", domain_state.domain);
+    EXPECT_FALSE(state.GetDomainState("a.google-analytics.com", false,
+                                      &domain_state));
+    EXPECT_TRUE(state.GetDomainState("a.google-analytics.com", true,
+                                     &domain_state));
+    EXPECT_EQ("google-analytics.com", domain_state.domain);
+
+    state.AddHSTS("example.com", expiry, true);
+  }
+}
+
+TEST_F(TransportSecurityStateTest, ManyDynamicEntries) {
+  TransportSecurityState state;
+  TransportSecurityState::DomainState domain_state;
+  const base::Time expiry =
+      base::Time::Now() + base::TimeDelta::FromSeconds(1000);
+
+  const int kNumHosts = 1000;
+  for (int i = 0; i < kNumHosts; ++i)
+    state.AddHSTS(base::StringPrintf("host%d.example", i), expiry, i % 2 == 0);
+
+  for (int i = 0; i < kNumHosts; ++i) {
+    std::string host = base::StringPrintf("host%d.example", i);
+    EXPECT_TRUE(state.GetDomainState(host, true, &domain_state));
+    EXPECT_EQ(host, domain_state.domain);
+    EXPECT_EQ(i % 2 == 0,
+              state.GetDomainState("www." + host, true, &domain_state));
+  }
+  EXPECT_FALSE(state.GetDomainState("example", true, &domain_state));
+
+  EXPECT_TRUE(state.DeleteDynamicDataForHost("host1.example"));
+  EXPECT_FALSE(state.GetDomainState("host1.example", true, &domain_state));
+  EXPECT_TRUE(state.GetDomainState("host2.example", true, &domain_state));
+}
+
 static bool ShouldRedirect(const char* hostname) {
   TransportSecurityState state;
   TransportSecurityState::DomainState domain_state;
@@ -384,6 +384,10 @@ size_t QuicSession::GetNumOpenStreams() const {
   return stream_map_.size() + implicitly_created_streams_.size();
 }
 
+bool QuicSession::HasAvailableStreamCapacity() const {
+  return GetNumOpenStreams() < max_open_streams_;
+}
+
 void QuicSession::MarkWriteBlocked(QuicStreamId id) {
   write_blocked_streams_.AddBlockedObject(id);
 }
@@ -129,6 +129,9 @@ class NET_EXPORT_PRIVATE QuicSession : public QuicConnectionVisitorInterface {
   // been implicitly created.
   virtual size_t GetNumOpenStreams() const;
 
+  // Returns true if another outgoing stream can be opened right away.
+  bool HasAvailableStreamCapacity() const;
+
   void MarkWriteBlocked(QuicStreamId id);
 
   // Marks that |stream_id| is blocked waiting to decompress the
@@ -9,11 +9,13 @@
 #include "base/logging.h"
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_loop_proxy.h"
+#include "base/metrics/histogram.h"
 #include "base/rand_util.h"
 #include "base/stl_util.h"
 #include "base/values.h"
 #include "net/base/net_errors.h"
 #include "net/cert/cert_verifier.h"
+#include "net/cert/x509_certificate.h"
 #include "net/dns/host_resolver.h"
 #include "net/dns/single_request_host_resolver.h"
 #include "net/quic/crypto/proof_verifier_chromium.h"
@@ -26,6 +28,7 @@
 #include "net/quic/quic_http_stream.h"
 #include "net/quic/quic_protocol.h"
 #include "net/socket/client_socket_factory.h"
+#include "net/ssl/ssl_info.h"
 
 namespace net {
 
@@ -168,6 +171,12 @@ int QuicStreamFactory::Job::DoResolveHostComplete(int rv) {
   }
 
   DCHECK(!factory_->HasActiveSession(host_port_proxy_pair_));
+
+  // Inform the factory of this resolution, which will set up
+  // a session alias, if possible.
+  if (factory_->OnResolution(host_port_proxy_pair_, is_https_, address_list_))
+    return OK;
+
   io_state_ = STATE_CONNECT;
   return OK;
 }
@@ -252,6 +261,7 @@ QuicStreamFactory::QuicStreamFactory(
       quic_crypto_client_stream_factory_(quic_crypto_client_stream_factory),
       random_generator_(random_generator),
       clock_(clock),
+      num_sessions_saved_by_pooling_(0),
       weak_factory_(this) {
   config_.SetDefaults();
   config_.set_idle_connection_state_lifetime(
@@ -299,6 +309,57 @@ int QuicStreamFactory::Create(const HostPortProxyPair& host_port_proxy_pair,
   return rv;
 }
 
+bool QuicStreamFactory::OnResolution(
+    const HostPortProxyPair& host_port_proxy_pair,
+    bool is_https,
+    const AddressList& address_list) {
+  DCHECK(!HasActiveSession(host_port_proxy_pair));
+  for (AddressList::const_iterator address_it = address_list.begin();
+       address_it != address_list.end(); ++address_it) {
+    IPAliasMap::const_iterator alias_it = ip_aliases_.find(*address_it);
+    if (alias_it == ip_aliases_.end())
+      continue;
+
+    const SessionSet& sessions = alias_it->second;
+    for (SessionSet::const_iterator it = sessions.begin();
+         it != sessions.end(); ++it) {
+      QuicClientSession* session = *it;
+      // The session must be reachable through the same proxy.
+      const AliasSet& aliases = session_aliases_[session];
+      if (aliases.empty() ||
+          !(aliases.begin()->second == host_port_proxy_pair.second)) {
+        continue;
+      }
+      if (!CanPool(session, host_port_proxy_pair.first.host(), is_https)) {
+        UMA_HISTOGRAM_BOOLEAN("Net.QuicSession.IPPoolDomainMatch", false);
+        continue;
+      }
+
+      UMA_HISTOGRAM_BOOLEAN("Net.QuicSession.IPPoolDomainMatch", true);
+      ++num_sessions_saved_by_pooling_;
+      active_sessions_[host_port_proxy_pair] = session;
+      session_aliases_[session].insert(host_port_proxy_pair);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool QuicStreamFactory::CanPool(QuicClientSession* session,
+                                const std::string& host,
+                                bool is_https) {
+  if (!session->HasAvailableStreamCapacity())
+    return false;
+
+  SSLInfo ssl_info;
+  bool is_secure_session = session->GetSSLInfo(&ssl_info) && ssl_info.cert;
+  if (!is_https) {
+    // Never send http requests over a session authenticated for https.
+    return !is_secure_session;
+  }
+  return is_secure_session && ssl_info.cert->VerifyNameMatch(host);
+}
+
 void QuicStreamFactory::OnJobComplete(Job* job, int rv) {
   if (rv == OK) {
     // Create all the streams, but do not notify them yet.
@@ -352,6 +413,12 @@ void QuicStreamFactory::OnSessionClose(QuicClientSession* session) {
     DCHECK_EQ(session, active_sessions_[*it]);
     active_sessions_.erase(*it);
   }
+  IPAliasMap::iterator ip_it = ip_aliases_.find(session->peer_address());
+  if (ip_it != ip_aliases_.end()) {
+    ip_it->second.erase(session);
+    if (ip_it->second.empty())
+      ip_aliases_.erase(ip_it);
+  }
   all_sessions_.erase(session);
   session_aliases_.erase(session);
   delete session;
@@ -470,6 +537,10 @@ void QuicStreamFactory::ActivateSession(
   DCHECK(!HasActiveSession(host_port_proxy_pair));
   active_sessions_[host_port_proxy_pair] = session;
   session_aliases_[session].insert(host_port_proxy_pair);
+  // Only direct connections can be pooled by address, since the peer address
+  // of a proxied session is that of the proxy.
+  if (host_port_proxy_pair.second.is_direct())
+    ip_aliases_[session->peer_address()].insert(session);
 }
 
 QuicCryptoClientConfig* QuicStreamFactory::GetOrCreateCryptoConfig(
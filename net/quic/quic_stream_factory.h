@@ -6,12 +6,14 @@
 #define NET_QUIC_QUIC_STREAM_FACTORY_H_
 
 #include <map>
+#include <set>
 #include <string>
 
 #include "base/memory/weak_ptr.h"
 #include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
 #include "net/base/host_port_pair.h"
+#include "net/base/ip_endpoint.h"
 #include "net/base/net_log.h"
 #include "net/base/network_change_notifier.h"
 #include "net/proxy/proxy_server.h"
@@ -114,6 +116,13 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
 
   base::Value* QuicStreamFactoryInfoToValue() const;
 
+  // Returns the number of requests which were served by an existing session
+  // to a different origin (one sharing an IP address and, for https, covered
+  // by the session's certificate) instead of a new connection.
+  size_t num_sessions_saved_by_pooling() const {
+    return num_sessions_saved_by_pooling_;
+  }
+
   // NetworkChangeNotifier::IPAddressObserver methods:
 
   // Until the servers support roaming, close all connections when the local
@@ -127,6 +136,7 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   typedef std::set<HostPortProxyPair> AliasSet;
   typedef std::map<QuicClientSession*, AliasSet> SessionAliasMap;
   typedef std::set<QuicClientSession*> SessionSet;
+  typedef std::map<IPEndPoint, SessionSet> IPAliasMap;
   typedef std::map<HostPortProxyPair, QuicCryptoClientConfig*> CryptoConfigMap;
   typedef std::map<HostPortProxyPair, Job*> JobMap;
   typedef std::map<QuicStreamRequest*, Job*> RequestMap;
@@ -134,6 +144,18 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   typedef std::map<Job*, RequestSet> JobRequestsMap;
 
   void OnJobComplete(Job* job, int rv);
+  // Called by a Job once |host_port_proxy_pair| has been resolved to
+  // |address_list|. Returns true if an existing session to one of those
+  // addresses can serve |host_port_proxy_pair|, in which case the session is
+  // aliased to it and no new connection needs to be made.
+  bool OnResolution(const HostPortProxyPair& host_port_proxy_pair,
+                    bool is_https,
+                    const AddressList& address_list);
+  // Returns true if |session| may carry streams for |host|: it must have room
+  // for another stream and, if |is_https|, its certificate must cover |host|.
+  bool CanPool(QuicClientSession* session,
+               const std::string& host,
+               bool is_https);
   bool HasActiveSession(const HostPortProxyPair& host_port_proxy_pair);
   bool HasActiveJob(const HostPortProxyPair& host_port_proxy_pair);
   QuicClientSession* CreateSession(
@@ -160,6 +182,10 @@ class NET_EXPORT_PRIVATE QuicStreamFactory
   // (not going away session, once they're implemented).
   SessionMap active_sessions_;
   SessionAliasMap session_aliases_;
+  // Maps the peer address of each active session to the sessions connected
+  // to it, so that origins resolving to the same address can share them.
+  IPAliasMap ip_aliases_;
+  size_t num_sessions_saved_by_pooling_;
 
   // Contains owning pointers to QuicCryptoClientConfig. QuicCryptoClientConfig
   // contains configuration and cached state about servers.
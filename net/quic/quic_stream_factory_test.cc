@@ -167,6 +167,114 @@ TEST_F(QuicStreamFactoryTest, Create) {
   EXPECT_TRUE(socket_data.at_write_eof());
 }
 
+TEST_F(QuicStreamFactoryTest, Pooling) {
+  MockRead reads[] = {
+    MockRead(ASYNC, OK, 0)  // EOF
+  };
+  DeterministicSocketData socket_data(reads, arraysize(reads), NULL, 0);
+  socket_factory_.AddSocketDataProvider(&socket_data);
+  socket_data.StopAfter(1);
+
+  HostPortProxyPair server2(HostPortPair("mail.google.com", 443),
+                            ProxyServer::Direct());
+  host_resolver_.rules()->AddIPLiteralRule(
+      host_port_proxy_pair_.first.host(), "192.168.0.1", std::string());
+  host_resolver_.rules()->AddIPLiteralRule(
+      server2.first.host(), "192.168.0.1", std::string());
+
+  QuicStreamRequest request(&factory_);
+  EXPECT_EQ(ERR_IO_PENDING, request.Request(host_port_proxy_pair_, is_https_,
+                                            cert_verifier_.get(), net_log_,
+                                            callback_.callback()));
+  EXPECT_EQ(OK, callback_.WaitForResult());
+  scoped_ptr<QuicHttpStream> stream = request.ReleaseStream();
+  EXPECT_TRUE(stream.get());
+  EXPECT_EQ(0u, factory_.num_sessions_saved_by_pooling());
+
+  // The second server resolves to the same address, so it should share the
+  // first session rather than open a new connection.
+  TestCompletionCallback callback;
+  QuicStreamRequest request2(&factory_);
+  EXPECT_EQ(ERR_IO_PENDING, request2.Request(server2, is_https_,
+                                             cert_verifier_.get(), net_log_,
+                                             callback.callback()));
+  EXPECT_EQ(OK, callback.WaitForResult());
+  scoped_ptr<QuicHttpStream> stream2 = request2.ReleaseStream();
+  EXPECT_TRUE(stream2.get());
+  EXPECT_EQ(1u, factory_.num_sessions_saved_by_pooling());
+
+  // Both servers are now served by an active session.
+  EXPECT_TRUE(factory_.CreateIfSessionExists(server2, net_log_).get());
+
+  stream.reset();
+  stream2.reset();
+
+  EXPECT_TRUE(socket_data.at_read_eof());
+  EXPECT_TRUE(socket_data.at_write_eof());
+}
+
+TEST_F(QuicStreamFactoryTest, NoPoolingWhenSessionIsFull) {
+  MockRead reads[] = {
+    MockRead(ASYNC, OK, 0)  // EOF
+  };
+  DeterministicSocketData socket_data1(reads, arraysize(reads), NULL, 0);
+  DeterministicSocketData socket_data2(reads, arraysize(reads), NULL, 0);
+  socket_factory_.AddSocketDataProvider(&socket_data1);
+  socket_factory_.AddSocketDataProvider(&socket_data2);
+  socket_data1.StopAfter(1);
+  socket_data2.StopAfter(1);
+
+  HostPortProxyPair server2(HostPortPair("mail.google.com", 443),
+                            ProxyServer::Direct());
+  host_resolver_.rules()->AddIPLiteralRule(
+      host_port_proxy_pair_.first.host(), "192.168.0.1", std::string());
+  host_resolver_.rules()->AddIPLiteralRule(
+      server2.first.host(), "192.168.0.1", std::string());
+
+  // Open as many streams as the first session allows.
+  HttpRequestInfo request_info;
+  std::vector<QuicHttpStream*> streams;
+  for (size_t i = 0; i < 2 * kDefaultMaxStreamsPerConnection; i++) {
+    QuicStreamRequest request(&factory_);
+    int rv = request.Request(host_port_proxy_pair_, is_https_,
+                             cert_verifier_.get(), net_log_,
+                             callback_.callback());
+    if (i == 0) {
+      EXPECT_EQ(ERR_IO_PENDING, rv);
+      EXPECT_EQ(OK, callback_.WaitForResult());
+    } else {
+      EXPECT_EQ(OK, rv);
+    }
+    scoped_ptr<QuicHttpStream> stream = request.ReleaseStream();
+    EXPECT_TRUE(stream);
+    EXPECT_EQ(OK, stream->InitializeStream(
+        &request_info, DEFAULT_PRIORITY, net_log_, CompletionCallback()));
+    streams.push_back(stream.release());
+  }
+
+  // The second server resolves to the same address, but the full session
+  // can not take its stream, so it gets a session of its own.
+  TestCompletionCallback callback;
+  QuicStreamRequest request2(&factory_);
+  EXPECT_EQ(ERR_IO_PENDING, request2.Request(server2, is_https_,
+                                             cert_verifier_.get(), net_log_,
+                                             callback.callback()));
+  EXPECT_EQ(OK, callback.WaitForResult());
+  scoped_ptr<QuicHttpStream> stream2 = request2.ReleaseStream();
+  EXPECT_TRUE(stream2.get());
+  EXPECT_EQ(OK, stream2->InitializeStream(
+      &request_info, DEFAULT_PRIORITY, net_log_, CompletionCallback()));
+  EXPECT_EQ(0u, factory_.num_sessions_saved_by_pooling());
+
+  stream2.reset();
+  STLDeleteElements(&streams);
+
+  EXPECT_TRUE(socket_data1.at_read_eof());
+  EXPECT_TRUE(socket_data1.at_write_eof());
+  EXPECT_TRUE(socket_data2.at_read_eof());
+  EXPECT_TRUE(socket_data2.at_write_eof());
+}
+
 TEST_F(QuicStreamFactoryTest, MaxOpenStream) {
   MockRead reads[] = {
     MockRead(ASYNC, OK, 0)  // EOF
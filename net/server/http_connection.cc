@@ -5,6 +5,7 @@
 #include "net/server/http_connection.h"
 
 #include "net/server/http_server.h"
+#include "net/server/http_server_request_info.h"
 #include "net/server/http_server_response_info.h"
 #include "net/server/web_socket.h"
 #include "net/socket/stream_listen_socket.h"
@@ -31,7 +32,11 @@ void HttpConnection::Send(const HttpServerResponseInfo& response) {
 
 HttpConnection::HttpConnection(HttpServer* server, StreamListenSocket* sock)
     : server_(server),
-      socket_(sock) {
+      socket_(sock),
+      parse_state_(0),
+      parse_pos_(0),
+      headers_complete_(false),
+      request_keep_alive_(true) {
   id_ = last_id_++;
 }
 
@@ -44,8 +49,16 @@ void HttpConnection::DetachSocket() {
   socket_ = NULL;
 }
 
+void HttpConnection::ResetParser() {
+  request_.reset();
+  parse_pos_ = 0;
+  headers_complete_ = false;
+  parse_buffer_.clear();
+  parse_header_name_.clear();
+}
+
 void HttpConnection::Shift(int num_bytes) {
-  recv_data_ = recv_data_.substr(num_bytes);
+  recv_data_.erase(0, num_bytes);
 }
 
 }  // namespace net
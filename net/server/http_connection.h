@@ -5,6 +5,7 @@
 #ifndef NET_SERVER_HTTP_CONNECTION_H_
 #define NET_SERVER_HTTP_CONNECTION_H_
 
+#include <queue>
 #include <string>
 
 #include "base/basictypes.h"
@@ -15,6 +16,7 @@
 namespace net {
 
 class HttpServer;
+class HttpServerRequestInfo;
 class HttpServerResponseInfo;
 class StreamListenSocket;
 class WebSocket;
@@ -40,11 +42,35 @@ class HttpConnection {
 
   void DetachSocket();
 
+  // Discards the parsed request, ready for the next one.
+  void ResetParser();
+
   HttpServer* server_;
   scoped_refptr<StreamListenSocket> socket_;
   scoped_ptr<WebSocket> web_socket_;
   std::string recv_data_;
   int id_;
+
+  // State of HttpServer's request parser, kept across reads so that the
+  // buffered part of a request is not scanned again when more data arrives.
+  // |request_| holds the request being parsed, and is NULL between requests.
+  // |parse_pos_| is the offset in |recv_data_| where parsing resumes, and
+  // |parse_state_| and the two buffers hold the parser's position within the
+  // current token. |headers_complete_| is set once the LF ending the headers
+  // has been consumed, while the body may still be arriving.
+  scoped_ptr<HttpServerRequestInfo> request_;
+  int parse_state_;
+  size_t parse_pos_;
+  bool headers_complete_;
+  std::string parse_buffer_;
+  std::string parse_header_name_;
+  bool request_keep_alive_;
+
+  // For each request passed to the delegate and not yet responded to, whether
+  // the connection is to be kept alive after the response. Responses must be
+  // sent in the order of the requests.
+  std::queue<bool> keep_alive_after_response_;
+
   DISALLOW_COPY_AND_ASSIGN(HttpConnection);
 };
 
@@ -53,6 +53,13 @@ void HttpServer::SendResponse(int connection_id,
   if (connection == NULL)
     return;
   connection->Send(response);
+
+  if (connection->keep_alive_after_response_.empty())
+    return;
+  bool keep_alive = connection->keep_alive_after_response_.front();
+  connection->keep_alive_after_response_.pop();
+  if (!keep_alive)
+    Close(connection_id);
 }
 
 void HttpServer::Send(int connection_id,
@@ -126,46 +133,70 @@ void HttpServer::DidRead(StreamListenSocket* socket,
       continue;
     }
 
-    HttpServerRequestInfo request;
-    size_t pos = 0;
-    if (!ParseHeaders(connection, &request, &pos))
+    if (!ParseHeaders(connection))
       break;
+    HttpServerRequestInfo* request = connection->request_.get();
+    size_t pos = connection->parse_pos_;
 
-    std::string connection_header = request.GetHeaderValue("connection");
+    std::string connection_header = request->GetHeaderValue("connection");
     if (connection_header == "Upgrade") {
       connection->web_socket_.reset(WebSocket::CreateWebSocket(connection,
-                                                               request,
+                                                               *request,
                                                                &pos));
 
       if (!connection->web_socket_.get())  // Not enough data was received.
         break;
-      delegate_->OnWebSocketRequest(connection->id(), request);
+      scoped_ptr<HttpServerRequestInfo> upgrade_request(
+          connection->request_.Pass());
       connection->Shift(pos);
+      connection->ResetParser();
+      int connection_id = connection->id();
+      delegate_->OnWebSocketRequest(connection_id, *upgrade_request);
+      if (!FindConnection(connection_id))
+        return;  // The delegate closed the connection.
       continue;
     }
 
     const char kContentLength[] = "content-length";
-    if (request.headers.count(kContentLength)) {
+    if (request->headers.count(kContentLength)) {
       size_t content_length = 0;
       const size_t kMaxBodySize = 100 << 20;
-      if (!base::StringToSizeT(request.GetHeaderValue(kContentLength),
+      if (!base::StringToSizeT(request->GetHeaderValue(kContentLength),
                                &content_length) ||
           content_length > kMaxBodySize) {
         connection->Send(HttpServerResponseInfo::CreateFor500(
             "request content-length too big or unknown: " +
-            request.GetHeaderValue(kContentLength)));
+            request->GetHeaderValue(kContentLength)));
         DidClose(socket);
-        break;
+        return;
       }
 
+      // The headers stay parsed while the body arrives.
       if (connection->recv_data_.length() - pos < content_length)
         break;  // Not enough data was received yet.
-      request.data = connection->recv_data_.substr(pos, content_length);
+      request->data = connection->recv_data_.substr(pos, content_length);
       pos += content_length;
     }
 
-    delegate_->OnHttpRequest(connection->id(), request);
+    // HTTP/1.1 connections persist unless the client asks to close them, and
+    // HTTP/1.0 ones only if the client asks to keep them alive.
+    bool keep_alive = connection->request_keep_alive_;
+    if (LowerCaseEqualsASCII(connection_header, "close"))
+      keep_alive = false;
+    else if (LowerCaseEqualsASCII(connection_header, "keep-alive"))
+      keep_alive = true;
+    connection->keep_alive_after_response_.push(keep_alive);
+
+    scoped_ptr<HttpServerRequestInfo> completed_request(
+        connection->request_.Pass());
     connection->Shift(pos);
+    connection->ResetParser();
+    int connection_id = connection->id();
+    delegate_->OnHttpRequest(connection_id, *completed_request);
+    if (!FindConnection(connection_id))
+      return;  // The delegate closed the connection.
+    if (!keep_alive)
+      break;  // Requests pipelined after this one are not served.
   }
 }
 
@@ -187,7 +218,9 @@ HttpServer::~HttpServer() {
 // HTTP Request Parser
 // This HTTP request parser uses a simple state machine to quickly parse
 // through the headers.  The parser is not 100% complete, as it is designed
-// for use in this simple test driver.
+// for use in this simple test driver.  Its state is kept in the
+// HttpConnection, so each received byte is scanned only once even when the
+// headers arrive over several reads.
 //
 // Known issues:
 //   - does not handle whitespace on first HTTP line correctly.  Expects
@@ -245,17 +278,27 @@ int charToInput(char ch) {
   return INPUT_DEFAULT;
 }
 
-bool HttpServer::ParseHeaders(HttpConnection* connection,
-                              HttpServerRequestInfo* info,
-                              size_t* ppos) {
-  size_t& pos = *ppos;
-  size_t data_len = connection->recv_data_.length();
-  int state = ST_METHOD;
-  std::string buffer;
-  std::string header_name;
-  std::string header_value;
+bool HttpServer::ParseHeaders(HttpConnection* connection) {
+  if (!connection->request_) {
+    connection->request_.reset(new HttpServerRequestInfo);
+    connection->parse_state_ = ST_METHOD;
+    connection->parse_pos_ = 0;
+    connection->headers_complete_ = false;
+  }
+  // ST_DONE is entered on the final CR, so only skip parsing once the LF
+  // after it has been consumed too.
+  if (connection->headers_complete_)
+    return true;  // Still waiting for the body.
+
+  HttpServerRequestInfo* info = connection->request_.get();
+  const std::string& data = connection->recv_data_;
+  size_t& pos = connection->parse_pos_;
+  int& state = connection->parse_state_;
+  std::string& buffer = connection->parse_buffer_;
+  std::string& header_name = connection->parse_header_name_;
+  size_t data_len = data.length();
   while (pos < data_len) {
-    char ch = connection->recv_data_[pos++];
+    char ch = data[pos++];
     int input = charToInput(ch);
     int next_state = parser_state[state][input];
 
@@ -273,20 +316,23 @@ bool HttpServer::ParseHeaders(HttpConnection* connection,
           break;
         case ST_PROTO:
           // TODO(mbelshe): Deal better with parsing protocol.
-          DCHECK(buffer == "HTTP/1.1");
+          DCHECK(buffer == "HTTP/1.1" || buffer == "HTTP/1.0");
+          connection->request_keep_alive_ = (buffer == "HTTP/1.1");
           buffer.clear();
           break;
         case ST_NAME:
           header_name = StringToLowerASCII(buffer);
           buffer.clear();
           break;
-        case ST_VALUE:
+        case ST_VALUE: {
+          std::string header_value;
           TrimWhitespaceASCII(buffer, TRIM_LEADING, &header_value);
           // TODO(mbelshe): Deal better with duplicate headers
           DCHECK(info->headers.find(header_name) == info->headers.end());
           info->headers[header_name] = header_value;
           buffer.clear();
           break;
+        }
         case ST_SEPARATOR:
           break;
       }
@@ -303,6 +349,7 @@ bool HttpServer::ParseHeaders(HttpConnection* connection,
           break;
         case ST_DONE:
           DCHECK(input == INPUT_LF);
+          connection->headers_complete_ = true;
           return true;
         case ST_ERR:
           return false;
@@ -78,12 +78,11 @@ class HttpServer : public StreamListenSocket::Delegate,
   friend class base::RefCountedThreadSafe<HttpServer>;
   friend class HttpConnection;
 
-  // Expects the raw data to be stored in recv_data_. If parsing is successful,
-  // will remove the data parsed from recv_data_, leaving only the unused
-  // recv data.
-  bool ParseHeaders(HttpConnection* connection,
-                    HttpServerRequestInfo* info,
-                    size_t* pos);
+  // Parses the request headers in the connection's recv_data_, resuming where
+  // the previous call stopped. Returns true once the headers are complete,
+  // with the request in connection->request_ and connection->parse_pos_ at
+  // the start of the body.
+  bool ParseHeaders(HttpConnection* connection);
 
   HttpConnection* FindConnection(int connection_id);
   HttpConnection* FindConnection(StreamListenSocket* socket);
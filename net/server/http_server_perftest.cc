@@ -0,0 +1,140 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "net/base/address_list.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/test_completion_callback.h"
+#include "net/server/http_server.h"
+#include "net/server/http_server_request_info.h"
+#include "net/socket/tcp_client_socket.h"
+#include "net/socket/tcp_listen_socket.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kRequests = 10000;
+const int kPipelineDepth = 100;
+
+const char kRequest[] = "GET /test HTTP/1.1\r\nHost: localhost\r\n\r\n";
+const char kResponseBody[] = "ok";
+
+// Returns the number of times |pattern| occurs in |data|.
+int CountOccurrences(const std::string& data, const std::string& pattern) {
+  int count = 0;
+  for (size_t pos = data.find(pattern); pos != std::string::npos;
+       pos = data.find(pattern, pos + pattern.length())) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+class HttpServerPerfTest : public testing::Test,
+                           public HttpServer::Delegate {
+ public:
+  virtual void SetUp() OVERRIDE {
+    TCPListenSocketFactory socket_factory("127.0.0.1", 0);
+    server_ = new HttpServer(socket_factory, this);
+    IPEndPoint address;
+    ASSERT_EQ(OK, server_->GetLocalAddress(&address));
+
+    socket_.reset(
+        new TCPClientSocket(AddressList(address), NULL, NetLog::Source()));
+    TestCompletionCallback callback;
+    ASSERT_EQ(OK, callback.GetResult(socket_->Connect(callback.callback())));
+  }
+
+  virtual void OnHttpRequest(int connection_id,
+                             const HttpServerRequestInfo& info) OVERRIDE {
+    server_->Send200(connection_id, kResponseBody, "text/plain");
+  }
+
+  virtual void OnWebSocketRequest(int connection_id,
+                                  const HttpServerRequestInfo& info) OVERRIDE {
+    NOTREACHED();
+  }
+
+  virtual void OnWebSocketMessage(int connection_id,
+                                  const std::string& data) OVERRIDE {
+    NOTREACHED();
+  }
+
+  virtual void OnClose(int connection_id) OVERRIDE {}
+
+ protected:
+  // Writes all of |data| to the server.
+  void Write(const std::string& data) {
+    scoped_refptr<DrainableIOBuffer> buffer(
+        new DrainableIOBuffer(new StringIOBuffer(data), data.length()));
+    while (buffer->BytesRemaining()) {
+      TestCompletionCallback callback;
+      int result = callback.GetResult(socket_->Write(
+          buffer.get(), buffer->BytesRemaining(), callback.callback()));
+      ASSERT_GT(result, 0);
+      buffer->DidConsume(result);
+    }
+  }
+
+  // Reads until |count| complete responses have been received.
+  void ReadResponses(int count) {
+    const std::string end_of_response = std::string("\r\n\r\n") +
+                                        kResponseBody;
+    std::string received;
+    scoped_refptr<IOBuffer> buffer(new IOBuffer(4096));
+    while (CountOccurrences(received, end_of_response) < count) {
+      TestCompletionCallback callback;
+      int result = callback.GetResult(
+          socket_->Read(buffer.get(), 4096, callback.callback()));
+      ASSERT_GT(result, 0);
+      received.append(buffer->data(), result);
+    }
+  }
+
+  base::MessageLoopForIO message_loop_;
+  scoped_refptr<HttpServer> server_;
+  scoped_ptr<TCPClientSocket> socket_;
+};
+
+// Sends one request at a time on a keep-alive connection; the time per
+// request is the round trip latency through the server.
+TEST_F(HttpServerPerfTest, KeepAliveLatency) {
+  PerfTimeLogger timer("HttpServer_KeepAlive_Latency");
+  for (int i = 0; i < kRequests; ++i) {
+    Write(kRequest);
+    ReadResponses(1);
+  }
+  timer.Done();
+}
+
+// Sends requests in batches without waiting for the responses in between,
+// which measures the parser's and the response path's throughput.
+TEST_F(HttpServerPerfTest, PipelinedThroughput) {
+  std::string batch;
+  for (int i = 0; i < kPipelineDepth; ++i)
+    batch.append(kRequest);
+
+  PerfTimer timer;
+  for (int i = 0; i < kRequests / kPipelineDepth; ++i) {
+    Write(batch);
+    ReadResponses(kPipelineDepth);
+  }
+  double elapsed_seconds = timer.Elapsed().InSecondsF();
+  LogPerfResult("HttpServer_Pipelined_Throughput",
+                kRequests / elapsed_seconds, "requests/s");
+}
+
+}  // namespace net
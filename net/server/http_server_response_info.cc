@@ -49,11 +49,22 @@ void HttpServerResponseInfo::SetBody(const std::string& body,
 std::string HttpServerResponseInfo::Serialize() const {
   std::string response = base::StringPrintf(
       "HTTP/1.1 %d %s\r\n", status_code_, GetHttpReasonPhrase(status_code_));
+  // Size the response up front so it is built, and sent, as one buffer.
+  size_t size = response.size() + 2 + body_.size();
   Headers::const_iterator header;
   for (header = headers_.begin(); header != headers_.end(); ++header)
-    response += header->first + ":" + header->second + "\r\n";
+    size += header->first.size() + 1 + header->second.size() + 2;
+  response.reserve(size);
 
-  return response + "\r\n" + body_;
+  for (header = headers_.begin(); header != headers_.end(); ++header) {
+    response.append(header->first);
+    response.append(":");
+    response.append(header->second);
+    response.append("\r\n");
+  }
+  response.append("\r\n");
+  response.append(body_);
+  return response;
 }
 
 HttpStatusCode HttpServerResponseInfo::status_code() const {
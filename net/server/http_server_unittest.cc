@@ -129,6 +129,7 @@ class HttpServerTest : public testing::Test,
   virtual void OnHttpRequest(int connection_id,
                              const HttpServerRequestInfo& info) OVERRIDE {
     requests_.push_back(info);
+    request_connection_ids_.push_back(connection_id);
     if (requests_.size() == quit_after_request_count_)
       run_loop_quit_func_.Run();
   }
@@ -143,7 +144,9 @@ class HttpServerTest : public testing::Test,
     NOTREACHED();
   }
 
-  virtual void OnClose(int connection_id) OVERRIDE {}
+  virtual void OnClose(int connection_id) OVERRIDE {
+    closed_connection_ids_.push_back(connection_id);
+  }
 
   bool RunUntilRequestsReceived(size_t count) {
     quit_after_request_count_ = count;
@@ -158,10 +161,15 @@ class HttpServerTest : public testing::Test,
   }
 
  protected:
+  // Declared before |server_|, whose connections report closing on its
+  // destruction.
+  std::vector<int> closed_connection_ids_;
+
   scoped_refptr<HttpServer> server_;
   IPEndPoint server_address_;
   base::Closure run_loop_quit_func_;
   std::vector<HttpServerRequestInfo> requests_;
+  std::vector<int> request_connection_ids_;
 
  private:
   size_t quit_after_request_count_;
@@ -293,6 +301,77 @@ TEST_F(HttpServerTest, RequestWithBodySplitAcrossPackets) {
   ASSERT_EQ(body, requests_[0].data);
 }
 
+TEST_F(HttpServerTest, RequestSplitIntoSingleBytes) {
+  scoped_refptr<StreamListenSocket> socket(
+      new MockStreamListenSocket(server_.get()));
+  server_->DidAccept(NULL, socket.get());
+  std::string request(
+      "POST /test HTTP/1.1\r\n"
+      "Header: value\r\n"
+      "Content-Length: 4\r\n\r\n"
+      "body");
+  for (size_t i = 0; i < request.length() - 1; ++i)
+    server_->DidRead(socket.get(), request.c_str() + i, 1);
+  ASSERT_EQ(0u, requests_.size());
+  server_->DidRead(socket.get(), request.c_str() + request.length() - 1, 1);
+  ASSERT_EQ(1u, requests_.size());
+  ASSERT_EQ("POST", requests_[0].method);
+  ASSERT_EQ("/test", requests_[0].path);
+  ASSERT_EQ("value", requests_[0].GetHeaderValue("header"));
+  ASSERT_EQ("body", requests_[0].data);
+}
+
+TEST_F(HttpServerTest, KeepAliveRequestsSplitBeforeFinalLF) {
+  scoped_refptr<StreamListenSocket> socket(
+      new MockStreamListenSocket(server_.get()));
+  server_->DidAccept(NULL, socket.get());
+  std::string first("GET /test1 HTTP/1.1\r\n\r");
+  server_->DidRead(socket.get(), first.c_str(), first.length());
+  ASSERT_EQ(0u, requests_.size());
+  std::string second("\nGET /test2 HTTP/1.1\r\n\r");
+  server_->DidRead(socket.get(), second.c_str(), second.length());
+  ASSERT_EQ(1u, requests_.size());
+  ASSERT_EQ("/test1", requests_[0].path);
+  ASSERT_EQ("", requests_[0].data);
+  server_->DidRead(socket.get(), "\n", 1);
+  ASSERT_EQ(2u, requests_.size());
+  ASSERT_EQ("GET", requests_[1].method);
+  ASSERT_EQ("/test2", requests_[1].path);
+  ASSERT_EQ("", requests_[1].data);
+}
+
+TEST_F(HttpServerTest, PipelinedRequests) {
+  TestHttpClient client;
+  ASSERT_EQ(OK, client.ConnectAndWait(server_address_));
+  client.Send("GET /test1 HTTP/1.1\r\n\r\n"
+              "POST /test2 HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody"
+              "GET /test3 HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(3));
+  ASSERT_EQ("/test1", requests_[0].path);
+  ASSERT_EQ("/test2", requests_[1].path);
+  ASSERT_EQ("body", requests_[1].data);
+  ASSERT_EQ("/test3", requests_[2].path);
+  ASSERT_EQ(request_connection_ids_[0], request_connection_ids_[2]);
+}
+
+TEST_F(HttpServerTest, ConnectionCloseAfterResponse) {
+  TestHttpClient client;
+  ASSERT_EQ(OK, client.ConnectAndWait(server_address_));
+  client.Send("GET /test1 HTTP/1.1\r\n\r\n"
+              "GET /test2 HTTP/1.1\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE(RunUntilRequestsReceived(2));
+  int connection_id = request_connection_ids_[0];
+
+  // The connection stays open after the first response...
+  server_->Send200(connection_id, "1", "text/plain");
+  ASSERT_EQ(0u, closed_connection_ids_.size());
+
+  // ...and is closed after the response to the request that asked for it.
+  server_->Send200(connection_id, "2", "text/plain");
+  ASSERT_EQ(1u, closed_connection_ids_.size());
+  ASSERT_EQ(connection_id, closed_connection_ids_[0]);
+}
+
 TEST_F(HttpServerTest, MultipleRequestsOnSameConnection) {
   // The idea behind this test is that requests with or without bodies should
   // not break parsing of the next request.
@@ -141,7 +141,9 @@ void StreamListenSocket::SendInternal(const char* bytes, int len) {
 }
 
 void StreamListenSocket::Listen() {
-  int backlog = 10;  // TODO(erikkay): maybe don't allow any backlog?
+  // Let the system cap the backlog so that bursts of connections from
+  // keep-alive clients are not refused.
+  int backlog = SOMAXCONN;
   if (listen(socket_, backlog) == -1) {
     // TODO(erikkay): error handling.
     LOG(ERROR) << "Could not listen on socket.";
@@ -580,11 +580,8 @@ int SpdySession::TryCreateStream(SpdyStreamRequest* request,
   if (err != OK)
     return err;
 
-  if (!max_concurrent_streams_ ||
-      (active_streams_.size() + created_streams_.size() <
-       max_concurrent_streams_)) {
+  if (HasAvailableStreamCapacity())
     return CreateStream(*request, stream);
-  }
 
   stalled_streams_++;
   net_log().AddEvent(NetLog::TYPE_SPDY_SESSION_STALLED_MAX_STREAMS);
@@ -1587,6 +1584,12 @@ bool SpdySession::IsReused() const {
   return buffered_spdy_framer_->frames_received() > 0;
 }
 
+bool SpdySession::HasAvailableStreamCapacity() const {
+  return !max_concurrent_streams_ ||
+      (active_streams_.size() + created_streams_.size() <
+       max_concurrent_streams_);
+}
+
 bool SpdySession::GetLoadTimingInfo(SpdyStreamId stream_id,
                                     LoadTimingInfo* load_timing_info) const {
   return connection_->GetLoadTimingInfo(stream_id != kFirstStreamId,
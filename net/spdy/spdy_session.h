@@ -400,6 +400,10 @@ class NET_EXPORT SpdySession : public BufferedSpdyFramerVisitorInterface,
     return !active_streams_.empty() || !created_streams_.empty();
   }
 
+  // Returns true if a new stream could be created on this session right away,
+  // without waiting for an existing stream to close.
+  bool HasAvailableStreamCapacity() const;
+
   // Access to the number of active and pending streams.  These are primarily
   // available for testing and diagnostics.
   size_t num_active_streams() const { return active_streams_.size(); }
@@ -43,6 +43,7 @@ SpdySessionPool::SpdySessionPool(
     SpdySessionPool::TimeFunc time_func,
     const std::string& trusted_spdy_proxy)
     : http_server_properties_(http_server_properties),
+      num_sessions_saved_by_pooling_(0),
       ssl_config_service_(ssl_config_service),
       resolver_(resolver),
       verify_domain_authentication_(true),
@@ -205,6 +206,11 @@ base::WeakPtr<SpdySession> SpdySessionPool::FindAvailableSession(
       continue;
     }
 
+    // Don't pool onto a session which is already at its stream concurrency
+    // limit; requests for |key| would only queue behind the existing ones.
+    if (!available_session->HasAvailableStreamCapacity())
+      continue;
+
     UMA_HISTOGRAM_ENUMERATION("Net.SpdyIPPoolDomainMatch", 1, 2);
     UMA_HISTOGRAM_ENUMERATION("Net.SpdySessionGet",
                               FOUND_EXISTING_FROM_IP_POOL,
@@ -212,6 +218,7 @@ base::WeakPtr<SpdySession> SpdySessionPool::FindAvailableSession(
     net_log.AddEvent(
         NetLog::TYPE_SPDY_SESSION_POOL_FOUND_EXISTING_SESSION_FROM_IP_POOL,
         available_session->net_log().source().ToEventParametersCallback());
+    ++num_sessions_saved_by_pooling_;
     // Add this session to the map so that we can find it next time.
     MapKeyToAvailableSession(key, available_session);
     available_session->AddPooledAlias(key);
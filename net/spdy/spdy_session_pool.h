@@ -125,6 +125,12 @@ class NET_EXPORT SpdySessionPool
   // responsible for deleting the returned value.
   base::Value* SpdySessionPoolInfoToValue() const;
 
+  // Returns the number of keys which were served by an existing session to a
+  // different host (through an IP alias) instead of a new connection.
+  size_t num_sessions_saved_by_pooling() const {
+    return num_sessions_saved_by_pooling_;
+  }
+
   base::WeakPtr<HttpServerProperties> http_server_properties() {
     return http_server_properties_;
   }
@@ -204,6 +210,9 @@ class NET_EXPORT SpdySessionPool
   // A map of IPEndPoint aliases for sessions.
   AliasMap aliases_;
 
+  // The number of times an IP alias was used instead of a new session.
+  size_t num_sessions_saved_by_pooling_;
+
   static bool g_force_single_domain;
 
   const scoped_refptr<SSLConfigService> ssl_config_service_;
@@ -373,7 +373,9 @@ void SpdySessionPoolTest::RunIPPoolingTest(
   EXPECT_FALSE(HasSpdySession(spdy_session_pool_, test_hosts[2].key));
 
   // The second host overlaps with the first, and should IP pool.
+  EXPECT_EQ(0u, spdy_session_pool_->num_sessions_saved_by_pooling());
   EXPECT_TRUE(HasSpdySession(spdy_session_pool_, test_hosts[1].key));
+  EXPECT_EQ(1u, spdy_session_pool_->num_sessions_saved_by_pooling());
 
   // Verify that the second host, through a proxy, won't share the IP.
   SpdySessionKey proxy_key(test_hosts[1].key.host_port_pair(),
@@ -489,6 +491,79 @@ TEST_P(SpdySessionPoolTest, IPPoolingCloseIdleSessions) {
   RunIPPoolingTest(SPDY_POOL_CLOSE_IDLE_SESSIONS);
 }
 
+// A session which has no room for another stream should not be shared with an
+// IP-aliased host; that host gets a session of its own instead.
+TEST_P(SpdySessionPoolTest, IPPoolingSkipsFullSession) {
+  const int kTestPort = 80;
+  const char kFirstHost[] = "www.foo.com";
+  const char kSecondHost[] = "js.foo.com";
+
+  session_deps_.host_resolver->set_synchronous_mode(true);
+  session_deps_.host_resolver->rules()->AddIPLiteralRule(
+      kFirstHost, "192.168.0.1", std::string());
+  session_deps_.host_resolver->rules()->AddIPLiteralRule(
+      kSecondHost, "192.168.0.2,192.168.0.1", std::string());
+
+  // Populate the HostCache, as the IP pooling code looks up the cache only.
+  AddressList addresses;
+  HostResolver::RequestInfo info(HostPortPair(kSecondHost, kTestPort));
+  session_deps_.host_resolver->Resolve(
+      info, &addresses, CompletionCallback(), NULL, BoundNetLog());
+
+  SpdySessionKey first_key(HostPortPair(kFirstHost, kTestPort),
+                           ProxyServer::Direct(), kPrivacyModeDisabled);
+  SpdySessionKey second_key(HostPortPair(kSecondHost, kTestPort),
+                            ProxyServer::Direct(), kPrivacyModeDisabled);
+
+  // The server allows only one concurrent stream.
+  SpdyTestUtil spdy_util(GetParam());
+  SettingsMap new_settings;
+  new_settings[SETTINGS_MAX_CONCURRENT_STREAMS] =
+      SettingsFlagsAndValue(SETTINGS_FLAG_NONE, 1);
+  scoped_ptr<SpdyFrame> settings_frame(
+      spdy_util.ConstructSpdySettings(new_settings));
+
+  MockConnect connect_data(SYNCHRONOUS, OK);
+  MockRead reads[] = {
+    CreateMockRead(*settings_frame),
+    MockRead(SYNCHRONOUS, ERR_IO_PENDING)  // Stall forever.
+  };
+
+  StaticSocketDataProvider data(reads, arraysize(reads), NULL, 0);
+  data.set_connect_data(connect_data);
+  session_deps_.socket_factory->AddSocketDataProvider(&data);
+
+  SSLSocketDataProvider ssl(SYNCHRONOUS, OK);
+  session_deps_.socket_factory->AddSSLSocketDataProvider(&ssl);
+
+  CreateNetworkSession();
+
+  base::WeakPtr<SpdySession> session =
+      CreateInsecureSpdySession(http_session_, first_key, BoundNetLog());
+
+  // Flush the SpdySession::OnReadComplete() task, which applies the SETTINGS.
+  base::MessageLoop::current()->RunUntilIdle();
+  ASSERT_TRUE(session->HasAvailableStreamCapacity());
+
+  // Use up the only stream the session may have.
+  base::WeakPtr<SpdyStream> spdy_stream =
+      CreateStreamSynchronously(SPDY_BIDIRECTIONAL_STREAM,
+                                session, GURL("http://www.foo.com"),
+                                MEDIUM, BoundNetLog());
+  ASSERT_TRUE(spdy_stream.get() != NULL);
+  EXPECT_FALSE(session->HasAvailableStreamCapacity());
+
+  // The second host resolves to the same IP, but the session is full.
+  EXPECT_FALSE(HasSpdySession(spdy_session_pool_, second_key));
+  EXPECT_EQ(0u, spdy_session_pool_->num_sessions_saved_by_pooling());
+
+  // Once the stream is gone, the session can be shared again.
+  spdy_stream->Cancel();
+  EXPECT_TRUE(session->HasAvailableStreamCapacity());
+  EXPECT_TRUE(HasSpdySession(spdy_session_pool_, second_key));
+  EXPECT_EQ(1u, spdy_session_pool_->num_sessions_saved_by_pooling());
+}
+
 }  // namespace
 
 }  // namespace net
@@ -8,8 +8,11 @@
 #include <fcntl.h>
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 
+#include <algorithm>
+
 #include "base/callback.h"
 #include "base/logging.h"
 #include "base/message_loop/message_loop.h"
@@ -29,10 +32,87 @@ const int kBindRetries = 10;
 const int kPortStart = 1024;
 const int kPortEnd = 65535;
 
+// The most datagrams RecvMultiple() and SendMultiple() move per call.
+const size_t kMaxDatagramsPerCall = 32;
+
+// Room for the SCM_TIMESTAMP control message of a received datagram.
+const size_t kControlBufferSize = CMSG_SPACE(sizeof(struct timeval));
+
+#if defined(OS_LINUX)
+typedef struct mmsghdr DatagramMessage;
+#else
+// The layout of Linux's struct mmsghdr, for platforms without recvmmsg() and
+// sendmmsg().
+struct DatagramMessage {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+#endif
+
+// Receives up to |count| datagrams into |messages|, setting the msg_len of
+// each. Returns the number received, or -1 with errno set if none were.
+int ReceiveMessages(int socket, DatagramMessage* messages, int count) {
+#if defined(OS_LINUX)
+  int rv = HANDLE_EINTR(recvmmsg(socket, messages, count, 0, NULL));
+  if (rv >= 0 || errno != ENOSYS)
+    return rv;
+  // recvmmsg() is not supported before Linux 2.6.33.
+#endif
+  int received = 0;
+  for (; received < count; ++received) {
+    ssize_t bytes =
+        HANDLE_EINTR(recvmsg(socket, &messages[received].msg_hdr, 0));
+    if (bytes < 0)
+      break;
+    messages[received].msg_len = bytes;
+  }
+  return received > 0 ? received : -1;
+}
+
+// Sends up to |count| datagrams from |messages|. Returns the number sent, or
+// -1 with errno set if none were.
+int SendMessages(int socket, DatagramMessage* messages, int count) {
+#if defined(OS_LINUX)
+  int rv = HANDLE_EINTR(sendmmsg(socket, messages, count, 0));
+  if (rv >= 0 || errno != ENOSYS)
+    return rv;
+  // sendmmsg() is not supported before Linux 3.0.
+#endif
+  int sent = 0;
+  for (; sent < count; ++sent) {
+    ssize_t bytes = HANDLE_EINTR(sendmsg(socket, &messages[sent].msg_hdr, 0));
+    if (bytes < 0)
+      break;
+    messages[sent].msg_len = bytes;
+  }
+  return sent > 0 ? sent : -1;
+}
+
+// Returns the time in the SCM_TIMESTAMP control message of |header|, or a
+// null time if there is none.
+base::Time GetReceiveTime(struct msghdr* header) {
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(header); cmsg;
+       cmsg = CMSG_NXTHDR(header, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP) {
+      struct timeval time;
+      memcpy(&time, CMSG_DATA(cmsg), sizeof(time));
+      return base::Time::FromTimeVal(time);
+    }
+  }
+  return base::Time();
+}
+
 }  // namespace
 
 namespace net {
 
+UDPDatagram::UDPDatagram() : buffer_size(0), size(0) {}
+
+UDPDatagram::UDPDatagram(IOBuffer* buffer, int buffer_size)
+    : buffer(buffer), buffer_size(buffer_size), size(0) {}
+
+UDPDatagram::~UDPDatagram() {}
+
 UDPSocketLibevent::UDPSocketLibevent(
     DatagramSocket::BindType bind_type,
     const RandIntCallback& rand_int_cb,
@@ -48,7 +128,10 @@ UDPSocketLibevent::UDPSocketLibevent(
           write_watcher_(this),
           read_buf_len_(0),
           recv_from_address_(NULL),
+          recv_datagrams_(NULL),
           write_buf_len_(0),
+          send_datagrams_(NULL),
+          receive_timestamps_(false),
           net_log_(BoundNetLog::Make(net_log, NetLog::SOURCE_UDP_SOCKET)) {
   net_log_.BeginEvent(NetLog::TYPE_SOCKET_ALIVE,
                       source.ToEventParametersCallback());
@@ -72,10 +155,12 @@ void UDPSocketLibevent::Close() {
   read_buf_len_ = 0;
   read_callback_.Reset();
   recv_from_address_ = NULL;
+  recv_datagrams_ = NULL;
   write_buf_ = NULL;
   write_buf_len_ = 0;
   write_callback_.Reset();
   send_to_address_.reset();
+  send_datagrams_ = NULL;
 
   bool ok = read_socket_watcher_.StopWatchingFileDescriptor();
   DCHECK(ok);
@@ -87,6 +172,7 @@ void UDPSocketLibevent::Close() {
 
   socket_ = kInvalidSocket;
   addr_family_ = 0;
+  receive_timestamps_ = false;
 }
 
 int UDPSocketLibevent::GetPeerAddress(IPEndPoint* address) const {
@@ -168,6 +254,33 @@ int UDPSocketLibevent::RecvFrom(IOBuffer* buf,
   return ERR_IO_PENDING;
 }
 
+int UDPSocketLibevent::RecvMultiple(std::vector<UDPDatagram>* datagrams,
+                                    const CompletionCallback& callback) {
+  DCHECK(CalledOnValidThread());
+  DCHECK_NE(kInvalidSocket, socket_);
+  DCHECK(read_callback_.is_null());
+  DCHECK(!recv_datagrams_);
+  DCHECK(!callback.is_null());  // Synchronous operation not supported
+  DCHECK(!datagrams->empty());
+
+  int result = InternalRecvMultiple(datagrams);
+  if (result != ERR_IO_PENDING)
+    return result;
+
+  if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+          socket_, true, base::MessageLoopForIO::WATCH_READ,
+          &read_socket_watcher_, &read_watcher_)) {
+    PLOG(ERROR) << "WatchFileDescriptor failed on read";
+    result = MapSystemError(errno);
+    LogRead(result, NULL, 0, NULL);
+    return result;
+  }
+
+  recv_datagrams_ = datagrams;
+  read_callback_ = callback;
+  return ERR_IO_PENDING;
+}
+
 int UDPSocketLibevent::Write(IOBuffer* buf,
                              int buf_len,
                              const CompletionCallback& callback) {
@@ -214,6 +327,33 @@ int UDPSocketLibevent::SendToOrWrite(IOBuffer* buf,
   return ERR_IO_PENDING;
 }
 
+int UDPSocketLibevent::SendMultiple(std::vector<UDPDatagram>* datagrams,
+                                    const CompletionCallback& callback) {
+  DCHECK(CalledOnValidThread());
+  DCHECK_NE(kInvalidSocket, socket_);
+  DCHECK(write_callback_.is_null());
+  DCHECK(!send_datagrams_);
+  DCHECK(!callback.is_null());  // Synchronous operation not supported
+  DCHECK(!datagrams->empty());
+
+  int result = InternalSendMultiple(datagrams);
+  if (result != ERR_IO_PENDING)
+    return result;
+
+  if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+          socket_, true, base::MessageLoopForIO::WATCH_WRITE,
+          &write_socket_watcher_, &write_watcher_)) {
+    DVLOG(1) << "WatchFileDescriptor failed on write, errno " << errno;
+    result = MapSystemError(errno);
+    LogWrite(result, NULL, NULL);
+    return result;
+  }
+
+  send_datagrams_ = datagrams;
+  write_callback_ = callback;
+  return ERR_IO_PENDING;
+}
+
 int UDPSocketLibevent::Connect(const IPEndPoint& address) {
   net_log_.BeginEvent(NetLog::TYPE_UDP_CONNECT,
                       CreateNetLogUDPConnectCallback(&address));
@@ -296,6 +436,20 @@ bool UDPSocketLibevent::SetSendBufferSize(int32 size) {
   return rv == 0;
 }
 
+int UDPSocketLibevent::EnableReceiveTimestamps() {
+  DCHECK(CalledOnValidThread());
+  if (!is_connected())
+    return ERR_SOCKET_NOT_CONNECTED;
+
+  int true_value = 1;
+  int rv = setsockopt(socket_, SOL_SOCKET, SO_TIMESTAMP, &true_value,
+                      sizeof(true_value));
+  if (rv < 0)
+    return MapSystemError(errno);
+  receive_timestamps_ = true;
+  return OK;
+}
+
 void UDPSocketLibevent::AllowAddressReuse() {
   DCHECK(CalledOnValidThread());
   DCHECK(!is_connected());
@@ -341,12 +495,14 @@ void UDPSocketLibevent::DoWriteCallback(int rv) {
 }
 
 void UDPSocketLibevent::DidCompleteRead() {
-  int result =
+  int result = recv_datagrams_ ?
+      InternalRecvMultiple(recv_datagrams_) :
       InternalRecvFrom(read_buf_.get(), read_buf_len_, recv_from_address_);
   if (result != ERR_IO_PENDING) {
     read_buf_ = NULL;
     read_buf_len_ = 0;
     recv_from_address_ = NULL;
+    recv_datagrams_ = NULL;
     bool ok = read_socket_watcher_.StopWatchingFileDescriptor();
     DCHECK(ok);
     DoReadCallback(result);
@@ -393,13 +549,15 @@ int UDPSocketLibevent::CreateSocket(const IPEndPoint& address) {
 }
 
 void UDPSocketLibevent::DidCompleteWrite() {
-  int result =
+  int result = send_datagrams_ ?
+      InternalSendMultiple(send_datagrams_) :
       InternalSendTo(write_buf_.get(), write_buf_len_, send_to_address_.get());
 
   if (result != ERR_IO_PENDING) {
     write_buf_ = NULL;
     write_buf_len_ = 0;
     send_to_address_.reset();
+    send_datagrams_ = NULL;
     write_socket_watcher_.StopWatchingFileDescriptor();
     DoWriteCallback(result);
   }
@@ -478,6 +636,97 @@ int UDPSocketLibevent::InternalSendTo(IOBuffer* buf, int buf_len,
   return result;
 }
 
+int UDPSocketLibevent::InternalRecvMultiple(
+    std::vector<UDPDatagram>* datagrams) {
+  int count = std::min(datagrams->size(), kMaxDatagramsPerCall);
+  DatagramMessage messages[kMaxDatagramsPerCall];
+  struct iovec iovs[kMaxDatagramsPerCall];
+  SockaddrStorage storages[kMaxDatagramsPerCall];
+  char controls[kMaxDatagramsPerCall][kControlBufferSize];
+  memset(messages, 0, sizeof(messages));
+  for (int i = 0; i < count; ++i) {
+    UDPDatagram* datagram = &(*datagrams)[i];
+    DCHECK_GT(datagram->buffer_size, 0);
+    iovs[i].iov_base = datagram->buffer->data();
+    iovs[i].iov_len = datagram->buffer_size;
+    struct msghdr* header = &messages[i].msg_hdr;
+    header->msg_name = storages[i].addr;
+    header->msg_namelen = storages[i].addr_len;
+    header->msg_iov = &iovs[i];
+    header->msg_iovlen = 1;
+    if (receive_timestamps_) {
+      header->msg_control = controls[i];
+      header->msg_controllen = kControlBufferSize;
+    }
+  }
+
+  int received = ReceiveMessages(socket_, messages, count);
+  if (received < 0) {
+    int result = MapSystemError(errno);
+    if (result != ERR_IO_PENDING)
+      LogRead(result, NULL, 0, NULL);
+    return result;
+  }
+
+  for (int i = 0; i < received; ++i) {
+    UDPDatagram* datagram = &(*datagrams)[i];
+    struct msghdr* header = &messages[i].msg_hdr;
+    datagram->size = messages[i].msg_len;
+    if (!datagram->address.FromSockAddr(storages[i].addr,
+                                        header->msg_namelen)) {
+      LogRead(ERR_FAILED, NULL, 0, NULL);
+      return ERR_FAILED;
+    }
+    datagram->receive_time =
+        receive_timestamps_ ? GetReceiveTime(header) : base::Time();
+    LogRead(datagram->size, datagram->buffer->data(), header->msg_namelen,
+            storages[i].addr);
+  }
+  return received;
+}
+
+int UDPSocketLibevent::InternalSendMultiple(
+    std::vector<UDPDatagram>* datagrams) {
+  int count = std::min(datagrams->size(), kMaxDatagramsPerCall);
+  DatagramMessage messages[kMaxDatagramsPerCall];
+  struct iovec iovs[kMaxDatagramsPerCall];
+  SockaddrStorage storages[kMaxDatagramsPerCall];
+  memset(messages, 0, sizeof(messages));
+  for (int i = 0; i < count; ++i) {
+    const UDPDatagram& datagram = (*datagrams)[i];
+    DCHECK_GT(datagram.buffer_size, 0);
+    iovs[i].iov_base = datagram.buffer->data();
+    iovs[i].iov_len = datagram.buffer_size;
+    struct msghdr* header = &messages[i].msg_hdr;
+    if (!datagram.address.address().empty()) {
+      if (!datagram.address.ToSockAddr(storages[i].addr,
+                                       &storages[i].addr_len)) {
+        LogWrite(ERR_FAILED, NULL, NULL);
+        return ERR_FAILED;
+      }
+      header->msg_name = storages[i].addr;
+      header->msg_namelen = storages[i].addr_len;
+    }
+    header->msg_iov = &iovs[i];
+    header->msg_iovlen = 1;
+  }
+
+  int sent = SendMessages(socket_, messages, count);
+  if (sent < 0) {
+    int result = MapSystemError(errno);
+    if (result != ERR_IO_PENDING)
+      LogWrite(result, NULL, NULL);
+    return result;
+  }
+
+  for (int i = 0; i < sent; ++i) {
+    const UDPDatagram& datagram = (*datagrams)[i];
+    LogWrite(messages[i].msg_len, datagram.buffer->data(),
+             datagram.address.address().empty() ? NULL : &datagram.address);
+  }
+  return sent;
+}
+
 int UDPSocketLibevent::SetSocketOptions() {
   int true_value = 1;
   if (socket_options_ & SOCKET_OPTION_REUSE_ADDRESS) {
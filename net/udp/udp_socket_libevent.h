@@ -5,10 +5,13 @@
 #ifndef NET_UDP_UDP_SOCKET_LIBEVENT_H_
 #define NET_UDP_UDP_SOCKET_LIBEVENT_H_
 
+#include <vector>
+
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
 #include "base/threading/non_thread_safe.h"
+#include "base/time/time.h"
 #include "net/base/completion_callback.h"
 #include "net/base/io_buffer.h"
 #include "net/base/ip_endpoint.h"
@@ -19,6 +22,30 @@
 
 namespace net {
 
+// A datagram for UDPSocketLibevent::RecvMultiple() and SendMultiple().
+struct NET_EXPORT UDPDatagram {
+  UDPDatagram();
+  UDPDatagram(IOBuffer* buffer, int buffer_size);
+  ~UDPDatagram();
+
+  scoped_refptr<IOBuffer> buffer;
+
+  // When receiving, the number of bytes |buffer| can hold. When sending, the
+  // number of bytes to send from it.
+  int buffer_size;
+
+  // Set to the number of bytes received.
+  int size;
+
+  // When receiving, set to the sender's address. When sending, the
+  // recipient's address, which is left empty on a connected socket.
+  IPEndPoint address;
+
+  // Set to the time the datagram arrived, if receive timestamps are enabled.
+  // See UDPSocketLibevent::EnableReceiveTimestamps().
+  base::Time receive_time;
+};
+
 class NET_EXPORT UDPSocketLibevent : public base::NonThreadSafe {
  public:
   UDPSocketLibevent(DatagramSocket::BindType bind_type,
@@ -92,6 +119,33 @@ class NET_EXPORT UDPSocketLibevent : public base::NonThreadSafe {
              const IPEndPoint& address,
              const CompletionCallback& callback);
 
+  // Read up to |datagrams->size()| datagrams from the socket, using as few
+  // system calls as the platform allows. Each element of |datagrams| must
+  // have its |buffer| and |buffer_size| set.
+  // Returns the number of datagrams received, which fill the front of
+  // |datagrams|, a net error code, or ERR_IO_PENDING if the IO is in
+  // progress. If ERR_IO_PENDING is returned, the caller must keep
+  // |datagrams| alive and unchanged until the callback is called with the
+  // number of datagrams received.
+  // RecvMultiple() and RecvFrom() share one outstanding read.
+  int RecvMultiple(std::vector<UDPDatagram>* datagrams,
+                   const CompletionCallback& callback);
+
+  // Send the datagrams in |datagrams|, in order, using as few system calls as
+  // the platform allows.
+  // Returns the number of datagrams sent from the front of |datagrams|, which
+  // may be fewer than all of them, a net error code, or ERR_IO_PENDING if the
+  // IO is in progress. If ERR_IO_PENDING is returned, the caller must keep
+  // |datagrams| alive and unchanged until the callback is called.
+  // SendMultiple() and SendTo() share one outstanding write.
+  int SendMultiple(std::vector<UDPDatagram>* datagrams,
+                   const CompletionCallback& callback);
+
+  // Have the kernel timestamp incoming datagrams, and report the times in
+  // UDPDatagram::receive_time. Only RecvMultiple() reports them.
+  // Returns a net error code.
+  int EnableReceiveTimestamps();
+
   // Set the receive buffer size (in bytes) for the socket.
   bool SetReceiveBufferSize(int32 size);
 
@@ -219,6 +273,8 @@ class NET_EXPORT UDPSocketLibevent : public base::NonThreadSafe {
   int InternalConnect(const IPEndPoint& address);
   int InternalRecvFrom(IOBuffer* buf, int buf_len, IPEndPoint* address);
   int InternalSendTo(IOBuffer* buf, int buf_len, const IPEndPoint* address);
+  int InternalRecvMultiple(std::vector<UDPDatagram>* datagrams);
+  int InternalSendMultiple(std::vector<UDPDatagram>* datagrams);
 
   // Applies |socket_options_| to |socket_|. Should be called before
   // Bind().
@@ -262,11 +318,22 @@ class NET_EXPORT UDPSocketLibevent : public base::NonThreadSafe {
   int read_buf_len_;
   IPEndPoint* recv_from_address_;
 
+  // The datagrams used by InternalRecvMultiple() to retry RecvMultiple
+  // requests.
+  std::vector<UDPDatagram>* recv_datagrams_;
+
   // The buffer used by InternalWrite() to retry Write requests
   scoped_refptr<IOBuffer> write_buf_;
   int write_buf_len_;
   scoped_ptr<IPEndPoint> send_to_address_;
 
+  // The datagrams used by InternalSendMultiple() to retry SendMultiple
+  // requests.
+  std::vector<UDPDatagram>* send_datagrams_;
+
+  // Whether SO_TIMESTAMP is set on |socket_|.
+  bool receive_timestamps_;
+
   // External callback; called when read is complete.
   CompletionCallback read_callback_;
 
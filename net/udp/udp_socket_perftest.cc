@@ -0,0 +1,112 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/test_completion_callback.h"
+#include "net/udp/udp_socket_libevent.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kDatagrams = 200000;
+const int kDatagramSize = 64;
+const int kBatchSize = 32;
+
+// Room for every datagram in flight, so that none are dropped on loopback.
+const int32 kSocketBufferSize = 4 * 1024 * 1024;
+
+// Sends datagrams over loopback and receives them on the same thread, so the
+// rates below are per core.
+class UDPSocketPerfTest : public testing::Test {
+ public:
+  UDPSocketPerfTest()
+      : server_(DatagramSocket::DEFAULT_BIND, RandIntCallback(), NULL,
+                NetLog::Source()),
+        client_(DatagramSocket::DEFAULT_BIND, RandIntCallback(), NULL,
+                NetLog::Source()) {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    IPAddressNumber localhost;
+    ASSERT_TRUE(ParseIPLiteralToNumber("127.0.0.1", &localhost));
+    ASSERT_EQ(OK, server_.Bind(IPEndPoint(localhost, 0)));
+    IPEndPoint server_address;
+    ASSERT_EQ(OK, server_.GetLocalAddress(&server_address));
+    ASSERT_EQ(OK, client_.Connect(server_address));
+    ASSERT_TRUE(server_.SetReceiveBufferSize(kSocketBufferSize));
+    ASSERT_TRUE(client_.SetSendBufferSize(kSocketBufferSize));
+  }
+
+  // Moves |kDatagrams| datagrams, |batch_size| at a time, and logs the rate
+  // as |test_name|. A batch size of one uses Write() and RecvFrom().
+  void Transfer(int batch_size, const char* test_name) {
+    std::vector<UDPDatagram> send_batch;
+    std::vector<UDPDatagram> recv_batch;
+    for (int i = 0; i < batch_size; ++i) {
+      send_batch.push_back(
+          UDPDatagram(new IOBuffer(kDatagramSize), kDatagramSize));
+      recv_batch.push_back(
+          UDPDatagram(new IOBuffer(kDatagramSize), kDatagramSize));
+    }
+    IPEndPoint address;
+
+    PerfTimer timer;
+    for (int sent = 0; sent < kDatagrams; sent += batch_size) {
+      TestCompletionCallback callback;
+      if (batch_size == 1) {
+        int rv = client_.Write(send_batch[0].buffer.get(), kDatagramSize,
+                               callback.callback());
+        ASSERT_EQ(kDatagramSize, callback.GetResult(rv));
+        rv = server_.RecvFrom(recv_batch[0].buffer.get(), kDatagramSize,
+                              &address, callback.callback());
+        ASSERT_EQ(kDatagramSize, callback.GetResult(rv));
+        continue;
+      }
+
+      int rv = client_.SendMultiple(&send_batch, callback.callback());
+      ASSERT_EQ(batch_size, callback.GetResult(rv));
+      for (int received = 0; received < batch_size; ) {
+        std::vector<UDPDatagram> remaining(recv_batch.begin(),
+                                           recv_batch.begin() +
+                                               (batch_size - received));
+        rv = server_.RecvMultiple(&remaining, callback.callback());
+        rv = callback.GetResult(rv);
+        ASSERT_GT(rv, 0);
+        received += rv;
+      }
+    }
+    base::TimeDelta elapsed = timer.Elapsed();
+    LogPerfResult(test_name, kDatagrams / elapsed.InSecondsF(),
+                  "datagrams/s");
+  }
+
+ private:
+  base::MessageLoopForIO message_loop_;
+  UDPSocketLibevent server_;
+  UDPSocketLibevent client_;
+};
+
+TEST_F(UDPSocketPerfTest, SingleDatagrams) {
+  Transfer(1, "UDP_SingleDatagrams");
+}
+
+TEST_F(UDPSocketPerfTest, BatchedDatagrams) {
+  Transfer(kBatchSize, "UDP_BatchedDatagrams");
+}
+
+}  // namespace
+
+}  // namespace net
@@ -580,6 +580,80 @@ TEST_F(UDPSocketTest, MulticastOptions) {
   socket.Close();
 }
 
+#if defined(OS_POSIX)
+TEST_F(UDPSocketTest, SendAndRecvMultiple) {
+  IPEndPoint bind_address;
+  CreateUDPAddress("127.0.0.1", 0, &bind_address);
+  UDPSocket server(DatagramSocket::DEFAULT_BIND,
+                   RandIntCallback(),
+                   NULL,
+                   NetLog::Source());
+  ASSERT_EQ(OK, server.Bind(bind_address));
+  IPEndPoint server_address;
+  ASSERT_EQ(OK, server.GetLocalAddress(&server_address));
+
+  UDPSocket client(DatagramSocket::DEFAULT_BIND,
+                   RandIntCallback(),
+                   NULL,
+                   NetLog::Source());
+  ASSERT_EQ(OK, client.Connect(server_address));
+  IPEndPoint client_address;
+  ASSERT_EQ(OK, client.GetLocalAddress(&client_address));
+  ASSERT_EQ(OK, server.EnableReceiveTimestamps());
+
+  // The client sends on its connected socket, without addresses.
+  const char* const kMessages[] = { "first", "second", "third" };
+  std::vector<UDPDatagram> sent;
+  for (size_t i = 0; i < arraysize(kMessages); ++i) {
+    scoped_refptr<StringIOBuffer> buffer(new StringIOBuffer(kMessages[i]));
+    sent.push_back(UDPDatagram(buffer.get(), buffer->size()));
+  }
+  TestCompletionCallback send_callback;
+  int rv = client.SendMultiple(&sent, send_callback.callback());
+  EXPECT_EQ(static_cast<int>(arraysize(kMessages)),
+            send_callback.GetResult(rv));
+
+  std::vector<UDPDatagram> received;
+  for (size_t i = 0; i < 4; ++i)
+    received.push_back(UDPDatagram(new IOBuffer(kMaxRead), kMaxRead));
+  size_t count = 0;
+  while (count < arraysize(kMessages)) {
+    std::vector<UDPDatagram> batch(received.begin() + count, received.end());
+    TestCompletionCallback recv_callback;
+    rv = recv_callback.GetResult(
+        server.RecvMultiple(&batch, recv_callback.callback()));
+    ASSERT_GT(rv, 0);
+    std::copy(batch.begin(), batch.begin() + rv, received.begin() + count);
+    count += rv;
+  }
+  ASSERT_EQ(arraysize(kMessages), count);
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(kMessages[i], std::string(received[i].buffer->data(),
+                                        received[i].size));
+    EXPECT_TRUE(client_address == received[i].address);
+    EXPECT_FALSE(received[i].receive_time.is_null());
+    EXPECT_LE(received[i].receive_time, base::Time::Now());
+  }
+
+  // The server replies with an address on its unconnected socket.
+  std::vector<UDPDatagram> reply;
+  reply.push_back(UDPDatagram(new StringIOBuffer("reply"), 5));
+  reply[0].address = client_address;
+  rv = server.SendMultiple(&reply, send_callback.callback());
+  EXPECT_EQ(1, send_callback.GetResult(rv));
+
+  std::vector<UDPDatagram> client_received;
+  client_received.push_back(UDPDatagram(new IOBuffer(kMaxRead), kMaxRead));
+  TestCompletionCallback recv_callback;
+  rv = client.RecvMultiple(&client_received, recv_callback.callback());
+  ASSERT_EQ(1, recv_callback.GetResult(rv));
+  EXPECT_EQ("reply", std::string(client_received[0].buffer->data(),
+                                 client_received[0].size));
+  // Timestamps were not enabled on the client.
+  EXPECT_TRUE(client_received[0].receive_time.is_null());
+}
+#endif  // defined(OS_POSIX)
+
 }  // namespace
 
 }  // namespace net
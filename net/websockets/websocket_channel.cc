@@ -13,6 +13,7 @@
 #include "net/base/big_endian.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_log.h"
+#include "net/websockets/websocket_deflate_stream.h"
 #include "net/websockets/websocket_errors.h"
 #include "net/websockets/websocket_event_interface.h"
 #include "net/websockets/websocket_frame.h"
@@ -232,6 +233,25 @@ void WebSocketChannel::SendAddChannelRequestWithFactory(
 void WebSocketChannel::OnConnectSuccess(scoped_ptr<WebSocketStream> stream) {
   DCHECK(stream);
   DCHECK_EQ(CONNECTING, state_);
+
+  // Compress messages if the server accepted permessage-deflate.
+  WebSocketDeflateParameters deflate_parameters;
+  std::string failure_message;
+  if (deflate_parameters.InitializeFromResponse(stream->GetExtensions(),
+                                                &failure_message)) {
+    scoped_ptr<WebSocketDeflateStream> deflate_stream(
+        new WebSocketDeflateStream(stream.Pass(), deflate_parameters));
+    if (!deflate_stream->Initialize())
+      failure_message = "Failed to initialize permessage-deflate";
+    stream = deflate_stream.PassAs<WebSocketStream>();
+  }
+  if (!failure_message.empty()) {
+    VLOG(1) << failure_message;
+    stream->Close();
+    OnConnectFailure(kWebSocketErrorProtocolError);
+    return;
+  }
+
   stream_ = stream.Pass();
   state_ = CONNECTED;
   event_interface_->OnAddChannelResponse(false, stream_->GetSubProtocol());
@@ -394,12 +414,17 @@ void WebSocketChannel::ProcessFrameChunk(
     // if this happens when state_ is CONNECTED, it is definitely a bug.
     DCHECK(state_ != CONNECTED) << "Unexpected header-less frame received "
                                 << "(final_chunk = " << chunk->final_chunk
-                                << ", data size = " << chunk->data->size()
+                                << ", data size = "
+                                << (chunk->data ? chunk->data->size() : 0)
                                 << ")";
     return;
   }
   scoped_refptr<IOBufferWithSize> data_buffer;
   data_buffer.swap(chunk->data);
+  // The parser gives no buffer to a chunk without payload, such as the first
+  // chunk of a frame whose payload has not arrived yet.
+  if (!data_buffer)
+    data_buffer = new IOBufferWithSize(0);
   const bool is_final_chunk = chunk->final_chunk;
   chunk.reset();
   WebSocketFrameHeader::OpCode opcode = current_frame_header_->opcode;
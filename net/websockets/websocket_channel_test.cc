@@ -421,6 +421,12 @@ class ReadableFakeWebSocketStream : public FakeWebSocketStream {
   // time you wish it to return from the test.
   ReadableFakeWebSocketStream() : index_(0), read_frames_pending_(false) {}
 
+  // Constructs a stream which reports |extensions| as negotiated.
+  explicit ReadableFakeWebSocketStream(const std::string& extensions)
+      : FakeWebSocketStream("", extensions),
+        index_(0),
+        read_frames_pending_(false) {}
+
   // Check that all the prepared responses have been consumed.
   virtual ~ReadableFakeWebSocketStream() {
     CHECK(index_ >= responses_.size());
@@ -883,6 +889,53 @@ TEST_F(WebSocketChannelEventInterfaceTest, ProtocolPassed) {
       scoped_ptr<WebSocketStream>(new FakeWebSocketStream("Bob", "")));
 }
 
+// When the server accepts permessage-deflate, the stream is wrapped so that
+// compressed messages arrive decompressed.
+TEST_F(WebSocketChannelEventInterfaceTest, DeflateStreamWrapped) {
+  scoped_ptr<ReadableFakeWebSocketStream> stream(
+      new ReadableFakeWebSocketStream("permessage-deflate"));
+  // "Hello", compressed as in the permessage-deflate specification.
+  static const char kCompressedHello[] = "\xf2\x48\xcd\xc9\xc9\x07\x00";
+  const size_t kCompressedHelloSize = arraysize(kCompressedHello) - 1;
+  scoped_ptr<WebSocketFrameChunk> frame_chunk(new WebSocketFrameChunk);
+  frame_chunk->header.reset(
+      new WebSocketFrameHeader(WebSocketFrameHeader::kOpCodeText));
+  frame_chunk->header->final = true;
+  frame_chunk->header->reserved1 = true;
+  frame_chunk->header->payload_length = kCompressedHelloSize;
+  frame_chunk->final_chunk = true;
+  frame_chunk->data = new IOBufferWithSize(kCompressedHelloSize);
+  memcpy(frame_chunk->data->data(), kCompressedHello, kCompressedHelloSize);
+  ScopedVector<WebSocketFrameChunk> chunks;
+  chunks.push_back(frame_chunk.release());
+  stream->PrepareRawReadFrames(
+      ReadableFakeWebSocketStream::SYNC, OK, chunks.Pass());
+  set_stream(stream.Pass());
+  {
+    InSequence s;
+    EXPECT_CALL(*event_interface_, OnAddChannelResponse(false, _));
+    EXPECT_CALL(*event_interface_, OnFlowControl(_));
+    EXPECT_CALL(
+        *event_interface_,
+        OnDataFrame(
+            true, WebSocketFrameHeader::kOpCodeText, AsVector("Hello")));
+  }
+
+  CreateChannelAndConnectSuccessfully();
+}
+
+// Invalid permessage-deflate parameters in the server's response fail the
+// connection.
+TEST_F(WebSocketChannelEventInterfaceTest, InvalidDeflateParametersFail) {
+  EXPECT_CALL(*event_interface_, OnAddChannelResponse(true, ""));
+
+  CreateChannelAndConnect();
+
+  connect_data_.factory.connect_delegate->OnSuccess(
+      scoped_ptr<WebSocketStream>(new FakeWebSocketStream(
+          "", "permessage-deflate; client_max_window_bits=99")));
+}
+
 // The first frames from the server can arrive together with the handshake, in
 // which case they will be available as soon as ReadFrames() is called the first
 // time.
@@ -1068,6 +1121,36 @@ TEST_F(WebSocketChannelEventInterfaceTest, FragmentedFrames) {
   base::MessageLoop::current()->RunUntilIdle();
 }
 
+// A chunk may carry only the header of a frame whose payload has not arrived
+// yet, in which case it has no data buffer.
+TEST_F(WebSocketChannelEventInterfaceTest, ChunkWithoutData) {
+  scoped_ptr<ReadableFakeWebSocketStream> stream(
+      new ReadableFakeWebSocketStream);
+  static const InitFrameChunk chunks1[] = {
+      {{FINAL_FRAME, WebSocketFrameHeader::kOpCodeText, NOT_MASKED, 5},
+       NOT_FINAL_CHUNK, NULL}};
+  static const InitFrameChunk chunks2[] = {
+      {{NO_HEADER}, FINAL_CHUNK, "HELLO"}};
+  stream->PrepareReadFrames(ReadableFakeWebSocketStream::ASYNC, OK, chunks1);
+  stream->PrepareReadFrames(ReadableFakeWebSocketStream::ASYNC, OK, chunks2);
+  set_stream(stream.Pass());
+  {
+    InSequence s;
+    EXPECT_CALL(*event_interface_, OnAddChannelResponse(false, _));
+    EXPECT_CALL(*event_interface_, OnFlowControl(_));
+    EXPECT_CALL(
+        *event_interface_,
+        OnDataFrame(false, WebSocketFrameHeader::kOpCodeText, AsVector("")));
+    EXPECT_CALL(*event_interface_,
+                OnDataFrame(true,
+                            WebSocketFrameHeader::kOpCodeContinuation,
+                            AsVector("HELLO")));
+  }
+
+  CreateChannelAndConnectSuccessfully();
+  base::MessageLoop::current()->RunUntilIdle();
+}
+
 // In the case when a single-frame message because fragmented, it must be
 // correctly transformed to multiple frames.
 TEST_F(WebSocketChannelEventInterfaceTest, MessageFragmentation) {
@@ -0,0 +1,331 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/websockets/websocket_deflate_stream.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+namespace {
+
+const char kExtensionName[] = "permessage-deflate";
+const char kClientMaxWindowBits[] = "client_max_window_bits";
+const char kServerMaxWindowBits[] = "server_max_window_bits";
+const char kClientNoContextTakeOver[] = "client_no_context_takeover";
+const char kServerNoContextTakeOver[] = "server_no_context_takeover";
+
+const int kMinWindowBits = 8;
+const int kMaxWindowBits = 15;
+
+// A server could otherwise make us allocate without bound by sending a small
+// frame which decompresses to a huge one.
+const size_t kDefaultMaxInflatedFrameSize = 64 * 1024 * 1024;
+
+// Parses a window bits parameter value, which may be quoted.
+bool ParseWindowBits(const std::string& value, int* window_bits) {
+  std::string unquoted = value;
+  if (unquoted.size() >= 2 && unquoted[0] == '"' &&
+      unquoted[unquoted.size() - 1] == '"') {
+    unquoted = unquoted.substr(1, unquoted.size() - 2);
+  }
+  int bits = 0;
+  if (!base::StringToInt(unquoted, &bits) || bits < kMinWindowBits ||
+      bits > kMaxWindowBits) {
+    return false;
+  }
+  *window_bits = bits;
+  return true;
+}
+
+WebSocketContextTakeOverMode TakeOverMode(bool no_context_takeover) {
+  return no_context_takeover ? WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT
+                             : WEBSOCKET_TAKE_OVER_CONTEXT;
+}
+
+}  // namespace
+
+WebSocketDeflateParameters::WebSocketDeflateParameters()
+    : client_max_window_bits(kMaxWindowBits),
+      server_max_window_bits(kMaxWindowBits),
+      client_no_context_takeover(false),
+      server_no_context_takeover(false),
+      client_mem_level(8),
+      max_inflated_frame_size(kDefaultMaxInflatedFrameSize) {
+}
+
+std::string WebSocketDeflateParameters::AsOffer() const {
+  // The server may always lower our window, so that is offered without a
+  // value.
+  std::string offer = std::string(kExtensionName) + "; " + kClientMaxWindowBits;
+  if (client_no_context_takeover)
+    offer += std::string("; ") + kClientNoContextTakeOver;
+  if (server_max_window_bits != kMaxWindowBits) {
+    offer += base::StringPrintf("; %s=%d", kServerMaxWindowBits,
+                                server_max_window_bits);
+  }
+  if (server_no_context_takeover)
+    offer += std::string("; ") + kServerNoContextTakeOver;
+  return offer;
+}
+
+bool WebSocketDeflateParameters::InitializeFromResponse(
+    const std::string& extensions,
+    std::string* failure_message) {
+  failure_message->clear();
+  std::vector<std::string> extension_list;
+  base::SplitString(extensions, ',', &extension_list);
+  for (size_t i = 0; i < extension_list.size(); ++i) {
+    std::vector<std::string> tokens;
+    base::SplitString(extension_list[i], ';', &tokens);
+    if (tokens.empty() || tokens[0] != kExtensionName)
+      continue;
+
+    std::vector<std::string> seen;
+    for (size_t j = 1; j < tokens.size(); ++j) {
+      std::string name = tokens[j];
+      std::string value;
+      size_t equals = tokens[j].find('=');
+      if (equals != std::string::npos) {
+        TrimWhitespaceASCII(tokens[j].substr(0, equals), TRIM_ALL, &name);
+        TrimWhitespaceASCII(tokens[j].substr(equals + 1), TRIM_ALL, &value);
+      }
+      if (std::find(seen.begin(), seen.end(), name) != seen.end()) {
+        *failure_message = "Duplicate permessage-deflate parameter " + name;
+        return false;
+      }
+      seen.push_back(name);
+
+      bool valid = true;
+      if (name == kClientNoContextTakeOver) {
+        valid = value.empty();
+        client_no_context_takeover = true;
+      } else if (name == kServerNoContextTakeOver) {
+        valid = value.empty();
+        server_no_context_takeover = true;
+      } else if (name == kClientMaxWindowBits) {
+        int bits = 0;
+        valid = ParseWindowBits(value, &bits);
+        client_max_window_bits = std::min(client_max_window_bits, bits);
+      } else if (name == kServerMaxWindowBits) {
+        valid = ParseWindowBits(value, &server_max_window_bits);
+      } else {
+        valid = false;
+      }
+      if (!valid) {
+        *failure_message =
+            "Invalid permessage-deflate parameter " + tokens[j];
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+WebSocketDeflateStream::WebSocketDeflateStream(
+    scoped_ptr<WebSocketStream> stream,
+    const WebSocketDeflateParameters& parameters)
+    : stream_(stream.Pass()),
+      parameters_(parameters),
+      deflater_(TakeOverMode(parameters.client_no_context_takeover)),
+      inflater_(TakeOverMode(parameters.server_no_context_takeover)),
+      writing_continued_message_(false),
+      reading_continued_message_(false),
+      reading_compressed_message_(false) {
+  DCHECK(stream_);
+}
+
+WebSocketDeflateStream::~WebSocketDeflateStream() {}
+
+bool WebSocketDeflateStream::Initialize() {
+  inflater_.set_max_output_size(parameters_.max_inflated_frame_size);
+  return deflater_.Initialize(parameters_.client_max_window_bits,
+                              parameters_.client_mem_level) &&
+         inflater_.Initialize(parameters_.server_max_window_bits);
+}
+
+int WebSocketDeflateStream::ReadFrames(
+    ScopedVector<WebSocketFrameChunk>* frame_chunks,
+    const CompletionCallback& callback) {
+  int result = OK;
+  do {
+    // This use of base::Unretained is safe because we own the WebSocketStream,
+    // and destroying it cancels its callbacks.
+    result = stream_->ReadFrames(
+        frame_chunks,
+        base::Bind(&WebSocketDeflateStream::OnReadComplete,
+                   base::Unretained(this),
+                   base::Unretained(frame_chunks),
+                   callback));
+    if (result != OK)
+      return result;
+    result = Inflate(frame_chunks);
+    // Keep reading if all of the chunks belonged to incomplete compressed
+    // frames.
+  } while (result == OK && frame_chunks->empty());
+  return result;
+}
+
+int WebSocketDeflateStream::WriteFrames(
+    ScopedVector<WebSocketFrameChunk>* frame_chunks,
+    const CompletionCallback& callback) {
+  int result = Deflate(frame_chunks);
+  if (result != OK)
+    return result;
+  return stream_->WriteFrames(frame_chunks, callback);
+}
+
+void WebSocketDeflateStream::Close() { stream_->Close(); }
+
+std::string WebSocketDeflateStream::GetSubProtocol() const {
+  return stream_->GetSubProtocol();
+}
+
+std::string WebSocketDeflateStream::GetExtensions() const {
+  return stream_->GetExtensions();
+}
+
+int WebSocketDeflateStream::SendHandshakeRequest(
+    const GURL& url,
+    const HttpRequestHeaders& headers,
+    HttpResponseInfo* response_info,
+    const CompletionCallback& callback) {
+  return stream_->SendHandshakeRequest(url, headers, response_info, callback);
+}
+
+int WebSocketDeflateStream::ReadHandshakeResponse(
+    const CompletionCallback& callback) {
+  return stream_->ReadHandshakeResponse(callback);
+}
+
+int WebSocketDeflateStream::Deflate(
+    ScopedVector<WebSocketFrameChunk>* frame_chunks) {
+  for (size_t i = 0; i < frame_chunks->size(); ++i) {
+    WebSocketFrameChunk* chunk = (*frame_chunks)[i];
+    WebSocketFrameHeader* header = chunk->header.get();
+    if (header && WebSocketFrameHeader::IsKnownControlOpCode(header->opcode))
+      continue;
+    // WebSocketChannel writes every frame in one chunk.
+    if (!header || !chunk->final_chunk) {
+      NOTREACHED() << "Compressing partial frames is not supported.";
+      return ERR_INVALID_ARGUMENT;
+    }
+
+    // Only the first frame of a message is marked as compressed.
+    header->reserved1 = !writing_continued_message_;
+    writing_continued_message_ = !header->final;
+
+    if (chunk->data &&
+        !deflater_.AddBytes(chunk->data->data(), chunk->data->size())) {
+      return ERR_FAILED;
+    }
+    if (!(header->final ? deflater_.Finish() : deflater_.Flush()))
+      return ERR_FAILED;
+    size_t size = deflater_.CurrentOutputSize();
+    chunk->data = deflater_.GetOutput(size);
+    header->payload_length = size;
+  }
+  return OK;
+}
+
+int WebSocketDeflateStream::Inflate(
+    ScopedVector<WebSocketFrameChunk>* frame_chunks) {
+  ScopedVector<WebSocketFrameChunk> chunks_read;
+  chunks_read.swap(*frame_chunks);
+  for (size_t i = 0; i < chunks_read.size(); ++i) {
+    scoped_ptr<WebSocketFrameChunk> chunk(chunks_read[i]);
+    chunks_read[i] = NULL;
+    if (chunk->header) {
+      WebSocketFrameHeader* header = chunk->header.get();
+      if (WebSocketFrameHeader::IsKnownControlOpCode(header->opcode)) {
+        if (header->reserved1)
+          return ERR_WS_PROTOCOL_ERROR;
+      } else {
+        if (!reading_continued_message_)
+          reading_compressed_message_ = header->reserved1;
+        else if (header->reserved1)
+          return ERR_WS_PROTOCOL_ERROR;
+        reading_continued_message_ = !header->final;
+        if (reading_compressed_message_) {
+          reading_frame_header_ = chunk->header.Pass();
+          reading_frame_header_->reserved1 = false;
+          reading_frame_data_.clear();
+        }
+      }
+    }
+
+    if (!reading_frame_header_) {
+      // Neither the frame nor its message is compressed.
+      frame_chunks->push_back(chunk.release());
+      continue;
+    }
+
+    if (chunk->data) {
+      if (static_cast<size_t>(chunk->data->size()) >
+          parameters_.max_inflated_frame_size - reading_frame_data_.size()) {
+        return ERR_WS_PROTOCOL_ERROR;
+      }
+      const char* data = chunk->data->data();
+      reading_frame_data_.insert(reading_frame_data_.end(), data,
+                                 data + chunk->data->size());
+    }
+    if (chunk->final_chunk) {
+      int result = InflateFrame(&chunk);
+      if (result != OK)
+        return result;
+      frame_chunks->push_back(chunk.release());
+    }
+  }
+  return OK;
+}
+
+int WebSocketDeflateStream::InflateFrame(
+    scoped_ptr<WebSocketFrameChunk>* chunk) {
+  scoped_ptr<WebSocketFrameHeader> header(reading_frame_header_.Pass());
+  if (!reading_frame_data_.empty() &&
+      !inflater_.AddBytes(&reading_frame_data_.front(),
+                          reading_frame_data_.size())) {
+    return ERR_WS_PROTOCOL_ERROR;
+  }
+  reading_frame_data_.clear();
+  if (header->final && !inflater_.Finish())
+    return ERR_WS_PROTOCOL_ERROR;
+
+  size_t size = inflater_.CurrentOutputSize();
+  if (size > static_cast<size_t>(kint32max))
+    return ERR_WS_PROTOCOL_ERROR;
+  header->payload_length = size;
+  chunk->reset(new WebSocketFrameChunk);
+  (*chunk)->header = header.Pass();
+  (*chunk)->final_chunk = true;
+  (*chunk)->data = inflater_.GetOutput(size);
+  return OK;
+}
+
+void WebSocketDeflateStream::OnReadComplete(
+    ScopedVector<WebSocketFrameChunk>* frame_chunks,
+    const CompletionCallback& callback,
+    int result) {
+  if (result == OK)
+    result = Inflate(frame_chunks);
+  if (result == OK && frame_chunks->empty()) {
+    result = ReadFrames(frame_chunks, callback);
+    if (result == ERR_IO_PENDING)
+      return;
+  }
+  callback.Run(result);
+}
+
+}  // namespace net
@@ -0,0 +1,126 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_WEBSOCKETS_WEBSOCKET_DEFLATE_STREAM_H_
+#define NET_WEBSOCKETS_WEBSOCKET_DEFLATE_STREAM_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "net/base/completion_callback.h"
+#include "net/base/net_export.h"
+#include "net/websockets/websocket_deflater.h"
+#include "net/websockets/websocket_frame.h"
+#include "net/websockets/websocket_stream.h"
+
+namespace net {
+
+// Parameters of the permessage-deflate extension. "Client" refers to this
+// side of the connection.
+struct NET_EXPORT_PRIVATE WebSocketDeflateParameters {
+  WebSocketDeflateParameters();
+
+  // Returns the Sec-WebSocket-Extensions value that offers permessage-deflate
+  // to the server with these parameters.
+  std::string AsOffer() const;
+
+  // Updates the parameters from the extensions the server accepted, in the
+  // format of WebSocketStream::GetExtensions(). Returns true if
+  // permessage-deflate was accepted with valid parameters. On failure,
+  // |*failure_message| says why if the extension was present but invalid.
+  bool InitializeFromResponse(const std::string& extensions,
+                              std::string* failure_message);
+
+  // Sliding window sizes, as powers of two between 8 and 15.
+  int client_max_window_bits;
+  int server_max_window_bits;
+
+  // Whether each side discards its sliding window after every message. This
+  // lets the streams be pooled between messages, at some cost in compression
+  // ratio.
+  bool client_no_context_takeover;
+  bool server_no_context_takeover;
+
+  // zlib's memory level for the compressor, between 1 and 9. Not negotiated.
+  int client_mem_level;
+
+  // The largest frame accepted from the server, both before and after
+  // decompression. Not negotiated.
+  size_t max_inflated_frame_size;
+};
+
+// A WebSocketStream that implements the permessage-deflate extension on top of
+// another WebSocketStream. Data messages are compressed as they are written,
+// and compressed messages are decompressed as they are read. Control frames
+// pass through unchanged.
+//
+// A compressed frame is buffered until it has been read completely, since the
+// length of its payload is only known once it has been decompressed. Frames
+// which exceed WebSocketDeflateParameters::max_inflated_frame_size, either
+// compressed or decompressed, fail the read with ERR_WS_PROTOCOL_ERROR.
+class NET_EXPORT_PRIVATE WebSocketDeflateStream : public WebSocketStream {
+ public:
+  WebSocketDeflateStream(scoped_ptr<WebSocketStream> stream,
+                         const WebSocketDeflateParameters& parameters);
+  virtual ~WebSocketDeflateStream();
+
+  // Sets up compression. Returns false on failure, in which case the stream
+  // must not be used.
+  bool Initialize();
+
+  // WebSocketStream functions.
+  virtual int ReadFrames(ScopedVector<WebSocketFrameChunk>* frame_chunks,
+                         const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteFrames(ScopedVector<WebSocketFrameChunk>* frame_chunks,
+                          const CompletionCallback& callback) OVERRIDE;
+  virtual void Close() OVERRIDE;
+  virtual std::string GetSubProtocol() const OVERRIDE;
+  virtual std::string GetExtensions() const OVERRIDE;
+  virtual int SendHandshakeRequest(const GURL& url,
+                                   const HttpRequestHeaders& headers,
+                                   HttpResponseInfo* response_info,
+                                   const CompletionCallback& callback) OVERRIDE;
+  virtual int ReadHandshakeResponse(
+      const CompletionCallback& callback) OVERRIDE;
+
+ private:
+  // Compresses the data frames in |frame_chunks| in place.
+  int Deflate(ScopedVector<WebSocketFrameChunk>* frame_chunks);
+
+  // Replaces the chunks of compressed frames in |frame_chunks| with
+  // decompressed frames, holding back incomplete ones.
+  int Inflate(ScopedVector<WebSocketFrameChunk>* frame_chunks);
+
+  // Decompresses the frame buffered in |reading_frame_header_| and
+  // |reading_frame_data_|.
+  int InflateFrame(scoped_ptr<WebSocketFrameChunk>* chunk);
+
+  void OnReadComplete(ScopedVector<WebSocketFrameChunk>* frame_chunks,
+                      const CompletionCallback& callback,
+                      int result);
+
+  const scoped_ptr<WebSocketStream> stream_;
+  const WebSocketDeflateParameters parameters_;
+  WebSocketDeflater deflater_;
+  WebSocketInflater inflater_;
+
+  // Whether the message being written or read continues with more frames, and
+  // whether it is compressed.
+  bool writing_continued_message_;
+  bool reading_continued_message_;
+  bool reading_compressed_message_;
+
+  // The compressed frame being read, until all of its chunks have arrived.
+  scoped_ptr<WebSocketFrameHeader> reading_frame_header_;
+  std::vector<char> reading_frame_data_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebSocketDeflateStream);
+};
+
+}  // namespace net
+
+#endif  // NET_WEBSOCKETS_WEBSOCKET_DEFLATE_STREAM_H_
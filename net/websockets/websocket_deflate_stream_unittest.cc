@@ -0,0 +1,301 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/websockets/websocket_deflate_stream.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/compiler_specific.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// A WebSocketStream that keeps the frames written to it, and returns them
+// when they are read. Both complete synchronously.
+class LoopbackWebSocketStream : public WebSocketStream {
+ public:
+  LoopbackWebSocketStream() {}
+
+  virtual int ReadFrames(ScopedVector<WebSocketFrameChunk>* frame_chunks,
+                         const CompletionCallback& callback) OVERRIDE {
+    if (chunks_.empty())
+      return ERR_IO_PENDING;
+    frame_chunks->swap(chunks_);
+    return OK;
+  }
+
+  virtual int WriteFrames(ScopedVector<WebSocketFrameChunk>* frame_chunks,
+                          const CompletionCallback& callback) OVERRIDE {
+    for (size_t i = 0; i < frame_chunks->size(); ++i) {
+      chunks_.push_back((*frame_chunks)[i]);
+      (*frame_chunks)[i] = NULL;
+    }
+    frame_chunks->clear();
+    return OK;
+  }
+
+  virtual void Close() OVERRIDE {}
+  virtual std::string GetSubProtocol() const OVERRIDE { return ""; }
+  virtual std::string GetExtensions() const OVERRIDE { return ""; }
+
+  virtual int SendHandshakeRequest(
+      const GURL& url,
+      const HttpRequestHeaders& headers,
+      HttpResponseInfo* response_info,
+      const CompletionCallback& callback) OVERRIDE {
+    return ERR_NOT_IMPLEMENTED;
+  }
+
+  virtual int ReadHandshakeResponse(
+      const CompletionCallback& callback) OVERRIDE {
+    return ERR_NOT_IMPLEMENTED;
+  }
+
+  // The frames that were written and have not been read.
+  ScopedVector<WebSocketFrameChunk>* chunks() { return &chunks_; }
+
+ private:
+  ScopedVector<WebSocketFrameChunk> chunks_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoopbackWebSocketStream);
+};
+
+scoped_ptr<WebSocketFrameChunk> CreateFrame(WebSocketFrameHeader::OpCode opcode,
+                                            bool final,
+                                            const std::string& data) {
+  scoped_ptr<WebSocketFrameChunk> chunk(new WebSocketFrameChunk);
+  chunk->header.reset(new WebSocketFrameHeader(opcode));
+  chunk->header->final = final;
+  chunk->header->payload_length = data.size();
+  chunk->final_chunk = true;
+  chunk->data = new IOBufferWithSize(data.size());
+  std::copy(data.begin(), data.end(), chunk->data->data());
+  return chunk.Pass();
+}
+
+std::string ToString(const WebSocketFrameChunk& chunk) {
+  return std::string(chunk.data->data(), chunk.data->size());
+}
+
+class WebSocketDeflateStreamTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    loopback_ = new LoopbackWebSocketStream;
+    stream_.reset(new WebSocketDeflateStream(
+        scoped_ptr<WebSocketStream>(loopback_), WebSocketDeflateParameters()));
+    ASSERT_TRUE(stream_->Initialize());
+  }
+
+  void Write(scoped_ptr<WebSocketFrameChunk> chunk) {
+    ScopedVector<WebSocketFrameChunk> chunks;
+    chunks.push_back(chunk.release());
+    ASSERT_EQ(OK, stream_->WriteFrames(&chunks, CompletionCallback()));
+  }
+
+  // Owned by |stream_|.
+  LoopbackWebSocketStream* loopback_;
+  scoped_ptr<WebSocketDeflateStream> stream_;
+};
+
+TEST_F(WebSocketDeflateStreamTest, RoundTrip) {
+  Write(CreateFrame(WebSocketFrameHeader::kOpCodeText, true, "Hello"));
+
+  // The frame is written compressed.
+  ASSERT_EQ(1u, loopback_->chunks()->size());
+  const WebSocketFrameChunk& written = *(*loopback_->chunks())[0];
+  EXPECT_TRUE(written.header->reserved1);
+  EXPECT_EQ(std::string("\xf2\x48\xcd\xc9\xc9\x07\x00", 7), ToString(written));
+  EXPECT_EQ(7u, written.header->payload_length);
+
+  ScopedVector<WebSocketFrameChunk> chunks;
+  ASSERT_EQ(OK, stream_->ReadFrames(&chunks, CompletionCallback()));
+  ASSERT_EQ(1u, chunks.size());
+  EXPECT_FALSE(chunks[0]->header->reserved1);
+  EXPECT_EQ(5u, chunks[0]->header->payload_length);
+  EXPECT_EQ("Hello", ToString(*chunks[0]));
+}
+
+TEST_F(WebSocketDeflateStreamTest, FragmentedMessage) {
+  Write(CreateFrame(WebSocketFrameHeader::kOpCodeText, false, "Hello, "));
+  Write(CreateFrame(WebSocketFrameHeader::kOpCodeContinuation, true, "world"));
+
+  // Only the first frame of the message is marked as compressed.
+  ASSERT_EQ(2u, loopback_->chunks()->size());
+  EXPECT_TRUE((*loopback_->chunks())[0]->header->reserved1);
+  EXPECT_FALSE((*loopback_->chunks())[1]->header->reserved1);
+
+  ScopedVector<WebSocketFrameChunk> chunks;
+  ASSERT_EQ(OK, stream_->ReadFrames(&chunks, CompletionCallback()));
+  ASSERT_EQ(2u, chunks.size());
+  EXPECT_EQ("Hello, ", ToString(*chunks[0]));
+  EXPECT_EQ("world", ToString(*chunks[1]));
+  EXPECT_TRUE(chunks[1]->header->final);
+}
+
+TEST_F(WebSocketDeflateStreamTest, ControlFramesAreNotCompressed) {
+  Write(CreateFrame(WebSocketFrameHeader::kOpCodePing, true, "ping"));
+  ASSERT_EQ(1u, loopback_->chunks()->size());
+  EXPECT_FALSE((*loopback_->chunks())[0]->header->reserved1);
+  EXPECT_EQ("ping", ToString(*(*loopback_->chunks())[0]));
+}
+
+TEST_F(WebSocketDeflateStreamTest, UncompressedMessagePassesThrough) {
+  loopback_->chunks()->push_back(
+      CreateFrame(WebSocketFrameHeader::kOpCodeText, true, "plain").release());
+  ScopedVector<WebSocketFrameChunk> chunks;
+  ASSERT_EQ(OK, stream_->ReadFrames(&chunks, CompletionCallback()));
+  ASSERT_EQ(1u, chunks.size());
+  EXPECT_EQ("plain", ToString(*chunks[0]));
+}
+
+TEST_F(WebSocketDeflateStreamTest, CompressedFrameSplitIntoChunks) {
+  Write(CreateFrame(WebSocketFrameHeader::kOpCodeText, true, "Hello"));
+  std::string compressed = ToString(*(*loopback_->chunks())[0]);
+  loopback_->chunks()->clear();
+
+  // The first half of the frame arrives on its own, and is held back.
+  scoped_ptr<WebSocketFrameChunk> first(new WebSocketFrameChunk);
+  first->header.reset(new WebSocketFrameHeader(
+      WebSocketFrameHeader::kOpCodeText));
+  first->header->final = true;
+  first->header->reserved1 = true;
+  first->header->payload_length = compressed.size();
+  first->data = new IOBufferWithSize(3);
+  std::copy(compressed.begin(), compressed.begin() + 3, first->data->data());
+  loopback_->chunks()->push_back(first.release());
+  ScopedVector<WebSocketFrameChunk> chunks;
+  EXPECT_EQ(ERR_IO_PENDING,
+            stream_->ReadFrames(&chunks, CompletionCallback()));
+  EXPECT_TRUE(chunks.empty());
+
+  scoped_ptr<WebSocketFrameChunk> rest(new WebSocketFrameChunk);
+  rest->final_chunk = true;
+  rest->data = new IOBufferWithSize(compressed.size() - 3);
+  std::copy(compressed.begin() + 3, compressed.end(), rest->data->data());
+  loopback_->chunks()->push_back(rest.release());
+  ASSERT_EQ(OK, stream_->ReadFrames(&chunks, CompletionCallback()));
+  ASSERT_EQ(1u, chunks.size());
+  EXPECT_EQ("Hello", ToString(*chunks[0]));
+}
+
+TEST_F(WebSocketDeflateStreamTest, CompressedControlFrameIsRejected) {
+  scoped_ptr<WebSocketFrameChunk> ping(
+      CreateFrame(WebSocketFrameHeader::kOpCodePing, true, ""));
+  ping->header->reserved1 = true;
+  loopback_->chunks()->push_back(ping.release());
+  ScopedVector<WebSocketFrameChunk> chunks;
+  EXPECT_EQ(ERR_WS_PROTOCOL_ERROR,
+            stream_->ReadFrames(&chunks, CompletionCallback()));
+}
+
+TEST_F(WebSocketDeflateStreamTest, OversizedInflatedFrameIsRejected) {
+  const std::string message(100000, 'x');
+  Write(CreateFrame(WebSocketFrameHeader::kOpCodeText, true, message));
+  ScopedVector<WebSocketFrameChunk> written;
+  written.swap(*loopback_->chunks());
+  ASSERT_EQ(1u, written.size());
+  ASSERT_LT(static_cast<size_t>(written[0]->data->size()), 1000u);
+
+  // The frame is small, but decompresses to more than is allowed.
+  WebSocketDeflateParameters parameters;
+  parameters.max_inflated_frame_size = message.size() - 1;
+  LoopbackWebSocketStream* loopback = new LoopbackWebSocketStream;
+  WebSocketDeflateStream limited_stream(
+      scoped_ptr<WebSocketStream>(loopback), parameters);
+  ASSERT_TRUE(limited_stream.Initialize());
+  loopback->chunks()->swap(written);
+  ScopedVector<WebSocketFrameChunk> chunks;
+  EXPECT_EQ(ERR_WS_PROTOCOL_ERROR,
+            limited_stream.ReadFrames(&chunks, CompletionCallback()));
+}
+
+TEST_F(WebSocketDeflateStreamTest, OversizedCompressedFrameIsRejected) {
+  WebSocketDeflateParameters parameters;
+  parameters.max_inflated_frame_size = 16;
+  LoopbackWebSocketStream* loopback = new LoopbackWebSocketStream;
+  WebSocketDeflateStream limited_stream(
+      scoped_ptr<WebSocketStream>(loopback), parameters);
+  ASSERT_TRUE(limited_stream.Initialize());
+
+  // The compressed frame is rejected as it is buffered, before it is
+  // complete.
+  scoped_ptr<WebSocketFrameChunk> first(new WebSocketFrameChunk);
+  first->header.reset(new WebSocketFrameHeader(
+      WebSocketFrameHeader::kOpCodeText));
+  first->header->final = true;
+  first->header->reserved1 = true;
+  first->header->payload_length = 1000;
+  first->data = new IOBufferWithSize(17);
+  std::fill(first->data->data(), first->data->data() + 17, '\0');
+  loopback->chunks()->push_back(first.release());
+  ScopedVector<WebSocketFrameChunk> chunks;
+  EXPECT_EQ(ERR_WS_PROTOCOL_ERROR,
+            limited_stream.ReadFrames(&chunks, CompletionCallback()));
+}
+
+TEST(WebSocketDeflateParametersTest, Offer) {
+  WebSocketDeflateParameters parameters;
+  EXPECT_EQ("permessage-deflate; client_max_window_bits",
+            parameters.AsOffer());
+  parameters.server_max_window_bits = 10;
+  parameters.server_no_context_takeover = true;
+  EXPECT_EQ("permessage-deflate; client_max_window_bits; "
+            "server_max_window_bits=10; server_no_context_takeover",
+            parameters.AsOffer());
+}
+
+TEST(WebSocketDeflateParametersTest, Response) {
+  WebSocketDeflateParameters parameters;
+  std::string failure_message;
+  EXPECT_TRUE(parameters.InitializeFromResponse(
+      "foo, permessage-deflate; client_max_window_bits=10; "
+      "server_max_window_bits=\"12\"; client_no_context_takeover",
+      &failure_message));
+  EXPECT_EQ("", failure_message);
+  EXPECT_EQ(10, parameters.client_max_window_bits);
+  EXPECT_EQ(12, parameters.server_max_window_bits);
+  EXPECT_TRUE(parameters.client_no_context_takeover);
+  EXPECT_FALSE(parameters.server_no_context_takeover);
+}
+
+TEST(WebSocketDeflateParametersTest, NotAccepted) {
+  WebSocketDeflateParameters parameters;
+  std::string failure_message;
+  EXPECT_FALSE(parameters.InitializeFromResponse("", &failure_message));
+  EXPECT_EQ("", failure_message);
+  EXPECT_FALSE(parameters.InitializeFromResponse("x-webkit-deflate-frame",
+                                                 &failure_message));
+  EXPECT_EQ("", failure_message);
+}
+
+TEST(WebSocketDeflateParametersTest, InvalidResponse) {
+  static const char* const kInvalidResponses[] = {
+    "permessage-deflate; client_max_window_bits=16",
+    "permessage-deflate; server_max_window_bits=7",
+    "permessage-deflate; server_max_window_bits",
+    "permessage-deflate; client_no_context_takeover=1",
+    "permessage-deflate; server_no_context_takeover; "
+        "server_no_context_takeover",
+    "permessage-deflate; unknown_parameter",
+  };
+  for (size_t i = 0; i < arraysize(kInvalidResponses); ++i) {
+    WebSocketDeflateParameters parameters;
+    std::string failure_message;
+    EXPECT_FALSE(parameters.InitializeFromResponse(kInvalidResponses[i],
+                                                   &failure_message))
+        << kInvalidResponses[i];
+    EXPECT_NE("", failure_message) << kInvalidResponses[i];
+  }
+}
+
+}  // namespace
+
+}  // namespace net
@@ -0,0 +1,321 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/websockets/websocket_deflater.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "net/base/io_buffer.h"
+#include "third_party/zlib/zlib.h"
+
+namespace net {
+
+namespace {
+
+// The size of the buffer that zlib writes its output to.
+const size_t kFixedBufferSize = 4096;
+
+// The tail that a sync flush leaves in a deflate stream. permessage-deflate
+// omits it from the end of each message.
+const char kFlushTrailer[] = {'\x00', '\x00', '\xff', '\xff'};
+
+// Most idle streams kept for each combination of parameters.
+const size_t kMaxIdleStreams = 16;
+
+enum StreamKind {
+  DEFLATE_STREAM,
+  INFLATE_STREAM,
+};
+
+// Returns a new initialized stream, or NULL on failure.
+z_stream* CreateStream(StreamKind kind, int window_bits, int mem_level) {
+  scoped_ptr<z_stream> stream(new z_stream);
+  memset(stream.get(), 0, sizeof(*stream));
+  // Negative window bits select raw deflate, without a zlib header.
+  int result = (kind == DEFLATE_STREAM) ?
+      deflateInit2(stream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   -window_bits, mem_level,
+                   Z_DEFAULT_STRATEGY) :
+      inflateInit2(stream.get(), -window_bits);
+  if (result != Z_OK) {
+    DLOG(ERROR) << "Failed to initialize a zlib stream: " << result;
+    return NULL;
+  }
+  return stream.release();
+}
+
+void DestroyStream(StreamKind kind, z_stream* stream) {
+  if (kind == DEFLATE_STREAM)
+    deflateEnd(stream);
+  else
+    inflateEnd(stream);
+  delete stream;
+}
+
+// Idle zlib streams, for the deflaters and inflaters that do not take over
+// their context between messages.
+class StreamPool {
+ public:
+  StreamPool() {}
+
+  // Returns an initialized stream, or NULL on failure.
+  z_stream* Acquire(StreamKind kind, int window_bits, int mem_level) {
+    {
+      base::AutoLock auto_lock(lock_);
+      std::vector<z_stream*>* idle_streams =
+          &idle_streams_[Key(kind, window_bits, mem_level)];
+      if (!idle_streams->empty()) {
+        z_stream* stream = idle_streams->back();
+        idle_streams->pop_back();
+        return stream;
+      }
+    }
+    return CreateStream(kind, window_bits, mem_level);
+  }
+
+  // Resets |stream| and keeps it for reuse, unless enough are kept already.
+  void Release(StreamKind kind,
+               int window_bits,
+               int mem_level,
+               z_stream* stream) {
+    int result = (kind == DEFLATE_STREAM) ?
+        deflateReset(stream) : inflateReset(stream);
+    if (result == Z_OK) {
+      base::AutoLock auto_lock(lock_);
+      std::vector<z_stream*>* idle_streams =
+          &idle_streams_[Key(kind, window_bits, mem_level)];
+      if (idle_streams->size() < kMaxIdleStreams) {
+        idle_streams->push_back(stream);
+        return;
+      }
+    }
+    DestroyStream(kind, stream);
+  }
+
+ private:
+  // zlib fixes the parameters of a stream when it is initialized, so streams
+  // are only shared between users with the same ones.
+  static int Key(StreamKind kind, int window_bits, int mem_level) {
+    return (kind << 8) | (window_bits << 4) | mem_level;
+  }
+
+  base::Lock lock_;
+  std::map<int, std::vector<z_stream*> > idle_streams_;
+
+  DISALLOW_COPY_AND_ASSIGN(StreamPool);
+};
+
+base::LazyInstance<StreamPool>::Leaky g_stream_pool =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Removes at most |size| bytes from the front of |buffer| and returns them.
+scoped_refptr<IOBufferWithSize> TakeOutput(std::deque<char>* buffer,
+                                           size_t size) {
+  size = std::min(size, buffer->size());
+  scoped_refptr<IOBufferWithSize> output(new IOBufferWithSize(size));
+  std::copy(buffer->begin(), buffer->begin() + size, output->data());
+  buffer->erase(buffer->begin(), buffer->begin() + size);
+  return output;
+}
+
+}  // namespace
+
+WebSocketDeflater::WebSocketDeflater(WebSocketContextTakeOverMode mode)
+    : mode_(mode),
+      window_bits_(0),
+      mem_level_(0),
+      stream_(NULL),
+      fixed_buffer_(kFixedBufferSize) {
+}
+
+WebSocketDeflater::~WebSocketDeflater() {
+  if (!stream_)
+    return;
+  if (mode_ == WEBSOCKET_TAKE_OVER_CONTEXT) {
+    DestroyStream(DEFLATE_STREAM, stream_);
+  } else {
+    g_stream_pool.Get().Release(
+        DEFLATE_STREAM, window_bits_, mem_level_, stream_);
+  }
+}
+
+bool WebSocketDeflater::Initialize(int window_bits, int mem_level) {
+  DCHECK(!window_bits_);
+  // zlib does not support raw deflate with an 8 bit window.
+  if (window_bits < 9 || window_bits > 15 || mem_level < 1 || mem_level > 9)
+    return false;
+  window_bits_ = window_bits;
+  mem_level_ = mem_level;
+  if (mode_ == WEBSOCKET_TAKE_OVER_CONTEXT) {
+    stream_ = CreateStream(DEFLATE_STREAM, window_bits_, mem_level_);
+    return stream_ != NULL;
+  }
+  return true;
+}
+
+bool WebSocketDeflater::AddBytes(const char* data, size_t size) {
+  if (!size)
+    return true;
+  if (!stream_) {
+    stream_ =
+        g_stream_pool.Get().Acquire(DEFLATE_STREAM, window_bits_, mem_level_);
+    if (!stream_)
+      return false;
+  }
+  stream_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream_->avail_in = size;
+  return Deflate(Z_NO_FLUSH);
+}
+
+bool WebSocketDeflater::Flush() {
+  if (!stream_)
+    return true;  // Nothing was added since the last flush.
+  return Deflate(Z_SYNC_FLUSH);
+}
+
+bool WebSocketDeflater::Finish() {
+  if (!stream_) {
+    // An empty message is a single empty stored block.
+    buffer_.push_back('\x00');
+    return true;
+  }
+  size_t size_before_flush = buffer_.size();
+  if (!Deflate(Z_SYNC_FLUSH))
+    return false;
+  if (buffer_.size() == size_before_flush) {
+    // zlib writes nothing if it was flushed already and given no data since.
+    // The receiver appends the trailer to this header of an empty stored
+    // block.
+    buffer_.push_back('\x00');
+  } else {
+    DCHECK_GE(buffer_.size(), arraysize(kFlushTrailer));
+    DCHECK(std::equal(kFlushTrailer, kFlushTrailer + arraysize(kFlushTrailer),
+                      buffer_.end() - arraysize(kFlushTrailer)));
+    buffer_.resize(buffer_.size() - arraysize(kFlushTrailer));
+  }
+
+  if (mode_ == WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT) {
+    g_stream_pool.Get().Release(
+        DEFLATE_STREAM, window_bits_, mem_level_, stream_);
+    stream_ = NULL;
+  }
+  return true;
+}
+
+scoped_refptr<IOBufferWithSize> WebSocketDeflater::GetOutput(size_t size) {
+  return TakeOutput(&buffer_, size);
+}
+
+// static
+size_t WebSocketDeflater::EstimateMemoryUsage(int window_bits, int mem_level) {
+  return (1 << (window_bits + 2)) + (1 << (mem_level + 9));
+}
+
+bool WebSocketDeflater::Deflate(int flush) {
+  // zlib only stops short of filling the output buffer once it has consumed
+  // all of the input and, if asked to, flushed.
+  do {
+    stream_->next_out = reinterpret_cast<Bytef*>(&fixed_buffer_[0]);
+    stream_->avail_out = fixed_buffer_.size();
+    int result = deflate(stream_, flush);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      DLOG(ERROR) << "deflate() failed: " << result;
+      return false;
+    }
+    size_t written = fixed_buffer_.size() - stream_->avail_out;
+    buffer_.insert(buffer_.end(), fixed_buffer_.begin(),
+                   fixed_buffer_.begin() + written);
+  } while (stream_->avail_out == 0);
+  DCHECK_EQ(0u, stream_->avail_in);
+  return true;
+}
+
+WebSocketInflater::WebSocketInflater(WebSocketContextTakeOverMode mode)
+    : mode_(mode),
+      window_bits_(0),
+      max_output_size_(std::numeric_limits<size_t>::max()),
+      stream_(NULL),
+      fixed_buffer_(kFixedBufferSize) {
+}
+
+WebSocketInflater::~WebSocketInflater() {
+  if (!stream_)
+    return;
+  if (mode_ == WEBSOCKET_TAKE_OVER_CONTEXT)
+    DestroyStream(INFLATE_STREAM, stream_);
+  else
+    g_stream_pool.Get().Release(INFLATE_STREAM, window_bits_, 0, stream_);
+}
+
+bool WebSocketInflater::Initialize(int window_bits) {
+  DCHECK(!window_bits_);
+  if (window_bits < 8 || window_bits > 15)
+    return false;
+  window_bits_ = window_bits;
+  if (mode_ == WEBSOCKET_TAKE_OVER_CONTEXT) {
+    stream_ = CreateStream(INFLATE_STREAM, window_bits_, 0);
+    return stream_ != NULL;
+  }
+  return true;
+}
+
+bool WebSocketInflater::AddBytes(const char* data, size_t size) {
+  if (!size)
+    return true;
+  if (!stream_) {
+    stream_ = g_stream_pool.Get().Acquire(INFLATE_STREAM, window_bits_, 0);
+    if (!stream_)
+      return false;
+  }
+  stream_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream_->avail_in = size;
+  do {
+    stream_->next_out = reinterpret_cast<Bytef*>(&fixed_buffer_[0]);
+    stream_->avail_out = fixed_buffer_.size();
+    int result = inflate(stream_, Z_SYNC_FLUSH);
+    if (result == Z_STREAM_END) {
+      // The sender ended the deflate stream. Any further data starts a new
+      // one.
+      result = inflateReset(stream_);
+    }
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      DVLOG(1) << "inflate() failed: " << result;
+      return false;
+    }
+    size_t written = fixed_buffer_.size() - stream_->avail_out;
+    if (written > max_output_size_ - buffer_.size()) {
+      DVLOG(1) << "inflate() output exceeds " << max_output_size_ << " bytes";
+      return false;
+    }
+    buffer_.insert(buffer_.end(), fixed_buffer_.begin(),
+                   fixed_buffer_.begin() + written);
+    if (result == Z_BUF_ERROR && !written)
+      break;  // No progress is possible.
+  } while (stream_->avail_in > 0 || stream_->avail_out == 0);
+  return true;
+}
+
+bool WebSocketInflater::Finish() {
+  if (!AddBytes(kFlushTrailer, arraysize(kFlushTrailer)))
+    return false;
+  if (mode_ == WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT) {
+    g_stream_pool.Get().Release(INFLATE_STREAM, window_bits_, 0, stream_);
+    stream_ = NULL;
+  }
+  return true;
+}
+
+scoped_refptr<IOBufferWithSize> WebSocketInflater::GetOutput(size_t size) {
+  return TakeOutput(&buffer_, size);
+}
+
+}  // namespace net
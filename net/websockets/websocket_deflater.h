@@ -0,0 +1,125 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_WEBSOCKETS_WEBSOCKET_DEFLATER_H_
+#define NET_WEBSOCKETS_WEBSOCKET_DEFLATER_H_
+
+#include <deque>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "net/base/net_export.h"
+
+struct z_stream_s;
+
+namespace net {
+
+class IOBufferWithSize;
+
+// Whether a compressor or decompressor keeps its sliding window from one
+// message to the next, as negotiated by the permessage-deflate extension.
+enum WebSocketContextTakeOverMode {
+  WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT,
+  WEBSOCKET_TAKE_OVER_CONTEXT,
+};
+
+// Compresses the payload of WebSocket messages for the permessage-deflate
+// extension. The payload of a message is passed to AddBytes() in any number
+// of pieces, and the compressed data is taken with GetOutput() after each
+// Flush() or Finish().
+//
+// A deflater that does not take over its context between messages only holds
+// a zlib stream while it is in the middle of a message. Between messages the
+// stream is returned to a process-wide pool, so idle connections use no zlib
+// memory.
+class NET_EXPORT_PRIVATE WebSocketDeflater {
+ public:
+  explicit WebSocketDeflater(WebSocketContextTakeOverMode mode);
+  ~WebSocketDeflater();
+
+  // Sets up the compressor. |window_bits| must be between 9 and 15, since
+  // zlib cannot compress with an 8 bit window, and |mem_level| between 1 and
+  // 9. Returns false on failure.
+  bool Initialize(int window_bits, int mem_level);
+
+  // Adds payload data to the current message. Returns false on failure.
+  bool AddBytes(const char* data, size_t size);
+
+  // Makes the compressed form of everything added so far available, at the
+  // end of a frame in the middle of a message.
+  bool Flush();
+
+  // Ends the current message and makes the rest of its compressed form
+  // available.
+  bool Finish();
+
+  // Removes and returns at most |size| bytes of the compressed output.
+  scoped_refptr<IOBufferWithSize> GetOutput(size_t size);
+
+  size_t CurrentOutputSize() const { return buffer_.size(); }
+
+  // Returns the memory that zlib allocates for a compressor with these
+  // parameters, as documented in zconf.h.
+  static size_t EstimateMemoryUsage(int window_bits, int mem_level);
+
+ private:
+  // Deflates everything in |stream_|'s input with |flush|.
+  bool Deflate(int flush);
+
+  const WebSocketContextTakeOverMode mode_;
+  int window_bits_;
+  int mem_level_;
+  z_stream_s* stream_;
+  std::deque<char> buffer_;
+  std::vector<char> fixed_buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebSocketDeflater);
+};
+
+// Decompresses the payload of WebSocket messages compressed with the
+// permessage-deflate extension. The streams of inflaters that do not take
+// over their context are pooled as for WebSocketDeflater.
+class NET_EXPORT_PRIVATE WebSocketInflater {
+ public:
+  explicit WebSocketInflater(WebSocketContextTakeOverMode mode);
+  ~WebSocketInflater();
+
+  // Sets up the decompressor. |window_bits| must be between 8 and 15. Returns
+  // false on failure.
+  bool Initialize(int window_bits);
+
+  // Adds compressed payload data of the current message. Returns false if the
+  // data is corrupt, or if it decompresses to more output than allowed by
+  // set_max_output_size().
+  bool AddBytes(const char* data, size_t size);
+
+  // Ends the current message.
+  bool Finish();
+
+  // Limits the output that may wait to be taken with GetOutput(). The limit
+  // is checked as the output is produced, so a small input cannot make the
+  // inflater allocate much more than |size| bytes. There is no limit by
+  // default.
+  void set_max_output_size(size_t size) { max_output_size_ = size; }
+
+  // Removes and returns at most |size| bytes of the decompressed output.
+  scoped_refptr<IOBufferWithSize> GetOutput(size_t size);
+
+  size_t CurrentOutputSize() const { return buffer_.size(); }
+
+ private:
+  const WebSocketContextTakeOverMode mode_;
+  int window_bits_;
+  size_t max_output_size_;
+  z_stream_s* stream_;
+  std::deque<char> buffer_;
+  std::vector<char> fixed_buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebSocketInflater);
+};
+
+}  // namespace net
+
+#endif  // NET_WEBSOCKETS_WEBSOCKET_DEFLATER_H_
@@ -0,0 +1,278 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/websockets/websocket_deflater.h"
+
+#include <string>
+
+#include "base/command_line.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "net/base/io_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+// Run
+//   out/Release/net_unittests --websocket-deflate-iterations=100
+//      --gtest_filter='WebSocketDeflaterBenchmark.*'
+// to benchmark permessage-deflate compression.
+static const char kBenchmarkIterations[] = "websocket-deflate-iterations";
+static const int kDefaultIterations = 1;
+
+namespace net {
+
+namespace {
+
+std::string ToString(IOBufferWithSize* buffer) {
+  return std::string(buffer->data(), buffer->size());
+}
+
+std::string Deflate(WebSocketDeflater* deflater, const std::string& message) {
+  EXPECT_TRUE(deflater->AddBytes(message.data(), message.size()));
+  EXPECT_TRUE(deflater->Finish());
+  scoped_refptr<IOBufferWithSize> output =
+      deflater->GetOutput(deflater->CurrentOutputSize());
+  return ToString(output.get());
+}
+
+std::string Inflate(WebSocketInflater* inflater, const std::string& data) {
+  EXPECT_TRUE(inflater->AddBytes(data.data(), data.size()));
+  EXPECT_TRUE(inflater->Finish());
+  scoped_refptr<IOBufferWithSize> output =
+      inflater->GetOutput(inflater->CurrentOutputSize());
+  return ToString(output.get());
+}
+
+// A JSON message of the kind that permessage-deflate is meant for.
+std::string JsonMessage(int id) {
+  return base::StringPrintf(
+      "{\"id\":%d,\"type\":\"update\",\"symbol\":\"GOOG\",\"price\":%d.25,"
+      "\"volume\":%d,\"exchange\":\"NASDAQ\",\"currency\":\"USD\"}",
+      id, 800 + id % 50, 1000 * id);
+}
+
+TEST(WebSocketDeflaterTest, Hello) {
+  // From the permessage-deflate specification.
+  WebSocketDeflater deflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(deflater.Initialize(15, 8));
+  EXPECT_EQ(std::string("\xf2\x48\xcd\xc9\xc9\x07\x00", 7),
+            Deflate(&deflater, "Hello"));
+  // The context is not taken over, so the message compresses the same way.
+  EXPECT_EQ(std::string("\xf2\x48\xcd\xc9\xc9\x07\x00", 7),
+            Deflate(&deflater, "Hello"));
+}
+
+TEST(WebSocketDeflaterTest, EmptyMessage) {
+  WebSocketDeflater deflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(deflater.Initialize(15, 8));
+  EXPECT_EQ(std::string(1, '\x00'), Deflate(&deflater, ""));
+
+  WebSocketInflater inflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(inflater.Initialize(15));
+  EXPECT_EQ("", Inflate(&inflater, std::string(1, '\x00')));
+}
+
+TEST(WebSocketDeflaterTest, InvalidParameters) {
+  WebSocketDeflater deflater1(WEBSOCKET_TAKE_OVER_CONTEXT);
+  EXPECT_FALSE(deflater1.Initialize(8, 8));
+  WebSocketDeflater deflater2(WEBSOCKET_TAKE_OVER_CONTEXT);
+  EXPECT_FALSE(deflater2.Initialize(15, 10));
+  WebSocketInflater inflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+  EXPECT_FALSE(inflater.Initialize(16));
+}
+
+TEST(WebSocketDeflaterTest, ContextTakeOver) {
+  WebSocketDeflater deflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(deflater.Initialize(15, 8));
+  WebSocketInflater inflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(inflater.Initialize(15));
+
+  std::string message = JsonMessage(1);
+  std::string first = Deflate(&deflater, message);
+  std::string second = Deflate(&deflater, message);
+  // The second message refers back to the first.
+  EXPECT_LT(second.size(), first.size());
+  EXPECT_EQ(message, Inflate(&inflater, first));
+  EXPECT_EQ(message, Inflate(&inflater, second));
+}
+
+TEST(WebSocketDeflaterTest, WindowBits) {
+  for (int window_bits = 9; window_bits <= 15; ++window_bits) {
+    WebSocketDeflater deflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+    ASSERT_TRUE(deflater.Initialize(window_bits, 1));
+    WebSocketInflater inflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+    ASSERT_TRUE(inflater.Initialize(window_bits));
+    std::string message;
+    for (int i = 0; i < 100; ++i)
+      message += JsonMessage(i);
+    EXPECT_EQ(message, Inflate(&inflater, Deflate(&deflater, message)))
+        << "window_bits = " << window_bits;
+  }
+}
+
+TEST(WebSocketDeflaterTest, MessageInSeveralFrames) {
+  WebSocketDeflater deflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(deflater.Initialize(15, 8));
+  WebSocketInflater inflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(inflater.Initialize(15));
+
+  ASSERT_TRUE(deflater.AddBytes("Hello, ", 7));
+  ASSERT_TRUE(deflater.Flush());
+  scoped_refptr<IOBufferWithSize> frame1 =
+      deflater.GetOutput(deflater.CurrentOutputSize());
+  ASSERT_TRUE(deflater.AddBytes("world", 5));
+  ASSERT_TRUE(deflater.Finish());
+  scoped_refptr<IOBufferWithSize> frame2 =
+      deflater.GetOutput(deflater.CurrentOutputSize());
+
+  // Everything in the first frame can be decompressed before the second one
+  // arrives.
+  ASSERT_TRUE(inflater.AddBytes(frame1->data(), frame1->size()));
+  EXPECT_EQ("Hello, ",
+            ToString(inflater.GetOutput(inflater.CurrentOutputSize()).get()));
+  EXPECT_EQ("world", Inflate(&inflater, ToString(frame2.get())));
+}
+
+TEST(WebSocketDeflaterTest, LargeMessage) {
+  WebSocketDeflater deflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(deflater.Initialize(15, 8));
+  WebSocketInflater inflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(inflater.Initialize(15));
+
+  // Incompressible data, larger than zlib's output buffer.
+  std::string message;
+  uint32 state = 1;
+  for (int i = 0; i < 100000; ++i) {
+    state = state * 1103515245 + 12345;
+    message.push_back(static_cast<char>(state >> 16));
+  }
+  std::string compressed = Deflate(&deflater, message);
+  EXPECT_EQ(message, Inflate(&inflater, compressed));
+
+  // Output can be taken in pieces.
+  ASSERT_TRUE(inflater.AddBytes(compressed.data(), compressed.size()));
+  ASSERT_TRUE(inflater.Finish());
+  EXPECT_EQ(message.substr(0, 10), ToString(inflater.GetOutput(10).get()));
+  EXPECT_EQ(message.size() - 10, inflater.CurrentOutputSize());
+}
+
+TEST(WebSocketDeflaterTest, CorruptData) {
+  WebSocketInflater inflater(WEBSOCKET_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(inflater.Initialize(15));
+  // A block with the reserved type 3.
+  EXPECT_FALSE(inflater.AddBytes("\xff\xff\xff\xff", 4));
+}
+
+TEST(WebSocketDeflaterTest, MaxOutputSize) {
+  WebSocketDeflater deflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(deflater.Initialize(15, 8));
+  // A megabyte of zeros compresses to about a kilobyte.
+  const std::string message(1024 * 1024, '\0');
+  std::string compressed = Deflate(&deflater, message);
+  ASSERT_LT(compressed.size(), 4096u);
+
+  WebSocketInflater inflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(inflater.Initialize(15));
+  inflater.set_max_output_size(message.size());
+  EXPECT_EQ(message, Inflate(&inflater, compressed));
+
+  WebSocketInflater limited_inflater(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT);
+  ASSERT_TRUE(limited_inflater.Initialize(15));
+  limited_inflater.set_max_output_size(message.size() - 1);
+  EXPECT_FALSE(limited_inflater.AddBytes(compressed.data(),
+                                         compressed.size()));
+  EXPECT_LE(limited_inflater.CurrentOutputSize(), message.size() - 1);
+}
+
+class WebSocketDeflaterBenchmark : public testing::Test {
+ public:
+  WebSocketDeflaterBenchmark() : iterations_(kDefaultIterations) {}
+
+  virtual void SetUp() {
+    std::string iterations(
+        CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+            kBenchmarkIterations));
+    int benchmark_iterations = 0;
+    if (!iterations.empty() &&
+        base::StringToInt(iterations, &benchmark_iterations)) {
+      iterations_ = benchmark_iterations;
+    }
+  }
+
+  // Compresses and decompresses a stream of JSON messages and logs the
+  // compression ratio, the CPU time per megabyte of input, and the zlib
+  // memory that each connection holds.
+  void Benchmark(WebSocketContextTakeOverMode mode,
+                 int window_bits,
+                 int mem_level) {
+    static const int kMessages = 10000;
+    std::vector<std::string> messages;
+    size_t input_size = 0;
+    for (int i = 0; i < kMessages; ++i) {
+      messages.push_back(JsonMessage(i));
+      input_size += messages.back().size();
+    }
+
+    size_t output_size = 0;
+    base::TimeDelta deflate_time;
+    base::TimeDelta inflate_time;
+    for (int x = 0; x < iterations_; ++x) {
+      WebSocketDeflater deflater(mode);
+      ASSERT_TRUE(deflater.Initialize(window_bits, mem_level));
+      WebSocketInflater inflater(mode);
+      ASSERT_TRUE(inflater.Initialize(window_bits));
+      output_size = 0;
+      for (size_t i = 0; i < messages.size(); ++i) {
+        base::TimeTicks start = base::TimeTicks::HighResNow();
+        std::string compressed = Deflate(&deflater, messages[i]);
+        base::TimeTicks middle = base::TimeTicks::HighResNow();
+        std::string decompressed = Inflate(&inflater, compressed);
+        inflate_time += base::TimeTicks::HighResNow() - middle;
+        deflate_time += middle - start;
+        output_size += compressed.size();
+        ASSERT_EQ(messages[i].size(), decompressed.size());
+      }
+    }
+
+    double megabytes =
+        static_cast<double>(input_size) * iterations_ / (1024 * 1024);
+    // Connections that do not take over their context hold no zlib memory
+    // between messages.
+    size_t memory_per_connection =
+        mode == WEBSOCKET_TAKE_OVER_CONTEXT ?
+        WebSocketDeflater::EstimateMemoryUsage(window_bits, mem_level) +
+            (1 << window_bits) : 0;
+    LOG(INFO) << base::StringPrintf(
+        "%s, window_bits %d, mem_level %d: compression ratio %.02f, "
+        "deflate %.01f ms/MB, inflate %.01f ms/MB, %" PRIuS
+        " bytes of idle memory per connection",
+        mode == WEBSOCKET_TAKE_OVER_CONTEXT ? "context takeover"
+                                            : "no context takeover",
+        window_bits, mem_level,
+        static_cast<double>(input_size) / output_size,
+        deflate_time.InMillisecondsF() / megabytes,
+        inflate_time.InMillisecondsF() / megabytes,
+        memory_per_connection);
+  }
+
+ private:
+  int iterations_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebSocketDeflaterBenchmark);
+};
+
+TEST_F(WebSocketDeflaterBenchmark, BenchmarkContextTakeOver) {
+  Benchmark(WEBSOCKET_TAKE_OVER_CONTEXT, 15, 8);
+  Benchmark(WEBSOCKET_TAKE_OVER_CONTEXT, 10, 4);
+}
+
+TEST_F(WebSocketDeflaterBenchmark, BenchmarkNoContextTakeOver) {
+  Benchmark(WEBSOCKET_DO_NOT_TAKE_OVER_CONTEXT, 15, 8);
+}
+
+}  // namespace
+
+}  // namespace net
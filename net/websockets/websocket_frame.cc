@@ -13,6 +13,10 @@
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif  // defined(__SSE2__)
+
 namespace {
 
 const uint8 kFinalBit = 0x80;
@@ -37,6 +41,22 @@ inline void MaskWebSocketFramePayloadByBytes(
   }
 }
 
+// The bulk of the payload is masked one PackedMaskType at a time. SSE2 is
+// available on every x86-64 CPU, and on x86 when the compiler targets it.
+#if defined(__SSE2__)
+typedef __m128i PackedMaskType;
+
+inline void XorPacked(PackedMaskType* masked, PackedMaskType packed_mask_key) {
+  *masked = _mm_xor_si128(*masked, packed_mask_key);
+}
+#else
+typedef size_t PackedMaskType;
+
+inline void XorPacked(PackedMaskType* masked, PackedMaskType packed_mask_key) {
+  *masked ^= packed_mask_key;
+}
+#endif  // defined(__SSE2__)
+
 }  // Unnamed namespace.
 
 namespace net {
@@ -162,12 +182,11 @@ void MaskWebSocketFramePayload(const WebSocketMaskingKey& masking_key,
 
   DCHECK_GE(data_size, 0);
 
-  // Most of the masking is done one word at a time, except for the beginning
-  // and the end of the buffer which may be unaligned. We use size_t to get the
-  // word size for this architecture. We require it be a multiple of
+  // Most of the masking is done one PackedMaskType (a 16-byte vector with
+  // SSE2, a word otherwise) at a time, except for the beginning and the end of
+  // the buffer which may be unaligned. We require it be a multiple of
   // kMaskingKeyLength in size.
-  typedef size_t PackedMaskType;
-  PackedMaskType packed_mask_key = 0;
+  PackedMaskType packed_mask_key;
   static const size_t kPackedMaskKeySize = sizeof(packed_mask_key);
   COMPILE_ASSERT((kPackedMaskKeySize >= kMaskingKeyLength &&
                   kPackedMaskKeySize % kMaskingKeyLength == 0),
@@ -217,7 +236,7 @@ void MaskWebSocketFramePayload(const WebSocketMaskingKey& masking_key,
     // practice, this will work for the compilers and architectures currently
     // supported by Chromium, and the tests are extremely unlikely to pass if a
     // future compiler/architecture breaks it.
-    *reinterpret_cast<PackedMaskType*>(merged) ^= packed_mask_key;
+    XorPacked(reinterpret_cast<PackedMaskType*>(merged), packed_mask_key);
   }
 
   MaskWebSocketFramePayloadByBytes(
@@ -29,13 +29,36 @@ const uint64 kMaxPayloadLengthWithoutExtendedLengthField = 125;
 const uint64 kPayloadLengthWithTwoByteExtendedLengthField = 126;
 const uint64 kPayloadLengthWithEightByteExtendedLengthField = 127;
 
+// The maximum size of a frame header, which is the most that may have to be
+// carried over between calls to Decode().
+const size_t kMaximumFrameHeaderSize =
+    net::WebSocketFrameHeader::kBaseHeaderSize +
+    net::WebSocketFrameHeader::kMaximumExtendedLengthSize +
+    net::WebSocketFrameHeader::kMaskingKeyLength;
+
+// An IOBufferWithSize referring to part of another IOBuffer, which it keeps
+// alive. This lets the payload of a frame be passed on without copying it.
+class DependentIOBufferWithSize : public net::IOBufferWithSize {
+ public:
+  DependentIOBufferWithSize(net::IOBuffer* buffer, size_t offset, int size)
+      : net::IOBufferWithSize(buffer->data() + offset, size),
+        buffer_(buffer) {}
+
+ private:
+  virtual ~DependentIOBufferWithSize() {
+    // |data_| belongs to |buffer_|.
+    data_ = NULL;
+  }
+
+  scoped_refptr<net::IOBuffer> buffer_;
+};
+
 }  // Unnamed namespace.
 
 namespace net {
 
 WebSocketFrameParser::WebSocketFrameParser()
-    : current_read_pos_(0),
-      frame_offset_(0),
+    : frame_offset_(0),
       websocket_error_(kWebSocketNormalClosure) {
   std::fill(masking_key_.key,
             masking_key_.key + WebSocketFrameHeader::kMaskingKeyLength,
@@ -53,61 +76,75 @@ bool WebSocketFrameParser::Decode(
   if (!length)
     return true;
 
-  // TODO(yutak): Remove copy.
-  buffer_.insert(buffer_.end(), data, data + length);
+  scoped_refptr<IOBuffer> buffer(new IOBuffer(length));
+  memcpy(buffer->data(), data, length);
+  return Decode(buffer.get(), length, frame_chunks);
+}
 
-  while (current_read_pos_ < buffer_.size()) {
+bool WebSocketFrameParser::Decode(
+    IOBuffer* data,
+    size_t length,
+    ScopedVector<WebSocketFrameChunk>* frame_chunks) {
+  if (websocket_error_ != kWebSocketNormalClosure)
+    return false;
+
+  size_t pos = 0;
+  while (pos < length) {
     bool first_chunk = false;
     if (!current_frame_header_.get()) {
-      DecodeFrameHeader();
+      pos += DecodeFrameHeader(data->data() + pos, length - pos);
       if (websocket_error_ != kWebSocketNormalClosure)
         return false;
-      // If frame header is incomplete, then carry over the remaining
-      // data to the next round of Decode().
+      // If frame header is incomplete, then it was carried over to the next
+      // round of Decode().
       if (!current_frame_header_.get())
         break;
       first_chunk = true;
     }
 
     scoped_ptr<WebSocketFrameChunk> frame_chunk =
-        DecodeFramePayload(first_chunk);
+        DecodeFramePayload(first_chunk, data, length, &pos);
     DCHECK(frame_chunk.get());
     frame_chunks->push_back(frame_chunk.release());
 
     if (current_frame_header_.get()) {
-      DCHECK(current_read_pos_ == buffer_.size());
+      DCHECK_EQ(length, pos);
       break;
     }
   }
 
-  // Drain unnecessary data. TODO(yutak): Remove copy. (but how?)
-  buffer_.erase(buffer_.begin(), buffer_.begin() + current_read_pos_);
-  current_read_pos_ = 0;
-
   // Sanity check: the size of carried-over data should not exceed
   // the maximum possible length of a frame header.
-  static const size_t kMaximumFrameHeaderSize =
-      WebSocketFrameHeader::kBaseHeaderSize +
-      WebSocketFrameHeader::kMaximumExtendedLengthSize +
-      WebSocketFrameHeader::kMaskingKeyLength;
-  DCHECK_LT(buffer_.size(), kMaximumFrameHeaderSize);
+  DCHECK_LT(header_buffer_.size(), kMaximumFrameHeaderSize);
 
   return true;
 }
 
-void WebSocketFrameParser::DecodeFrameHeader() {
+size_t WebSocketFrameParser::DecodeFrameHeader(const char* data,
+                                               size_t length) {
   typedef WebSocketFrameHeader::OpCode OpCode;
   static const int kMaskingKeyLength = WebSocketFrameHeader::kMaskingKeyLength;
 
   DCHECK(!current_frame_header_.get());
 
-  const char* start = &buffer_.front() + current_read_pos_;
+  // A header split across reads is completed in |header_buffer_|. No more
+  // than the largest possible header is copied into it.
+  const size_t carried_over = header_buffer_.size();
+  if (carried_over) {
+    size_t to_copy =
+        std::min(length, kMaximumFrameHeaderSize - carried_over);
+    header_buffer_.insert(header_buffer_.end(), data, data + to_copy);
+    data = &header_buffer_.front();
+    length = header_buffer_.size();
+  }
+
+  const char* start = data;
   const char* current = start;
-  const char* end = &buffer_.front() + buffer_.size();
+  const char* end = data + length;
 
   // Header needs 2 bytes at minimum.
   if (end - current < 2)
-    return;
+    return CarryOverFrameHeader(start, end, carried_over);
 
   uint8 first_byte = *current++;
   uint8 second_byte = *current++;
@@ -122,7 +159,7 @@ void WebSocketFrameParser::DecodeFrameHeader() {
   uint64 payload_length = second_byte & kPayloadLengthMask;
   if (payload_length == kPayloadLengthWithTwoByteExtendedLengthField) {
     if (end - current < 2)
-      return;
+      return CarryOverFrameHeader(start, end, carried_over);
     uint16 payload_length_16;
     ReadBigEndian(current, &payload_length_16);
     current += 2;
@@ -131,7 +168,7 @@ void WebSocketFrameParser::DecodeFrameHeader() {
       websocket_error_ = kWebSocketErrorProtocolError;
   } else if (payload_length == kPayloadLengthWithEightByteExtendedLengthField) {
     if (end - current < 8)
-      return;
+      return CarryOverFrameHeader(start, end, carried_over);
     ReadBigEndian(current, &payload_length);
     current += 8;
     if (payload_length <= kuint16max ||
@@ -142,16 +179,15 @@ void WebSocketFrameParser::DecodeFrameHeader() {
     }
   }
   if (websocket_error_ != kWebSocketNormalClosure) {
-    buffer_.clear();
-    current_read_pos_ = 0;
+    header_buffer_.clear();
     current_frame_header_.reset();
     frame_offset_ = 0;
-    return;
+    return 0;
   }
 
   if (masked) {
     if (end - current < kMaskingKeyLength)
-      return;
+      return CarryOverFrameHeader(start, end, carried_over);
     std::copy(current, current + kMaskingKeyLength, masking_key_.key);
     current += kMaskingKeyLength;
   } else {
@@ -165,16 +201,32 @@ void WebSocketFrameParser::DecodeFrameHeader() {
   current_frame_header_->reserved3 = reserved3;
   current_frame_header_->masked = masked;
   current_frame_header_->payload_length = payload_length;
-  current_read_pos_ += current - start;
   DCHECK_EQ(0u, frame_offset_);
+
+  // Only the bytes of the header that were not carried over came from the
+  // caller's data.
+  size_t used = (current - start) - carried_over;
+  header_buffer_.clear();
+  return used;
+}
+
+size_t WebSocketFrameParser::CarryOverFrameHeader(const char* start,
+                                                  const char* end,
+                                                  size_t carried_over) {
+  // All of the data is part of the incomplete header. If some was carried
+  // over already, the rest has been appended to |header_buffer_|.
+  if (!carried_over)
+    header_buffer_.assign(start, end);
+  return (end - start) - carried_over;
 }
 
 scoped_ptr<WebSocketFrameChunk> WebSocketFrameParser::DecodeFramePayload(
-    bool first_chunk) {
-  const char* current = &buffer_.front() + current_read_pos_;
-  const char* end = &buffer_.front() + buffer_.size();
+    bool first_chunk,
+    IOBuffer* data,
+    size_t length,
+    size_t* pos) {
   uint64 next_size = std::min<uint64>(
-      end - current, current_frame_header_->payload_length - frame_offset_);
+      length - *pos, current_frame_header_->payload_length - frame_offset_);
   // This check must pass because |payload_length| is already checked to be
   // less than std::numeric_limits<int>::max() when the header is parsed.
   DCHECK_LE(next_size, static_cast<uint64>(kint32max));
@@ -185,17 +237,16 @@ scoped_ptr<WebSocketFrameChunk> WebSocketFrameParser::DecodeFramePayload(
   }
   frame_chunk->final_chunk = false;
   if (next_size) {
-    frame_chunk->data = new IOBufferWithSize(static_cast<int>(next_size));
-    char* io_data = frame_chunk->data->data();
-    memcpy(io_data, current, next_size);
     if (current_frame_header_->masked) {
       // The masking function is its own inverse, so we use the same function to
       // unmask as to mask.
       MaskWebSocketFramePayload(
-          masking_key_, frame_offset_, io_data, next_size);
+          masking_key_, frame_offset_, data->data() + *pos, next_size);
     }
+    frame_chunk->data =
+        new DependentIOBufferWithSize(data, *pos, static_cast<int>(next_size));
 
-    current_read_pos_ += next_size;
+    *pos += next_size;
     frame_offset_ += next_size;
   }
 
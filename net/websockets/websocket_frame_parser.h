@@ -17,6 +17,8 @@
 
 namespace net {
 
+class IOBuffer;
+
 // Parses WebSocket frames from byte stream.
 //
 // Specification of WebSocket frame format is available at
@@ -40,6 +42,13 @@ class NET_EXPORT WebSocketFrameParser {
               size_t length,
               ScopedVector<WebSocketFrameChunk>* frame_chunks);
 
+  // Same as above, but the payload data of the parsed chunks refers to the
+  // first |length| bytes of |data| instead of being copied out of it. Masked
+  // payload is unmasked in place, so the caller must not use |data| again.
+  bool Decode(IOBuffer* data,
+              size_t length,
+              ScopedVector<WebSocketFrameChunk>* frame_chunks);
+
   // Returns kWebSocketNormalClosure if the parser has not failed to decode
   // WebSocket frames. Otherwise returns WebSocketError which is defined in
   // websocket_errors.h. We can convert net::WebSocketError to net::Error by
@@ -47,27 +56,38 @@ class NET_EXPORT WebSocketFrameParser {
   WebSocketError websocket_error() const { return websocket_error_; }
 
  private:
-  // Tries to decode a frame header from |current_read_pos_|.
-  // If successful, this function updates |current_read_pos_|,
-  // |current_frame_header_|, and |masking_key_| (if available).
-  // This function may set |failed_| to true if it observes a corrupt frame.
-  // If there is not enough data in the remaining buffer to parse a frame
-  // header, this function returns without doing anything.
-  void DecodeFrameHeader();
-
-  // Decodes frame payload and creates a WebSocketFrameChunk object.
-  // This function updates |current_read_pos_| and |frame_offset_| after
-  // parsing. This function returns a frame object even if no payload data is
-  // available at this moment, so the receiver could make use of frame header
-  // information. If the end of frame is reached, this function clears
-  // |current_frame_header_|, |frame_offset_| and |masking_key_|.
-  scoped_ptr<WebSocketFrameChunk> DecodeFramePayload(bool first_chunk);
-
-  // Internal buffer to store the data to parse.
-  std::vector<char> buffer_;
-
-  // Position in |buffer_| where the next round of parsing starts.
-  size_t current_read_pos_;
+  // Tries to decode a frame header from the |length| bytes at |data|,
+  // preceded by any bytes carried over in |header_buffer_|, and returns the
+  // number of bytes of |data| used. If successful, this function updates
+  // |current_frame_header_| and |masking_key_| (if available). This function
+  // may set |websocket_error_| if it observes a corrupt frame. If there is not
+  // enough data to parse a frame header, the data is carried over in
+  // |header_buffer_| to the next call.
+  size_t DecodeFrameHeader(const char* data, size_t length);
+
+  // Called by DecodeFrameHeader() when the header from |start| to |end| is
+  // incomplete. Saves it in |header_buffer_| and returns the number of bytes
+  // of the caller's data it used, given that |carried_over| bytes came from
+  // |header_buffer_|.
+  size_t CarryOverFrameHeader(const char* start,
+                              const char* end,
+                              size_t carried_over);
+
+  // Decodes frame payload starting at offset |*pos| in |data| and creates a
+  // WebSocketFrameChunk object referring to it. This function updates |*pos|
+  // and |frame_offset_| after parsing. This function returns a frame object
+  // even if no payload data is available at this moment, so the receiver could
+  // make use of frame header information. If the end of frame is reached, this
+  // function clears |current_frame_header_|, |frame_offset_| and
+  // |masking_key_|.
+  scoped_ptr<WebSocketFrameChunk> DecodeFramePayload(bool first_chunk,
+                                                     IOBuffer* data,
+                                                     size_t length,
+                                                     size_t* pos);
+
+  // A frame header split across calls to Decode(). Payload data is never
+  // buffered, so this holds at most one incomplete header.
+  std::vector<char> header_buffer_;
 
   // Frame header and masking key of the current frame.
   // |masking_key_| is filled with zeros if the current frame is not masked.
@@ -8,12 +8,25 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/logging.h"
 #include "base/memory/scoped_vector.h"
 #include "base/port.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
 #include "net/base/io_buffer.h"
 #include "net/websockets/websocket_frame.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
+// Run
+//   out/Release/net_unittests --websocket-parser-iterations=1000
+//      --gtest_filter='WebSocketFrameParserBenchmark.*'
+// to benchmark the WebSocketFrameParser::Decode() function.
+static const char kBenchmarkIterations[] = "websocket-parser-iterations";
+static const int kDefaultIterations = 10;
+static const int kBenchmarkDataSize = 1 << 20;
+
 namespace net {
 
 namespace {
@@ -103,6 +116,28 @@ TEST(WebSocketFrameParserTest, DecodeMaskedFrame) {
   EXPECT_TRUE(std::equal(kHello, kHello + kHelloLength, frame->data->data()));
 }
 
+TEST(WebSocketFrameParserTest, DecodeIOBufferWithoutCopy) {
+  WebSocketFrameParser parser;
+
+  scoped_refptr<IOBuffer> buffer(new IOBuffer(kMaskedHelloFrameLength));
+  memcpy(buffer->data(), kMaskedHelloFrame, kMaskedHelloFrameLength);
+  ScopedVector<WebSocketFrameChunk> frames;
+  EXPECT_TRUE(parser.Decode(buffer.get(), kMaskedHelloFrameLength, &frames));
+  ASSERT_EQ(1u, frames.size());
+  WebSocketFrameChunk* frame = frames[0];
+  EXPECT_TRUE(frame->final_chunk);
+
+  // The payload is unmasked in place, and the chunk refers to it.
+  const size_t kHeaderLength = kMaskedHelloFrameLength - kHelloLength;
+  ASSERT_EQ(static_cast<int>(kHelloLength), frame->data->size());
+  EXPECT_EQ(buffer->data() + kHeaderLength, frame->data->data());
+  EXPECT_TRUE(std::equal(kHello, kHello + kHelloLength, frame->data->data()));
+
+  // The chunk keeps the buffer alive.
+  buffer = NULL;
+  EXPECT_TRUE(std::equal(kHello, kHello + kHelloLength, frame->data->data()));
+}
+
 TEST(WebSocketFrameParserTest, DecodeManyFrames) {
   struct Input {
     const char* frame;
@@ -571,6 +606,75 @@ TEST(WebSocketFrameParserTest, FinalBitAndReservedBits) {
   }
 }
 
+class WebSocketFrameParserBenchmark : public testing::Test {
+ public:
+  WebSocketFrameParserBenchmark() : iterations_(kDefaultIterations) {}
+
+  virtual void SetUp() {
+    std::string iterations(
+        CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+            kBenchmarkIterations));
+    int benchmark_iterations = 0;
+    if (!iterations.empty() &&
+        base::StringToInt(iterations, &benchmark_iterations)) {
+      iterations_ = benchmark_iterations;
+    }
+  }
+
+  // Decodes |kBenchmarkDataSize| bytes of masked binary frames, each with
+  // |payload_size| bytes of payload, as they would arrive from the network
+  // in 64KB reads.
+  void Benchmark(size_t payload_size) {
+    WebSocketFrameHeader header(WebSocketFrameHeader::kOpCodeBinary);
+    header.final = true;
+    header.masked = true;
+    header.payload_length = payload_size;
+    WebSocketMaskingKey masking_key = GenerateWebSocketMaskingKey();
+    std::vector<char> frame(GetWebSocketFrameHeaderSize(header) +
+                            payload_size, 'a');
+    WriteWebSocketFrameHeader(header, &masking_key, &frame.front(),
+                              frame.size());
+    std::vector<char> stream;
+    while (stream.size() + frame.size() <= kBenchmarkDataSize)
+      stream.insert(stream.end(), frame.begin(), frame.end());
+
+    LOG(INFO) << "Benchmarking WebSocketFrameParser::Decode() for "
+              << iterations_ << " iterations";
+    static const size_t kReadSize = 1 << 16;
+    base::TimeDelta elapsed;
+    for (int x = 0; x < iterations_; ++x) {
+      WebSocketFrameParser parser;
+      for (size_t pos = 0; pos < stream.size(); pos += kReadSize) {
+        size_t length = std::min(kReadSize, stream.size() - pos);
+        scoped_refptr<IOBuffer> buffer(new IOBuffer(length));
+        memcpy(buffer->data(), &stream[pos], length);
+        ScopedVector<WebSocketFrameChunk> frames;
+        base::TimeTicks start = base::TimeTicks::HighResNow();
+        ASSERT_TRUE(parser.Decode(buffer.get(), length, &frames));
+        elapsed += base::TimeTicks::HighResNow() - start;
+      }
+    }
+    double megabytes = static_cast<double>(stream.size()) * iterations_ /
+                       (1024 * 1024);
+    LOG(INFO) << "Payload size " << payload_size
+              << base::StringPrintf(" decoded at %.01f MB/s",
+                                    megabytes / elapsed.InSecondsF());
+  }
+
+ private:
+  int iterations_;
+
+  DISALLOW_COPY_AND_ASSIGN(WebSocketFrameParserBenchmark);
+};
+
+TEST_F(WebSocketFrameParserBenchmark, BenchmarkSmallFrames) {
+  Benchmark(16);
+}
+
+TEST_F(WebSocketFrameParserBenchmark, BenchmarkLargeFrames) {
+  Benchmark(1 << 16);
+}
+
 }  // Unnamed namespace
 
 }  // namespace net
@@ -112,6 +112,26 @@ TEST_F(ApplyUpdatesAndResolveConflictsCommandTest,
       << "All updates should have been successfully applied";
 }
 
+TEST_F(ApplyUpdatesAndResolveConflictsCommandTest,
+       UpdateWithDeepHierarchyBeforeParents) {
+  // Each folder is received before its parent, deepest first.
+  string root_server_id = syncable::GetNullId().GetServerId();
+  const int kDepth = 10;
+  for (int i = kDepth - 1; i >= 0; --i) {
+    entry_factory_->CreateUnappliedNewBookmarkItemWithParent(
+        base::StringPrintf("folder%d", i), DefaultBookmarkSpecifics(),
+        i == 0 ? root_server_id : base::StringPrintf("folder%d", i - 1));
+  }
+
+  ExpectGroupToChange(apply_updates_command_, GROUP_UI);
+  apply_updates_command_.ExecuteImpl(session());
+
+  const sessions::StatusController& status = session()->status_controller();
+  EXPECT_EQ(0, status.num_hierarchy_conflicts());
+  EXPECT_EQ(kDepth, status.num_updates_applied())
+      << "All updates should have been successfully applied";
+}
+
 // Runs the ApplyUpdatesAndResolveConflictsCommand on an item that has both
 // local and remote modifications (IS_UNSYNCED and IS_UNAPPLIED_UPDATE).  We
 // expect the command to detect that this update can't be applied because it is
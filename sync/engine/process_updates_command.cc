@@ -102,38 +102,59 @@ bool UpdateContainsNewVersion(syncable::BaseTransaction *trans,
 
 }  // namespace
 
+SyncerError ProcessUpdatesCommand::ExecuteImpl(SyncSession* session) {
+  const sync_pb::GetUpdatesResponse& updates =
+      session->status_controller().updates_response().get_updates();
+  const ModelSafeRoutingInfo& routes = session->context()->routing_info();
+
+  // Work out the type and group of every update once, here on the syncer
+  // thread, rather than once per group under the write transaction.
+  DCHECK(updates_by_group_.empty());
+  for (int i = 0; i < updates.entries().size(); i++) {
+    const sync_pb::SyncEntity& update = updates.entries(i);
+    ModelType type = GetModelType(update);
+    updates_by_group_[GetGroupForModelType(type, routes)].push_back(
+        PendingUpdate(i, type, IsWellFormedUpdate(update)));
+  }
+
+  SyncerError result = ModelChangingSyncerCommand::ExecuteImpl(session);
+  updates_by_group_.clear();
+  return result;
+}
+
 SyncerError ProcessUpdatesCommand::ModelChangingExecuteImpl(
     SyncSession* session) {
+  sessions::StatusController* status = session->mutable_status_controller();
+
+  // Each group only sees the updates that live on its thread.
+  // TODO(tim): Don't allow access to objects in other ModelSafeGroups.
+  // See crbug.com/121521 .
+  UpdatesByGroup::const_iterator group_updates =
+      updates_by_group_.find(status->group_restriction());
+  if (group_updates == updates_by_group_.end())
+    return SYNCER_OK;
+  const std::vector<PendingUpdate>& pending = group_updates->second;
+
   syncable::Directory* dir = session->context()->directory();
 
   syncable::WriteTransaction trans(FROM_HERE, syncable::SYNCER, dir);
 
-  sessions::StatusController* status = session->mutable_status_controller();
   const sync_pb::GetUpdatesResponse& updates =
       status->updates_response().get_updates();
-  int update_count = updates.entries().size();
 
   ModelTypeSet requested_types = GetRoutingInfoTypes(
       session->context()->routing_info());
 
-  DVLOG(1) << update_count << " entries to verify";
-  for (int i = 0; i < update_count; i++) {
-    const sync_pb::SyncEntity& update = updates.entries(i);
-
-    // The current function gets executed on several different threads, but
-    // every call iterates over the same list of items that the server returned
-    // to us.  We're not allowed to process items unless we're on the right
-    // thread for that type.  This check will ensure we only touch the items
-    // that live on our current thread.
-    // TODO(tim): Don't allow access to objects in other ModelSafeGroups.
-    // See crbug.com/121521 .
-    ModelSafeGroup g = GetGroupForModelType(GetModelType(update),
-                                            session->context()->routing_info());
-    if (g != status->group_restriction())
-      continue;
+  DVLOG(1) << pending.size() << " entries to verify";
+  for (size_t i = 0; i < pending.size(); i++) {
+    const sync_pb::SyncEntity& update = updates.entries(pending[i].index);
 
-    VerifyResult verify_result = VerifyUpdate(
-        &trans, update, requested_types, session->context()->routing_info());
+    VerifyResult verify_result = VERIFY_FAIL;
+    if (pending[i].well_formed) {
+      verify_result = VerifyUpdate(&trans, update, pending[i].type,
+                                   requested_types,
+                                   session->context()->routing_info());
+    }
     status->increment_num_updates_downloaded_by(1);
     if (!UpdateContainsNewVersion(&trans, update))
       status->increment_num_reflected_updates_downloaded_by(1);
@@ -153,6 +174,22 @@ SyncerError ProcessUpdatesCommand::ModelChangingExecuteImpl(
   return SYNCER_OK;
 }
 
+// static
+bool ProcessUpdatesCommand::IsWellFormedUpdate(
+    const sync_pb::SyncEntity& entry) {
+  const bool deleted = entry.has_deleted() && entry.deleted();
+
+  if (!SyncableIdFromProto(entry.id_string()).ServerKnows()) {
+    LOG(ERROR) << "Illegal negative id in received updates";
+    return false;
+  }
+  if (!deleted && SyncerProtoUtil::NameFromSyncEntity(entry).empty()) {
+    LOG(ERROR) << "Zero length name in non-deleted update";
+    return false;
+  }
+  return true;
+}
+
 namespace {
 
 // In the event that IDs match, but tags differ AttemptReuniteClient tag
@@ -171,33 +208,21 @@ VerifyResult VerifyTagConsistency(const sync_pb::SyncEntity& entry,
 
 }  // namespace
 
+// |entry| must have passed IsWellFormedUpdate().
 VerifyResult ProcessUpdatesCommand::VerifyUpdate(
     syncable::WriteTransaction* trans, const sync_pb::SyncEntity& entry,
+    ModelType model_type,
     ModelTypeSet requested_types,
     const ModelSafeRoutingInfo& routes) {
   syncable::Id id = SyncableIdFromProto(entry.id_string());
-  VerifyResult result = VERIFY_FAIL;
 
   const bool deleted = entry.has_deleted() && entry.deleted();
   const bool is_directory = IsFolder(entry);
-  const ModelType model_type = GetModelType(entry);
-
-  if (!id.ServerKnows()) {
-    LOG(ERROR) << "Illegal negative id in received updates";
-    return result;
-  }
-  {
-    const std::string name = SyncerProtoUtil::NameFromSyncEntity(entry);
-    if (name.empty() && !deleted) {
-      LOG(ERROR) << "Zero length name in non-deleted update";
-      return result;
-    }
-  }
 
   syncable::MutableEntry same_id(trans, GET_BY_ID, id);
-  result = VerifyNewEntry(entry, &same_id, deleted);
+  VerifyResult result = VerifyNewEntry(entry, &same_id, deleted);
 
-  ModelType placement_type = !deleted ? GetModelType(entry)
+  ModelType placement_type = !deleted ? model_type
       : same_id.good() ? same_id.GetModelType() : UNSPECIFIED;
 
   if (VERIFY_UNDECIDED == result) {
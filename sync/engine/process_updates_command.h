@@ -5,6 +5,9 @@
 #ifndef SYNC_ENGINE_PROCESS_UPDATES_COMMAND_H_
 #define SYNC_ENGINE_PROCESS_UPDATES_COMMAND_H_
 
+#include <map>
+#include <vector>
+
 #include "base/compiler_specific.h"
 #include "sync/base/sync_export.h"
 #include "sync/engine/model_changing_syncer_command.h"
@@ -34,6 +37,11 @@ class SYNC_EXPORT_PRIVATE ProcessUpdatesCommand
   ProcessUpdatesCommand();
   virtual ~ProcessUpdatesCommand();
 
+  // SyncerCommand implementation.  Sorts the downloaded updates by group and
+  // runs the checks that don't need the directory before any worker takes
+  // the write transaction.
+  virtual SyncerError ExecuteImpl(sessions::SyncSession* session) OVERRIDE;
+
  protected:
   // ModelChangingSyncerCommand implementation.
   virtual std::set<ModelSafeGroup> GetGroupsToChange(
@@ -42,15 +50,38 @@ class SYNC_EXPORT_PRIVATE ProcessUpdatesCommand
       sessions::SyncSession* session) OVERRIDE;
 
  private:
+  // An update from the GetUpdates response, identified by its index there.
+  struct PendingUpdate {
+    PendingUpdate(int index, ModelType type, bool well_formed)
+        : index(index), type(type), well_formed(well_formed) {}
+
+    int index;
+    ModelType type;
+    // False if the update failed the checks in IsWellFormedUpdate().
+    bool well_formed;
+  };
+  typedef std::map<ModelSafeGroup, std::vector<PendingUpdate> >
+      UpdatesByGroup;
+
+  // Returns false if |entry| can never be applied, whatever the state of the
+  // directory.
+  static bool IsWellFormedUpdate(const sync_pb::SyncEntity& entry);
+
   VerifyResult VerifyUpdate(
       syncable::WriteTransaction* trans,
       const sync_pb::SyncEntity& entry,
+      ModelType model_type,
       ModelTypeSet requested_types,
       const ModelSafeRoutingInfo& routes);
   ServerUpdateProcessingResult ProcessUpdate(
       const sync_pb::SyncEntity& proto_update,
       const Cryptographer* cryptographer,
       syncable::WriteTransaction* const trans);
+
+  // The updates of the current session, sorted by the group that owns them.
+  // Only valid during ExecuteImpl().
+  UpdatesByGroup updates_by_group_;
+
   DISALLOW_COPY_AND_ASSIGN(ProcessUpdatesCommand);
 };
 
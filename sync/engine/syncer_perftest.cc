@@ -0,0 +1,109 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "sync/engine/apply_updates_and_resolve_conflicts_command.h"
+#include "sync/engine/download.h"
+#include "sync/internal_api/public/engine/model_safe_worker.h"
+#include "sync/sessions/status_controller.h"
+#include "sync/sessions/sync_session.h"
+#include "sync/syncable/directory.h"
+#include "sync/test/engine/fake_model_worker.h"
+#include "sync/test/engine/mock_connection_manager.h"
+#include "sync/test/engine/syncer_command_test.h"
+#include "sync/test/engine/test_id_factory.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace syncer {
+
+namespace {
+
+const char kForeignCacheGuid[] = "kqyg7097kro6GSUod+GSg==";
+
+}  // namespace
+
+// Measures an initial sync against the mock server: one GetUpdates
+// response is downloaded and processed, then applied to the directory.
+class SyncerPerfTest : public SyncerCommandTest {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    workers()->push_back(
+        make_scoped_refptr(new FakeModelWorker(GROUP_UI)));
+    workers()->push_back(
+        make_scoped_refptr(new FakeModelWorker(GROUP_PASSIVE)));
+    (*mutable_routing_info())[BOOKMARKS] = GROUP_UI;
+    (*mutable_routing_info())[PREFERENCES] = GROUP_PASSIVE;
+    SyncerCommandTest::SetUp();
+    ConfigureMockServerConnection();
+    directory()->set_store_birthday(mock_server()->store_birthday());
+  }
+
+  // Serves |num_folders| bookmark folders of |bookmarks_per_folder|
+  // bookmarks each, sent before the folders that contain them, plus
+  // |num_prefs| preferences.  Logs the time taken to download and process
+  // the updates and the time taken to apply them.
+  void RunInitialSync(const char* name,
+                      int num_folders,
+                      int bookmarks_per_folder,
+                      int num_prefs) {
+    int next_id = num_folders + 1;
+    for (int folder = 1; folder <= num_folders; ++folder) {
+      for (int i = 0; i < bookmarks_per_folder; ++i, ++next_id) {
+        mock_server()->AddUpdateBookmark(
+            next_id, folder, base::StringPrintf("Bookmark %d", next_id),
+            10, 10, kForeignCacheGuid, base::StringPrintf("-%d", next_id));
+      }
+    }
+    for (int folder = num_folders; folder >= 1; --folder) {
+      mock_server()->AddUpdateDirectory(
+          folder, 0, base::StringPrintf("Folder %d", folder), 10, 10,
+          kForeignCacheGuid, base::StringPrintf("-%d", folder));
+    }
+    for (int i = 0; i < num_prefs; ++i, ++next_id) {
+      mock_server()->AddUpdatePref(
+          TestIdFactory::FromNumber(next_id).GetServerId(),
+          TestIdFactory::root().GetServerId(),
+          base::StringPrintf("pref%d", i), 10, 10);
+    }
+    const int total_updates =
+        num_folders * (bookmarks_per_folder + 1) + num_prefs;
+
+    PerfTimer download_timer;
+    EXPECT_EQ(SYNCER_OK,
+              DownloadUpdatesForConfigure(
+                  session(), false,
+                  sync_pb::GetUpdatesCallerInfo::NEWLY_SUPPORTED_DATATYPE,
+                  GetRoutingInfoTypes(routing_info())));
+    base::TimeDelta download_elapsed = download_timer.Elapsed();
+
+    ApplyUpdatesAndResolveConflictsCommand apply_updates;
+    PerfTimer apply_timer;
+    apply_updates.ExecuteImpl(session());
+    base::TimeDelta apply_elapsed = apply_timer.Elapsed();
+
+    const sessions::StatusController& status = session()->status_controller();
+    EXPECT_EQ(total_updates,
+              status.model_neutral_state().num_updates_downloaded_total);
+    EXPECT_EQ(total_updates, status.num_updates_applied());
+    EXPECT_EQ(0, status.num_hierarchy_conflicts());
+
+    LogPerfResult(base::StringPrintf("%s_download_and_process", name).c_str(),
+                  download_elapsed.InMillisecondsF(), "ms");
+    LogPerfResult(base::StringPrintf("%s_apply", name).c_str(),
+                  apply_elapsed.InMillisecondsF(), "ms");
+  }
+};
+
+TEST_F(SyncerPerfTest, InitialSyncFlat) {
+  RunInitialSync("Syncer_initial_sync_10k_flat", 1, 10000, 1000);
+}
+
+TEST_F(SyncerPerfTest, InitialSyncManyFolders) {
+  RunInitialSync("Syncer_initial_sync_500x20", 500, 20, 1000);
+}
+
+}  // namespace syncer
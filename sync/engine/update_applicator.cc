@@ -4,6 +4,7 @@
 
 #include "sync/engine/update_applicator.h"
 
+#include <map>
 #include <vector>
 
 #include "base/logging.h"
@@ -18,6 +19,7 @@ using std::vector;
 namespace syncer {
 
 using syncable::ID;
+using syncable::SERVER_PARENT_ID;
 
 UpdateApplicator::UpdateApplicator(Cryptographer* cryptographer,
                                    const ModelSafeRoutingInfo& routes,
@@ -38,7 +40,10 @@ UpdateApplicator::~UpdateApplicator() {
 // Some updates must be applied in order.  For example, children must be created
 // after their parent folder is created.  This function runs an O(n^2) algorithm
 // that will keep trying until there is nothing left to apply, or it stops
-// making progress, which would indicate that the hierarchy is invalid.
+// making progress, which would indicate that the hierarchy is invalid.  Within
+// a pass, an update that conflicts because its parent is missing is retried as
+// soon as that parent is applied, so a hierarchy received children-first
+// still applies in a single pass.
 //
 // The update applicator also has to deal with simple conflicts, which occur
 // when an item is modified on both the server and the local model.  We remember
@@ -55,22 +60,34 @@ void UpdateApplicator::AttemptApplications(
   DVLOG(1) << "UpdateApplicator running over " << to_apply.size() << " items.";
   while (!to_apply.empty()) {
     std::vector<int64> to_reapply;
-
-    for (std::vector<int64>::iterator i = to_apply.begin();
-         i != to_apply.end(); ++i) {
-      syncable::Entry read_entry(trans, syncable::GET_BY_HANDLE, *i);
+    // Hierarchy conflicts from this pass, keyed by the parent they wait for.
+    std::multimap<syncable::Id, int64> waiting_for_parent;
+
+    // Updates woken by their parent are appended to |attempts|, past the end
+    // of |to_apply|; those only get one retry per pass.
+    std::vector<int64> attempts = to_apply;
+    for (size_t i = 0; i < attempts.size(); ++i) {
+      const int64 handle = attempts[i];
+      syncable::Entry read_entry(trans, syncable::GET_BY_HANDLE, handle);
       if (SkipUpdate(read_entry)) {
         continue;
       }
 
-      syncable::MutableEntry entry(trans, syncable::GET_BY_HANDLE, *i);
+      syncable::MutableEntry entry(trans, syncable::GET_BY_HANDLE, handle);
       UpdateAttemptResponse result = AttemptToUpdateEntry(
           trans, &entry, cryptographer_);
 
       switch (result) {
-        case SUCCESS:
+        case SUCCESS: {
           updates_applied_++;
+          typedef std::multimap<syncable::Id, int64>::iterator Iter;
+          std::pair<Iter, Iter> children =
+              waiting_for_parent.equal_range(entry.Get(ID));
+          for (Iter it = children.first; it != children.second; ++it)
+            attempts.push_back(it->second);
+          waiting_for_parent.erase(children.first, children.second);
           break;
+        }
         case CONFLICT_SIMPLE:
           simple_conflict_ids_.insert(entry.Get(ID));
           break;
@@ -81,7 +98,12 @@ void UpdateApplicator::AttemptApplications(
           // The decision to classify these as hierarchy conflcits is tentative.
           // If we make any progress this round, we'll clear the hierarchy
           // conflict count and attempt to reapply these updates.
-          to_reapply.push_back(*i);
+          if (i < to_apply.size()) {
+            waiting_for_parent.insert(
+                std::make_pair(entry.Get(SERVER_PARENT_ID), handle));
+          } else {
+            to_reapply.push_back(handle);
+          }
           break;
         default:
           NOTREACHED();
@@ -89,6 +111,12 @@ void UpdateApplicator::AttemptApplications(
       }
     }
 
+    for (std::multimap<syncable::Id, int64>::const_iterator it =
+             waiting_for_parent.begin();
+         it != waiting_for_parent.end(); ++it) {
+      to_reapply.push_back(it->second);
+    }
+
     if (to_reapply.size() == to_apply.size()) {
       // We made no progress.  Must be stubborn hierarchy conflicts.
       hierarchy_conflicts_ = to_apply.size();
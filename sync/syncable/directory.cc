@@ -490,6 +490,7 @@ void Directory::TakeSnapshotForSaveChanges(SaveChangesSnapshot* snapshot) {
     // We don't bother removing from the index here as we blow the entire thing
     // in a moment, and it unnecessarily complicates iteration.
     entry->clear_dirty(NULL);
+    entry->clear_dirty_fields();
   }
   ClearDirtyMetahandles();
 
@@ -759,6 +760,7 @@ void Directory::HandleSaveChangesFailure(const SaveChangesSnapshot& snapshot) {
         kernel_->metahandles_map.find((*i)->ref(META_HANDLE));
     if (found != kernel_->metahandles_map.end()) {
       found->second->mark_dirty(&kernel_->dirty_metahandles);
+      found->second->add_dirty_fields((*i)->dirty_fields());
     }
   }
 
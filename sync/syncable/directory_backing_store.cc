@@ -11,6 +11,7 @@
 #include "base/base64.h"
 #include "base/debug/trace_event.h"
 #include "base/logging.h"
+#include "base/metrics/histogram.h"
 #include "base/rand_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/time/time.h"
@@ -37,39 +38,60 @@ static const string::size_type kUpdateStatementBufferSize = 2048;
 // Increment this version whenever updating DB tables.
 const int32 kCurrentDBVersion = 86;
 
-// Iterate over the fields of |entry| and bind each to |statement| for
-// updating.  Returns the number of args bound.
-void BindFields(const EntryKernel& entry,
-                sql::Statement* statement) {
-  int index = 0;
-  int i = 0;
-  for (i = BEGIN_FIELDS; i < INT64_FIELDS_END; ++i) {
-    statement->BindInt64(index++, entry.ref(static_cast<Int64Field>(i)));
-  }
-  for ( ; i < TIME_FIELDS_END; ++i) {
-    statement->BindInt64(index++,
+// The number of partial UPDATE statements, one per combination of changed
+// columns, kept prepared.
+static const size_t kMaxCachedUpdateStatements = 32;
+
+// Binds |field| of |entry| to parameter |index| of |statement|.  Returns
+// the number of bytes bound.
+size_t BindField(const EntryKernel& entry,
+                 int field,
+                 int index,
+                 sql::Statement* statement) {
+  if (field < INT64_FIELDS_END) {
+    statement->BindInt64(index, entry.ref(static_cast<Int64Field>(field)));
+    return sizeof(int64);
+  }
+  if (field < TIME_FIELDS_END) {
+    statement->BindInt64(index,
                          TimeToProtoTime(
-                             entry.ref(static_cast<TimeField>(i))));
-  }
-  for ( ; i < ID_FIELDS_END; ++i) {
-    statement->BindString(index++, entry.ref(static_cast<IdField>(i)).s_);
-  }
-  for ( ; i < BIT_FIELDS_END; ++i) {
-    statement->BindInt(index++, entry.ref(static_cast<BitField>(i)));
-  }
-  for ( ; i < STRING_FIELDS_END; ++i) {
-    statement->BindString(index++, entry.ref(static_cast<StringField>(i)));
-  }
-  for ( ; i < PROTO_FIELDS_END; ++i) {
-    std::string temp;
-    entry.ref(static_cast<ProtoField>(i)).SerializeToString(&temp);
-    statement->BindBlob(index++, temp.data(), temp.length());
-  }
-  for ( ; i < UNIQUE_POSITION_FIELDS_END; ++i) {
-    std::string temp;
-    entry.ref(static_cast<UniquePositionField>(i)).SerializeToString(&temp);
-    statement->BindBlob(index++, temp.data(), temp.length());
+                             entry.ref(static_cast<TimeField>(field))));
+    return sizeof(int64);
+  }
+  if (field < ID_FIELDS_END) {
+    const string& id = entry.ref(static_cast<IdField>(field)).value();
+    statement->BindString(index, id);
+    return id.length();
+  }
+  if (field < BIT_FIELDS_END) {
+    statement->BindInt(index, entry.ref(static_cast<BitField>(field)));
+    return sizeof(int);
+  }
+  if (field < STRING_FIELDS_END) {
+    const string& value = entry.ref(static_cast<StringField>(field));
+    statement->BindString(index, value);
+    return value.length();
+  }
+  string temp;
+  if (field < PROTO_FIELDS_END) {
+    entry.ref(static_cast<ProtoField>(field)).SerializeToString(&temp);
+  } else {
+    DCHECK_LT(field, UNIQUE_POSITION_FIELDS_END);
+    entry.ref(static_cast<UniquePositionField>(field)).SerializeToString(
+        &temp);
   }
+  statement->BindBlob(index, temp.data(), temp.length());
+  return temp.length();
+}
+
+// Iterate over the fields of |entry| and bind each to |statement| for
+// updating.  Returns the number of bytes bound.
+size_t BindFields(const EntryKernel& entry,
+                  sql::Statement* statement) {
+  size_t bytes = 0;
+  for (int i = BEGIN_FIELDS; i < FIELD_COUNT; ++i)
+    bytes += BindField(entry, i, i - BEGIN_FIELDS, statement);
+  return bytes;
 }
 
 // The caller owns the returned EntryKernel*.  Assumes the statement currently
@@ -98,8 +120,10 @@ scoped_ptr<EntryKernel> UnpackEntry(sql::Statement* statement) {
                 statement->ColumnString(i));
   }
   for ( ; i < PROTO_FIELDS_END; ++i) {
-    kernel->mutable_ref(static_cast<ProtoField>(i)).ParseFromArray(
-        statement->ColumnBlob(i), statement->ColumnByteLength(i));
+    sync_pb::EntitySpecifics specifics;
+    specifics.ParseFromArray(statement->ColumnBlob(i),
+                             statement->ColumnByteLength(i));
+    kernel->put(static_cast<ProtoField>(i), specifics);
   }
   for ( ; i < UNIQUE_POSITION_FIELDS_END; ++i) {
     std::string temp;
@@ -114,6 +138,8 @@ scoped_ptr<EntryKernel> UnpackEntry(sql::Statement* statement) {
     kernel->mutable_ref(static_cast<UniquePositionField>(i)) =
         UniquePosition::FromProto(proto);
   }
+  // The row on disk matches the kernel.
+  kernel->clear_dirty_fields();
   return kernel.Pass();
 }
 
@@ -215,12 +241,18 @@ bool DirectoryBackingStore::SaveChanges(
   if (!transaction.Begin())
     return false;
 
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  size_t bytes_written = 0;
+
+  // Rows that exist already only have their changed columns updated.
   PrepareSaveEntryStatement(METAS_TABLE, &save_meta_statment_);
   for (EntryKernelSet::const_iterator i = snapshot.dirty_metas.begin();
        i != snapshot.dirty_metas.end(); ++i) {
     DCHECK((*i)->is_dirty());
-    if (!SaveEntryToDB(&save_meta_statment_, **i))
+    if (!UpdateEntryToDB(**i, &bytes_written) &&
+        !SaveEntryToDB(&save_meta_statment_, **i, &bytes_written)) {
       return false;
+    }
   }
 
   if (!DeleteEntries(METAS_TABLE, snapshot.metahandles_to_purge))
@@ -230,7 +262,7 @@ bool DirectoryBackingStore::SaveChanges(
                             &save_delete_journal_statment_);
   for (EntryKernelSet::const_iterator i = snapshot.delete_journals.begin();
        i != snapshot.delete_journals.end(); ++i) {
-    if (!SaveEntryToDB(&save_delete_journal_statment_, **i))
+    if (!SaveEntryToDB(&save_delete_journal_statment_, **i, &bytes_written))
       return false;
   }
 
@@ -277,7 +309,16 @@ bool DirectoryBackingStore::SaveChanges(
     }
   }
 
-  return transaction.Commit();
+  if (!transaction.Commit())
+    return false;
+
+  UMA_HISTOGRAM_TIMES("Sync.DirectorySaveChangesTime",
+                      base::TimeTicks::Now() - start_time);
+  UMA_HISTOGRAM_COUNTS("Sync.DirectorySaveChangesEntries",
+                       snapshot.dirty_metas.size());
+  UMA_HISTOGRAM_CUSTOM_COUNTS("Sync.DirectorySaveChangesBytes",
+                              bytes_written, 1, 64 * 1024 * 1024, 50);
+  return true;
 }
 
 bool DirectoryBackingStore::InitializeTables() {
@@ -590,12 +631,57 @@ bool DirectoryBackingStore::LoadInfo(Directory::KernelLoadInfo* info) {
 
 /* static */
 bool DirectoryBackingStore::SaveEntryToDB(sql::Statement* save_statement,
-                                          const EntryKernel& entry) {
+                                          const EntryKernel& entry,
+                                          size_t* bytes_written) {
   save_statement->Reset(true);
-  BindFields(entry, save_statement);
+  *bytes_written += BindFields(entry, save_statement);
   return save_statement->Run();
 }
 
+bool DirectoryBackingStore::UpdateEntryToDB(const EntryKernel& entry,
+                                            size_t* bytes_written) {
+  // Entries that were never written, or whose metahandle changed, need the
+  // whole row.
+  const EntryKernel::FieldSet& fields = entry.dirty_fields();
+  if (fields.all() || fields.test(META_HANDLE))
+    return false;
+  if (fields.none())
+    return true;
+
+  const unsigned long key = fields.to_ulong();
+  UpdateStatementMap::iterator found = update_statements_.find(key);
+  if (found == update_statements_.end()) {
+    if (update_statements_.size() >= kMaxCachedUpdateStatements)
+      update_statements_.clear();
+    string query("UPDATE metas SET ");
+    const char* separator = "";
+    for (int i = BEGIN_FIELDS; i < FIELD_COUNT; ++i) {
+      if (!fields.test(i))
+        continue;
+      query.append(separator);
+      separator = ", ";
+      query.append(ColumnName(i));
+      query.append(" = ?");
+    }
+    query.append(" WHERE metahandle = ?");
+    linked_ptr<sql::Statement> statement(
+        new sql::Statement(db_->GetUniqueStatement(query.c_str())));
+    found = update_statements_.insert(std::make_pair(key, statement)).first;
+  }
+
+  sql::Statement* statement = found->second.get();
+  statement->Reset(true);
+  int index = 0;
+  for (int i = BEGIN_FIELDS; i < FIELD_COUNT; ++i) {
+    if (fields.test(i))
+      *bytes_written += BindField(entry, i, index++, statement);
+  }
+  statement->BindInt64(index, entry.ref(META_HANDLE));
+  // The row may be missing, for example after the tables were recreated; the
+  // caller then writes the whole entry.
+  return statement->Run() && db_->GetLastChangeCount() == 1;
+}
+
 bool DirectoryBackingStore::DropDeletedEntries() {
   if (!db_->Execute("DELETE FROM metas "
                     "WHERE is_del > 0 "
@@ -5,8 +5,10 @@
 #ifndef SYNC_SYNCABLE_DIRECTORY_BACKING_STORE_H_
 #define SYNC_SYNCABLE_DIRECTORY_BACKING_STORE_H_
 
+#include <map>
 #include <string>
 
+#include "base/memory/linked_ptr.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/threading/non_thread_safe.h"
 #include "sql/connection.h"
@@ -101,10 +103,13 @@ class SYNC_EXPORT_PRIVATE DirectoryBackingStore : public base::NonThreadSafe {
   bool LoadInfo(Directory::KernelLoadInfo* info);
 
   // Save/update helpers for entries.  Return false if sqlite commit fails.
+  // Both add the number of bytes bound to |bytes_written|.
   static bool SaveEntryToDB(sql::Statement* save_statement,
-                            const EntryKernel& entry);
-  bool SaveNewEntryToDB(const EntryKernel& entry);
-  bool UpdateEntryToDB(const EntryKernel& entry);
+                            const EntryKernel& entry,
+                            size_t* bytes_written);
+  // Writes only the dirty fields of an entry already in the metas table.
+  // Returns false if the whole row has to be written instead.
+  bool UpdateEntryToDB(const EntryKernel& entry, size_t* bytes_written);
 
   // Close save_dbhandle_.  Broken out for testing.
   void EndSave();
@@ -174,6 +179,10 @@ class SYNC_EXPORT_PRIVATE DirectoryBackingStore : public base::NonThreadSafe {
   scoped_ptr<sql::Connection> db_;
   sql::Statement save_meta_statment_;
   sql::Statement save_delete_journal_statment_;
+  // Prepared UPDATE statements keyed by the set of columns they write.
+  typedef std::map<unsigned long, linked_ptr<sql::Statement> >
+      UpdateStatementMap;
+  UpdateStatementMap update_statements_;
   std::string dir_name_;
 
   // Set to true if migration left some old columns around that need to be
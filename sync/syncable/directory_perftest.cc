@@ -0,0 +1,165 @@
+// Copyright 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "sync/protocol/bookmark_specifics.pb.h"
+#include "sync/syncable/directory.h"
+#include "sync/syncable/entry_kernel.h"
+#include "sync/syncable/mutable_entry.h"
+#include "sync/syncable/on_disk_directory_backing_store.h"
+#include "sync/syncable/syncable_read_transaction.h"
+#include "sync/syncable/syncable_write_transaction.h"
+#include "sync/test/engine/test_id_factory.h"
+#include "sync/test/null_directory_change_delegate.h"
+#include "sync/test/null_transaction_observer.h"
+#include "sync/util/test_unrecoverable_error_handler.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace syncer {
+namespace syncable {
+
+namespace {
+
+const char kDirectoryName[] = "PerfTest";
+
+}  // namespace
+
+class DirectoryPerfTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    db_path_ = temp_dir_.path().Append(
+        FILE_PATH_LITERAL("DirectoryPerfTest.sqlite3"));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    if (dir_)
+      dir_->SaveChanges();
+    dir_.reset();
+  }
+
+  void OpenDirectory() {
+    dir_.reset(new Directory(
+        new OnDiskDirectoryBackingStore(kDirectoryName, db_path_),
+        &handler_, NULL, NULL, NULL));
+    ASSERT_EQ(OPENED, dir_->Open(kDirectoryName, &delegate_,
+                                 NullTransactionObserver()));
+  }
+
+  // Creates |count| synced bookmarks, as left behind by an initial sync,
+  // and saves them to disk.
+  void CreateSyncedBookmarks(int count) {
+    {
+      WriteTransaction trans(FROM_HERE, UNITTEST, dir_.get());
+      for (int i = 0; i < count; ++i) {
+        std::string title = base::StringPrintf("Bookmark %d", i);
+        MutableEntry entry(&trans, CREATE, BOOKMARKS, trans.root_id(), title);
+        ASSERT_TRUE(entry.good());
+        sync_pb::EntitySpecifics specifics;
+        specifics.mutable_bookmark()->set_url(
+            base::StringPrintf("http://www.example.com/page%d.html", i));
+        specifics.mutable_bookmark()->set_title(title);
+        entry.Put(ID, id_factory_.NewServerId());
+        entry.Put(BASE_VERSION, 1);
+        entry.Put(SERVER_VERSION, 1);
+        entry.Put(SERVER_NON_UNIQUE_NAME, title);
+        entry.Put(SERVER_PARENT_ID, trans.root_id());
+        entry.Put(SPECIFICS, specifics);
+        entry.Put(SERVER_SPECIFICS, specifics);
+        entry.Put(IS_UNSYNCED, false);
+      }
+    }
+    ASSERT_TRUE(dir_->SaveChanges());
+  }
+
+  // Returns the estimated memory used by the loaded entry kernels.
+  size_t EstimateKernelMemoryUsage() {
+    ReadTransaction trans(FROM_HERE, dir_.get());
+    std::vector<const EntryKernel*> kernels;
+    dir_->GetAllEntryKernels(&trans, &kernels);
+    size_t usage = 0;
+    for (size_t i = 0; i < kernels.size(); ++i)
+      usage += kernels[i]->EstimateMemoryUsage();
+    return usage;
+  }
+
+  // Loads a directory of |count| bookmarks from disk and logs the time
+  // taken and the memory used per entry.
+  void RunLoad(const char* name, int count) {
+    OpenDirectory();
+    CreateSyncedBookmarks(count);
+    dir_.reset();
+
+    PerfTimer timer;
+    OpenDirectory();
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    LogPerfResult(base::StringPrintf("%s_load_time", name).c_str(),
+                  elapsed.InMillisecondsF(), "ms");
+    LogPerfResult(base::StringPrintf("%s_bytes_per_entry", name).c_str(),
+                  EstimateKernelMemoryUsage() / count, "bytes");
+  }
+
+  // Modifies every |stride|th of |count| bookmarks and logs how long it
+  // takes to save the changes.
+  void RunSaveChanges(const char* name, int count, int stride) {
+    OpenDirectory();
+    CreateSyncedBookmarks(count);
+
+    {
+      WriteTransaction trans(FROM_HERE, UNITTEST, dir_.get());
+      std::vector<const EntryKernel*> kernels;
+      dir_->GetAllEntryKernels(&trans, &kernels);
+      for (size_t i = 0; i < kernels.size(); i += stride) {
+        MutableEntry entry(&trans, GET_BY_HANDLE,
+                           kernels[i]->ref(META_HANDLE));
+        ASSERT_TRUE(entry.good());
+        if (entry.Get(ID).IsRoot())
+          continue;
+        sync_pb::EntitySpecifics specifics = entry.Get(SPECIFICS);
+        specifics.mutable_bookmark()->set_title("Renamed");
+        entry.Put(SPECIFICS, specifics);
+        entry.Put(IS_UNSYNCED, true);
+      }
+    }
+
+    PerfTimer timer;
+    ASSERT_TRUE(dir_->SaveChanges());
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    LogPerfResult(base::StringPrintf("%s_save_changes", name).c_str(),
+                  elapsed.InMillisecondsF(), "ms");
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::ScopedTempDir temp_dir_;
+  base::FilePath db_path_;
+  NullDirectoryChangeDelegate delegate_;
+  TestUnrecoverableErrorHandler handler_;
+  TestIdFactory id_factory_;
+  scoped_ptr<Directory> dir_;
+};
+
+TEST_F(DirectoryPerfTest, Load100kBookmarks) {
+  RunLoad("Directory_100k_bookmarks", 100000);
+}
+
+TEST_F(DirectoryPerfTest, SaveChanges100kBookmarksFewDirty) {
+  RunSaveChanges("Directory_100k_bookmarks_1pct_dirty", 100000, 100);
+}
+
+TEST_F(DirectoryPerfTest, SaveChanges100kBookmarksAllDirty) {
+  RunSaveChanges("Directory_100k_bookmarks_all_dirty", 100000, 1);
+}
+
+}  // namespace syncable
+}  // namespace syncer
@@ -17,10 +17,64 @@ EntryKernel::EntryKernel() : dirty_(false) {
   for (int i = INT64_FIELDS_BEGIN; i < INT64_FIELDS_END; ++i) {
     int64_fields[i] = 0;
   }
+  dirty_fields_.set();
 }
 
 EntryKernel::~EntryKernel() {}
 
+void EntryKernel::put(ProtoField field, const sync_pb::EntitySpecifics& value) {
+  dirty_fields_.set(field);
+  scoped_refptr<SharedSpecifics>& slot =
+      specifics_fields[field - PROTO_FIELDS_BEGIN];
+  const int byte_size = value.ByteSize();
+  if (byte_size == 0) {
+    slot = NULL;
+    return;
+  }
+
+  // Share the value of another field if it is the same; SERVER_SPECIFICS
+  // and SPECIFICS match for every entry that is in sync.
+  std::string serialized;
+  for (int i = 0; i < PROTO_FIELDS_COUNT; ++i) {
+    const scoped_refptr<SharedSpecifics>& other = specifics_fields[i];
+    if (i == field - PROTO_FIELDS_BEGIN || !other.get())
+      continue;
+    if (&other->data == &value) {
+      slot = other;
+      return;
+    }
+    if (other->data.ByteSize() != byte_size)
+      continue;
+    if (serialized.empty())
+      value.SerializeToString(&serialized);
+    if (other->data.SerializeAsString() == serialized) {
+      slot = other;
+      return;
+    }
+  }
+  slot = new SharedSpecifics(value);
+}
+
+size_t EntryKernel::EstimateMemoryUsage() const {
+  size_t usage = sizeof(*this);
+  for (int i = 0; i < STRING_FIELDS_COUNT; ++i)
+    usage += string_fields[i].capacity();
+  for (int i = 0; i < ID_FIELDS_COUNT; ++i)
+    usage += id_fields[i].value().capacity();
+  for (int i = 0; i < PROTO_FIELDS_COUNT; ++i) {
+    const SharedSpecifics* specifics = specifics_fields[i].get();
+    if (!specifics)
+      continue;
+    // Count a value shared between fields once.
+    bool counted = false;
+    for (int j = 0; j < i; ++j)
+      counted |= specifics_fields[j].get() == specifics;
+    if (!counted)
+      usage += sizeof(*specifics) + specifics->data.ByteSize();
+  }
+  return usage;
+}
+
 ModelType EntryKernel::GetModelType() const {
   ModelType specifics_type = GetModelTypeFromSpecifics(ref(SPECIFICS));
   if (specifics_type != UNSPECIFIED)
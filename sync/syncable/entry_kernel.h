@@ -7,6 +7,7 @@
 
 #include <set>
 
+#include "base/memory/ref_counted.h"
 #include "base/time/time.h"
 #include "base/values.h"
 #include "sync/base/sync_export.h"
@@ -177,8 +178,14 @@ enum {
 
 struct SYNC_EXPORT_PRIVATE EntryKernel {
  private:
+  // Specifics are immutable once stored and shared between the fields of
+  // a kernel that hold the same value and with copies of the kernel, such
+  // as SaveChanges snapshots and mutation records.  NULL stands for empty
+  // specifics, which is what most BASE_SERVER_SPECIFICS hold.
+  typedef base::RefCountedData<sync_pb::EntitySpecifics> SharedSpecifics;
+
   std::string string_fields[STRING_FIELDS_COUNT];
-  sync_pb::EntitySpecifics specifics_fields[PROTO_FIELDS_COUNT];
+  scoped_refptr<SharedSpecifics> specifics_fields[PROTO_FIELDS_COUNT];
   int64 int64_fields[INT64_FIELDS_COUNT];
   base::Time time_fields[TIME_FIELDS_COUNT];
   Id id_fields[ID_FIELDS_COUNT];
@@ -216,42 +223,64 @@ struct SYNC_EXPORT_PRIVATE EntryKernel {
     return dirty_;
   }
 
+  // The fields that changed since this kernel was last written to the
+  // database, so that only their columns need to be updated.  A kernel
+  // that was never written has all of its fields set.
+  typedef std::bitset<FIELD_COUNT> FieldSet;
+  inline const FieldSet& dirty_fields() const {
+    return dirty_fields_;
+  }
+  inline void add_dirty_fields(const FieldSet& fields) {
+    dirty_fields_ |= fields;
+  }
+  inline void clear_dirty_fields() {
+    dirty_fields_.reset();
+  }
+
   // Setters.
   inline void put(MetahandleField field, int64 value) {
     int64_fields[field - INT64_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(Int64Field field, int64 value) {
     int64_fields[field - INT64_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(TimeField field, const base::Time& value) {
     // Round-trip to proto time format and back so that we have
     // consistent time resolutions (ms).
     time_fields[field - TIME_FIELDS_BEGIN] =
         ProtoTimeToTime(TimeToProtoTime(value));
+    dirty_fields_.set(field);
   }
   inline void put(IdField field, const Id& value) {
     id_fields[field - ID_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(BaseVersion field, int64 value) {
     int64_fields[field - INT64_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(IndexedBitField field, bool value) {
     bit_fields[field - BIT_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(IsDelField field, bool value) {
     bit_fields[field - BIT_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(BitField field, bool value) {
     bit_fields[field - BIT_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(StringField field, const std::string& value) {
     string_fields[field - STRING_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
-  inline void put(ProtoField field, const sync_pb::EntitySpecifics& value) {
-    specifics_fields[field - PROTO_FIELDS_BEGIN].CopyFrom(value);
-  }
+  void put(ProtoField field, const sync_pb::EntitySpecifics& value);
   inline void put(UniquePositionField field, const UniquePosition& value) {
     unique_position_fields[field - UNIQUE_POSITION_FIELDS_BEGIN] = value;
+    dirty_fields_.set(field);
   }
   inline void put(BitTemp field, bool value) {
     bit_temps[field - BIT_TEMPS_BEGIN] = value;
@@ -286,7 +315,10 @@ struct SYNC_EXPORT_PRIVATE EntryKernel {
     return string_fields[field - STRING_FIELDS_BEGIN];
   }
   inline const sync_pb::EntitySpecifics& ref(ProtoField field) const {
-    return specifics_fields[field - PROTO_FIELDS_BEGIN];
+    const SharedSpecifics* specifics =
+        specifics_fields[field - PROTO_FIELDS_BEGIN].get();
+    return specifics ? specifics->data
+                     : sync_pb::EntitySpecifics::default_instance();
   }
   inline const UniquePosition& ref(UniquePositionField field) const {
     return unique_position_fields[field - UNIQUE_POSITION_FIELDS_BEGIN];
@@ -297,15 +329,15 @@ struct SYNC_EXPORT_PRIVATE EntryKernel {
 
   // Non-const, mutable ref getters for object types only.
   inline std::string& mutable_ref(StringField field) {
+    dirty_fields_.set(field);
     return string_fields[field - STRING_FIELDS_BEGIN];
   }
-  inline sync_pb::EntitySpecifics& mutable_ref(ProtoField field) {
-    return specifics_fields[field - PROTO_FIELDS_BEGIN];
-  }
   inline Id& mutable_ref(IdField field) {
+    dirty_fields_.set(field);
     return id_fields[field - ID_FIELDS_BEGIN];
   }
   inline UniquePosition& mutable_ref(UniquePositionField field) {
+    dirty_fields_.set(field);
     return unique_position_fields[field - UNIQUE_POSITION_FIELDS_BEGIN];
   }
 
@@ -320,9 +352,14 @@ struct SYNC_EXPORT_PRIVATE EntryKernel {
   // they will be serialized as empty proto's.
   base::DictionaryValue* ToValue(Cryptographer* cryptographer) const;
 
+  // Approximate heap footprint of this kernel.  Specifics shared with
+  // other kernels are counted in full by each of them.
+  size_t EstimateMemoryUsage() const;
+
  private:
   // Tracks whether this entry needs to be saved to the database.
   bool dirty_;
+  FieldSet dirty_fields_;
 };
 
 class EntryKernelLessByMetaHandle {
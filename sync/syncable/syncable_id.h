@@ -114,8 +114,6 @@ class SYNC_EXPORT Id {
 
  private:
   friend scoped_ptr<EntryKernel> UnpackEntry(sql::Statement* statement);
-  friend void BindFields(const EntryKernel& entry,
-                         sql::Statement* statement);
   SYNC_EXPORT_PRIVATE friend std::ostream& operator<<(std::ostream& out,
                                                       const Id& id);
   friend class MockConnectionManager;
@@ -85,6 +85,31 @@ void ExpectDataFromBookmarkFaviconEquals(BaseTransaction* trans,
 }
 }  // namespace
 
+TEST(SyncableEntryKernelTest, SpecificsSharedBetweenFields) {
+  EntryKernel kernel;
+  EXPECT_EQ(0, kernel.ref(SPECIFICS).ByteSize());
+  EXPECT_EQ(0, kernel.ref(BASE_SERVER_SPECIFICS).ByteSize());
+
+  sync_pb::EntitySpecifics specifics;
+  specifics.mutable_bookmark()->set_url("http://demo/");
+  kernel.put(SPECIFICS, specifics);
+  kernel.put(SERVER_SPECIFICS, specifics);
+  EXPECT_EQ(&kernel.ref(SPECIFICS), &kernel.ref(SERVER_SPECIFICS));
+
+  // Copies share too, and changing one field leaves the other alone.
+  EntryKernel copy(kernel);
+  EXPECT_EQ(&kernel.ref(SPECIFICS), &copy.ref(SPECIFICS));
+  specifics.mutable_bookmark()->set_url("http://other/");
+  copy.put(SPECIFICS, specifics);
+  EXPECT_EQ("http://other/", copy.ref(SPECIFICS).bookmark().url());
+  EXPECT_EQ("http://demo/", copy.ref(SERVER_SPECIFICS).bookmark().url());
+  EXPECT_EQ("http://demo/", kernel.ref(SPECIFICS).bookmark().url());
+
+  kernel.put(SPECIFICS, sync_pb::EntitySpecifics());
+  EXPECT_FALSE(kernel.ref(SPECIFICS).has_bookmark());
+  EXPECT_TRUE(kernel.ref(SERVER_SPECIFICS).has_bookmark());
+}
+
 class SyncableGeneralTest : public testing::Test {
  public:
   static const char kIndexTestName[];
@@ -281,6 +306,56 @@ TEST_F(SyncableGeneralTest, ChildrenOps) {
   dir.SaveChanges();
 }
 
+// Changes made after the first save are written as column updates; check
+// that they and the untouched columns survive a reload.
+TEST_F(SyncableGeneralTest, ChangedFieldsPersistAfterReload) {
+  TestIdFactory factory;
+  const Id id = factory.NewServerId();
+  int64 metahandle;
+  sync_pb::EntitySpecifics specifics;
+  specifics.mutable_bookmark()->set_url("http://demo/");
+
+  {
+    Directory dir(new OnDiskDirectoryBackingStore(kIndexTestName, db_path_),
+                  &handler_, NULL, NULL, NULL);
+    ASSERT_EQ(OPENED, dir.Open(kIndexTestName, &delegate_,
+                               NullTransactionObserver()));
+    {
+      WriteTransaction wtrans(FROM_HERE, UNITTEST, &dir);
+      MutableEntry me(&wtrans, CREATE, BOOKMARKS, wtrans.root_id(), "old");
+      ASSERT_TRUE(me.good());
+      me.Put(ID, id);
+      me.Put(BASE_VERSION, 1);
+      me.Put(SPECIFICS, specifics);
+      metahandle = me.Get(META_HANDLE);
+    }
+    ASSERT_TRUE(dir.SaveChanges());
+    {
+      WriteTransaction wtrans(FROM_HERE, UNITTEST, &dir);
+      MutableEntry me(&wtrans, GET_BY_HANDLE, metahandle);
+      ASSERT_TRUE(me.good());
+      EXPECT_TRUE(me.GetKernelCopy().dirty_fields().none());
+      me.Put(NON_UNIQUE_NAME, "new");
+      me.Put(SERVER_VERSION, 5);
+      EXPECT_EQ(2U, me.GetKernelCopy().dirty_fields().count());
+    }
+    ASSERT_TRUE(dir.SaveChanges());
+  }
+
+  Directory dir(new OnDiskDirectoryBackingStore(kIndexTestName, db_path_),
+                &handler_, NULL, NULL, NULL);
+  ASSERT_EQ(OPENED, dir.Open(kIndexTestName, &delegate_,
+                             NullTransactionObserver()));
+  ReadTransaction trans(FROM_HERE, &dir);
+  Entry e(&trans, GET_BY_HANDLE, metahandle);
+  ASSERT_TRUE(e.good());
+  EXPECT_EQ("new", e.Get(NON_UNIQUE_NAME));
+  EXPECT_EQ(5, e.Get(SERVER_VERSION));
+  EXPECT_EQ(id, e.Get(ID));
+  EXPECT_EQ(1, e.Get(BASE_VERSION));
+  EXPECT_EQ("http://demo/", e.Get(SPECIFICS).bookmark().url());
+}
+
 TEST_F(SyncableGeneralTest, ClientIndexRebuildsProperly) {
   int64 written_metahandle;
   TestIdFactory factory;
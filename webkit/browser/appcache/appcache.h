@@ -7,6 +7,7 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "base/gtest_prod_util.h"
@@ -37,6 +38,7 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCache
  public:
   typedef std::map<GURL, AppCacheEntry> EntryMap;
   typedef std::set<AppCacheHost*> AppCacheHosts;
+  typedef std::map<int64, std::string> ResponseDigestMap;
 
   AppCache(AppCacheStorage* storage, int64 cache_id);
 
@@ -67,6 +69,18 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCache
       int64 response_id, GURL* optional_url);
   const EntryMap& entries() const { return entries_; }
 
+  // Digests of the headers and bodies of the responses written for this
+  // cache by an update, keyed by response id. Storage uses them to share a
+  // single copy of identical responses; they are dropped once the cache has
+  // been stored.
+  void SetResponseDigest(int64 response_id, const std::string& digest) {
+    response_digests_[response_id] = digest;
+  }
+  const ResponseDigestMap& response_digests() const {
+    return response_digests_;
+  }
+  void ClearResponseDigests() { response_digests_.clear(); }
+
   // The AppCache owns the collection of executable handlers that have
   // been started for this instance. The getter looks up an existing
   // handler returning null if not found, the GetOrCreate method will
@@ -176,6 +190,7 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCache
   AppCacheHosts associated_hosts_;
 
   EntryMap entries_;    // contains entries of all types
+  ResponseDigestMap response_digests_;
 
   NamespaceVector intercept_namespaces_;
   NamespaceVector fallback_namespaces_;
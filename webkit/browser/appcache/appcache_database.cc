@@ -21,8 +21,8 @@ namespace appcache {
 // Schema -------------------------------------------------------------------
 namespace {
 
-const int kCurrentVersion = 5;
-const int kCompatibleVersion = 5;
+const int kCurrentVersion = 6;
+const int kCompatibleVersion = 6;
 
 // A mechanism to run experiments that may affect in data being persisted
 // in different ways such that when the experiment is toggled on/off via
@@ -37,6 +37,7 @@ const char kEntriesTable[] = "Entries";
 const char kNamespacesTable[] = "Namespaces";
 const char kOnlineWhiteListsTable[] = "OnlineWhiteLists";
 const char kDeletableResponseIdsTable[] = "DeletableResponseIds";
+const char kResponseDigestsTable[] = "ResponseDigests";
 
 struct TableInfo {
   const char* table_name;
@@ -87,6 +88,11 @@ const TableInfo kTables[] = {
 
   { kDeletableResponseIdsTable,
     "(response_id INTEGER NOT NULL)" },
+
+  { kResponseDigestsTable,
+    "(response_id INTEGER NOT NULL,"
+    " digest TEXT NOT NULL,"
+    " response_size INTEGER)" },
 };
 
 const IndexInfo kIndexes[] = {
@@ -115,10 +121,11 @@ const IndexInfo kIndexes[] = {
     "(cache_id, url)",
     true },
 
+  // Not unique, entries with identical content share a response.
   { "EntriesResponseIdIndex",
     kEntriesTable,
     "(response_id)",
-    true },
+    false },
 
   { "NamespacesCacheIndex",
     kNamespacesTable,
@@ -144,6 +151,16 @@ const IndexInfo kIndexes[] = {
     kDeletableResponseIdsTable,
     "(response_id)",
     true },
+
+  { "ResponseDigestsDigestIndex",
+    kResponseDigestsTable,
+    "(digest)",
+    false },
+
+  { "ResponseDigestsResponseIdIndex",
+    kResponseDigestsTable,
+    "(response_id)",
+    true },
 };
 
 const int kTableCount = ARRAYSIZE_UNSAFE(kTables);
@@ -852,6 +869,80 @@ bool AppCacheDatabase::DeleteDeletableResponseIds(
   return RunCachedStatementWithIds(SQL_FROM_HERE, kSql, response_ids);
 }
 
+bool AppCacheDatabase::FindResponseIdForDigest(
+    const std::string& digest, int64 response_size, int64* response_id) {
+  DCHECK(response_id);
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql =
+      "SELECT response_id FROM ResponseDigests"
+      "  WHERE digest = ? AND response_size = ?"
+      "  LIMIT 1";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+  statement.BindString(0, digest);
+  statement.BindInt64(1, response_size);
+
+  if (!statement.Step())
+    return false;
+  *response_id = statement.ColumnInt64(0);
+  return true;
+}
+
+bool AppCacheDatabase::InsertResponseDigest(
+    int64 response_id, const std::string& digest, int64 response_size) {
+  if (!LazyOpen(true))
+    return false;
+
+  const char* kSql =
+      "INSERT INTO ResponseDigests (response_id, digest, response_size)"
+      "  VALUES(?, ?, ?)";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+  statement.BindInt64(0, response_id);
+  statement.BindString(1, digest);
+  statement.BindInt64(2, response_size);
+
+  return statement.Run();
+}
+
+bool AppCacheDatabase::DeleteResponseDigests(
+    const std::vector<int64>& response_ids) {
+  const char* kSql =
+      "DELETE FROM ResponseDigests WHERE response_id = ?";
+  return RunCachedStatementWithIds(SQL_FROM_HERE, kSql, response_ids);
+}
+
+bool AppCacheDatabase::RemoveReferencedResponseIds(
+    std::vector<int64>* response_ids) {
+  DCHECK(response_ids);
+  if (response_ids->empty())
+    return true;
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql =
+      "SELECT 1 FROM Entries WHERE response_id = ? LIMIT 1";
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+
+  std::vector<int64> unreferenced;
+  std::vector<int64>::const_iterator iter = response_ids->begin();
+  while (iter != response_ids->end()) {
+    statement.BindInt64(0, *iter);
+    if (!statement.Step()) {
+      if (!statement.Succeeded())
+        return false;
+      unreferenced.push_back(*iter);
+    }
+    statement.Reset(true);
+    ++iter;
+  }
+  response_ids->swap(unreferenced);
+  return true;
+}
+
 bool AppCacheDatabase::RunCachedStatementWithIds(
     const sql::StatementID& statement_id, const char* sql,
     const std::vector<int64>& ids) {
@@ -896,8 +987,9 @@ bool AppCacheDatabase::FindResponseIdsForCacheHelper(
   if (!LazyOpen(false))
     return false;
 
+  // Entries of a cache may share a response.
   const char* kSql =
-      "SELECT response_id FROM Entries WHERE cache_id = ?";
+      "SELECT DISTINCT response_id FROM Entries WHERE cache_id = ?";
 
   sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
 
@@ -1164,6 +1256,29 @@ bool AppCacheDatabase::UpgradeSchema() {
     }
     meta_table_->SetVersionNumber(5);
     meta_table_->SetCompatibleVersionNumber(5);
+    if (!transaction.Commit())
+      return false;
+  }
+
+  if (meta_table_->GetVersionNumber() == 5) {
+    // version 5 pre 10/2013
+    // Allow entries to share responses and add the ResponseDigests table.
+    DCHECK_EQ(strcmp(kEntriesTable, kIndexes[5].table_name), 0);
+    DCHECK_EQ(strcmp(kResponseDigestsTable, kTables[6].table_name), 0);
+    DCHECK_EQ(strcmp(kResponseDigestsTable, kIndexes[11].table_name), 0);
+    DCHECK_EQ(strcmp(kResponseDigestsTable, kIndexes[12].table_name), 0);
+    sql::Transaction transaction(db_.get());
+    if (!transaction.Begin())
+      return false;
+    if (!db_->Execute("DROP INDEX EntriesResponseIdIndex") ||
+        !CreateIndex(db_.get(), kIndexes[5]) ||
+        !CreateTable(db_.get(), kTables[6]) ||
+        !CreateIndex(db_.get(), kIndexes[11]) ||
+        !CreateIndex(db_.get(), kIndexes[12])) {
+      return false;
+    }
+    meta_table_->SetVersionNumber(6);
+    meta_table_->SetCompatibleVersionNumber(6);
     return transaction.Commit();
   }
 
@@ -157,6 +157,18 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCacheDatabase {
   bool InsertDeletableResponseIds(const std::vector<int64>& response_ids);
   bool DeleteDeletableResponseIds(const std::vector<int64>& response_ids);
 
+  // Responses are content addressed by a digest of their headers and body
+  // so that identical responses fetched for different entries, caches or
+  // groups can share a single copy in the disk cache.
+  bool FindResponseIdForDigest(const std::string& digest, int64 response_size,
+                               int64* response_id);
+  bool InsertResponseDigest(int64 response_id, const std::string& digest,
+                            int64 response_size);
+  bool DeleteResponseDigests(const std::vector<int64>& response_ids);
+  // Removes the ids that are still referenced by some entry from
+  // |response_ids|, leaving only those that are safe to delete.
+  bool RemoveReferencedResponseIds(std::vector<int64>* response_ids);
+
   // So our callers can wrap operations in transactions.
   sql::Connection* db_connection() {
     LazyOpen(true);
@@ -215,8 +227,10 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCacheDatabase {
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, ReCreate);
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, DeletableResponseIds);
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, OriginUsage);
+  FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, ResponseDigests);
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, UpgradeSchema3to5);
   FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, UpgradeSchema4to5);
+  FRIEND_TEST_ALL_PREFIXES(AppCacheDatabaseTest, UpgradeSchema5to6);
 
   DISALLOW_COPY_AND_ASSIGN(AppCacheDatabase);
 };
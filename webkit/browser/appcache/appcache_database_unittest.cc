@@ -598,6 +598,59 @@ TEST(AppCacheDatabaseTest, DeletableResponseIds) {
   ASSERT_TRUE(ignore_errors.CheckIgnoredErrors());
 }
 
+TEST(AppCacheDatabaseTest, ResponseDigests) {
+  const base::FilePath kEmptyPath;
+  AppCacheDatabase db(kEmptyPath);
+  EXPECT_TRUE(db.LazyOpen(true));
+
+  sql::ScopedErrorIgnorer ignore_errors;
+  // TODO(shess): See EntryRecords test.
+  ignore_errors.IgnoreError(SQLITE_CONSTRAINT);
+
+  const std::string kDigest("0123456789abcdef");
+  int64 response_id = kNoResponseId;
+  EXPECT_FALSE(db.FindResponseIdForDigest(kDigest, 100, &response_id));
+
+  EXPECT_TRUE(db.InsertResponseDigest(1, kDigest, 100));
+  EXPECT_FALSE(db.InsertResponseDigest(1, kDigest, 100));
+  EXPECT_TRUE(db.FindResponseIdForDigest(kDigest, 100, &response_id));
+  EXPECT_EQ(1, response_id);
+
+  // The size must match too.
+  EXPECT_FALSE(db.FindResponseIdForDigest(kDigest, 200, &response_id));
+
+  // Two caches sharing response 1, response 2 only referenced by one.
+  AppCacheDatabase::EntryRecord entry;
+  entry.cache_id = 1;
+  entry.url = GURL("http://blah/1");
+  entry.flags = AppCacheEntry::EXPLICIT;
+  entry.response_id = 1;
+  entry.response_size = 100;
+  EXPECT_TRUE(db.InsertEntry(&entry));
+  entry.cache_id = 2;
+  EXPECT_TRUE(db.InsertEntry(&entry));
+  entry.url = GURL("http://blah/2");
+  entry.response_id = 2;
+  EXPECT_TRUE(db.InsertEntry(&entry));
+
+  std::vector<int64> ids;
+  EXPECT_TRUE(db.FindResponseIdsForCacheAsVector(2, &ids));
+  EXPECT_EQ(2U, ids.size());
+
+  // Once cache 2 is gone, only response 2 is unreferenced.
+  EXPECT_TRUE(db.DeleteEntriesForCache(2));
+  EXPECT_TRUE(db.RemoveReferencedResponseIds(&ids));
+  ASSERT_EQ(1U, ids.size());
+  EXPECT_EQ(2, ids[0]);
+
+  ids.clear();
+  ids.push_back(1);
+  EXPECT_TRUE(db.DeleteResponseDigests(ids));
+  EXPECT_FALSE(db.FindResponseIdForDigest(kDigest, 100, &response_id));
+
+  ASSERT_TRUE(ignore_errors.CheckIgnoredErrors());
+}
+
 TEST(AppCacheDatabaseTest, OriginUsage) {
   const GURL kManifestUrl("http://blah/manifest");
   const GURL kManifestUrl2("http://blah/manifest2");
@@ -862,8 +915,8 @@ TEST(AppCacheDatabaseTest, UpgradeSchema3to5) {
   EXPECT_TRUE(db.db_->DoesColumnExist("Namespaces", "is_pattern"));
   EXPECT_TRUE(db.db_->DoesColumnExist("OnlineWhiteLists", "is_pattern"));
 
-  EXPECT_EQ(5, db.meta_table_->GetVersionNumber());
-  EXPECT_EQ(5, db.meta_table_->GetCompatibleVersionNumber());
+  EXPECT_EQ(6, db.meta_table_->GetVersionNumber());
+  EXPECT_EQ(6, db.meta_table_->GetCompatibleVersionNumber());
 
   std::vector<AppCacheDatabase::NamespaceRecord> intercepts;
   std::vector<AppCacheDatabase::NamespaceRecord> fallbacks;
@@ -1087,13 +1140,13 @@ TEST(AppCacheDatabaseTest, UpgradeSchema4to5) {
     EXPECT_TRUE(transaction.Commit());
   }
 
-  // Open that database and verify that it got upgraded to v5.
+  // Open that database and verify that it got upgraded to v6.
   AppCacheDatabase db(kDbFile);
   EXPECT_TRUE(db.LazyOpen(true));
   EXPECT_TRUE(db.db_->DoesColumnExist("Namespaces", "is_pattern"));
   EXPECT_TRUE(db.db_->DoesColumnExist("OnlineWhiteLists", "is_pattern"));
-  EXPECT_EQ(5, db.meta_table_->GetVersionNumber());
-  EXPECT_EQ(5, db.meta_table_->GetCompatibleVersionNumber());
+  EXPECT_EQ(6, db.meta_table_->GetVersionNumber());
+  EXPECT_EQ(6, db.meta_table_->GetCompatibleVersionNumber());
 
   std::vector<AppCacheDatabase::NamespaceRecord> intercepts;
   std::vector<AppCacheDatabase::NamespaceRecord> fallbacks;
@@ -1125,4 +1178,58 @@ TEST(AppCacheDatabaseTest, UpgradeSchema4to5) {
   }
 }
 
+TEST(AppCacheDatabaseTest, UpgradeSchema5to6) {
+  // Real file on disk for this test.
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const base::FilePath kDbFile = temp_dir.path().AppendASCII("upgrade5.db");
+
+  // Create a current database and turn it back into a v5 one, which
+  // has a unique response id index on the Entries table and no
+  // ResponseDigests table.
+  {
+    AppCacheDatabase db(kDbFile);
+    EXPECT_TRUE(db.LazyOpen(true));
+    AppCacheDatabase::EntryRecord entry;
+    entry.cache_id = 1;
+    entry.url = GURL("http://blah/1");
+    entry.flags = AppCacheEntry::EXPLICIT;
+    entry.response_id = 1;
+    entry.response_size = 100;
+    EXPECT_TRUE(db.InsertEntry(&entry));
+  }
+  {
+    sql::Connection connection;
+    EXPECT_TRUE(connection.Open(kDbFile));
+    sql::Transaction transaction(&connection);
+    EXPECT_TRUE(transaction.Begin());
+    EXPECT_TRUE(connection.Execute("DROP TABLE ResponseDigests"));
+    EXPECT_TRUE(connection.Execute("DROP INDEX EntriesResponseIdIndex"));
+    EXPECT_TRUE(connection.Execute(
+        "CREATE UNIQUE INDEX EntriesResponseIdIndex ON Entries(response_id)"));
+    sql::MetaTable meta_table;
+    EXPECT_TRUE(meta_table.Init(&connection, 5, 5));
+    meta_table.SetVersionNumber(5);
+    meta_table.SetCompatibleVersionNumber(5);
+    EXPECT_TRUE(transaction.Commit());
+  }
+
+  // Open that database and verify that it got upgraded to v6.
+  AppCacheDatabase db(kDbFile);
+  EXPECT_TRUE(db.LazyOpen(true));
+  EXPECT_TRUE(db.db_->DoesTableExist("ResponseDigests"));
+  EXPECT_TRUE(db.db_->DoesIndexExist("ResponseDigestsDigestIndex"));
+  EXPECT_TRUE(db.db_->DoesIndexExist("ResponseDigestsResponseIdIndex"));
+  EXPECT_EQ(6, db.meta_table_->GetVersionNumber());
+  EXPECT_EQ(6, db.meta_table_->GetCompatibleVersionNumber());
+
+  // Existing entries survive and may now share their response.
+  std::vector<AppCacheDatabase::EntryRecord> found;
+  EXPECT_TRUE(db.FindEntriesForCache(1, &found));
+  ASSERT_EQ(1U, found.size());
+  AppCacheDatabase::EntryRecord entry = found[0];
+  entry.cache_id = 2;
+  EXPECT_TRUE(db.InsertEntry(&entry));
+}
+
 }  // namespace appcache
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <map>
 #include <set>
 #include <vector>
 
@@ -59,6 +60,8 @@ bool DeleteGroupAndRelatedRecords(AppCacheDatabase* database,
         database->DeleteEntriesForCache(cache_record.cache_id) &&
         database->DeleteNamespacesForCache(cache_record.cache_id) &&
         database->DeleteOnlineWhiteListForCache(cache_record.cache_id) &&
+        database->RemoveReferencedResponseIds(deletable_response_ids) &&
+        database->DeleteResponseDigests(*deletable_response_ids) &&
         database->InsertDeletableResponseIds(*deletable_response_ids);
   } else {
     NOTREACHED() << "A existing group without a cache is unexpected";
@@ -587,8 +590,17 @@ class AppCacheStorageImpl::StoreGroupAndCacheTask : public StoreOrLoadTask {
   virtual ~StoreGroupAndCacheTask() {}
 
  private:
+  // Points entries at previously stored responses with the same content,
+  // recording the digests of those that are stored for the first time.
+  bool ShareIdenticalResponses();
+
   scoped_refptr<AppCacheGroup> group_;
   scoped_refptr<AppCache> cache_;
+  AppCache::ResponseDigestMap response_digests_;
+  // Maps the ids of newly written responses to the ids of the identical,
+  // already stored responses used in their place.
+  std::map<int64, int64> shared_response_ids_;
+  std::vector<int64> duplicate_response_ids_;
   bool success_;
   bool would_exceed_quota_;
   int64 space_available_;
@@ -610,6 +622,7 @@ AppCacheStorageImpl::StoreGroupAndCacheTask::StoreGroupAndCacheTask(
       &intercept_namespace_records_,
       &fallback_namespace_records_,
       &online_whitelist_records_);
+  response_digests_ = newest_cache->response_digests();
 }
 
 void AppCacheStorageImpl::StoreGroupAndCacheTask::GetQuotaThenSchedule() {
@@ -659,6 +672,9 @@ void AppCacheStorageImpl::StoreGroupAndCacheTask::Run() {
 
   int64 old_origin_usage = database_->GetOriginUsage(group_record_.origin);
 
+  if (!ShareIdenticalResponses())
+    return;
+
   AppCacheDatabase::GroupRecord existing_group;
   success_ = database_->FindGroup(group_record_.group_id, &existing_group);
   if (!success_) {
@@ -695,11 +711,15 @@ void AppCacheStorageImpl::StoreGroupAndCacheTask::Run() {
         ++id_iter;
       }
 
+      // Responses may also be shared with caches of other groups.
       success_ =
           database_->DeleteCache(cache.cache_id) &&
           database_->DeleteEntriesForCache(cache.cache_id) &&
           database_->DeleteNamespacesForCache(cache.cache_id) &&
           database_->DeleteOnlineWhiteListForCache(cache.cache_id) &&
+          database_->RemoveReferencedResponseIds(
+              &newly_deletable_response_ids_) &&
+          database_->DeleteResponseDigests(newly_deletable_response_ids_) &&
           database_->InsertDeletableResponseIds(newly_deletable_response_ids_);
           // TODO(michaeln): store group_id too with deletable ids
     } else {
@@ -749,8 +769,53 @@ void AppCacheStorageImpl::StoreGroupAndCacheTask::Run() {
   success_ = transaction.Commit();
 }
 
+bool AppCacheStorageImpl::StoreGroupAndCacheTask::ShareIdenticalResponses() {
+  std::vector<AppCacheDatabase::EntryRecord>::iterator iter =
+      entry_records_.begin();
+  for (; iter != entry_records_.end(); ++iter) {
+    AppCache::ResponseDigestMap::const_iterator found =
+        response_digests_.find(iter->response_id);
+    if (found == response_digests_.end())
+      continue;
+    std::map<int64, int64>::const_iterator shared =
+        shared_response_ids_.find(iter->response_id);
+    if (shared != shared_response_ids_.end()) {
+      iter->response_id = shared->second;
+      continue;
+    }
+    int64 existing_id = kNoResponseId;
+    if (database_->FindResponseIdForDigest(
+            found->second, iter->response_size, &existing_id)) {
+      if (existing_id == iter->response_id)
+        continue;
+      shared_response_ids_[iter->response_id] = existing_id;
+      duplicate_response_ids_.push_back(iter->response_id);
+      iter->response_id = existing_id;
+      continue;
+    }
+    if (!database_->InsertResponseDigest(
+            iter->response_id, found->second, iter->response_size)) {
+      return false;
+    }
+  }
+  return database_->InsertDeletableResponseIds(duplicate_response_ids_);
+}
+
 void AppCacheStorageImpl::StoreGroupAndCacheTask::RunCompleted() {
   if (success_) {
+    // Switch the in-memory entries over to the shared responses and
+    // schedule the duplicates written by the update for deletion.
+    std::map<int64, int64>::const_iterator iter =
+        shared_response_ids_.begin();
+    for (; iter != shared_response_ids_.end(); ++iter) {
+      GURL url;
+      while (cache_->GetEntryAndUrlWithResponseId(iter->first, &url))
+        cache_->GetEntry(url)->set_response_id(iter->second);
+    }
+    cache_->ClearResponseDigests();
+    newly_deletable_response_ids_.insert(newly_deletable_response_ids_.end(),
+                                         duplicate_response_ids_.begin(),
+                                         duplicate_response_ids_.end());
     storage_->UpdateUsageMapAndNotify(
         group_->manifest_url().GetOrigin(), new_origin_usage_);
     if (cache_.get() != group_->newest_complete_cache()) {
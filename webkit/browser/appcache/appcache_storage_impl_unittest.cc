@@ -30,6 +30,7 @@ const GURL kManifestUrl2("http://blah/manifest2");
 const GURL kManifestUrl3("http://blah/manifest3");
 const GURL kEntryUrl("http://blah/entry");
 const GURL kEntryUrl2("http://blah/entry2");
+const GURL kEntryUrl3("http://blah/entry3");
 const GURL kFallbackNamespace("http://blah/fallback_namespace/");
 const GURL kFallbackNamespace2("http://blah/fallback_namespace/longer");
 const GURL kFallbackTestUrl("http://blah/fallback_namespace/longer/test");
@@ -632,6 +633,63 @@ class AppCacheStorageImplTest : public testing::Test {
     TestFinished();
   }
 
+  // StoreSharesIdenticalResponses  --------------------------------------
+
+  void StoreSharesIdenticalResponses() {
+    PushNextTask(base::Bind(
+        &AppCacheStorageImplTest::Verify_StoreSharesIdenticalResponses,
+        base::Unretained(this)));
+
+    // The first two entries have identical headers and bodies. The third
+    // has the same body but different headers, so its digest differs.
+    group_ = new AppCacheGroup(
+        storage(), kManifestUrl, storage()->NewGroupId());
+    cache_ = new AppCache(storage(), storage()->NewCacheId());
+    cache_->AddEntry(kEntryUrl, AppCacheEntry(AppCacheEntry::EXPLICIT, 1,
+                                              kDefaultEntrySize));
+    cache_->AddEntry(kEntryUrl2, AppCacheEntry(AppCacheEntry::EXPLICIT, 2,
+                                               kDefaultEntrySize));
+    cache_->AddEntry(kEntryUrl3, AppCacheEntry(AppCacheEntry::EXPLICIT, 3,
+                                               kDefaultEntrySize));
+    cache_->SetResponseDigest(1, "digest");
+    cache_->SetResponseDigest(2, "digest");
+    cache_->SetResponseDigest(3, "other-headers-digest");
+
+    storage()->StoreGroupAndNewestCache(group_.get(), cache_.get(), delegate());
+    EXPECT_FALSE(delegate()->stored_group_success_);
+  }
+
+  void Verify_StoreSharesIdenticalResponses() {
+    EXPECT_TRUE(delegate()->stored_group_success_);
+    EXPECT_TRUE(cache_->response_digests().empty());
+
+    // The in-memory cache uses the shared response.
+    EXPECT_EQ(1, cache_->GetEntry(kEntryUrl)->response_id());
+    EXPECT_EQ(1, cache_->GetEntry(kEntryUrl2)->response_id());
+    EXPECT_EQ(3, cache_->GetEntry(kEntryUrl3)->response_id());
+
+    std::vector<AppCacheDatabase::EntryRecord> entry_records;
+    EXPECT_TRUE(database()->FindEntriesForCache(cache_->cache_id(),
+                                                &entry_records));
+    ASSERT_EQ(3U, entry_records.size());
+    for (size_t i = 0; i < entry_records.size(); ++i) {
+      if (entry_records[i].url == kEntryUrl3)
+        EXPECT_EQ(3, entry_records[i].response_id);
+      else
+        EXPECT_EQ(1, entry_records[i].response_id);
+    }
+
+    int64 response_id = kNoResponseId;
+    EXPECT_TRUE(database()->FindResponseIdForDigest(
+        "digest", kDefaultEntrySize, &response_id));
+    EXPECT_EQ(1, response_id);
+    EXPECT_TRUE(database()->FindResponseIdForDigest(
+        "other-headers-digest", kDefaultEntrySize, &response_id));
+    EXPECT_EQ(3, response_id);
+
+    TestFinished();
+  }
+
   // FailStoreGroup  --------------------------------------
 
   void FailStoreGroup() {
@@ -1555,6 +1613,10 @@ TEST_F(AppCacheStorageImplTest, StoreExistingGroupExistingCache) {
   RunTestOnIOThread(&AppCacheStorageImplTest::StoreExistingGroupExistingCache);
 }
 
+TEST_F(AppCacheStorageImplTest, StoreSharesIdenticalResponses) {
+  RunTestOnIOThread(&AppCacheStorageImplTest::StoreSharesIdenticalResponses);
+}
+
 TEST_F(AppCacheStorageImplTest, FailStoreGroup) {
   RunTestOnIOThread(&AppCacheStorageImplTest::FailStoreGroup);
 }
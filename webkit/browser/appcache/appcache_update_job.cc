@@ -4,12 +4,18 @@
 
 #include "webkit/browser/appcache/appcache_update_job.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/compiler_specific.h"
 #include "base/message_loop/message_loop.h"
+#include "base/pickle.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
+#include "crypto/secure_hash.h"
+#include "crypto/sha2.h"
 #include "net/base/io_buffer.h"
 #include "net/base/load_flags.h"
 #include "net/base/net_errors.h"
@@ -22,8 +28,23 @@
 namespace appcache {
 
 static const int kBufferSize = 32768;
-static const size_t kMaxConcurrentUrlFetches = 2;
+static const size_t kMaxConcurrentUrlFetches = 16;
+// Matches the per-host limit of the socket pools, so more fetches to one
+// host would only queue up in the network stack.
+static const size_t kMaxConcurrentUrlFetchesPerHost = 6;
+// How far into the queue of urls to fetch FetchUrls looks for one whose
+// host is not already saturated.
+static const size_t kMaxUrlFetchLookahead = 32;
 static const int kMax503Retries = 3;
+// The headers that are written to storage with a response, as persisted by
+// net::HttpResponseInfo when transient headers are skipped.
+static const net::HttpResponseHeaders::PersistOptions kStoredHeadersOptions =
+    net::HttpResponseHeaders::PERSIST_SANS_COOKIES |
+    net::HttpResponseHeaders::PERSIST_SANS_CHALLENGES |
+    net::HttpResponseHeaders::PERSIST_SANS_HOP_BY_HOP |
+    net::HttpResponseHeaders::PERSIST_SANS_NON_CACHEABLE |
+    net::HttpResponseHeaders::PERSIST_SANS_RANGES |
+    net::HttpResponseHeaders::PERSIST_SANS_SECURITY_STATE;
 
 // Helper class for collecting hosts per frontend when sending notifications
 // so that only one notification is sent for all hosts using the same frontend.
@@ -148,6 +169,16 @@ void AppCacheUpdateJob::URLFetcher::OnResponseStarted(
     // completion before reading any response data.
     if (fetch_type_ == URL_FETCH || fetch_type_ == MASTER_ENTRY_FETCH) {
       response_writer_.reset(job_->CreateResponseWriter());
+      response_hash_.reset(
+          crypto::SecureHash::Create(crypto::SecureHash::SHA256));
+      // Responses are only shared if they are served identically, so the
+      // digest covers the stored headers as well as the body.
+      if (request->response_headers()) {
+        Pickle headers_pickle;
+        request->response_headers()->Persist(&headers_pickle,
+                                             kStoredHeadersOptions);
+        response_hash_->Update(headers_pickle.data(), headers_pickle.size());
+      }
       scoped_refptr<HttpResponseInfoIOBuffer> io_buffer(
           new HttpResponseInfoIOBuffer(
               new net::HttpResponseInfo(request->response_info())));
@@ -242,6 +273,7 @@ bool AppCacheUpdateJob::URLFetcher::ConsumeResponseData(int bytes_read) {
     case URL_FETCH:
     case MASTER_ENTRY_FETCH:
       DCHECK(response_writer_.get());
+      response_hash_->Update(buffer_->data(), bytes_read);
       response_writer_->WriteData(
           buffer_.get(),
           bytes_read,
@@ -261,6 +293,12 @@ void AppCacheUpdateJob::URLFetcher::OnResponseCompleted() {
     return;
   }
 
+  if (response_hash_.get() && request_->status().is_success()) {
+    char digest[crypto::kSHA256Length];
+    response_hash_->Finish(digest, sizeof(digest));
+    response_digest_ = base::HexEncode(digest, sizeof(digest));
+  }
+
   switch (fetch_type_) {
     case MANIFEST_FETCH:
       job_->HandleManifestFetchCompleted(this);
@@ -549,8 +587,12 @@ void AppCacheUpdateJob::HandleUrlFetchCompleted(URLFetcher* fetcher) {
     DCHECK(fetcher->response_writer());
     entry.set_response_id(fetcher->response_writer()->response_id());
     entry.set_response_size(fetcher->response_writer()->amount_written());
-    if (!inprogress_cache_->AddOrModifyEntry(url, entry))
+    if (!inprogress_cache_->AddOrModifyEntry(url, entry)) {
       duplicate_response_ids_.push_back(entry.response_id());
+    } else if (!fetcher->response_digest().empty()) {
+      inprogress_cache_->SetResponseDigest(entry.response_id(),
+                                           fetcher->response_digest());
+    }
 
     // TODO(michaeln): Check for <html manifest=xxx>
     // See http://code.google.com/p/chromium/issues/detail?id=97930
@@ -629,10 +671,15 @@ void AppCacheUpdateJob::HandleMasterEntryFetchCompleted(
     AppCacheEntry master_entry(AppCacheEntry::MASTER,
                                fetcher->response_writer()->response_id(),
                                fetcher->response_writer()->amount_written());
-    if (cache->AddOrModifyEntry(url, master_entry))
+    if (cache->AddOrModifyEntry(url, master_entry)) {
       added_master_entries_.push_back(url);
-    else
+      if (!fetcher->response_digest().empty()) {
+        cache->SetResponseDigest(master_entry.response_id(),
+                                 fetcher->response_digest());
+      }
+    } else {
       duplicate_response_ids_.push_back(master_entry.response_id());
+    }
 
     // In no-update case, associate host with the newest cache.
     if (!inprogress_cache_.get()) {
@@ -937,11 +984,21 @@ void AppCacheUpdateJob::FetchUrls() {
 
   // Fetch each URL in the list according to section 6.9.4 step 17.1-17.3.
   // Fetch up to the concurrent limit. Other fetches will be triggered as each
-  // each fetch completes.
+  // each fetch completes. URLs on hosts that already have their share of
+  // fetches in flight are passed over in favor of those on other hosts.
   while (pending_url_fetches_.size() < kMaxConcurrentUrlFetches &&
          !urls_to_fetch_.empty()) {
-    UrlToFetch url_to_fetch = urls_to_fetch_.front();
-    urls_to_fetch_.pop_front();
+    size_t index = 0;
+    size_t lookahead = std::min(urls_to_fetch_.size(), kMaxUrlFetchLookahead);
+    while (index < lookahead &&
+           CountPendingUrlFetchesForHost(urls_to_fetch_[index].url.host()) >=
+               kMaxConcurrentUrlFetchesPerHost) {
+      ++index;
+    }
+    if (index == lookahead)
+      return;  // continues when a fetch completes
+    UrlToFetch url_to_fetch = urls_to_fetch_[index];
+    urls_to_fetch_.erase(urls_to_fetch_.begin() + index);
 
     AppCache::EntryMap::iterator it = url_file_list_.find(url_to_fetch.url);
     DCHECK(it != url_file_list_.end());
@@ -977,6 +1034,17 @@ void AppCacheUpdateJob::FetchUrls() {
   }
 }
 
+size_t AppCacheUpdateJob::CountPendingUrlFetchesForHost(
+    const std::string& host) const {
+  size_t count = 0;
+  for (PendingUrlFetches::const_iterator it = pending_url_fetches_.begin();
+       it != pending_url_fetches_.end(); ++it) {
+    if (it->first.host() == host)
+      ++count;
+  }
+  return count;
+}
+
 void AppCacheUpdateJob::CancelAllUrlFetches() {
   // Cancel any pending URL requests.
   for (PendingUrlFetches::iterator it = pending_url_fetches_.begin();
@@ -13,6 +13,7 @@
 
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
 #include "net/base/completion_callback.h"
 #include "net/http/http_response_headers.h"
 #include "net/url_request/url_request.h"
@@ -24,6 +25,10 @@
 #include "webkit/browser/webkit_storage_browser_export.h"
 #include "webkit/common/appcache/appcache_interfaces.h"
 
+namespace crypto {
+class SecureHash;
+}
+
 namespace appcache {
 
 class HostNotifier;
@@ -110,6 +115,9 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCacheUpdateJob
     AppCacheResponseWriter* response_writer() const {
       return response_writer_.get();
     }
+    // Hex encoded SHA-256 of the response headers and body written to
+    // storage, empty until the fetch has completed successfully.
+    const std::string& response_digest() const { return response_digest_; }
     void set_existing_response_headers(net::HttpResponseHeaders* headers) {
       existing_response_headers_ = headers;
     }
@@ -143,6 +151,8 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCacheUpdateJob
     scoped_refptr<net::HttpResponseHeaders> existing_response_headers_;
     std::string manifest_data_;
     scoped_ptr<AppCacheResponseWriter> response_writer_;
+    scoped_ptr<crypto::SecureHash> response_hash_;
+    std::string response_digest_;
   };  // class URLFetcher
 
   AppCacheResponseWriter* CreateResponseWriter();
@@ -192,6 +202,7 @@ class WEBKIT_STORAGE_BROWSER_EXPORT AppCacheUpdateJob
   void BuildUrlFileList(const Manifest& manifest);
   void AddUrlToFileList(const GURL& url, int type);
   void FetchUrls();
+  size_t CountPendingUrlFetchesForHost(const std::string& host) const;
   void CancelAllUrlFetches();
   bool ShouldSkipUrlFetch(const AppCacheEntry& entry);
 
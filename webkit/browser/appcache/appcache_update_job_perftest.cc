@@ -0,0 +1,220 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <set>
+#include <string>
+
+#include "base/bind.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "net/url_request/url_request_context.h"
+#include "net/url_request/url_request_job_factory_impl.h"
+#include "net/url_request/url_request_test_job.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/browser/appcache/appcache.h"
+#include "webkit/browser/appcache/appcache_group.h"
+#include "webkit/browser/appcache/appcache_service.h"
+#include "webkit/browser/appcache/appcache_storage.h"
+
+namespace appcache {
+
+namespace {
+
+// Simulated round trip time of every request.
+const int kLatencyMs = 20;
+
+// Resources are spread over this many hosts.
+const int kNumHosts = 4;
+
+const int kResourceSize = 16 * 1024;
+
+const char kManifestHeaders[] =
+    "HTTP/1.1 200 OK\0"
+    "Content-type: text/cache-manifest\0"
+    "\0";
+
+const char kResourceHeaders[] =
+    "HTTP/1.1 200 OK\0"
+    "Content-type: text/plain\0"
+    "\0";
+
+std::string HostUrl(int host) {
+  return base::StringPrintf("http://host%d.perf/", host);
+}
+
+// Answers after |kLatencyMs|, like a server on the other side of a network.
+class DelayedJob : public net::URLRequestTestJob {
+ public:
+  DelayedJob(net::URLRequest* request,
+             net::NetworkDelegate* network_delegate,
+             const std::string& headers,
+             const std::string& body)
+      : net::URLRequestTestJob(request, network_delegate, headers, body,
+                               true),
+        weak_factory_(this) {}
+
+ protected:
+  virtual ~DelayedJob() {}
+
+  virtual void StartAsync() OVERRIDE {
+    base::MessageLoop::current()->PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&DelayedJob::StartNow, weak_factory_.GetWeakPtr()),
+        base::TimeDelta::FromMilliseconds(kLatencyMs));
+  }
+
+ private:
+  void StartNow() {
+    net::URLRequestTestJob::StartAsync();
+  }
+
+  base::WeakPtrFactory<DelayedJob> weak_factory_;
+};
+
+// Serves a manifest listing |num_resources| resources of which only
+// |num_distinct| have distinct contents.
+class ManifestServer : public net::URLRequestJobFactory::ProtocolHandler {
+ public:
+  ManifestServer(int num_resources, int num_distinct)
+      : num_resources_(num_resources),
+        num_distinct_(num_distinct) {}
+
+  virtual net::URLRequestJob* MaybeCreateJob(
+      net::URLRequest* request,
+      net::NetworkDelegate* network_delegate) const OVERRIDE {
+    const std::string path = request->url().path();
+    if (path == "/manifest") {
+      std::string manifest("CACHE MANIFEST\n");
+      for (int i = 0; i < num_resources_; ++i) {
+        manifest += HostUrl(i % kNumHosts);
+        manifest += base::StringPrintf("resource%d\n", i);
+      }
+      return new DelayedJob(
+          request, network_delegate,
+          std::string(kManifestHeaders, arraysize(kManifestHeaders)),
+          manifest);
+    }
+
+    int index = 0;
+    EXPECT_TRUE(base::StringToInt(path.substr(strlen("/resource")), &index));
+    std::string body(base::IntToString(index % num_distinct_));
+    body.resize(kResourceSize, ' ');
+    return new DelayedJob(
+        request, network_delegate,
+        std::string(kResourceHeaders, arraysize(kResourceHeaders)),
+        body);
+  }
+
+ private:
+  const int num_resources_;
+  const int num_distinct_;
+};
+
+class QuitOnUpdateComplete : public AppCacheGroup::UpdateObserver {
+ public:
+  virtual void OnUpdateComplete(AppCacheGroup* group) OVERRIDE {
+    base::MessageLoop::current()->Quit();
+  }
+};
+
+void FlushThread(base::Thread* thread) {
+  base::WaitableEvent done(false, false);
+  thread->message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&base::WaitableEvent::Signal, base::Unretained(&done)));
+  done.Wait();
+}
+
+}  // namespace
+
+class AppCacheUpdateJobPerfTest : public testing::Test {
+ public:
+  AppCacheUpdateJobPerfTest()
+      : message_loop_(base::MessageLoop::TYPE_IO),
+        db_thread_("AppCacheUpdateJobPerfTest db"),
+        cache_thread_("AppCacheUpdateJobPerfTest cache") {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    ASSERT_TRUE(db_thread_.Start());
+    base::Thread::Options options(base::MessageLoop::TYPE_IO, 0);
+    ASSERT_TRUE(cache_thread_.StartWithOptions(options));
+  }
+
+  // Runs the initial update of a group whose manifest lists
+  // |num_resources| resources, |num_distinct| of them distinct, and logs
+  // the time taken and the number of responses kept in storage.
+  void RunUpdate(const char* name, int num_resources, int num_distinct) {
+    net::URLRequestJobFactoryImpl job_factory;
+    job_factory.SetProtocolHandler(
+        "http", new ManifestServer(num_resources, num_distinct));
+    net::URLRequestContext context;
+    context.set_job_factory(&job_factory);
+
+    scoped_ptr<AppCacheService> service(new AppCacheService(NULL));
+    service->set_request_context(&context);
+    service->Initialize(temp_dir_.path().AppendASCII(name),
+                        db_thread_.message_loop_proxy().get(),
+                        cache_thread_.message_loop_proxy().get());
+    FlushThread(&db_thread_);
+    message_loop_.RunUntilIdle();
+
+    QuitOnUpdateComplete observer;
+    scoped_refptr<AppCacheGroup> group(new AppCacheGroup(
+        service->storage(), GURL(HostUrl(0) + "manifest"),
+        service->storage()->NewGroupId()));
+    group->AddUpdateObserver(&observer);
+
+    PerfTimer timer;
+    group->StartUpdate();
+    message_loop_.Run();
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    AppCache* cache = group->newest_complete_cache();
+    ASSERT_TRUE(cache);
+    std::set<int64> response_ids;
+    for (AppCache::EntryMap::const_iterator iter = cache->entries().begin();
+         iter != cache->entries().end(); ++iter) {
+      response_ids.insert(iter->second.response_id());
+    }
+    // Every distinct resource plus the manifest.
+    EXPECT_EQ(static_cast<size_t>(num_distinct + 1), response_ids.size());
+
+    group->RemoveUpdateObserver(&observer);
+    group = NULL;
+    service.reset();
+    FlushThread(&db_thread_);
+    FlushThread(&cache_thread_);
+    message_loop_.RunUntilIdle();
+
+    LogPerfResult(base::StringPrintf("%s_update_time", name).c_str(),
+                  elapsed.InMillisecondsF(), "ms");
+    LogPerfResult(base::StringPrintf("%s_stored_responses", name).c_str(),
+                  response_ids.size(), "responses");
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::Thread db_thread_;
+  base::Thread cache_thread_;
+  base::ScopedTempDir temp_dir_;
+};
+
+TEST_F(AppCacheUpdateJobPerfTest, LargeManifest) {
+  RunUpdate("AppCacheUpdateJob_500_distinct", 500, 500);
+}
+
+TEST_F(AppCacheUpdateJobPerfTest, LargeManifestWithDuplicates) {
+  RunUpdate("AppCacheUpdateJob_500_of_50_distinct", 500, 50);
+}
+
+}  // namespace appcache
@@ -5,6 +5,7 @@
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/threading/thread.h"
 #include "net/base/net_errors.h"
@@ -89,6 +90,10 @@ class MockHttpServer {
         "HTTP/1.1 200 OK\0"
         "Cache-Control: no-store\0"
         "\0";
+    const char text_headers[] =
+        "HTTP/1.1 200 OK\0"
+        "Content-type: text/plain\0"
+        "\0";
 
     if (path == "/files/missing-mime-manifest") {
       (*headers) = std::string(ok_headers, arraysize(ok_headers));
@@ -165,6 +170,18 @@ class MockHttpServer {
       (*body) = "CACHE MANIFEST\n"
                 "CHROMIUM-INTERCEPT:\n"
                 "intercept1 return intercept1a\n";
+    } else if (path == "/files/manifest-same-bodies") {
+      (*headers) = std::string(manifest_headers, arraysize(manifest_headers));
+      (*body) = "CACHE MANIFEST\n"
+                "same-body1\n"
+                "same-body2\n"
+                "same-body-text\n";
+    } else if (path == "/files/same-body1" || path == "/files/same-body2") {
+      (*headers) = std::string(ok_headers, arraysize(ok_headers));
+      (*body) = "same body";
+    } else if (path == "/files/same-body-text") {
+      (*headers) = std::string(text_headers, arraysize(text_headers));
+      (*body) = "same body";
     } else if (path == "/files/notmodified") {
       (*headers) = std::string(not_modified_headers,
                                arraysize(not_modified_headers));
@@ -1128,6 +1145,76 @@ class AppCacheUpdateJobTest : public testing::Test,
     WaitForUpdateToFinish();
   }
 
+  void ResponseDigestsTest() {
+    // Responses with the same body only get the same digest if their
+    // headers match too.
+    ASSERT_EQ(base::MessageLoop::TYPE_IO, base::MessageLoop::current()->type());
+    GURL manifest_url =
+        MockHttpServer::GetMockUrl("files/manifest-same-bodies");
+    MakeService();
+    group_ = new AppCacheGroup(
+        service_->storage(), manifest_url,
+        service_->storage()->NewGroupId());
+    AppCacheUpdateJob* update =
+        new AppCacheUpdateJob(service_.get(), group_.get());
+    group_->update_job_ = update;
+
+    MockFrontend* frontend = MakeMockFrontend();
+    AppCacheHost* host = MakeHost(1, frontend);
+    update->StartUpdate(host, GURL());
+
+    // Set up checks for when update job finishes.
+    do_checks_after_update_finished_ = true;
+    expect_group_obsolete_ = false;
+    expect_group_has_cache_ = true;
+    tested_manifest_ = MANIFEST_SAME_BODIES;
+    frontend->AddExpectedEvent(MockFrontend::HostIds(1, host->host_id()),
+                               CHECKING_EVENT);
+
+    WaitForUpdateToFinish();
+  }
+
+  void FetchUrlsPerHostLimitTest() {
+    ASSERT_EQ(base::MessageLoop::TYPE_IO, base::MessageLoop::current()->type());
+
+    MakeService();
+    group_ = new AppCacheGroup(
+        service_->storage(), MockHttpServer::GetMockUrl("files/manifest1"),
+        service_->storage()->NewGroupId());
+    AppCacheUpdateJob* update =
+        new AppCacheUpdateJob(service_.get(), group_.get());
+    group_->update_job_ = update;
+
+    // Pretend update job has parsed a manifest listing ten urls on one host
+    // followed by two on another.
+    group_->update_status_ = AppCacheGroup::DOWNLOADING;
+    update->internal_state_ = AppCacheUpdateJob::DOWNLOADING;
+    update->inprogress_cache_ =
+        new AppCache(service_->storage(), service_->storage()->NewCacheId());
+    for (int i = 0; i < 10; ++i) {
+      update->AddUrlToFileList(
+          MockHttpServer::GetMockUrl(base::StringPrintf("files/explicit%d", i)),
+          AppCacheEntry::EXPLICIT);
+    }
+    update->AddUrlToFileList(GURL("http://cross_origin_host/files/explicit1"),
+                             AppCacheEntry::EXPLICIT);
+    update->AddUrlToFileList(GURL("http://cross_origin_host/files/explicit2"),
+                             AppCacheEntry::EXPLICIT);
+
+    // Only six fetches, kMaxConcurrentUrlFetchesPerHost, go to the first
+    // host. The urls on the other host are fetched from further back in the
+    // queue.
+    update->FetchUrls();
+    EXPECT_EQ(6u, update->CountPendingUrlFetchesForHost("mockhost"));
+    EXPECT_EQ(2u, update->CountPendingUrlFetchesForHost("cross_origin_host"));
+    EXPECT_EQ(8u, update->pending_url_fetches_.size());
+    EXPECT_EQ(4u, update->urls_to_fetch_.size());
+
+    // Abort as we're not testing the completion of the fetches.
+    delete update;
+    UpdateFinished();
+  }
+
   void BasicUpgradeSuccessTest() {
     ASSERT_EQ(base::MessageLoop::TYPE_IO, base::MessageLoop::current()->type());
 
@@ -3210,6 +3297,9 @@ class AppCacheUpdateJobTest : public testing::Test,
         case MANIFEST_WITH_INTERCEPT:
           VerifyManifestWithIntercept(cache);
           break;
+        case MANIFEST_SAME_BODIES:
+          VerifyManifestSameBodies(cache);
+          break;
         case NONE:
         default:
           break;
@@ -3354,6 +3444,29 @@ class AppCacheUpdateJobTest : public testing::Test,
     EXPECT_TRUE(cache->update_time_ > base::Time());
   }
 
+  void VerifyManifestSameBodies(AppCache* cache) {
+    EXPECT_EQ(4u, cache->entries().size());
+    AppCacheEntry* entry1 =
+        cache->GetEntry(MockHttpServer::GetMockUrl("files/same-body1"));
+    AppCacheEntry* entry2 =
+        cache->GetEntry(MockHttpServer::GetMockUrl("files/same-body2"));
+    AppCacheEntry* text_entry =
+        cache->GetEntry(MockHttpServer::GetMockUrl("files/same-body-text"));
+    ASSERT_TRUE(entry1);
+    ASSERT_TRUE(entry2);
+    ASSERT_TRUE(text_entry);
+    EXPECT_EQ(entry1->response_size(), text_entry->response_size());
+
+    const AppCache::ResponseDigestMap& digests = cache->response_digests();
+    ASSERT_EQ(1u, digests.count(entry1->response_id()));
+    ASSERT_EQ(1u, digests.count(entry2->response_id()));
+    ASSERT_EQ(1u, digests.count(text_entry->response_id()));
+    EXPECT_EQ(digests.find(entry1->response_id())->second,
+              digests.find(entry2->response_id())->second);
+    EXPECT_NE(digests.find(entry1->response_id())->second,
+              digests.find(text_entry->response_id())->second);
+  }
+
   void VerifyManifestWithIntercept(AppCache* cache) {
     EXPECT_EQ(2u, cache->entries().size());
     const char* kManifestPath = "files/manifest-with-intercept";
@@ -3378,7 +3491,8 @@ class AppCacheUpdateJobTest : public testing::Test,
     EMPTY_MANIFEST,
     EMPTY_FILE_MANIFEST,
     PENDING_MASTER_NO_UPDATE,
-    MANIFEST_WITH_INTERCEPT
+    MANIFEST_WITH_INTERCEPT,
+    MANIFEST_SAME_BODIES
   };
 
   scoped_ptr<IOThread> io_thread_;
@@ -3531,6 +3645,14 @@ TEST_F(AppCacheUpdateJobTest, DownloadInterceptEntriesTest) {
   RunTestOnIOThread(&AppCacheUpdateJobTest::DownloadInterceptEntriesTest);
 }
 
+TEST_F(AppCacheUpdateJobTest, ResponseDigests) {
+  RunTestOnIOThread(&AppCacheUpdateJobTest::ResponseDigestsTest);
+}
+
+TEST_F(AppCacheUpdateJobTest, FetchUrlsPerHostLimit) {
+  RunTestOnIOThread(&AppCacheUpdateJobTest::FetchUrlsPerHostLimitTest);
+}
+
 TEST_F(AppCacheUpdateJobTest, BasicUpgradeSuccess) {
   RunTestOnIOThread(&AppCacheUpdateJobTest::BasicUpgradeSuccessTest);
 }
@@ -32,6 +32,12 @@ namespace webkit_blob {
 
 namespace {
 
+// Size of the buffer each file item is read ahead into.
+const int kReadAheadBufferSize = 64 * 1024;
+
+// Number of file items, including the current one, that are read ahead.
+const int kMaxReadAheadItems = 2;
+
 bool IsFileType(BlobData::Item::Type type) {
   switch (type) {
     case BlobData::Item::TYPE_FILE:
@@ -44,6 +50,26 @@ bool IsFileType(BlobData::Item::Type type) {
 
 }  // namespace
 
+// Data read from a file item's reader before the consumer asked for it. The
+// reader's position always equals the item's read offset plus the bytes
+// still available here, so reads can resume on the reader once it drains.
+struct BlobURLRequestJob::ReadAhead {
+  ReadAhead()
+      : buffer(new net::IOBufferWithSize(kReadAheadBufferSize)),
+        pending(false),
+        result(0),
+        consumed(0) {}
+
+  int BytesAvailable() const { return result > 0 ? result - consumed : 0; }
+
+  scoped_refptr<net::IOBufferWithSize> buffer;
+  bool pending;
+
+  // Bytes read into |buffer|, or a net error code.
+  int result;
+  int consumed;
+};
+
 BlobURLRequestJob::BlobURLRequestJob(
     net::URLRequest* request,
     net::NetworkDelegate* network_delegate,
@@ -60,6 +86,7 @@ BlobURLRequestJob::BlobURLRequestJob(
       pending_get_file_info_count_(0),
       current_item_index_(0),
       current_item_offset_(0),
+      waiting_for_read_ahead_(false),
       error_(false),
       byte_range_set_(false) {
   DCHECK(file_thread_proxy_.get());
@@ -150,6 +177,7 @@ void BlobURLRequestJob::SetExtraRequestHeaders(
 
 BlobURLRequestJob::~BlobURLRequestJob() {
   STLDeleteValues(&index_to_reader_);
+  STLDeleteValues(&index_to_read_ahead_);
 }
 
 void BlobURLRequestJob::DidStart() {
@@ -374,6 +402,33 @@ bool BlobURLRequestJob::ReadFileItem(FileStreamReader* reader,
                                      int bytes_to_read) {
   DCHECK_GE(read_buf_->BytesRemaining(), bytes_to_read);
   DCHECK(reader);
+
+  IndexToReadAheadMap::iterator found =
+      index_to_read_ahead_.find(current_item_index_);
+  if (found != index_to_read_ahead_.end()) {
+    ReadAhead* read_ahead = found->second;
+    if (read_ahead->pending) {
+      // The reader is busy; pick the data up once the read ahead lands.
+      waiting_for_read_ahead_ = true;
+      SetStatus(net::URLRequestStatus(net::URLRequestStatus::IO_PENDING, 0));
+      return false;
+    }
+    if (read_ahead->result < 0) {
+      NotifyFailure(read_ahead->result);
+      return false;
+    }
+    if (read_ahead->BytesAvailable() > 0) {
+      int bytes_copied = std::min(bytes_to_read,
+                                  read_ahead->BytesAvailable());
+      memcpy(read_buf_->data(),
+             read_ahead->buffer->data() + read_ahead->consumed,
+             bytes_copied);
+      read_ahead->consumed += bytes_copied;
+      AdvanceBytesRead(bytes_copied);
+      return true;
+    }
+  }
+
   const int result = reader->Read(
       read_buf_.get(),
       bytes_to_read,
@@ -405,6 +460,7 @@ void BlobURLRequestJob::DidReadFile(int result) {
   // If the read buffer is completely filled, we're done.
   if (!read_buf_->BytesRemaining()) {
     int bytes_read = BytesReadCompleted();
+    ReadAheadFileItems();
     NotifyReadComplete(bytes_read);
     return;
   }
@@ -421,6 +477,86 @@ void BlobURLRequestJob::DeleteCurrentFileReader() {
     delete found->second;
     index_to_reader_.erase(found);
   }
+
+  IndexToReadAheadMap::iterator read_ahead =
+      index_to_read_ahead_.find(current_item_index_);
+  if (read_ahead != index_to_read_ahead_.end()) {
+    delete read_ahead->second;
+    index_to_read_ahead_.erase(read_ahead);
+  }
+}
+
+void BlobURLRequestJob::ReadAheadFileItems() {
+  if (error_)
+    return;
+
+  int64 bytes_left = remaining_bytes_;
+  int file_items = 0;
+  for (size_t index = current_item_index_;
+       index < blob_data_->items().size() && bytes_left > 0 &&
+           file_items < kMaxReadAheadItems;
+       ++index) {
+    int64 item_offset = index == current_item_index_ ? current_item_offset_ : 0;
+    int64 item_bytes =
+        std::min(item_length_list_[index] - item_offset, bytes_left);
+    bytes_left -= item_bytes;
+    if (!IsFileType(blob_data_->items().at(index).type()))
+      continue;
+    ++file_items;
+    ReadAheadFileItem(index, item_bytes);
+  }
+}
+
+void BlobURLRequestJob::ReadAheadFileItem(size_t index, int64 item_bytes) {
+  if (item_bytes <= 0)
+    return;
+
+  ReadAhead*& read_ahead = index_to_read_ahead_[index];
+  if (!read_ahead)
+    read_ahead = new ReadAhead();
+
+  // Only one read may be outstanding on a reader, and data already read
+  // ahead must be consumed first.
+  if (read_ahead->pending || read_ahead->result < 0 ||
+      read_ahead->BytesAvailable() > 0) {
+    return;
+  }
+
+  int bytes_to_read = static_cast<int>(
+      std::min(item_bytes, static_cast<int64>(kReadAheadBufferSize)));
+  read_ahead->pending = true;
+  read_ahead->result = 0;
+  read_ahead->consumed = 0;
+  const int result = GetFileStreamReader(index)->Read(
+      read_ahead->buffer.get(),
+      bytes_to_read,
+      base::Bind(&BlobURLRequestJob::DidReadAhead,
+                 weak_factory_.GetWeakPtr(), index));
+  if (result != net::ERR_IO_PENDING) {
+    read_ahead->pending = false;
+    read_ahead->result = result > 0 ? result : net::ERR_FAILED;
+  }
+}
+
+void BlobURLRequestJob::DidReadAhead(size_t index, int result) {
+  IndexToReadAheadMap::iterator found = index_to_read_ahead_.find(index);
+  if (found == index_to_read_ahead_.end())
+    return;
+
+  // As in DidReadFile(), the item's length is known up front, so hitting
+  // the end of the file early is reported as a failure.
+  ReadAhead* read_ahead = found->second;
+  read_ahead->pending = false;
+  read_ahead->result = result > 0 ? result : net::ERR_FAILED;
+
+  if (!waiting_for_read_ahead_ || index != current_item_index_)
+    return;
+  waiting_for_read_ahead_ = false;
+  SetStatus(net::URLRequestStatus());  // Clear the IO_PENDING status
+
+  int bytes_read = 0;
+  if (ReadLoop(&bytes_read))
+    NotifyReadComplete(bytes_read);
 }
 
 int BlobURLRequestJob::BytesReadCompleted() {
@@ -452,6 +588,7 @@ bool BlobURLRequestJob::ReadLoop(int* bytes_read) {
   }
 
   *bytes_read = BytesReadCompleted();
+  ReadAheadFileItems();
   return true;
 }
 
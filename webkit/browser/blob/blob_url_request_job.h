@@ -60,7 +60,9 @@ class WEBKIT_STORAGE_BROWSER_EXPORT BlobURLRequestJob
   virtual ~BlobURLRequestJob();
 
  private:
+  struct ReadAhead;
   typedef std::map<size_t, FileStreamReader*> IndexToReaderMap;
+  typedef std::map<size_t, ReadAhead*> IndexToReadAheadMap;
 
   // For preparing for read: get the size, apply the range and perform seek.
   void DidStart();
@@ -81,6 +83,13 @@ class WEBKIT_STORAGE_BROWSER_EXPORT BlobURLRequestJob
   void DidReadFile(int result);
   void DeleteCurrentFileReader();
 
+  // For reading file items ahead of the consumer: while the current item
+  // drains, the next chunk of it and of the following file items is read
+  // into memory so that the next ReadRawData() does not wait on the disk.
+  void ReadAheadFileItems();
+  void ReadAheadFileItem(size_t index, int64 item_bytes);
+  void DidReadAhead(size_t index, int result);
+
   int ComputeBytesToRead() const;
   int BytesReadCompleted();
 
@@ -109,12 +118,17 @@ class WEBKIT_STORAGE_BROWSER_EXPORT BlobURLRequestJob
   int64 remaining_bytes_;
   int pending_get_file_info_count_;
   IndexToReaderMap index_to_reader_;
+  IndexToReadAheadMap index_to_read_ahead_;
   size_t current_item_index_;
   int64 current_item_offset_;
 
   // Holds the buffer for read data with the IOBuffer interface.
   scoped_refptr<net::DrainableIOBuffer> read_buf_;
 
+  // Is set while ReadRawData() is waiting for a read ahead of the current
+  // item to complete.
+  bool waiting_for_read_ahead_;
+
   // Is set when NotifyFailure() is called and reset when DidStart is called.
   bool error_;
 
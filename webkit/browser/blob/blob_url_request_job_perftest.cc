@@ -0,0 +1,173 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/file_util.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_loop_proxy.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread.h"
+#include "net/base/io_buffer.h"
+#include "net/url_request/url_request.h"
+#include "net/url_request/url_request_context.h"
+#include "net/url_request/url_request_job_factory_impl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/browser/blob/blob_url_request_job.h"
+#include "webkit/common/blob/blob_data.h"
+
+namespace webkit_blob {
+
+namespace {
+
+// Matches the read size used by AsyncResourceHandler.
+const int kReadBufferSize = 32 * 1024;
+
+// Drains the response in |kReadBufferSize| reads, counting the bytes.
+class DrainingDelegate : public net::URLRequest::Delegate {
+ public:
+  DrainingDelegate()
+      : buffer_(new net::IOBuffer(kReadBufferSize)),
+        bytes_received_(0) {}
+
+  virtual void OnResponseStarted(net::URLRequest* request) OVERRIDE {
+    if (!request->status().is_success()) {
+      base::MessageLoop::current()->Quit();
+      return;
+    }
+    ReadSome(request);
+  }
+
+  virtual void OnReadCompleted(net::URLRequest* request,
+                               int bytes_read) OVERRIDE {
+    if (bytes_read <= 0) {
+      base::MessageLoop::current()->Quit();
+      return;
+    }
+    bytes_received_ += bytes_read;
+    ReadSome(request);
+  }
+
+  int64 bytes_received() const { return bytes_received_; }
+
+ private:
+  void ReadSome(net::URLRequest* request) {
+    int bytes_read = 0;
+    while (request->Read(buffer_.get(), kReadBufferSize, &bytes_read)) {
+      if (bytes_read <= 0) {
+        base::MessageLoop::current()->Quit();
+        return;
+      }
+      bytes_received_ += bytes_read;
+    }
+    if (!request->status().is_io_pending())
+      base::MessageLoop::current()->Quit();
+  }
+
+  scoped_refptr<net::IOBuffer> buffer_;
+  int64 bytes_received_;
+
+  DISALLOW_COPY_AND_ASSIGN(DrainingDelegate);
+};
+
+class BlobProtocolHandler : public net::URLRequestJobFactory::ProtocolHandler {
+ public:
+  BlobProtocolHandler(BlobData* blob_data,
+                      base::MessageLoopProxy* file_thread_proxy)
+      : blob_data_(blob_data),
+        file_thread_proxy_(file_thread_proxy) {}
+
+  virtual net::URLRequestJob* MaybeCreateJob(
+      net::URLRequest* request,
+      net::NetworkDelegate* network_delegate) const OVERRIDE {
+    return new BlobURLRequestJob(request, network_delegate, blob_data_.get(),
+                                 NULL, file_thread_proxy_.get());
+  }
+
+ private:
+  scoped_refptr<BlobData> blob_data_;
+  scoped_refptr<base::MessageLoopProxy> file_thread_proxy_;
+};
+
+}  // namespace
+
+class BlobURLRequestJobPerfTest : public testing::Test {
+ public:
+  BlobURLRequestJobPerfTest()
+      : message_loop_(base::MessageLoop::TYPE_IO),
+        file_thread_("BlobURLRequestJobPerfTest file") {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    ASSERT_TRUE(file_thread_.Start());
+  }
+
+  // Builds a blob of |num_files| files of |file_size| bytes, each preceded by
+  // a small bytes item, reads it back through a blob: URL request and logs
+  // the throughput.
+  void RunRead(const char* name, int num_files, int file_size) {
+    scoped_refptr<BlobData> blob_data(new BlobData());
+    const std::string header(1024, 'h');
+    const std::string contents(file_size, 'x');
+    int64 total_bytes = 0;
+    for (int i = 0; i < num_files; ++i) {
+      base::FilePath path = temp_dir_.path().AppendASCII(
+          base::StringPrintf("%s_%d.dat", name, i));
+      ASSERT_EQ(file_size, file_util::WriteFile(path, contents.data(),
+                                                contents.size()));
+      blob_data->AppendData(header);
+      blob_data->AppendFile(path, 0, -1, base::Time());
+      total_bytes += header.size() + file_size;
+    }
+
+    net::URLRequestJobFactoryImpl job_factory;
+    job_factory.SetProtocolHandler(
+        "blob", new BlobProtocolHandler(blob_data.get(),
+                                        file_thread_.message_loop_proxy()));
+    net::URLRequestContext context;
+    context.set_job_factory(&job_factory);
+
+    DrainingDelegate delegate;
+    scoped_ptr<net::URLRequest> request(
+        context.CreateRequest(GURL("blob:perf"), &delegate));
+
+    PerfTimer timer;
+    request->Start();
+    message_loop_.Run();
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    EXPECT_TRUE(request->status().is_success());
+    EXPECT_EQ(total_bytes, delegate.bytes_received());
+    request.reset();
+    message_loop_.RunUntilIdle();
+
+    double megabytes = static_cast<double>(total_bytes) / (1024 * 1024);
+    LogPerfResult(base::StringPrintf("%s_throughput", name).c_str(),
+                  megabytes / elapsed.InSecondsF(), "MB/s");
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::Thread file_thread_;
+  base::ScopedTempDir temp_dir_;
+};
+
+TEST_F(BlobURLRequestJobPerfTest, SingleLargeFile) {
+  RunRead("BlobURLRequestJob_1x64MB", 1, 64 * 1024 * 1024);
+}
+
+TEST_F(BlobURLRequestJobPerfTest, ManyMediumFiles) {
+  RunRead("BlobURLRequestJob_32x2MB", 32, 2 * 1024 * 1024);
+}
+
+TEST_F(BlobURLRequestJobPerfTest, ManySmallFiles) {
+  RunRead("BlobURLRequestJob_512x16KB", 512, 16 * 1024);
+}
+
+}  // namespace webkit_blob
@@ -9,6 +9,7 @@
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
 #include "base/time/time.h"
 #include "net/base/io_buffer.h"
 #include "net/http/http_request_headers.h"
@@ -335,6 +336,49 @@ TEST_F(BlobURLRequestJobTest, TestGetLargeFileRequest) {
   TestSuccessRequest(large_data);
 }
 
+TEST_F(BlobURLRequestJobTest, TestGetMultipleLargeFilesRequest) {
+  // Each file is larger than the read ahead buffer, so reads alternate
+  // between data read ahead and direct reads across several items.
+  const int kFileSize = 150 * 1024;
+  const int kNumFiles = 3;
+  std::string expected;
+  for (int i = 0; i < kNumFiles; ++i) {
+    base::FilePath path = temp_dir_.path().AppendASCII(
+        base::StringPrintf("LargeBlob%d.dat", i));
+    std::string data;
+    data.reserve(kFileSize);
+    for (int j = 0; j < kFileSize; ++j)
+      data.append(1, static_cast<char>((i * 7 + j) % 256));
+    ASSERT_EQ(kFileSize,
+              file_util::WriteFile(path, data.data(), data.size()));
+    blob_data_->AppendData(kTestData1);
+    blob_data_->AppendFile(path, 0, -1, base::Time());
+    expected += kTestData1;
+    expected += data;
+  }
+  TestSuccessRequest(expected);
+}
+
+TEST_F(BlobURLRequestJobTest, TestGetRangeOfMultipleLargeFilesRequest) {
+  const int kFileSize = 100 * 1024;
+  std::string expected;
+  for (int i = 0; i < 2; ++i) {
+    base::FilePath path = temp_dir_.path().AppendASCII(
+        base::StringPrintf("LargeBlob%d.dat", i));
+    std::string data(kFileSize, static_cast<char>('a' + i));
+    ASSERT_EQ(kFileSize,
+              file_util::WriteFile(path, data.data(), data.size()));
+    blob_data_->AppendFile(path, 0, -1, base::Time());
+    expected += data;
+  }
+  net::HttpRequestHeaders extra_headers;
+  extra_headers.SetHeader(net::HttpRequestHeaders::kRange,
+                          "bytes=1000-150000");
+  expected_status_code_ = 206;
+  expected_response_ = expected.substr(1000, 150000 - 1000 + 1);
+  TestRequest("GET", extra_headers);
+}
+
 TEST_F(BlobURLRequestJobTest, TestGetNonExistentFileRequest) {
   base::FilePath non_existent_file =
       temp_file1_.InsertBeforeExtension(FILE_PATH_LITERAL("-na"));
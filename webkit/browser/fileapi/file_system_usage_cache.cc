@@ -4,7 +4,9 @@
 
 #include "webkit/browser/fileapi/file_system_usage_cache.h"
 
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/debug/trace_event.h"
@@ -19,8 +21,18 @@ namespace fileapi {
 namespace {
 const int64 kCloseDelaySeconds = 5;
 const size_t kMaxHandleCacheSize = 2;
+
+// A journal larger than this is treated as corrupted; it only ever holds the
+// entries with updates in progress.
+const int64 kMaxJournalSize = 1024 * 1024;
 }  // namespace
 
+FileSystemUsageCache::JournalEntry::JournalEntry()
+    : update_count(0),
+      initial_usage(0),
+      applied_delta(0) {
+}
+
 FileSystemUsageCache::FileSystemUsageCache(
     base::SequencedTaskRunner* task_runner)
     : weak_factory_(this),
@@ -143,7 +155,104 @@ bool FileSystemUsageCache::UpdateUsage(const base::FilePath& usage_file_path,
                                        int64 fs_usage) {
   TRACE_EVENT0("FileSystem", "UsageCache::UpdateUsage");
   DCHECK(CalledOnValidThread());
-  return Write(usage_file_path, true, 0, fs_usage);
+  return WriteWithJournal(usage_file_path, true, 0, fs_usage, Journal());
+}
+
+bool FileSystemUsageCache::StartJournaledUpdate(
+    const base::FilePath& usage_file_path,
+    const base::FilePath& entry_path,
+    int64 entry_usage) {
+  TRACE_EVENT0("FileSystem", "UsageCache::StartJournaledUpdate");
+  DCHECK(CalledOnValidThread());
+  bool is_valid = true;
+  uint32 dirty = 0;
+  int64 usage = 0;
+  bool new_handle = !HasCacheFileHandle(usage_file_path);
+  if (!Read(usage_file_path, &is_valid, &dirty, &usage))
+    return false;
+
+  // An unreadable journal can't be used for recovery anyway; fall back to a
+  // plain dirty count.
+  Journal journal;
+  if (!ReadJournal(usage_file_path, &journal))
+    return IncrementDirty(usage_file_path);
+
+  JournalEntry& entry = journal[entry_path];
+  if (entry.update_count++ == 0) {
+    entry.initial_usage = entry_usage;
+    entry.applied_delta = 0;
+  }
+
+  bool success = WriteWithJournal(usage_file_path, is_valid, dirty + 1,
+                                  usage, journal);
+  if (success && dirty == 0 && new_handle)
+    FlushFile(usage_file_path);
+  return success;
+}
+
+bool FileSystemUsageCache::AtomicUpdateJournaledUsage(
+    const base::FilePath& usage_file_path,
+    const DeltaMap& deltas) {
+  TRACE_EVENT0("FileSystem", "UsageCache::AtomicUpdateJournaledUsage");
+  DCHECK(CalledOnValidThread());
+  int64 total_delta = 0;
+  for (DeltaMap::const_iterator itr = deltas.begin();
+       itr != deltas.end(); ++itr)
+    total_delta += itr->second;
+
+  bool is_valid = true;
+  uint32 dirty = 0;
+  int64 usage = 0;
+  if (!Read(usage_file_path, &is_valid, &dirty, &usage))
+    return false;
+
+  Journal journal;
+  if (!ReadJournal(usage_file_path, &journal))
+    return Write(usage_file_path, is_valid, dirty, usage + total_delta);
+
+  for (DeltaMap::const_iterator itr = deltas.begin();
+       itr != deltas.end(); ++itr) {
+    Journal::iterator found = journal.find(itr->first);
+    if (found != journal.end())
+      found->second.applied_delta += itr->second;
+  }
+  return WriteWithJournal(usage_file_path, is_valid, dirty,
+                          usage + total_delta, journal);
+}
+
+bool FileSystemUsageCache::EndJournaledUpdate(
+    const base::FilePath& usage_file_path,
+    const base::FilePath& entry_path) {
+  TRACE_EVENT0("FileSystem", "UsageCache::EndJournaledUpdate");
+  DCHECK(CalledOnValidThread());
+  bool is_valid = true;
+  uint32 dirty = 0;
+  int64 usage = 0;
+  if (!Read(usage_file_path, &is_valid, &dirty, &usage) || dirty <= 0)
+    return false;
+
+  Journal journal;
+  if (!ReadJournal(usage_file_path, &journal))
+    return Write(usage_file_path, is_valid, dirty - 1, usage);
+
+  Journal::iterator found = journal.find(entry_path);
+  if (found != journal.end() && --found->second.update_count <= 0)
+    journal.erase(found);
+  return WriteWithJournal(usage_file_path, is_valid, dirty - 1, usage,
+                          journal);
+}
+
+bool FileSystemUsageCache::GetJournal(const base::FilePath& usage_file_path,
+                                      Journal* journal) {
+  TRACE_EVENT0("FileSystem", "UsageCache::GetJournal");
+  DCHECK(CalledOnValidThread());
+  DCHECK(journal);
+  bool is_valid = true;
+  uint32 dirty = 0;
+  int64 usage = 0;
+  if (!Read(usage_file_path, &is_valid, &dirty, &usage))
+    return false;
+  return ReadJournal(usage_file_path, journal);
 }
 
 bool FileSystemUsageCache::Exists(const base::FilePath& usage_file_path) {
@@ -228,6 +337,92 @@ bool FileSystemUsageCache::Write(const base::FilePath& usage_file_path,
   return true;
 }
 
+bool FileSystemUsageCache::ReadJournal(const base::FilePath& usage_file_path,
+                                       Journal* journal) {
+  TRACE_EVENT0("FileSystem", "UsageCache::ReadJournal");
+  DCHECK(CalledOnValidThread());
+  DCHECK(journal);
+  journal->clear();
+
+  base::PlatformFile file;
+  base::PlatformFileInfo file_info;
+  if (!GetPlatformFile(usage_file_path, &file) ||
+      !base::GetPlatformFileInfo(file, &file_info))
+    return false;
+  if (file_info.size <= kUsageFileSize)
+    return true;
+
+  int64 journal_size = file_info.size - kUsageFileSize;
+  if (journal_size > kMaxJournalSize)
+    return false;
+  std::vector<char> buffer(journal_size);
+  if (base::ReadPlatformFile(file, kUsageFileSize, &buffer[0],
+                             static_cast<int>(journal_size)) != journal_size)
+    return false;
+
+  Pickle read_pickle(&buffer[0], static_cast<int>(journal_size));
+  PickleIterator iter(read_pickle);
+  int count = 0;
+  if (!read_pickle.ReadInt(&iter, &count) || count < 0)
+    return false;
+  for (int i = 0; i < count; ++i) {
+    base::FilePath entry_path;
+    JournalEntry entry;
+    if (!entry_path.ReadFromPickle(&iter) ||
+        !read_pickle.ReadInt(&iter, &entry.update_count) ||
+        !read_pickle.ReadInt64(&iter, &entry.initial_usage) ||
+        !read_pickle.ReadInt64(&iter, &entry.applied_delta)) {
+      journal->clear();
+      return false;
+    }
+    (*journal)[entry_path] = entry;
+  }
+  return true;
+}
+
+bool FileSystemUsageCache::WriteWithJournal(
+    const base::FilePath& usage_file_path,
+    bool is_valid,
+    int32 dirty,
+    int64 usage,
+    const Journal& journal) {
+  TRACE_EVENT0("FileSystem", "UsageCache::WriteWithJournal");
+  DCHECK(CalledOnValidThread());
+  Pickle write_pickle;
+  write_pickle.WriteBytes(kUsageFileHeader, kUsageFileHeaderSize);
+  write_pickle.WriteBool(is_valid);
+  write_pickle.WriteUInt32(dirty);
+  write_pickle.WriteInt64(usage);
+  DCHECK_EQ(kUsageFileSize, static_cast<int>(write_pickle.size()));
+
+  std::string data(static_cast<const char*>(write_pickle.data()),
+                   write_pickle.size());
+  if (!journal.empty()) {
+    Pickle journal_pickle;
+    journal_pickle.WriteInt(static_cast<int>(journal.size()));
+    for (Journal::const_iterator itr = journal.begin();
+         itr != journal.end(); ++itr) {
+      itr->first.WriteToPickle(&journal_pickle);
+      journal_pickle.WriteInt(itr->second.update_count);
+      journal_pickle.WriteInt64(itr->second.initial_usage);
+      journal_pickle.WriteInt64(itr->second.applied_delta);
+    }
+    data.append(static_cast<const char*>(journal_pickle.data()),
+                journal_pickle.size());
+  }
+
+  // Both parts go out in a single write, so the usage and the journal of
+  // the deltas folded into it never disagree.
+  base::PlatformFile file;
+  if (!WriteBytes(usage_file_path, data.data(), data.size()) ||
+      !GetPlatformFile(usage_file_path, &file) ||
+      !base::TruncatePlatformFile(file, data.size())) {
+    Delete(usage_file_path);
+    return false;
+  }
+  return true;
+}
+
 bool FileSystemUsageCache::GetPlatformFile(const base::FilePath& file_path,
                                            base::PlatformFile* file) {
   DCHECK(CalledOnValidThread());
@@ -21,6 +21,26 @@ class TimedTaskHelper;
 
 class WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE FileSystemUsageCache {
  public:
+  // An entry of the file system with updates in progress.  Journaled updates
+  // are recorded in the .usage file next to the dirty count, so that after a
+  // crash the usage can be corrected by measuring just these entries instead
+  // of walking the whole origin.
+  struct WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE JournalEntry {
+    JournalEntry();
+
+    // Number of updates in progress on the entry.
+    int32 update_count;
+
+    // Usage of the entry when its first update started, or -1 if it could
+    // not be measured (e.g. it is a directory).
+    int64 initial_usage;
+
+    // Sum of the deltas for the entry already applied to the usage.
+    int64 applied_delta;
+  };
+  typedef std::map<base::FilePath, JournalEntry> Journal;
+  typedef std::map<base::FilePath, int64> DeltaMap;
+
   explicit FileSystemUsageCache(base::SequencedTaskRunner* task_runner);
   ~FileSystemUsageCache();
 
@@ -50,6 +70,26 @@ class WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE FileSystemUsageCache {
   bool AtomicUpdateUsageByDelta(const base::FilePath& usage_file_path,
                                 int64 delta);
 
+  // Like IncrementDirty(), but also journals that |entry_path|, whose usage
+  // is |entry_usage| (-1 if unknown), is being updated.
+  bool StartJournaledUpdate(const base::FilePath& usage_file_path,
+                            const base::FilePath& entry_path,
+                            int64 entry_usage);
+
+  // Like AtomicUpdateUsageByDelta(), but applies per-entry |deltas| and
+  // records them against the journaled entries in the same write.
+  bool AtomicUpdateJournaledUsage(const base::FilePath& usage_file_path,
+                                  const DeltaMap& deltas);
+
+  // Like DecrementDirty(), but also drops one journaled update of
+  // |entry_path|.
+  bool EndJournaledUpdate(const base::FilePath& usage_file_path,
+                          const base::FilePath& entry_path);
+
+  // Gets the journaled updates in the .usage file.
+  // Returns true if the .usage file is available.
+  bool GetJournal(const base::FilePath& usage_file_path, Journal* journal);
+
   bool Exists(const base::FilePath& usage_file_path);
   bool Delete(const base::FilePath& usage_file_path);
 
@@ -75,6 +115,15 @@ class WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE FileSystemUsageCache {
              int32 dirty,
              int64 fs_usage);
 
+  // Reads and writes the journal stored after the fixed-size part of the
+  // .usage file.  A .usage file without one has an empty journal.
+  bool ReadJournal(const base::FilePath& usage_file_path, Journal* journal);
+  bool WriteWithJournal(const base::FilePath& usage_file_path,
+                        bool is_valid,
+                        int32 dirty,
+                        int64 fs_usage,
+                        const Journal& journal);
+
   bool GetPlatformFile(const base::FilePath& file_path,
                        base::PlatformFile* file);
 
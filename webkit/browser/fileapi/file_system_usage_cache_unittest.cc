@@ -155,4 +155,66 @@ TEST_F(FileSystemUsageCacheTest, DecrementDirtyWithoutCacheFileTest) {
   EXPECT_FALSE(usage_cache()->IncrementDirty(usage_file_path));
 }
 
+TEST_F(FileSystemUsageCacheTest, JournaledUpdateTest) {
+  base::FilePath usage_file_path = GetUsageFilePath();
+  const base::FilePath entry_path(FILE_PATH_LITERAL("dir/file"));
+  ASSERT_TRUE(usage_cache()->UpdateUsage(usage_file_path, 1000));
+
+  ASSERT_TRUE(usage_cache()->StartJournaledUpdate(
+      usage_file_path, entry_path, 200));
+  FileSystemUsageCache::DeltaMap deltas;
+  deltas[entry_path] = 50;
+  ASSERT_TRUE(usage_cache()->AtomicUpdateJournaledUsage(usage_file_path,
+                                                        deltas));
+
+  // The journal survives reopening the cache, e.g. after a crash.
+  usage_cache()->CloseCacheFiles();
+  uint32 dirty = 0;
+  int64 usage = 0;
+  FileSystemUsageCache::Journal journal;
+  EXPECT_TRUE(usage_cache()->GetDirty(usage_file_path, &dirty));
+  EXPECT_EQ(1u, dirty);
+  EXPECT_TRUE(usage_cache()->GetUsage(usage_file_path, &usage));
+  EXPECT_EQ(1050, usage);
+  EXPECT_TRUE(usage_cache()->GetJournal(usage_file_path, &journal));
+  ASSERT_EQ(1u, journal.size());
+  EXPECT_EQ(1, journal[entry_path].update_count);
+  EXPECT_EQ(200, journal[entry_path].initial_usage);
+  EXPECT_EQ(50, journal[entry_path].applied_delta);
+
+  ASSERT_TRUE(usage_cache()->EndJournaledUpdate(usage_file_path, entry_path));
+  EXPECT_TRUE(usage_cache()->GetDirty(usage_file_path, &dirty));
+  EXPECT_EQ(0u, dirty);
+  EXPECT_TRUE(usage_cache()->GetJournal(usage_file_path, &journal));
+  EXPECT_TRUE(journal.empty());
+}
+
+TEST_F(FileSystemUsageCacheTest, UnjournaledUpdateKeepsJournalTest) {
+  base::FilePath usage_file_path = GetUsageFilePath();
+  const base::FilePath entry_path(FILE_PATH_LITERAL("file"));
+  ASSERT_TRUE(usage_cache()->UpdateUsage(usage_file_path, 0));
+
+  ASSERT_TRUE(usage_cache()->StartJournaledUpdate(
+      usage_file_path, entry_path, 10));
+  ASSERT_TRUE(usage_cache()->StartJournaledUpdate(
+      usage_file_path, entry_path, 20));
+  ASSERT_TRUE(usage_cache()->IncrementDirty(usage_file_path));
+
+  // The plain increment is not journaled, so the journal accounts for fewer
+  // updates than the dirty count.
+  uint32 dirty = 0;
+  FileSystemUsageCache::Journal journal;
+  EXPECT_TRUE(usage_cache()->GetDirty(usage_file_path, &dirty));
+  EXPECT_EQ(3u, dirty);
+  EXPECT_TRUE(usage_cache()->GetJournal(usage_file_path, &journal));
+  ASSERT_EQ(1u, journal.size());
+  EXPECT_EQ(2, journal[entry_path].update_count);
+  EXPECT_EQ(10, journal[entry_path].initial_usage);
+
+  // Resetting the usage drops the journal.
+  ASSERT_TRUE(usage_cache()->UpdateUsage(usage_file_path, 30));
+  EXPECT_TRUE(usage_cache()->GetJournal(usage_file_path, &journal));
+  EXPECT_TRUE(journal.empty());
+}
+
 }  // namespace fileapi
@@ -369,29 +369,32 @@ PlatformFileError ObfuscatedFileUtil::CreateDirectory(
   }
   if (!recursive && components.size() - index > 1)
     return base::PLATFORM_FILE_ERROR_NOT_FOUND;
-  bool first = true;
+
+  // All missing components are added in a single database write, so a
+  // recursive create either fully succeeds or leaves nothing behind.
+  std::vector<base::FilePath::StringType> new_names;
+  int64 growth = 0;
   for (; index < components.size(); ++index) {
-    FileInfo file_info;
-    file_info.name = components[index];
-    if (file_info.name == FILE_PATH_LITERAL("/"))
+    if (components[index] == FILE_PATH_LITERAL("/"))
       continue;
-    file_info.modification_time = base::Time::Now();
-    file_info.parent_id = parent_id;
-    int64 growth = UsageForPath(file_info.name.size());
-    if (!AllocateQuota(context, growth))
-      return base::PLATFORM_FILE_ERROR_NO_SPACE;
-    if (!db->AddFileInfo(file_info, &parent_id)) {
-      NOTREACHED();
-      return base::PLATFORM_FILE_ERROR_FAILED;
-    }
-    UpdateUsage(context, url, growth);
+    new_names.push_back(components[index]);
+    growth += UsageForPath(components[index].size());
+  }
+  DCHECK(!new_names.empty());
+  if (!AllocateQuota(context, growth))
+    return base::PLATFORM_FILE_ERROR_NO_SPACE;
+  FileId new_id;
+  if (!db->AddDirectoryChain(parent_id, new_names, base::Time::Now(),
+                             &new_id)) {
+    NOTREACHED();
+    return base::PLATFORM_FILE_ERROR_FAILED;
+  }
+  UpdateUsage(context, url, growth);
+  for (size_t i = 0; i < new_names.size(); ++i) {
     context->change_observers()->Notify(
         &FileChangeObserver::OnCreateDirectory, MakeTuple(url));
-    if (first) {
-      first = false;
-      TouchDirectory(db, file_info.parent_id);
-    }
   }
+  TouchDirectory(db, parent_id);
   return base::PLATFORM_FILE_OK;
 }
 
@@ -982,6 +985,28 @@ int64 ObfuscatedFileUtil::ComputeFilePathCost(const base::FilePath& path) {
   return UsageForPath(VirtualPath::BaseName(path).value().size());
 }
 
+int64 ObfuscatedFileUtil::ComputeEntryUsage(const FileSystemURL& url) {
+  SandboxDirectoryDatabase* db = GetDirectoryDatabase(
+      url.origin(), url.type(), false);
+  if (!db)
+    return 0;
+  FileId file_id;
+  if (!db->GetFileWithPath(url.path(), &file_id))
+    return 0;
+  FileInfo file_info;
+  if (!db->GetFileInfo(file_id, &file_info) || file_info.is_directory())
+    return -1;
+
+  int64 file_size = 0;
+  if (!file_info.data_path.empty()) {
+    base::FilePath local_path = DataPathToLocalPath(
+        url.origin(), url.type(), file_info.data_path);
+    if (!file_util::GetFileSize(local_path, &file_size))
+      file_size = 0;
+  }
+  return file_size + ComputeFilePathCost(url.path());
+}
+
 void ObfuscatedFileUtil::MaybePrepopulateDatabase() {
   // Always disable this for now. crbug.com/264429
   return;
@@ -179,6 +179,11 @@ class WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE ObfuscatedFileUtil
   // on each path segment and add the results.
   static int64 ComputeFilePathCost(const base::FilePath& path);
 
+  // Returns the usage of the single entry at |url|, i.e. its file size plus
+  // its path cost, or 0 if it does not exist.  Returns -1 if |url| is a
+  // directory, whose usage can only be computed by walking it.
+  int64 ComputeEntryUsage(const FileSystemURL& url);
+
   void MaybePrepopulateDatabase();
 
  private:
@@ -1178,6 +1178,28 @@ TEST_F(ObfuscatedFileUtilTest, TestPathQuotas) {
   EXPECT_EQ(1024 - path_cost, context->allowed_bytes_growth());
 }
 
+TEST_F(ObfuscatedFileUtilTest, TestComputeEntryUsage) {
+  scoped_ptr<FileSystemOperationContext> context(NewContext(NULL));
+  FileSystemURL dir_url = CreateURLFromUTF8("dir");
+  FileSystemURL file_url = CreateURLFromUTF8("dir/file");
+  EXPECT_EQ(0, ofu()->ComputeEntryUsage(file_url));
+
+  ASSERT_EQ(base::PLATFORM_FILE_OK, ofu()->CreateDirectory(
+      context.get(), dir_url, true /* exclusive */, false /* recursive */));
+  bool created = false;
+  context.reset(NewContext(NULL));
+  ASSERT_EQ(base::PLATFORM_FILE_OK,
+            ofu()->EnsureFileExists(context.get(), file_url, &created));
+  ASSERT_TRUE(created);
+  context.reset(NewContext(NULL));
+  ASSERT_EQ(base::PLATFORM_FILE_OK,
+            ofu()->Truncate(context.get(), file_url, 1234));
+
+  EXPECT_EQ(1234 + ObfuscatedFileUtil::ComputeFilePathCost(file_url.path()),
+            ofu()->ComputeEntryUsage(file_url));
+  EXPECT_EQ(-1, ofu()->ComputeEntryUsage(dir_url));
+}
+
 TEST_F(ObfuscatedFileUtilTest, TestCopyOrMoveFileNotFound) {
   FileSystemURL source_url = CreateURLFromUTF8("path0.txt");
   FileSystemURL dest_url = CreateURLFromUTF8("path1.txt");
@@ -29,21 +29,45 @@ void RecursiveOperationDelegate::StartRecursiveOperation(
     const StatusCallback& callback) {
   callback_ = callback;
   pending_directories_.push(root);
-  ProcessNextDirectory();
+  ProcessPendingOperations();
 }
 
 FileSystemOperationRunner* RecursiveOperationDelegate::operation_runner() {
   return file_system_context_->operation_runner();
 }
 
-void RecursiveOperationDelegate::ProcessNextDirectory() {
-  DCHECK(pending_files_.empty());
-  if (inflight_operations_ > 0)
-    return;
-  if (pending_directories_.empty()) {
-    callback_.Run(base::PLATFORM_FILE_OK);
-    return;
+void RecursiveOperationDelegate::ProcessPendingOperations() {
+  // Files are preferred so that the queue of discovered files stays short
+  // while directories keep feeding it.
+  while (!callback_.is_null() &&
+         inflight_operations_ < kMaxInflightOperations) {
+    if (!pending_files_.empty())
+      ProcessNextFile();
+    else if (!pending_directories_.empty())
+      ProcessNextDirectory();
+    else
+      break;
   }
+  if (callback_.is_null())
+    return;  // Already finished with an error.
+  if (!inflight_operations_ && pending_files_.empty() &&
+      pending_directories_.empty())
+    Finish(base::PLATFORM_FILE_OK);
+}
+
+void RecursiveOperationDelegate::ProcessNextFile() {
+  FileSystemURL url = pending_files_.front();
+  pending_files_.pop();
+  inflight_operations_++;
+  base::MessageLoopProxy::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&RecursiveOperationDelegate::ProcessFile,
+                 AsWeakPtr(), url,
+                 base::Bind(&RecursiveOperationDelegate::DidProcessFile,
+                            AsWeakPtr())));
+}
+
+void RecursiveOperationDelegate::ProcessNextDirectory() {
   FileSystemURL url = pending_directories_.front();
   pending_directories_.pop();
   inflight_operations_++;
@@ -52,40 +76,21 @@ void RecursiveOperationDelegate::ProcessNextDirectory() {
                       AsWeakPtr(), url));
 }
 
-void RecursiveOperationDelegate::ProcessPendingFiles() {
-  if (pending_files_.empty()) {
-    ProcessNextDirectory();
-    return;
-  }
-  while (!pending_files_.empty() &&
-         inflight_operations_ < kMaxInflightOperations) {
-    FileSystemURL url = pending_files_.front();
-    pending_files_.pop();
-    inflight_operations_++;
-    base::MessageLoopProxy::current()->PostTask(
-        FROM_HERE,
-        base::Bind(&RecursiveOperationDelegate::ProcessFile,
-                   AsWeakPtr(), url,
-                   base::Bind(&RecursiveOperationDelegate::DidProcessFile,
-                              AsWeakPtr())));
-  }
-}
-
 void RecursiveOperationDelegate::DidProcessFile(base::PlatformFileError error) {
   inflight_operations_--;
   DCHECK_GE(inflight_operations_, 0);
   if (error != base::PLATFORM_FILE_OK) {
-    callback_.Run(error);
+    Finish(error);
     return;
   }
-  ProcessPendingFiles();
+  ProcessPendingOperations();
 }
 
 void RecursiveOperationDelegate::DidProcessDirectory(
     const FileSystemURL& url,
     base::PlatformFileError error) {
   if (error != base::PLATFORM_FILE_OK) {
-    callback_.Run(error);
+    Finish(error);
     return;
   }
   operation_runner()->ReadDirectory(
@@ -106,7 +111,7 @@ void RecursiveOperationDelegate::DidReadDirectory(
                              AsWeakPtr(), error));
       return;
     }
-    callback_.Run(error);
+    Finish(error);
     return;
   }
   for (size_t i = 0; i < entries.size(); i++) {
@@ -119,12 +124,13 @@ void RecursiveOperationDelegate::DidReadDirectory(
     else
       pending_files_.push(url);
   }
-  if (has_more)
-    return;
-
-  inflight_operations_--;
-  DCHECK_GE(inflight_operations_, 0);
-  ProcessPendingFiles();
+  // The directory stays in flight until its last batch of entries arrives,
+  // but the entries found so far can be processed meanwhile.
+  if (!has_more) {
+    inflight_operations_--;
+    DCHECK_GE(inflight_operations_, 0);
+  }
+  ProcessPendingOperations();
 }
 
 void RecursiveOperationDelegate::DidTryProcessFile(
@@ -132,10 +138,20 @@ void RecursiveOperationDelegate::DidTryProcessFile(
     base::PlatformFileError error) {
   if (error == base::PLATFORM_FILE_ERROR_NOT_A_FILE) {
     // It wasn't a file either; returns with the previous error.
-    callback_.Run(previous_error);
+    Finish(previous_error);
     return;
   }
   DidProcessFile(error);
 }
 
+void RecursiveOperationDelegate::Finish(base::PlatformFileError error) {
+  if (callback_.is_null())
+    return;
+  // Suboperations still in flight may complete after this; they must not
+  // run the callback again.  Running it may also delete |this|.
+  StatusCallback callback = callback_;
+  callback_.Reset();
+  callback.Run(error);
+}
+
 }  // namespace fileapi
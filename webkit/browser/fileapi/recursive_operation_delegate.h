@@ -61,8 +61,13 @@ class RecursiveOperationDelegate
   // This will call ProcessFile and ProcessDirectory on each directory or file.
   // If the given |root| is a file this simply calls ProcessFile and exits.
   //
+  // Files and directories are processed concurrently, up to a fixed number
+  // of suboperations at a time; a directory's children are only processed
+  // after ProcessDirectory has completed for it.
+  //
   // |callback| is fired with base::PLATFORM_FILE_OK when every file/directory
   // under |root| is processed, or fired earlier when any suboperation fails.
+  // It is fired exactly once.
   void StartRecursiveOperation(const FileSystemURL& root,
                                const StatusCallback& callback);
 
@@ -74,8 +79,9 @@ class RecursiveOperationDelegate
   FileSystemOperationRunner* operation_runner();
 
  private:
+  void ProcessPendingOperations();
+  void ProcessNextFile();
   void ProcessNextDirectory();
-  void ProcessPendingFiles();
   void DidProcessFile(base::PlatformFileError error);
   void DidProcessDirectory(const FileSystemURL& url,
                            base::PlatformFileError error);
@@ -86,6 +92,7 @@ class RecursiveOperationDelegate
       bool has_more);
   void DidTryProcessFile(base::PlatformFileError previous_error,
                          base::PlatformFileError error);
+  void Finish(base::PlatformFileError error);
 
   FileSystemContext* file_system_context_;
   StatusCallback callback_;
@@ -0,0 +1,200 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "webkit/browser/fileapi/recursive_operation_delegate.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/callback.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/browser/fileapi/async_file_test_helper.h"
+#include "webkit/browser/fileapi/file_system_context.h"
+#include "webkit/browser/fileapi/file_system_url.h"
+#include "webkit/browser/fileapi/sandbox_file_system_test_helper.h"
+
+namespace fileapi {
+
+namespace {
+
+// The number of suboperations RecursiveOperationDelegate runs at a time.
+const size_t kMaxInflightOperations = 5;
+
+// Processes directories right away, but holds on to the callback for each
+// file until the test completes it, so that the test controls how file
+// suboperations overlap.
+class TestRecursiveOperationDelegate : public RecursiveOperationDelegate {
+ public:
+  TestRecursiveOperationDelegate(FileSystemContext* file_system_context,
+                                 const FileSystemURL& root,
+                                 const StatusCallback& callback)
+      : RecursiveOperationDelegate(file_system_context),
+        root_(root),
+        callback_(callback),
+        processed_file_count_(0),
+        max_pending_file_count_(0) {
+  }
+  virtual ~TestRecursiveOperationDelegate() {}
+
+  // RecursiveOperationDelegate overrides.
+  virtual void Run() OVERRIDE {
+    NOTREACHED();
+  }
+
+  virtual void RunRecursively() OVERRIDE {
+    StartRecursiveOperation(root_, callback_);
+  }
+
+  virtual void ProcessFile(const FileSystemURL& url,
+                           const StatusCallback& callback) OVERRIDE {
+    ++processed_file_count_;
+    pending_file_callbacks_.push_back(callback);
+    max_pending_file_count_ =
+        std::max(max_pending_file_count_, pending_file_callbacks_.size());
+  }
+
+  virtual void ProcessDirectory(const FileSystemURL& url,
+                                const StatusCallback& callback) OVERRIDE {
+    callback.Run(base::PLATFORM_FILE_OK);
+  }
+
+  // Completes the oldest file suboperation in flight with |error|.
+  void CompleteFile(base::PlatformFileError error) {
+    ASSERT_FALSE(pending_file_callbacks_.empty());
+    StatusCallback callback = pending_file_callbacks_.front();
+    pending_file_callbacks_.erase(pending_file_callbacks_.begin());
+    callback.Run(error);
+    base::MessageLoop::current()->RunUntilIdle();
+  }
+
+  size_t pending_file_count() const { return pending_file_callbacks_.size(); }
+  size_t processed_file_count() const { return processed_file_count_; }
+  size_t max_pending_file_count() const { return max_pending_file_count_; }
+
+ private:
+  FileSystemURL root_;
+  StatusCallback callback_;
+  std::vector<StatusCallback> pending_file_callbacks_;
+  size_t processed_file_count_;
+  size_t max_pending_file_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestRecursiveOperationDelegate);
+};
+
+void RecordStatus(int* callback_count,
+                  base::PlatformFileError* status_out,
+                  base::PlatformFileError status) {
+  ++*callback_count;
+  *status_out = status;
+}
+
+}  // namespace
+
+class RecursiveOperationDelegateTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(base_.CreateUniqueTempDir());
+    sandbox_file_system_.SetUp(base_.path());
+  }
+
+  virtual void TearDown() OVERRIDE {
+    sandbox_file_system_.TearDown();
+  }
+
+  // Creates the directory "dir" holding |file_count| files and returns its
+  // url.
+  FileSystemURL CreateDirectoryWithFiles(size_t file_count) {
+    FileSystemURL dir = sandbox_file_system_.CreateURLFromUTF8("dir");
+    EXPECT_EQ(base::PLATFORM_FILE_OK,
+              AsyncFileTestHelper::CreateDirectory(
+                  sandbox_file_system_.file_system_context(), dir));
+    for (size_t i = 0; i < file_count; ++i) {
+      FileSystemURL file = sandbox_file_system_.CreateURLFromUTF8(
+          base::StringPrintf("dir/file%d", static_cast<int>(i)));
+      EXPECT_EQ(base::PLATFORM_FILE_OK,
+                AsyncFileTestHelper::CreateFile(
+                    sandbox_file_system_.file_system_context(), file));
+    }
+    return dir;
+  }
+
+  scoped_ptr<TestRecursiveOperationDelegate> NewDelegate(
+      const FileSystemURL& root,
+      int* callback_count,
+      base::PlatformFileError* status) {
+    return make_scoped_ptr(new TestRecursiveOperationDelegate(
+        sandbox_file_system_.file_system_context(), root,
+        base::Bind(&RecordStatus, callback_count, status)));
+  }
+
+  base::MessageLoop message_loop_;
+  base::ScopedTempDir base_;
+  SandboxFileSystemTestHelper sandbox_file_system_;
+};
+
+TEST_F(RecursiveOperationDelegateTest, ProcessesFilesConcurrently) {
+  const size_t kFileCount = 8;
+  FileSystemURL dir = CreateDirectoryWithFiles(kFileCount);
+
+  int callback_count = 0;
+  base::PlatformFileError status = base::PLATFORM_FILE_ERROR_FAILED;
+  scoped_ptr<TestRecursiveOperationDelegate> delegate(
+      NewDelegate(dir, &callback_count, &status));
+  delegate->RunRecursively();
+  base::MessageLoop::current()->RunUntilIdle();
+
+  // As many files as allowed are processed at the same time.
+  EXPECT_EQ(kMaxInflightOperations, delegate->pending_file_count());
+
+  // Completing one starts the next.
+  delegate->CompleteFile(base::PLATFORM_FILE_OK);
+  EXPECT_EQ(kMaxInflightOperations, delegate->pending_file_count());
+  EXPECT_EQ(kMaxInflightOperations + 1, delegate->processed_file_count());
+
+  while (delegate->pending_file_count()) {
+    EXPECT_EQ(0, callback_count);
+    delegate->CompleteFile(base::PLATFORM_FILE_OK);
+  }
+  EXPECT_EQ(kFileCount, delegate->processed_file_count());
+  EXPECT_EQ(kMaxInflightOperations, delegate->max_pending_file_count());
+  EXPECT_EQ(1, callback_count);
+  EXPECT_EQ(base::PLATFORM_FILE_OK, status);
+}
+
+TEST_F(RecursiveOperationDelegateTest, FailureFinishesOnce) {
+  const size_t kFileCount = 8;
+  FileSystemURL dir = CreateDirectoryWithFiles(kFileCount);
+
+  int callback_count = 0;
+  base::PlatformFileError status = base::PLATFORM_FILE_OK;
+  scoped_ptr<TestRecursiveOperationDelegate> delegate(
+      NewDelegate(dir, &callback_count, &status));
+  delegate->RunRecursively();
+  base::MessageLoop::current()->RunUntilIdle();
+  ASSERT_EQ(kMaxInflightOperations, delegate->pending_file_count());
+
+  // The first failure finishes the operation while other files are still
+  // being processed.
+  delegate->CompleteFile(base::PLATFORM_FILE_ERROR_FAILED);
+  EXPECT_EQ(1, callback_count);
+  EXPECT_EQ(base::PLATFORM_FILE_ERROR_FAILED, status);
+
+  // The suboperations in flight neither finish it again nor start the
+  // remaining files.
+  delegate->CompleteFile(base::PLATFORM_FILE_ERROR_NOT_FOUND);
+  while (delegate->pending_file_count())
+    delegate->CompleteFile(base::PLATFORM_FILE_OK);
+  EXPECT_EQ(kMaxInflightOperations, delegate->processed_file_count());
+  EXPECT_EQ(1, callback_count);
+  EXPECT_EQ(base::PLATFORM_FILE_ERROR_FAILED, status);
+}
+
+}  // namespace fileapi
@@ -29,6 +29,9 @@ const char kOpenFileSystemLabel[] = "FileSystem.OpenFileSystem";
 const char kOpenFileSystemDetailLabel[] = "FileSystem.OpenFileSystemDetail";
 const char kOpenFileSystemDetailNonThrottledLabel[] =
     "FileSystem.OpenFileSystemDetailNonthrottled";
+const char kUsageJournalRecoveryTimeLabel[] =
+    "FileSystem.UsageJournalRecoveryTime";
+const char kUsageRecalculationTimeLabel[] = "FileSystem.UsageRecalculationTime";
 int64 kMinimumStatsCollectionIntervalHours = 1;
 
 enum FileSystemError {
@@ -307,11 +310,29 @@ int64 SandboxContext::GetOriginUsageOnFileThread(
     int64 usage = 0;
     return usage_cache()->GetUsage(usage_file_path, &usage) ? usage : -1;
   }
+  // The cache is dirty, most likely because we crashed in the middle of an
+  // update.  If the journal covers every outstanding update, correct the
+  // cached usage by re-measuring just those entries.
+  int64 usage = 0;
+  if (is_valid && dirty_status_available) {
+    base::TimeTicks start_time = base::TimeTicks::Now();
+    if (RecoverUsageFromJournal(file_system_context, origin_url, type,
+                                usage_file_path, dirty_status, &usage)) {
+      UMA_HISTOGRAM_TIMES(kUsageJournalRecoveryTimeLabel,
+                          base::TimeTicks::Now() - start_time);
+      usage_cache()->UpdateUsage(usage_file_path, usage);
+      return usage;
+    }
+  }
+
   // The usage cache has not been initialized or the cache is dirty.
   // Get the directory size now and update the cache.
   usage_cache()->Delete(usage_file_path);
 
-  int64 usage = RecalculateUsage(file_system_context, origin_url, type);
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  usage = RecalculateUsage(file_system_context, origin_url, type);
+  UMA_HISTOGRAM_TIMES(kUsageRecalculationTimeLabel,
+                      base::TimeTicks::Now() - start_time);
 
   // This clears the dirty flag too.
   usage_cache()->UpdateUsage(usage_file_path, usage);
@@ -383,6 +404,42 @@ int64 SandboxContext::RecalculateUsage(FileSystemContext* context,
   return usage;
 }
 
+bool SandboxContext::RecoverUsageFromJournal(
+    FileSystemContext* context,
+    const GURL& origin,
+    FileSystemType type,
+    const base::FilePath& usage_file_path,
+    uint32 dirty,
+    int64* usage) {
+  FileSystemUsageCache::Journal journal;
+  if (!usage_cache()->GetJournal(usage_file_path, &journal) ||
+      !usage_cache()->GetUsage(usage_file_path, usage))
+    return false;
+
+  uint32 journaled_updates = 0;
+  int64 correction = 0;
+  for (FileSystemUsageCache::Journal::const_iterator itr = journal.begin();
+       itr != journal.end(); ++itr) {
+    const FileSystemUsageCache::JournalEntry& entry = itr->second;
+    if (entry.initial_usage < 0)
+      return false;
+    int64 current_usage = sync_file_util()->ComputeEntryUsage(
+        context->CreateCrackedFileSystemURL(origin, type, itr->first));
+    if (current_usage < 0)
+      return false;
+    journaled_updates += entry.update_count;
+    correction += current_usage - entry.initial_usage - entry.applied_delta;
+  }
+
+  // Updates that were not journaled (e.g. on directories, or explicit
+  // invalidations) leave the dirty count ahead of the journal.
+  if (journaled_updates != dirty)
+    return false;
+
+  *usage += correction;
+  return *usage >= 0;
+}
+
 void SandboxContext::CollectOpenFileSystemMetrics(
     base::PlatformFileError error_code) {
   base::Time now = base::Time::Now();
@@ -162,6 +162,17 @@ class WEBKIT_STORAGE_BROWSER_EXPORT SandboxContext {
                          const GURL& origin,
                          FileSystemType type);
 
+  // Computes the usage of a dirty origin from its usage cache by
+  // re-measuring only the entries journaled as being updated.  Returns false
+  // if the journal does not account for every outstanding update, in which
+  // case the usage has to be recalculated.
+  bool RecoverUsageFromJournal(FileSystemContext* context,
+                               const GURL& origin,
+                               FileSystemType type,
+                               const base::FilePath& usage_file_path,
+                               uint32 dirty,
+                               int64* usage);
+
   scoped_refptr<base::SequencedTaskRunner> file_task_runner_;
 
   scoped_ptr<AsyncFileUtilAdapter> sandbox_file_util_;
@@ -4,6 +4,8 @@
 
 #include "webkit/browser/fileapi/sandbox_context.h"
 
+#include <string>
+
 #include "base/basictypes.h"
 #include "base/file_util.h"
 #include "base/files/scoped_temp_dir.h"
@@ -12,17 +14,31 @@
 #include "base/message_loop/message_loop_proxy.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "url/gurl.h"
+#include "webkit/browser/fileapi/file_system_context.h"
+#include "webkit/browser/fileapi/file_system_file_util.h"
+#include "webkit/browser/fileapi/file_system_operation_context.h"
 #include "webkit/browser/fileapi/file_system_url.h"
+#include "webkit/browser/fileapi/file_system_usage_cache.h"
+#include "webkit/browser/fileapi/mock_file_system_context.h"
 #include "webkit/browser/fileapi/mock_file_system_options.h"
+#include "webkit/browser/fileapi/obfuscated_file_util.h"
+#include "webkit/browser/fileapi/sandbox_file_system_test_helper.h"
 
 namespace fileapi {
 
 namespace {
 
+const GURL kOrigin("http://foo/");
+const FileSystemType kType = kFileSystemTypeTemporary;
+
+// The usage cache is skewed by this much before a simulated crash, so that a
+// usage recovered from the journal, which builds on the cached usage, can be
+// told apart from a full recalculation.
+const int64 kUsageSkew = 1000;
+
 FileSystemURL CreateFileSystemURL(const char* path) {
-  const GURL kOrigin("http://foo/");
   return FileSystemURL::CreateForTest(
-      kOrigin, kFileSystemTypeTemporary, base::FilePath::FromUTF8Unsafe(path));
+      kOrigin, kType, base::FilePath::FromUTF8Unsafe(path));
 }
 
 }  // namespace
@@ -39,6 +55,73 @@ class SandboxContextTest : public testing::Test {
         CreateAllowFileAccessOptions()));
   }
 
+  // Creates a file of |size| bytes at |file_path| and returns its usage,
+  // then starts an update of it that grows it by |growth| bytes, of which
+  // only |applied_growth| bytes reach the usage cache. The update is only
+  // journaled if |journaled| is true. The file system is closed without
+  // ending the update, as if the browser had crashed.
+  int64 CrashDuringUpdate(const base::FilePath& file_path,
+                          int64 size,
+                          int growth,
+                          int64 applied_growth,
+                          bool journaled) {
+    SandboxFileSystemTestHelper file_system(kOrigin, kType);
+    file_system.SetUp(data_dir_.path());
+    FileSystemURL url = file_system.CreateURL(file_path);
+
+    scoped_ptr<FileSystemOperationContext> context(
+        file_system.NewOperationContext());
+    context->set_allowed_bytes_growth(1024 * 1024);
+    bool created = false;
+    EXPECT_EQ(base::PLATFORM_FILE_OK,
+              file_system.file_util()->EnsureFileExists(
+                  context.get(), url, &created));
+    context.reset(file_system.NewOperationContext());
+    context->set_allowed_bytes_growth(1024 * 1024);
+    EXPECT_EQ(base::PLATFORM_FILE_OK,
+              file_system.file_util()->Truncate(context.get(), url, size));
+    base::MessageLoop::current()->RunUntilIdle();
+
+    FileSystemUsageCache* usage_cache = file_system.usage_cache();
+    base::FilePath usage_file_path = file_system.GetUsageCachePath();
+    int64 usage = 0;
+    EXPECT_TRUE(usage_cache->GetUsage(usage_file_path, &usage));
+    EXPECT_TRUE(usage_cache->UpdateUsage(usage_file_path, usage + kUsageSkew));
+
+    if (journaled) {
+      int64 entry_usage = file_system.file_system_context()->
+          sandbox_context()->sync_file_util()->ComputeEntryUsage(url);
+      EXPECT_TRUE(usage_cache->StartJournaledUpdate(
+          usage_file_path, file_path, entry_usage));
+      FileSystemUsageCache::DeltaMap deltas;
+      deltas[file_path] = applied_growth;
+      EXPECT_TRUE(usage_cache->AtomicUpdateJournaledUsage(usage_file_path,
+                                                          deltas));
+    } else {
+      EXPECT_TRUE(usage_cache->IncrementDirty(usage_file_path));
+      EXPECT_TRUE(usage_cache->AtomicUpdateUsageByDelta(usage_file_path,
+                                                        applied_growth));
+    }
+    std::string data(growth, 'a');
+    EXPECT_EQ(growth, file_util::AppendToFile(
+        file_system.GetLocalPath(file_path), data.data(), growth));
+
+    file_system.TearDown();
+    return usage;
+  }
+
+  // Opens the file system again and returns the usage of the origin.
+  int64 GetOriginUsageAfterRestart() {
+    scoped_refptr<FileSystemContext> file_system_context(
+        CreateFileSystemContextForTesting(NULL, data_dir_.path()));
+    int64 usage =
+        file_system_context->sandbox_context()->GetOriginUsageOnFileThread(
+            file_system_context.get(), kOrigin, kType);
+    file_system_context = NULL;
+    base::MessageLoop::current()->RunUntilIdle();
+    return usage;
+  }
+
   base::ScopedTempDir data_dir_;
   base::MessageLoop message_loop_;
   scoped_ptr<SandboxContext> context_;
@@ -79,4 +162,22 @@ TEST_F(SandboxContextTest, IsAccessValid) {
   EXPECT_TRUE(context_->IsAccessValid(CreateFileSystemURL("c:")));
 }
 
+TEST_F(SandboxContextTest, RecoverUsageFromJournal) {
+  const base::FilePath kPath = base::FilePath::FromUTF8Unsafe("file");
+  int64 usage = CrashDuringUpdate(kPath, 100, 30, 10, true /* journaled */);
+  EXPECT_EQ(100 + ObfuscatedFileUtil::ComputeFilePathCost(kPath), usage);
+
+  // Only the growth that did not reach the usage cache is added to it.
+  EXPECT_EQ(usage + kUsageSkew + 30, GetOriginUsageAfterRestart());
+}
+
+TEST_F(SandboxContextTest, RecalculateUsageWithoutJournal) {
+  const base::FilePath kPath = base::FilePath::FromUTF8Unsafe("file");
+  int64 usage = CrashDuringUpdate(kPath, 100, 30, 10, false /* journaled */);
+
+  // The outstanding update was not journaled, so the skewed cached usage is
+  // discarded and the usage is recalculated.
+  EXPECT_EQ(usage + 30, GetOriginUsageAfterRestart());
+}
+
 }  // namespace fileapi
@@ -74,6 +74,9 @@ const char kChildLookupSeparator[] = ":";
 const char kLastFileIdKey[] = "LAST_FILE_ID";
 const char kLastIntegerKey[] = "LAST_INTEGER";
 const int64 kMinimumReportIntervalHours = 1;
+// Enough for the working set of a typical app; each entry costs a key
+// string and a list node.
+const size_t kChildIdCacheSize = 4096;
 const char kInitStatusHistogramLabel[] = "FileSystem.DirectoryDatabaseInit";
 const char kDatabaseRepairHistogramLabel[] =
     "FileSystem.DirectoryDatabaseRepair";
@@ -411,7 +414,9 @@ SandboxDirectoryDatabase::FileInfo::~FileInfo() {
 
 SandboxDirectoryDatabase::SandboxDirectoryDatabase(
     const base::FilePath& filesystem_data_directory)
-    : filesystem_data_directory_(filesystem_data_directory) {
+    : filesystem_data_directory_(filesystem_data_directory),
+      child_id_cache_(kChildIdCacheSize),
+      last_file_id_(-1) {
 }
 
 SandboxDirectoryDatabase::~SandboxDirectoryDatabase() {
@@ -425,6 +430,11 @@ bool SandboxDirectoryDatabase::GetChildWithName(
     return false;
   DCHECK(child_id);
   std::string child_key = GetChildLookupKey(parent_id, name);
+  ChildIdCache::iterator found = child_id_cache_.Get(child_key);
+  if (found != child_id_cache_.end()) {
+    *child_id = found->second;
+    return true;
+  }
   std::string child_id_string;
   leveldb::Status status =
       db_->Get(leveldb::ReadOptions(), child_key, &child_id_string);
@@ -435,6 +445,7 @@ bool SandboxDirectoryDatabase::GetChildWithName(
       LOG(ERROR) << "Hit database corruption!";
       return false;
     }
+    child_id_cache_.Put(child_key, *child_id);
     return true;
   }
   HandleError(FROM_HERE, status);
@@ -524,6 +535,10 @@ bool SandboxDirectoryDatabase::AddFileInfo(
     return false;
   DCHECK(file_id);
   std::string child_key = GetChildLookupKey(info.parent_id, info.name);
+  if (child_id_cache_.Peek(child_key) != child_id_cache_.end()) {
+    LOG(ERROR) << "File exists already!";
+    return false;
+  }
   std::string child_id_string;
   leveldb::Status status =
       db_->Get(leveldb::ReadOptions(), child_key, &child_id_string);
@@ -557,10 +572,63 @@ bool SandboxDirectoryDatabase::AddFileInfo(
     HandleError(FROM_HERE, status);
     return false;
   }
+  last_file_id_ = temp_id;
+  child_id_cache_.Put(child_key, temp_id);
   *file_id = temp_id;
   return true;
 }
 
+bool SandboxDirectoryDatabase::AddDirectoryChain(
+    FileId parent_id,
+    const std::vector<base::FilePath::StringType>& names,
+    const base::Time& modification_time,
+    FileId* file_id) {
+  if (!Init(REPAIR_ON_CORRUPTION))
+    return false;
+  DCHECK(file_id);
+  DCHECK(!names.empty());
+  // Only the first link can collide; everything below it is new.
+  FileId existing_id;
+  if (GetChildWithName(parent_id, names.front(), &existing_id)) {
+    LOG(ERROR) << "File exists already!";
+    return false;
+  }
+  if (!db_)
+    return false;  // The lookup above hit an error.
+  if (!VerifyIsDirectory(parent_id))
+    return false;
+
+  FileId last_id;
+  if (!GetLastFileId(&last_id))
+    return false;
+
+  leveldb::WriteBatch batch;
+  std::vector<std::pair<std::string, FileId> > new_links;
+  FileInfo info;
+  info.parent_id = parent_id;
+  info.modification_time = modification_time;
+  for (size_t i = 0; i < names.size(); ++i) {
+    info.name = names[i];
+    ++last_id;
+    if (!AddFileInfoHelper(info, last_id, &batch))
+      return false;
+    new_links.push_back(
+        std::make_pair(GetChildLookupKey(info.parent_id, info.name), last_id));
+    info.parent_id = last_id;
+  }
+  batch.Put(LastFileIdKey(), base::Int64ToString(last_id));
+  leveldb::Status status = db_->Write(leveldb::WriteOptions(), &batch);
+  if (!status.ok()) {
+    HandleError(FROM_HERE, status);
+    return false;
+  }
+  last_file_id_ = last_id;
+  for (size_t i = 0; i < new_links.size(); ++i)
+    child_id_cache_.Put(new_links[i].first, new_links[i].second);
+  *file_id = last_id;
+  return true;
+}
+
 bool SandboxDirectoryDatabase::RemoveFileInfo(FileId file_id) {
   if (!Init(REPAIR_ON_CORRUPTION))
     return false;
@@ -722,6 +790,7 @@ bool SandboxDirectoryDatabase::Init(RecoveryOption recovery_option) {
   ReportInitStatus(status);
   if (status.ok()) {
     db_.reset(db);
+    ClearCaches();
     return true;
   }
   HandleError(FROM_HERE, status);
@@ -777,6 +846,8 @@ bool SandboxDirectoryDatabase::RepairDatabase(const std::string& db_path) {
 bool SandboxDirectoryDatabase::IsFileSystemConsistent() {
   if (!Init(FAIL_ON_CORRUPTION))
     return false;
+  // The check must look at what is actually in the database.
+  ClearCaches();
   DatabaseCheckHelper helper(this, db_.get(), filesystem_data_directory_);
   return helper.IsFileSystemConsistent();
 }
@@ -828,6 +899,7 @@ bool SandboxDirectoryDatabase::StoreDefaultValues() {
     HandleError(FROM_HERE, status);
     return false;
   }
+  last_file_id_ = 0;
   return true;
 }
 
@@ -835,6 +907,10 @@ bool SandboxDirectoryDatabase::GetLastFileId(FileId* file_id) {
   if (!Init(REPAIR_ON_CORRUPTION))
     return false;
   DCHECK(file_id);
+  if (last_file_id_ >= 0) {
+    *file_id = last_file_id_;
+    return true;
+  }
   std::string id_string;
   leveldb::Status status =
       db_->Get(leveldb::ReadOptions(), LastFileIdKey(), &id_string);
@@ -843,6 +919,7 @@ bool SandboxDirectoryDatabase::GetLastFileId(FileId* file_id) {
       LOG(ERROR) << "Hit database corruption!";
       return false;
     }
+    last_file_id_ = *file_id;
     return true;
   }
   if (!status.IsNotFound()) {
@@ -912,7 +989,13 @@ bool SandboxDirectoryDatabase::RemoveFileInfoHelper(
       return false;
     }
   }
-  batch->Delete(GetChildLookupKey(info.parent_id, info.name));
+  std::string child_key = GetChildLookupKey(info.parent_id, info.name);
+  // Dropped before the batch is written; if the write fails we only lose a
+  // cache entry.
+  ChildIdCache::iterator found = child_id_cache_.Peek(child_key);
+  if (found != child_id_cache_.end())
+    child_id_cache_.Erase(found);
+  batch->Delete(child_key);
   batch->Delete(GetFileLookupKey(file_id));
   return true;
 }
@@ -923,6 +1006,12 @@ void SandboxDirectoryDatabase::HandleError(
   LOG(ERROR) << "SandboxDirectoryDatabase failed at: "
              << from_here.ToString() << " with error: " << status.ToString();
   db_.reset();
+  ClearCaches();
+}
+
+void SandboxDirectoryDatabase::ClearCaches() {
+  child_id_cache_.Clear();
+  last_file_id_ = -1;
 }
 
 }  // namespace fileapi
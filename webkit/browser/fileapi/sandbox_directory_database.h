@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 
+#include "base/containers/mru_cache.h"
 #include "base/files/file_path.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/time/time.h"
@@ -69,6 +70,14 @@ class WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE SandboxDirectoryDatabase {
   bool ListChildren(FileId parent_id, std::vector<FileId>* children);
   bool GetFileInfo(FileId file_id, FileInfo* info);
   bool AddFileInfo(const FileInfo& info, FileId* file_id);
+  // Adds a chain of nested directories named |names| under |parent_id| in a
+  // single database write, as for a recursive mkdir.  On success |file_id| is
+  // set to the id of the innermost new directory.  Fails without adding
+  // anything if the first name already exists under |parent_id|.
+  bool AddDirectoryChain(FileId parent_id,
+                         const std::vector<base::FilePath::StringType>& names,
+                         const base::Time& modification_time,
+                         FileId* file_id);
   bool RemoveFileInfo(FileId file_id);
   // This does a full update of the FileInfo, and is what you'd use for moves
   // and renames.  If you just want to update the modification_time, use
@@ -99,6 +108,10 @@ class WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE SandboxDirectoryDatabase {
     FAIL_ON_CORRUPTION,
   };
 
+  // Maps child lookup keys to child ids.  Only positive lookups are cached;
+  // entries are dropped whenever the corresponding link is removed.
+  typedef base::MRUCache<std::string, FileId> ChildIdCache;
+
   friend class ObfuscatedFileUtil;
   friend class SandboxDirectoryDatabaseTest;
 
@@ -113,9 +126,13 @@ class WEBKIT_STORAGE_BROWSER_EXPORT_PRIVATE SandboxDirectoryDatabase {
   bool RemoveFileInfoHelper(FileId file_id, leveldb::WriteBatch* batch);
   void HandleError(const tracked_objects::Location& from_here,
                    const leveldb::Status& status);
+  void ClearCaches();
 
   const base::FilePath filesystem_data_directory_;
   scoped_ptr<leveldb::DB> db_;
+  ChildIdCache child_id_cache_;
+  // Mirrors LAST_FILE_ID once it has been read; -1 if not yet known.
+  FileId last_file_id_;
   base::Time last_reported_time_;
   DISALLOW_COPY_AND_ASSIGN(SandboxDirectoryDatabase);
 };
@@ -315,6 +315,75 @@ TEST_F(SandboxDirectoryDatabaseTest, TestGetFileWithPath) {
   EXPECT_EQ(file_id2, check_file_id);
 }
 
+TEST_F(SandboxDirectoryDatabaseTest, TestAddDirectoryChain) {
+  FileId dir_id;
+  CreateDirectory(0, FPL("foo"), &dir_id);
+
+  std::vector<base::FilePath::StringType> names;
+  names.push_back(FPL("bar"));
+  names.push_back(FPL("baz"));
+  names.push_back(FPL("qux"));
+  FileId leaf_id;
+  EXPECT_TRUE(db()->AddDirectoryChain(dir_id, names, base::Time::Now(),
+                                      &leaf_id));
+
+  FileId check_file_id;
+  EXPECT_TRUE(db()->GetFileWithPath(
+      base::FilePath(FPL("foo/bar/baz/qux")), &check_file_id));
+  EXPECT_EQ(leaf_id, check_file_id);
+  FileInfo info;
+  EXPECT_TRUE(db()->GetFileInfo(leaf_id, &info));
+  EXPECT_TRUE(info.is_directory());
+
+  // The first link already exists now, so nothing is added.
+  FileId unused_id;
+  EXPECT_FALSE(db()->AddDirectoryChain(dir_id, names, base::Time::Now(),
+                                       &unused_id));
+
+  // Ids handed out afterwards don't collide with the chain.
+  FileId file_id;
+  CreateDirectory(0, FPL("other"), &file_id);
+  EXPECT_GT(file_id, leaf_id);
+
+  // The same ids come back from a fresh instance.
+  InitDatabase();
+  EXPECT_TRUE(db()->GetFileWithPath(
+      base::FilePath(FPL("foo/bar/baz/qux")), &check_file_id));
+  EXPECT_EQ(leaf_id, check_file_id);
+  EXPECT_TRUE(db()->IsFileSystemConsistent());
+}
+
+TEST_F(SandboxDirectoryDatabaseTest, TestLookupAfterMoveAndRemove) {
+  FileId dir1_id;
+  FileId dir2_id;
+  CreateDirectory(0, FPL("foo"), &dir1_id);
+  CreateDirectory(0, FPL("bar"), &dir2_id);
+  FileId file_id;
+  CreateFile(dir1_id, FPL("file"), FPL("data"), &file_id);
+
+  // Warm up lookups of the original location.
+  FileId check_file_id;
+  EXPECT_TRUE(db()->GetFileWithPath(
+      base::FilePath(FPL("foo/file")), &check_file_id));
+  EXPECT_EQ(file_id, check_file_id);
+
+  FileInfo info;
+  EXPECT_TRUE(db()->GetFileInfo(file_id, &info));
+  info.parent_id = dir2_id;
+  EXPECT_TRUE(db()->UpdateFileInfo(file_id, info));
+  EXPECT_FALSE(db()->GetFileWithPath(
+      base::FilePath(FPL("foo/file")), &check_file_id));
+  EXPECT_TRUE(db()->GetFileWithPath(
+      base::FilePath(FPL("bar/file")), &check_file_id));
+  EXPECT_EQ(file_id, check_file_id);
+
+  EXPECT_TRUE(db()->RemoveFileInfo(file_id));
+  EXPECT_FALSE(db()->GetFileWithPath(
+      base::FilePath(FPL("bar/file")), &check_file_id));
+  EXPECT_TRUE(db()->RemoveFileInfo(dir1_id));
+  EXPECT_FALSE(db()->GetChildWithName(0, FPL("foo"), &check_file_id));
+}
+
 TEST_F(SandboxDirectoryDatabaseTest, TestListChildren) {
   // No children in the root.
   std::vector<FileId> children;
@@ -0,0 +1,170 @@
+// Copyright (c) 2013 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/perftimer.h"
+#include "base/strings/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/browser/fileapi/async_file_test_helper.h"
+#include "webkit/browser/fileapi/file_system_context.h"
+#include "webkit/browser/fileapi/file_system_url.h"
+#include "webkit/browser/fileapi/mock_file_system_context.h"
+#include "webkit/browser/fileapi/sandbox_directory_database.h"
+
+namespace fileapi {
+
+namespace {
+
+const char kOrigin[] = "http://example.com";
+
+// Number of GetFileWithPath calls made per lookup benchmark.
+const int kLookupIterations = 10000;
+
+void ExpectOk(base::PlatformFileError result,
+              const std::string& name,
+              const GURL& root_url) {
+  ASSERT_EQ(base::PLATFORM_FILE_OK, result);
+}
+
+}  // namespace
+
+class SandboxFileSystemPerfTest : public testing::Test {
+ public:
+  SandboxFileSystemPerfTest()
+      : message_loop_(base::MessageLoop::TYPE_IO) {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    file_system_context_ =
+        CreateFileSystemContextForTesting(NULL, temp_dir_.path());
+    file_system_context_->OpenFileSystem(
+        GURL(kOrigin), kFileSystemTypeTemporary,
+        OPEN_FILE_SYSTEM_CREATE_IF_NONEXISTENT,
+        base::Bind(&ExpectOk));
+    base::MessageLoop::current()->RunUntilIdle();
+  }
+
+  virtual void TearDown() OVERRIDE {
+    file_system_context_ = NULL;
+    base::MessageLoop::current()->RunUntilIdle();
+  }
+
+  FileSystemURL URL(const std::string& path) {
+    return file_system_context_->CreateCrackedFileSystemURL(
+        GURL(kOrigin), kFileSystemTypeTemporary,
+        base::FilePath::FromUTF8Unsafe(path));
+  }
+
+  // Builds a tree |depth| levels deep under |root|, where every directory
+  // has |fanout| subdirectories (except at the bottom) and |files| files.
+  // Returns the number of entries created.
+  int BuildTree(const std::string& root, int depth, int fanout, int files) {
+    EXPECT_EQ(base::PLATFORM_FILE_OK,
+              AsyncFileTestHelper::CreateDirectory(
+                  file_system_context_.get(), URL(root)));
+    int entries = 1;
+    for (int i = 0; i < files; ++i) {
+      EXPECT_EQ(base::PLATFORM_FILE_OK,
+                AsyncFileTestHelper::CreateFile(
+                    file_system_context_.get(),
+                    URL(base::StringPrintf("%s/file%d", root.c_str(), i))));
+      ++entries;
+    }
+    if (depth > 1) {
+      for (int i = 0; i < fanout; ++i) {
+        entries += BuildTree(base::StringPrintf("%s/dir%d", root.c_str(), i),
+                             depth - 1, fanout, files);
+      }
+    }
+    return entries;
+  }
+
+  // Copies a tree of the given shape and logs the copy rate, then removes
+  // the copy and logs the removal rate.
+  void RunTreeCopy(const char* name, int depth, int fanout, int files) {
+    int entries = BuildTree("src", depth, fanout, files);
+
+    PerfTimer copy_timer;
+    ASSERT_EQ(base::PLATFORM_FILE_OK,
+              AsyncFileTestHelper::Copy(file_system_context_.get(),
+                                        URL("src"), URL("dest")));
+    base::TimeDelta copy_elapsed = copy_timer.Elapsed();
+
+    PerfTimer remove_timer;
+    ASSERT_EQ(base::PLATFORM_FILE_OK,
+              AsyncFileTestHelper::Remove(file_system_context_.get(),
+                                          URL("dest"), true /* recursive */));
+    base::TimeDelta remove_elapsed = remove_timer.Elapsed();
+
+    LogPerfResult(base::StringPrintf("%s_copy", name).c_str(),
+                  entries / copy_elapsed.InSecondsF(), "entries/s");
+    LogPerfResult(base::StringPrintf("%s_remove", name).c_str(),
+                  entries / remove_elapsed.InSecondsF(), "entries/s");
+  }
+
+  // Resolves a path |depth| components deep in a directory database
+  // |kLookupIterations| times and logs the lookup rate.  With |cold| the
+  // database is reopened before every lookup.
+  void RunDeepLookup(const char* name, int depth, bool cold) {
+    base::ScopedTempDir db_dir;
+    ASSERT_TRUE(db_dir.CreateUniqueTempDir());
+    scoped_ptr<SandboxDirectoryDatabase> db(
+        new SandboxDirectoryDatabase(db_dir.path()));
+
+    std::vector<base::FilePath::StringType> names;
+    base::FilePath path;
+    for (int i = 0; i < depth; ++i) {
+      names.push_back(FILE_PATH_LITERAL("directory"));
+      path = path.Append(names.back());
+    }
+    SandboxDirectoryDatabase::FileId leaf_id;
+    ASSERT_TRUE(db->AddDirectoryChain(0, names, base::Time::Now(), &leaf_id));
+
+    int iterations = cold ? kLookupIterations / 100 : kLookupIterations;
+    PerfTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+      if (cold) {
+        db.reset();
+        db.reset(new SandboxDirectoryDatabase(db_dir.path()));
+      }
+      SandboxDirectoryDatabase::FileId file_id;
+      ASSERT_TRUE(db->GetFileWithPath(path, &file_id));
+      ASSERT_EQ(leaf_id, file_id);
+    }
+    base::TimeDelta elapsed = timer.Elapsed();
+
+    LogPerfResult(base::StringPrintf("%s_lookup", name).c_str(),
+                  iterations / elapsed.InSecondsF(), "lookups/s");
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::ScopedTempDir temp_dir_;
+  scoped_refptr<FileSystemContext> file_system_context_;
+};
+
+TEST_F(SandboxFileSystemPerfTest, WideTreeCopy) {
+  RunTreeCopy("SandboxFileSystem_wide_tree", 2, 4, 100);
+}
+
+TEST_F(SandboxFileSystemPerfTest, DeepTreeCopy) {
+  RunTreeCopy("SandboxFileSystem_deep_tree", 5, 3, 4);
+}
+
+TEST_F(SandboxFileSystemPerfTest, DeepPathLookup) {
+  RunDeepLookup("SandboxDirectoryDatabase_depth32", 32, false);
+}
+
+TEST_F(SandboxFileSystemPerfTest, DeepPathLookupCold) {
+  RunDeepLookup("SandboxDirectoryDatabase_depth32_cold", 32, true);
+}
+
+}  // namespace fileapi
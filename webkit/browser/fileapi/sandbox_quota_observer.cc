@@ -7,6 +7,7 @@
 #include "base/sequenced_task_runner.h"
 #include "webkit/browser/fileapi/file_system_url.h"
 #include "webkit/browser/fileapi/file_system_usage_cache.h"
+#include "webkit/browser/fileapi/obfuscated_file_util.h"
 #include "webkit/browser/fileapi/sandbox_context.h"
 #include "webkit/browser/fileapi/timed_task_helper.h"
 #include "webkit/browser/quota/quota_client.h"
@@ -32,7 +33,10 @@ void SandboxQuotaObserver::OnStartUpdate(const FileSystemURL& url) {
   base::FilePath usage_file_path = GetUsageCachePath(url);
   if (usage_file_path.empty())
     return;
-  file_system_usage_cache_->IncrementDirty(usage_file_path);
+  // Journal the entry's current usage so that a crash before OnEndUpdate()
+  // can be recovered by re-measuring it rather than the whole origin.
+  file_system_usage_cache_->StartJournaledUpdate(
+      usage_file_path, url.path(), sandbox_file_util_->ComputeEntryUsage(url));
 }
 
 void SandboxQuotaObserver::OnUpdate(const FileSystemURL& url,
@@ -51,7 +55,7 @@ void SandboxQuotaObserver::OnUpdate(const FileSystemURL& url,
   if (usage_file_path.empty())
     return;
 
-  pending_update_notification_[usage_file_path] += delta;
+  pending_update_notification_[usage_file_path][url.path()] += delta;
   if (!delayed_cache_update_helper_) {
     delayed_cache_update_helper_.reset(
         new TimedTaskHelper(update_notify_runner_.get()));
@@ -77,7 +81,7 @@ void SandboxQuotaObserver::OnEndUpdate(const FileSystemURL& url) {
     pending_update_notification_.erase(found);
   }
 
-  file_system_usage_cache_->DecrementDirty(usage_file_path);
+  file_system_usage_cache_->EndJournaledUpdate(usage_file_path, url.path());
 }
 
 void SandboxQuotaObserver::OnAccess(const FileSystemURL& url) {
@@ -130,10 +134,11 @@ void SandboxQuotaObserver::ApplyPendingUsageUpdate() {
 
 void SandboxQuotaObserver::UpdateUsageCacheFile(
     const base::FilePath& usage_file_path,
-    int64 delta) {
+    const EntryDeltaMap& deltas) {
   DCHECK(!usage_file_path.empty());
-  if (!usage_file_path.empty() && delta != 0)
-    file_system_usage_cache_->AtomicUpdateUsageByDelta(usage_file_path, delta);
+  if (!usage_file_path.empty() && !deltas.empty())
+    file_system_usage_cache_->AtomicUpdateJournaledUsage(usage_file_path,
+                                                         deltas);
 }
 
 }  // namespace fileapi
@@ -35,7 +35,9 @@ class SandboxQuotaObserver
     : public FileUpdateObserver,
       public FileAccessObserver {
  public:
-  typedef std::map<base::FilePath, int64> PendingUpdateNotificationMap;
+  // Pending deltas keyed by the entry's virtual path, for one usage file.
+  typedef std::map<base::FilePath, int64> EntryDeltaMap;
+  typedef std::map<base::FilePath, EntryDeltaMap> PendingUpdateNotificationMap;
 
   SandboxQuotaObserver(
       quota::QuotaManagerProxy* quota_manager_proxy,
@@ -58,7 +60,8 @@ class SandboxQuotaObserver
 
  private:
   void ApplyPendingUsageUpdate();
-  void UpdateUsageCacheFile(const base::FilePath& usage_file_path, int64 delta);
+  void UpdateUsageCacheFile(const base::FilePath& usage_file_path,
+                            const EntryDeltaMap& deltas);
 
   base::FilePath GetUsageCachePath(const FileSystemURL& url);
 
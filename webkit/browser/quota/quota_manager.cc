@@ -1162,6 +1162,8 @@ void QuotaManager::LazyInitialize() {
     return;
   }
 
+  initialization_start_time_ = base::TimeTicks::Now();
+
   // Use an empty path to open an in-memory only databse for incognito.
   database_.reset(new QuotaDatabase(is_incognito_ ? base::FilePath() :
       profile_path_.AppendASCII(kDatabaseName)));
@@ -1508,6 +1510,11 @@ void QuotaManager::DidGetLRUOrigin(const GURL* origin,
 
 void QuotaManager::DidGetInitialTemporaryGlobalQuota(
     QuotaStatusCode status, int64 quota_unused) {
+  // The initial temporary quota is derived from the global usage, so this is
+  // the time it takes to learn the usage of every origin at startup.
+  UMA_HISTOGRAM_LONG_TIMES("Quota.TimeToInitialGlobalUsage",
+                           base::TimeTicks::Now() - initialization_start_time_);
+
   if (eviction_disabled_)
     return;
 
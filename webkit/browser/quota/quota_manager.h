@@ -20,6 +20,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
 #include "base/sequenced_task_runner_helpers.h"
+#include "base/time/time.h"
 #include "webkit/browser/quota/quota_callbacks.h"
 #include "webkit/browser/quota/quota_client.h"
 #include "webkit/browser/quota/quota_database.h"
@@ -402,6 +403,10 @@ class WEBKIT_STORAGE_BROWSER_EXPORT QuotaManager
   bool temporary_quota_initialized_;
   int64 temporary_quota_override_;
 
+  // When LazyInitialize() started, for reporting how long it takes to get
+  // the initial global usage of every client.
+  base::TimeTicks initialization_start_time_;
+
   int64 desired_available_space_;
 
   // Map from origin to count.